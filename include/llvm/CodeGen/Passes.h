@@ -149,9 +149,10 @@ namespace llvm {
   RegisterCoalescer *createSimpleRegisterCoalescer();
 
   /// PrologEpilogCodeInserter Pass - This pass inserts prolog and epilog code,
-  /// and eliminates abstract frame references.
+  /// and eliminates abstract frame references. ShrinkWrap enables the shrink
+  /// wrapping of callee saved registers as --shrink-wrap does.
   ///
-  FunctionPass *createPrologEpilogCodeInserter();
+  FunctionPass *createPrologEpilogCodeInserter(bool ShrinkWrap = false);
 
   /// LowerSubregs Pass - This pass lowers subregs to register-register copies
   /// which yields suboptimal, but correct code if the register allocator
@@ -20,7 +20,11 @@ struct MCFixupKindInfo {
     FKF_IsPCRel = (1 << 0),
     
     /// Should this fixup kind force a 4-byte aligned effective PC value?
-    FKF_IsAlignedDownTo32Bits = (1 << 1)
+    FKF_IsAlignedDownTo32Bits = (1 << 1),
+
+    /// Should this fixup kind force a 32-byte aligned effective PC value? This
+    /// is the address of the fetch packet on the TI C6000 family.
+    FKF_IsAlignedDownTo32Bytes = (1 << 2)
   };
 
   /// A target specific name for the fixup kind. The names will be unique for
@@ -141,6 +141,7 @@ enum {
   EM_ALPHA = 41,    // DEC Alpha
   EM_SPARCV9 = 43,  // SPARC V9
   EM_X86_64 = 62,   // AMD64
+  EM_TI_C6000 = 140, // TI TMS320C6000 DSP family
   EM_MBLAZE = 47787 // Xilinx MicroBlaze
 };
 
@@ -290,6 +291,21 @@ enum {
   R_MICROBLAZE_COPY           = 21
 };
 
+// TI C6000 relocations (the subset used by the TMS320C64X backend).
+enum {
+  R_C6000_NONE                = 0,
+  R_C6000_ABS32               = 1,
+  R_C6000_ABS16               = 2,
+  R_C6000_ABS8                = 3,
+  R_C6000_PCR_S21             = 4,
+  R_C6000_PCR_S12             = 5,
+  R_C6000_PCR_S10             = 6,
+  R_C6000_PCR_S7              = 7,
+  R_C6000_ABS_S16             = 8,
+  R_C6000_ABS_L16             = 9,
+  R_C6000_ABS_H16             = 10
+};
+
 
 // ARM Specific e_flags
 enum { EF_ARM_EABIMASK = 0xFF000000U };
@@ -134,6 +134,17 @@ public:
     return false;
   }
 
+  /// getCalleeSavedSpillPartner - Returns the index of the entry of CSI that
+  /// spillCalleeSavedRegisters and restoreCalleeSavedRegisters save and
+  /// restore together with CSI[Idx], or Idx if it is saved on its own. Shrink
+  /// wrapping places such entries in the same blocks.
+  virtual unsigned
+  getCalleeSavedSpillPartner(const MachineFunction &MF,
+                             const std::vector<CalleeSavedInfo> &CSI,
+                             unsigned Idx) const {
+    return Idx;
+  }
+
   /// hasFP - Return true if the specified function should have a dedicated
   /// frame pointer register. For most targets this is true only if the function
   /// has variable sized allocas or if frame pointer elimination is disabled.
@@ -767,6 +767,26 @@ public:
     return PrefLoopAlignment;
   }
 
+  /// getMinimumJumpTableEntries - return the number of cases a switch (or a
+  /// range of one) needs before it is lowered to a jump table (if never set,
+  /// the default is 4)
+  unsigned getMinimumJumpTableEntries() const {
+    return MinimumJumpTableEntries;
+  }
+
+  /// getMinimumJumpTableDensity - return the percentage of jump table
+  /// entries that need to be case values rather than the default (if never
+  /// set, the default is 40)
+  unsigned getMinimumJumpTableDensity() const {
+    return MinimumJumpTableDensity;
+  }
+
+  /// preferJumpTablesToBitTests - return true if a switch should rather be
+  /// lowered to a jump table than to bit tests, if it qualifies for both
+  bool preferJumpTablesToBitTests() const {
+    return PreferJumpTablesToBitTests;
+  }
+
   /// getShouldFoldAtomicFences - return whether the combiner should fold
   /// fence MEMBARRIER instructions into the atomic intrinsic instructions.
   ///
@@ -1178,6 +1198,25 @@ protected:
     MinStackArgumentAlignment = Align;
   }
 
+  /// setMinimumJumpTableEntries - Set the number of cases a switch needs
+  /// before it is lowered to a jump table; default is 4
+  void setMinimumJumpTableEntries(unsigned Num) {
+    MinimumJumpTableEntries = Num;
+  }
+
+  /// setMinimumJumpTableDensity - Set the percentage of jump table entries
+  /// that need to be case values; default is 40
+  void setMinimumJumpTableDensity(unsigned Percent) {
+    MinimumJumpTableDensity = Percent;
+  }
+
+  /// setPreferJumpTablesToBitTests - Tells the code generator to lower a
+  /// switch to a jump table rather than to bit tests, if it qualifies for
+  /// both. Defaults to false
+  void setPreferJumpTablesToBitTests(bool Prefer = true) {
+    PreferJumpTablesToBitTests = Prefer;
+  }
+
   /// setShouldFoldAtomicFences - Set if the target's implementation of the
   /// atomic operation intrinsics includes locking. Default is false.
   void setShouldFoldAtomicFences(bool fold) {
@@ -1684,6 +1723,18 @@ private:
   ///
   unsigned PrefLoopAlignment;
 
+  /// MinimumJumpTableEntries - The number of cases a switch needs before it
+  /// is lowered to a jump table.
+  unsigned MinimumJumpTableEntries;
+
+  /// MinimumJumpTableDensity - The percentage of jump table entries that
+  /// need to be case values.
+  unsigned MinimumJumpTableDensity;
+
+  /// PreferJumpTablesToBitTests - Lower a switch qualifying for both to a
+  /// jump table rather than to bit tests.
+  bool PreferJumpTablesToBitTests;
+
   /// ShouldFoldAtomicFences - Whether fencing MEMBARRIER instructions should
   /// be folded into the enclosed atomic intrinsic instruction by the
   /// combiner.
@@ -141,6 +141,13 @@ public:
   /// getEnableTailMergeDefault - the default setting for -enable-tail-merge
   /// on this target.  User flag overrides.
   virtual bool getEnableTailMergeDefault() const { return true; }
+
+  /// getEnableShrinkWrapDefault - whether callee saved registers are shrink
+  /// wrapped on this target without --shrink-wrap. The shrink wrapped spills
+  /// and restores then go through spillCalleeSavedRegisters and
+  /// restoreCalleeSavedRegisters, which must handle any subset of the callee
+  /// saved registers at any block.
+  virtual bool getEnableShrinkWrapDefault() const { return false; }
 };
 
 } // End llvm namespace
@@ -58,7 +58,9 @@ STATISTIC(NumScavengedRegs, "Number of frame index regs scavenged");
 /// createPrologEpilogCodeInserter - This function returns a pass that inserts
 /// prolog and epilog code, and eliminates abstract frame references.
 ///
-FunctionPass *llvm::createPrologEpilogCodeInserter() { return new PEI(); }
+FunctionPass *llvm::createPrologEpilogCodeInserter(bool ShrinkWrap) {
+  return new PEI(ShrinkWrap);
+}
 
 /// runOnMachineFunction - Insert prolog/epilog code and replace abstract
 /// frame indexes with appropriate references.
@@ -381,7 +383,12 @@ void PEI::insertCSRSpillsAndRestores(MachineFunction &Fn) {
 
     I = MBB->begin();
 
-    // When shrink wrapping, use stack slot stores/loads.
+    // When shrink wrapping, use stack slot stores/loads. Targets that enable
+    // shrink wrapping themselves spill through the target interface.
+    if (ShrinkWrapDefault &&
+        TFI->spillCalleeSavedRegisters(*MBB, I, blockCSI, TRI))
+      continue;
+
     for (unsigned i = 0, e = blockCSI.size(); i != e; ++i) {
       // Add the callee-saved register as live-in.
       // It's killed at the spill.
@@ -438,6 +445,10 @@ void PEI::insertCSRSpillsAndRestores(MachineFunction &Fn) {
 
     // Restore all registers immediately before the return and any
     // terminators that preceed it.
+    if (ShrinkWrapDefault &&
+        TFI->restoreCalleeSavedRegisters(*MBB, I, blockCSI, TRI))
+      continue;
+
     for (unsigned i = 0, e = blockCSI.size(); i != e; ++i) {
       unsigned Reg = blockCSI[i].getReg();
       const TargetRegisterClass *RC = TRI->getMinimalPhysRegClass(Reg);
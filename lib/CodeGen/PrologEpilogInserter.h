@@ -36,7 +36,8 @@ namespace llvm {
   class PEI : public MachineFunctionPass {
   public:
     static char ID;
-    PEI() : MachineFunctionPass(ID) {
+    PEI(bool ShrinkWrap = false)
+      : MachineFunctionPass(ID), ShrinkWrapDefault(ShrinkWrap) {
       initializePEIPass(*PassRegistry::getPassRegistry());
     }
 
@@ -96,6 +97,10 @@ namespace llvm {
     // functions.
     bool ShrinkWrapThisFunction;
 
+    // Shrink wrap even without --shrink-wrap, the target asked for it and
+    // places the spills and restores itself.
+    bool ShrinkWrapDefault;
+
     // Flag to control whether to use the register scavenger to resolve
     // frame index materialization registers. Set according to
     // TRI->requiresFrameIndexScavenging() for the curren function.
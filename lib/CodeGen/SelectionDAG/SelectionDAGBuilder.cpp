@@ -1888,29 +1888,46 @@ static APInt ComputeRange(const APInt &First, const APInt &Last) {
   return (LastExt - FirstExt + 1ULL);
 }
 
-/// handleJTSwitchCase - Emit jumptable for current switch case range
-bool SelectionDAGBuilder::handleJTSwitchCase(CaseRec& CR,
-                                             CaseRecVector& WorkList,
-                                             const Value* SV,
-                                             MachineBasicBlock* Default,
-                                             MachineBasicBlock *SwitchBB) {
+/// isJumpTableRange - Returns true if the current switch case range has
+/// enough cases and is dense enough to be emitted as a jumptable. The bounds,
+/// number of cases, range and density of the table are returned in any case.
+bool SelectionDAGBuilder::isJumpTableRange(CaseRec& CR, APInt &First,
+                                           APInt &Last, APInt &TSize,
+                                           APInt &Range, double &Density) {
   Case& FrontCase = *CR.Range.first;
   Case& BackCase  = *(CR.Range.second-1);
 
-  const APInt &First = cast<ConstantInt>(FrontCase.Low)->getValue();
-  const APInt &Last  = cast<ConstantInt>(BackCase.High)->getValue();
+  First = cast<ConstantInt>(FrontCase.Low)->getValue();
+  Last  = cast<ConstantInt>(BackCase.High)->getValue();
 
-  APInt TSize(First.getBitWidth(), 0);
+  TSize = APInt(First.getBitWidth(), 0);
   for (CaseItr I = CR.Range.first, E = CR.Range.second;
        I!=E; ++I)
     TSize += I->size();
 
-  if (!areJTsAllowed(TLI) || TSize.ult(4))
+  Range = ComputeRange(First, Last);
+  Density = TSize.roundToDouble() / Range.roundToDouble();
+
+  if (!areJTsAllowed(TLI) || TSize.ult(TLI.getMinimumJumpTableEntries()))
     return false;
 
-  APInt Range = ComputeRange(First, Last);
-  double Density = TSize.roundToDouble() / Range.roundToDouble();
-  if (Density < 0.4)
+  // Sparse tables trade size for speed, not when optimizing for size
+  unsigned MinDensity = TLI.getMinimumJumpTableDensity();
+  if (FuncInfo.Fn->hasFnAttr(Attribute::OptimizeForSize))
+    MinDensity = std::max(MinDensity, 40U);
+
+  return Density >= MinDensity / 100.0;
+}
+
+/// handleJTSwitchCase - Emit jumptable for current switch case range
+bool SelectionDAGBuilder::handleJTSwitchCase(CaseRec& CR,
+                                             CaseRecVector& WorkList,
+                                             const Value* SV,
+                                             MachineBasicBlock* Default,
+                                             MachineBasicBlock *SwitchBB) {
+  APInt First, Last, TSize, Range;
+  double Density;
+  if (!isJumpTableRange(CR, First, Last, TSize, Range, Density))
     return false;
 
   DEBUG(dbgs() << "Lowering jump table\n"
@@ -2133,6 +2150,15 @@ bool SelectionDAGBuilder::handleBitTestsSwitchCase(CaseRec& CR,
   if (!TLI.isOperationLegal(ISD::SHL, TLI.getPointerTy()))
     return false;
 
+  // Bit tests branch once for each destination after the range check, a
+  // jumptable dispatches to all of them with a single (indirect) branch.
+  if (TLI.preferJumpTablesToBitTests()) {
+    APInt First, Last, TSize, Range;
+    double Density;
+    if (isJumpTableRange(CR, First, Last, TSize, Range, Density))
+      return false;
+  }
+
   size_t numCmps = 0;
   for (CaseItr I = CR.Range.first, E = CR.Range.second;
        I!=E; ++I) {
@@ -412,6 +412,8 @@ private:
   void visitUnreachable(const UnreachableInst &I) { /* noop */ }
 
   // Helpers for visitSwitch
+  bool isJumpTableRange(CaseRec& CR, APInt &First, APInt &Last,
+                        APInt &TSize, APInt &Range, double &Density);
   bool handleSmallSwitchRange(CaseRec& CR,
                               CaseRecVector& WorkList,
                               const Value* SV,
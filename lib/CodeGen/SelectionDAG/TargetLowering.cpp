@@ -584,6 +584,9 @@ TargetLowering::TargetLowering(const TargetMachine &tm,
   JumpBufSize = 0;
   JumpBufAlignment = 0;
   PrefLoopAlignment = 0;
+  MinimumJumpTableEntries = 4;
+  MinimumJumpTableDensity = 40;
+  PreferJumpTablesToBitTests = false;
   MinStackArgumentAlignment = 1;
   ShouldFoldAtomicFences = false;
 
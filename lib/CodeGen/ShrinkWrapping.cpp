@@ -41,6 +41,7 @@
 #include "llvm/CodeGen/MachineFrameInfo.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetFrameLowering.h"
 #include "llvm/Target/TargetRegisterInfo.h"
 #include "llvm/ADT/SparseBitVector.h"
 #include "llvm/ADT/DenseMap.h"
@@ -87,7 +88,7 @@ ShrinkWrapDebugging("shrink-wrap-dbg", cl::Hidden,
 
 void PEI::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.setPreservesCFG();
-  if (ShrinkWrapping || ShrinkWrapFunc != "") {
+  if (ShrinkWrapping || ShrinkWrapDefault || ShrinkWrapFunc != "") {
     AU.addRequired<MachineLoopInfo>();
     AU.addRequired<MachineDominatorTree>();
   }
@@ -153,7 +154,7 @@ void PEI::initShrinkWrappingInfo() {
 #ifndef NDEBUG
   HasFastExitPath = false;
 #endif
-  ShrinkWrapThisFunction = ShrinkWrapping;
+  ShrinkWrapThisFunction = ShrinkWrapping || ShrinkWrapDefault;
   // DEBUG: enable or disable shrink wrapping for the current function
   // via --shrink-wrap-func=<funcname>.
 #ifndef NDEBUG
@@ -402,6 +403,7 @@ bool PEI::calculateSets(MachineFunction &Fn) {
   MachineLoopInfo &LI = getAnalysis<MachineLoopInfo>();
   MachineDominatorTree &DT = getAnalysis<MachineDominatorTree>();
   const TargetRegisterInfo *TRI = Fn.getTarget().getRegisterInfo();
+  const TargetFrameLowering *TFI = Fn.getTarget().getFrameLowering();
 
   bool allCSRUsesInEntryBlock = true;
   for (MachineFunction::iterator MBBI = Fn.begin(), MBBE = Fn.end();
@@ -437,6 +439,11 @@ bool PEI::calculateSets(MachineFunction &Fn) {
     if (CSRUsed[MBB].empty())
       continue;
 
+    // CSRs the target saves and restores together are used together.
+    for (unsigned inx = 0, e = CSI.size(); inx != e; ++inx)
+      if (CSRUsed[MBB].test(inx))
+        CSRUsed[MBB].set(TFI->getCalleeSavedSpillPartner(Fn, CSI, inx));
+
     // Propagate CSRUsed[MBB] in loops
     if (MachineLoop* LP = LI.getLoopFor(MBB)) {
       // Add top level loop to work list.
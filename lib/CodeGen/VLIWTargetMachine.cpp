@@ -425,7 +425,8 @@ bool VLIWTargetMachine::addCommonCodeGenPasses(PassManagerBase &PM,
   printAndVerify(PM, "After LowerSubregs");
 
   // Insert prolog/epilog code.  Eliminate abstract frame index references...
-  PM.add(createPrologEpilogCodeInserter());
+  PM.add(createPrologEpilogCodeInserter(OptLevel != CodeGenOpt::None &&
+                                        getEnableShrinkWrapDefault()));
   printAndVerify(PM, "After PrologEpilogCodeInserter");
 
   // Branch folding must be run after regalloc and prolog/epilog insertion.
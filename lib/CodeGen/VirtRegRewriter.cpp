@@ -2016,18 +2016,18 @@ void LocalRewriter::ProcessUses(MachineInstr &MI, AvailableSpills &Spills,
         CanReuse = !ReusedOperands.isClobbered(PhysReg) &&
           Spills.canClobberPhysReg(PhysReg);
       }
-      // If this is an asm, and a PhysReg alias is used elsewhere as an
-      // earlyclobber operand, we can't also use it as an input.
-      if (MI.isInlineAsm()) {
-        for (unsigned k = 0, e = MI.getNumOperands(); k != e; ++k) {
-          MachineOperand &MOk = MI.getOperand(k);
-          if (MOk.isReg() && MOk.isEarlyClobber() &&
-              TRI->regsOverlap(MOk.getReg(), PhysReg)) {
-            CanReuse = false;
-            DEBUG(dbgs() << "Not reusing physreg " << TRI->getName(PhysReg)
-                         << " for vreg" << VirtReg << ": " << MOk << '\n');
-            break;
-          }
+      // If a PhysReg alias is used elsewhere as an earlyclobber operand, we
+      // can't also use it as an input. This holds for asms as well as for
+      // instructions with an earlyclobber def next to a tied use, e.g. a load
+      // that writes back its base register.
+      for (unsigned k = 0, e = MI.getNumOperands(); k != e; ++k) {
+        MachineOperand &MOk = MI.getOperand(k);
+        if (MOk.isReg() && MOk.isEarlyClobber() &&
+            TRI->regsOverlap(MOk.getReg(), PhysReg)) {
+          CanReuse = false;
+          DEBUG(dbgs() << "Not reusing physreg " << TRI->getName(PhysReg)
+                       << " for vreg" << VirtReg << ": " << MOk << '\n');
+          break;
         }
       }
 
@@ -28,6 +28,7 @@
 
 #include "../Target/X86/X86FixupKinds.h"
 #include "../Target/ARM/ARMFixupKinds.h"
+#include "../Target/TMS320C64X/TMS320C64XFixupKinds.h"
 
 #include <vector>
 using namespace llvm;
@@ -1106,6 +1107,8 @@ MCObjectWriter *llvm::createELFObjectWriter(MCELFObjectTargetWriter *MOTW,
       return new ARMELFObjectWriter(MOTW, OS, IsLittleEndian); break;
     case ELF::EM_MBLAZE:
       return new MBlazeELFObjectWriter(MOTW, OS, IsLittleEndian); break;
+    case ELF::EM_TI_C6000:
+      return new TMS320C64XELFObjectWriter(MOTW, OS, IsLittleEndian); break;
     default: llvm_unreachable("Unsupported architecture"); break;
   }
 }
@@ -1319,6 +1322,59 @@ unsigned MBlazeELFObjectWriter::GetRelocType(const MCValue &Target,
   return Type;
 }
 
+//===- TMS320C64XELFObjectWriter ---------------------------------------===//
+
+TMS320C64XELFObjectWriter::TMS320C64XELFObjectWriter(
+                                             MCELFObjectTargetWriter *MOTW,
+                                             raw_ostream &_OS,
+                                             bool IsLittleEndian)
+  : ELFObjectWriter(MOTW, _OS, IsLittleEndian) {
+}
+
+TMS320C64XELFObjectWriter::~TMS320C64XELFObjectWriter() {
+}
+
+unsigned TMS320C64XELFObjectWriter::GetRelocType(const MCValue &Target,
+                                                 const MCFixup &Fixup,
+                                                 bool IsPCRel,
+                                                 bool IsRelocWithSymbol,
+                                                 int64_t Addend) {
+  // determine the type of the relocation
+  unsigned Type;
+  if (IsPCRel) {
+    switch ((unsigned)Fixup.getKind()) {
+    default:
+      llvm_unreachable("Unimplemented");
+    case TMS320C64X::fixup_c64x_pcr_s21:
+      Type = ELF::R_C6000_PCR_S21;
+      break;
+    case TMS320C64X::fixup_c64x_pcr_s10:
+      Type = ELF::R_C6000_PCR_S10;
+      break;
+    }
+  } else {
+    switch ((unsigned)Fixup.getKind()) {
+    default: llvm_unreachable("invalid fixup kind!");
+    case FK_Data_4:
+      Type = ELF::R_C6000_ABS32;
+      break;
+    case FK_Data_2:
+      Type = ELF::R_C6000_ABS16;
+      break;
+    case FK_Data_1:
+      Type = ELF::R_C6000_ABS8;
+      break;
+    case TMS320C64X::fixup_c64x_abs_l16:
+      Type = ELF::R_C6000_ABS_L16;
+      break;
+    case TMS320C64X::fixup_c64x_abs_h16:
+      Type = ELF::R_C6000_ABS_H16;
+      break;
+    }
+  }
+  return Type;
+}
+
 //===- X86ELFObjectWriter -------------------------------------------===//
 
 
@@ -386,6 +386,21 @@ class ELFObjectWriter : public MCObjectWriter {
                                   bool IsPCRel, bool IsRelocWithSymbol,
                                   int64_t Addend);
   };
+
+  //===- TMS320C64XELFObjectWriter ---------------------------------------===//
+
+  class TMS320C64XELFObjectWriter : public ELFObjectWriter {
+  public:
+    TMS320C64XELFObjectWriter(MCELFObjectTargetWriter *MOTW,
+                              raw_ostream &_OS,
+                              bool IsLittleEndian);
+
+    virtual ~TMS320C64XELFObjectWriter();
+  protected:
+    virtual unsigned GetRelocType(const MCValue &Target, const MCFixup &Fixup,
+                                  bool IsPCRel, bool IsRelocWithSymbol,
+                                  int64_t Addend);
+  };
 }
 
 #endif
@@ -267,12 +267,20 @@ bool MCAssembler::EvaluateFixup(const MCAsmLayout &Layout,
   assert((ShouldAlignPC ? IsPCRel : true) &&
     "FKF_IsAlignedDownTo32Bits is only allowed on PC-relative fixups!");
 
+  bool ShouldAlignFP = Backend.getFixupKindInfo(Fixup.getKind()).Flags &
+                         MCFixupKindInfo::FKF_IsAlignedDownTo32Bytes;
+  assert((ShouldAlignFP ? IsPCRel : true) &&
+    "FKF_IsAlignedDownTo32Bytes is only allowed on PC-relative fixups!");
+
   if (IsPCRel) {
     uint32_t Offset = Layout.getFragmentOffset(DF) + Fixup.getOffset();
     
     // A number of ARM fixups in Thumb mode require that the effective PC
     // address be determined as the 32-bit aligned version of the actual offset.
     if (ShouldAlignPC) Offset &= ~0x3;
+
+    // TI C6000 branches are relative to the fetch packet of the branch.
+    if (ShouldAlignFP) Offset &= ~0x1f;
     Value -= Offset;
   }
 
@@ -0,0 +1,373 @@
+//===-- BranchOnCounter.cpp - TMS320C64X bdec/bpos formation --------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Closes counted loops with bpos/bdec, two passes:
+//
+//  - before register allocation, a conditional branch taken while a register
+//    is not negative (cmpgt x, -1 or its negation cmplt x, 0, the form that
+//    CounterLoops.cpp leaves in loop latches) becomes bpos on that register.
+//    This saves the compare, the predicate register and the constant
+//  - after register allocation, a latch that counts its register down right
+//    before bpos, and does not touch it otherwise, gets bdec instead. bdec
+//    tests before it decrements, so the decrement moves to the preheader
+//
+// The branch then only waits for the counter, the post RA scheduler issues
+// it as early as its delay slots permit.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "c64x-bdec"
+#include "TMS320C64X.h"
+#include "TMS320C64XInstrInfo.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetRegisterInfo.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+STATISTIC(NumBPos, "Number of branches turned into bpos");
+STATISTIC(NumBDec, "Number of loops closed with bdec");
+
+namespace {
+
+  struct BranchOnCounterSelect : public MachineFunctionPass {
+    static char ID;
+    const TargetInstrInfo *TII;
+    MachineRegisterInfo *MRI;
+
+    BranchOnCounterSelect(TargetMachine &tm)
+      : MachineFunctionPass(ID), TII(tm.getInstrInfo()), MRI(0) {}
+
+    virtual const char *getPassName() const {
+      return "TMS320C64X bpos Selection";
+    }
+
+    bool runOnMachineFunction(MachineFunction &MF);
+
+  private:
+    MachineInstr *getDef(unsigned Reg) const;
+    bool isConstant(const MachineOperand &MO, int Val) const;
+    void eraseIfDead(unsigned Reg);
+    bool selectBranch(MachineBasicBlock &MBB);
+  };
+
+  struct BranchOnCounterFusion : public MachineFunctionPass {
+    static char ID;
+    const TargetInstrInfo *TII;
+    const TargetRegisterInfo *TRI;
+
+    BranchOnCounterFusion(TargetMachine &tm)
+      : MachineFunctionPass(ID), TII(tm.getInstrInfo()),
+        TRI(tm.getRegisterInfo()) {}
+
+    virtual const char *getPassName() const {
+      return "TMS320C64X bdec Fusion";
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<MachineLoopInfo>();
+      MachineFunctionPass::getAnalysisUsage(AU);
+    }
+
+    bool runOnMachineFunction(MachineFunction &MF);
+
+  private:
+    bool fuseLoop(MachineLoop *L);
+  };
+
+  char BranchOnCounterSelect::ID = 0;
+  char BranchOnCounterFusion::ID = 0;
+}
+
+//-----------------------------------------------------------------------------
+
+FunctionPass *llvm::createTMS320C64XBranchOnCounterSelect(TargetMachine &tm) {
+  return new BranchOnCounterSelect(tm);
+}
+
+FunctionPass *llvm::createTMS320C64XBranchOnCounterFusion(TargetMachine &tm) {
+  return new BranchOnCounterFusion(tm);
+}
+
+//-----------------------------------------------------------------------------
+
+/// returns the definition of a virtual register, looking through copies
+MachineInstr *BranchOnCounterSelect::getDef(unsigned Reg) const {
+  while (TargetRegisterInfo::isVirtualRegister(Reg)) {
+    MachineInstr *Def = MRI->getVRegDef(Reg);
+    if (!Def || !Def->isCopy())
+      return Def;
+    Reg = Def->getOperand(1).getReg();
+  }
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+
+bool BranchOnCounterSelect::isConstant(const MachineOperand &MO,
+                                       int Val) const
+{
+  if (!MO.isReg())
+    return false;
+
+  MachineInstr *Def = getDef(MO.getReg());
+  if (!Def || TII->isPredicated(Def))
+    return false;
+
+  switch (Def->getOpcode()) {
+    case TMS320C64X::mvk_1:
+    case TMS320C64X::mvk_2:
+      return Def->getOperand(1).isImm() && Def->getOperand(1).getImm() == Val;
+    default:
+      return false;
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+/// erases the compare chain feeding a replaced branch once it is unused
+void BranchOnCounterSelect::eraseIfDead(unsigned Reg) {
+  if (!TargetRegisterInfo::isVirtualRegister(Reg)
+      || !MRI->use_nodbg_empty(Reg))
+    return;
+
+  MachineInstr *Def = MRI->getVRegDef(Reg);
+  if (!Def || Def->getNumOperands() == 0 || !Def->getOperand(0).isReg()
+      || Def->getOperand(0).getReg() != Reg)
+    return;
+
+  switch (Def->getOpcode()) {
+    case TMS320C64X::COPY:
+    case TMS320C64X::cmpgt_p_rr:
+    case TMS320C64X::cmplt_p_rr:
+    case TMS320C64X::mvk_1:
+    case TMS320C64X::mvk_2:
+      break;
+    default:
+      return;
+  }
+
+  SmallVector<unsigned, 2> Uses;
+  for (unsigned i = 1, e = Def->getNumOperands(); i != e; ++i) {
+    const MachineOperand &MO = Def->getOperand(i);
+    if (MO.isReg() && MO.getReg() && MO.isUse())
+      Uses.push_back(MO.getReg());
+  }
+
+  Def->eraseFromParent();
+  for (unsigned i = 0, e = Uses.size(); i != e; ++i)
+    eraseIfDead(Uses[i]);
+}
+
+//-----------------------------------------------------------------------------
+
+bool BranchOnCounterSelect::selectBranch(MachineBasicBlock &MBB) {
+  MachineBasicBlock::iterator Term = MBB.getFirstTerminator();
+  if (Term == MBB.end() || Term->getOpcode() != TMS320C64X::branch_cond)
+    return false;
+
+  MachineInstr *Br = Term;
+  MachineInstr *Next = llvm::next(Term) != MBB.end() ? llvm::next(Term) : 0;
+  if (Next && Next->getOpcode() != TMS320C64X::branch)
+    return false;
+
+  bool ContinueIfSet = Br->getOperand(1).getImm();
+  unsigned Pred = Br->getOperand(2).getReg();
+  MachineInstr *Cmp = getDef(Pred);
+  if (!Cmp || TII->isPredicated(Cmp))
+    return false;
+
+  // find x and whether the compare is set for x >= 0
+  const MachineOperand &Op1 = Cmp->getOperand(1);
+  const MachineOperand &Op2 = Cmp->getOperand(2);
+  const MachineOperand *Counter;
+  bool SetIfPositive;
+  switch (Cmp->getOpcode()) {
+    case TMS320C64X::cmpgt_p_rr:
+      if (isConstant(Op2, -1)) {
+        Counter = &Op1; SetIfPositive = true;
+      } else if (isConstant(Op1, 0)) {
+        Counter = &Op2; SetIfPositive = false;
+      } else
+        return false;
+      break;
+    case TMS320C64X::cmplt_p_rr:
+      if (isConstant(Op2, 0)) {
+        Counter = &Op1; SetIfPositive = false;
+      } else if (isConstant(Op1, -1)) {
+        Counter = &Op2; SetIfPositive = true;
+      } else
+        return false;
+      break;
+    default:
+      return false;
+  }
+
+  unsigned Reg = Counter->getReg();
+  if (!TargetRegisterInfo::isVirtualRegister(Reg))
+    return false;
+
+  // branching for x < 0 needs the targets swapped, which is only possible
+  // with an explicit branch to the other successor
+  bool Swap = SetIfPositive != ContinueIfSet;
+  if (Swap && !Next)
+    return false;
+
+  // the side follows the counter, unassigned registers go to A. Nothing is
+  // changed before this point, the branch is left alone on any bail-out.
+  const TargetRegisterClass *RC = MRI->getRegClass(Reg);
+  unsigned Opc = TMS320C64X::bpos_1;
+  if (RC == TMS320C64X::BRegsRegisterClass)
+    Opc = TMS320C64X::bpos_2;
+  else if (RC != TMS320C64X::ARegsRegisterClass &&
+           !MRI->constrainRegClass(Reg, TMS320C64X::ARegsRegisterClass))
+    return false;
+
+  MachineBasicBlock *Target = Br->getOperand(0).getMBB();
+  if (Swap) {
+    MachineBasicBlock *Other = Next->getOperand(0).getMBB();
+    Next->getOperand(0).setMBB(Target);
+    Target = Other;
+  }
+
+  TMS320C64XInstrInfo::addDefaultPred(BuildMI(MBB, Br, Br->getDebugLoc(),
+    TII->get(Opc)).addMBB(Target).addReg(Reg));
+
+  DEBUG(dbgs() << "bpos in BB#" << MBB.getNumber() << "\n");
+
+  // AnalyzeBranch gives up on counter branches, the branch folder would keep
+  // a branch to the layout successor behind the bpos
+  if (Next && MBB.isLayoutSuccessor(Next->getOperand(0).getMBB()))
+    Next->eraseFromParent();
+
+  Br->eraseFromParent();
+  eraseIfDead(Pred);
+  ++NumBPos;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool BranchOnCounterSelect::runOnMachineFunction(MachineFunction &MF) {
+  MRI = &MF.getRegInfo();
+
+  bool Changed = false;
+  for (MachineFunction::iterator I = MF.begin(), E = MF.end(); I != E; ++I)
+    Changed |= selectBranch(*I);
+  return Changed;
+}
+
+//-----------------------------------------------------------------------------
+
+bool BranchOnCounterFusion::fuseLoop(MachineLoop *L) {
+  MachineBasicBlock *Header = L->getHeader();
+  MachineBasicBlock *Latch = L->getLoopLatch();
+  MachineBasicBlock *Preheader = L->getLoopPreheader();
+  if (!Latch || !Preheader)
+    return false;
+
+  MachineBasicBlock::iterator Term = Latch->getFirstTerminator();
+  if (Term == Latch->end()
+      || (Term->getOpcode() != TMS320C64X::bpos_1
+          && Term->getOpcode() != TMS320C64X::bpos_2)
+      || Term->getOperand(0).getMBB() != Header)
+    return false;
+
+  MachineInstr *BPos = Term;
+  unsigned Reg = BPos->getOperand(1).getReg();
+
+  // the counter must be live only around the loop control
+  SmallVector<MachineBasicBlock*, 4> Exits;
+  L->getExitBlocks(Exits);
+  for (unsigned i = 0, e = Exits.size(); i != e; ++i)
+    if (Exits[i]->isLiveIn(Reg))
+      return false;
+
+  MachineInstr *Update = 0;
+  const std::vector<MachineBasicBlock*> &Blocks = L->getBlocks();
+  for (unsigned i = 0, e = Blocks.size(); i != e; ++i)
+    for (MachineBasicBlock::iterator I = Blocks[i]->begin(),
+         E = Blocks[i]->end(); I != E; ++I) {
+      // already scheduled
+      if (I->getOpcode() == TMS320C64X::BUNDLE_END)
+        return false;
+
+      if (&*I == BPos || I->isDebugValue()
+          || (!I->readsRegister(Reg, TRI) && !I->modifiesRegister(Reg, TRI)))
+        continue;
+
+      if (Update || Blocks[i] != Latch)
+        return false;
+
+      switch (I->getOpcode()) {
+        case TMS320C64X::add_ri_1:
+        case TMS320C64X::add_ri_2:
+        case TMS320C64X::addk_p:
+          if (I->getOperand(2).getImm() != -1)
+            return false;
+          break;
+        case TMS320C64X::sub_ri_1:
+        case TMS320C64X::sub_ri_2:
+          if (I->getOperand(2).getImm() != 1)
+            return false;
+          break;
+        default:
+          return false;
+      }
+
+      if (I->getOperand(0).getReg() != Reg || !I->getOperand(1).isReg()
+          || I->getOperand(1).getReg() != Reg
+          || TII->isPredicated(I))
+        return false;
+      Update = I;
+    }
+
+  if (!Update)
+    return false;
+
+  for (MachineBasicBlock::iterator I = Preheader->begin(),
+       E = Preheader->end(); I != E; ++I)
+    if (I->getOpcode() == TMS320C64X::BUNDLE_END)
+      return false;
+
+  // the loop enters with the counter one lower, bdec tests before it counts
+  Preheader->splice(Preheader->getFirstTerminator(), Latch, Update);
+
+  unsigned Opc = BPos->getOpcode() == TMS320C64X::bpos_1
+    ? TMS320C64X::bdec_1 : TMS320C64X::bdec_2;
+  TMS320C64XInstrInfo::addDefaultPred(BuildMI(*Latch, BPos,
+    BPos->getDebugLoc(), TII->get(Opc), Reg).addMBB(Header).addReg(Reg));
+  BPos->eraseFromParent();
+
+  DEBUG(dbgs() << "bdec in BB#" << Latch->getNumber() << "\n");
+  ++NumBDec;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool BranchOnCounterFusion::runOnMachineFunction(MachineFunction &MF) {
+  const MachineLoopInfo &MLI = getAnalysis<MachineLoopInfo>();
+
+  SmallVector<MachineLoop*, 8> Worklist(MLI.begin(), MLI.end());
+  bool Changed = false;
+  while (!Worklist.empty()) {
+    MachineLoop *L = Worklist.pop_back_val();
+    Worklist.append(L->begin(), L->end());
+    Changed |= fuseLoop(L);
+  }
+  return Changed;
+}
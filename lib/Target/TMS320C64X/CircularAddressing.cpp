@@ -0,0 +1,442 @@
+//===-- CircularAddressing.cpp - TMS320C64X AMR setup ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Circular buffer accesses (llvm.c64x.circ.*) are selected as post-modifying
+// loads and stores on one of A4-A7 that carry the log2 of their buffer size.
+// Which register they use is known only after register allocation, this pass
+// then writes the addressing mode register (AMR) accordingly:
+//
+//  - each of A4-A7 is switched to circular addressing using one of the two
+//    block size fields BK0/BK1, a block of 2^(N+1) bytes is encoded as N
+//  - if nothing in the function addresses memory through these registers in
+//    the ordinary way (and there are no calls), the AMR is written once on
+//    entry and cleared before each return
+//  - otherwise the AMR is set up in front of each run of circular accesses
+//    within a block and cleared after it. A run ends at calls (callees expect
+//    linear addressing), at terminators, and at ordinary accesses through a
+//    register that is circular within the run
+//
+// The AMR value is moved through a free B register, mvc only reads from .S2.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "circaddr"
+#include "TMS320C64X.h"
+#include "TMS320C64XInstrInfo.h"
+#include "llvm/Function.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetRegisterInfo.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+STATISTIC(NumCircAccesses, "Number of circular buffer accesses");
+STATISTIC(NumAMRWrites, "Number of AMR writes inserted");
+
+namespace {
+
+  // circular addressing is available for A4-A7, bits 2*i+1:2*i of the AMR
+  // hold the mode of A(4+i)
+  const unsigned NumCircRegs = 4;
+
+  // AMR modes and the position of the block size fields
+  const unsigned ModeBK0 = 1;
+  const unsigned ModeBK1 = 2;
+  const unsigned BK0Shift = 16;
+  const unsigned BK1Shift = 21;
+
+  /// AMR contents required by a run of circular accesses
+  struct AMRSetup {
+    unsigned Mode[NumCircRegs]; // ModeBK0/ModeBK1, 0 for linear addressing
+    unsigned Block[2];          // log2 of the block size, 0 if unused
+
+    AMRSetup() { clear(); }
+
+    void clear() {
+      for (unsigned i = 0; i != NumCircRegs; ++i)
+        Mode[i] = 0;
+      Block[0] = Block[1] = 0;
+    }
+
+    bool empty() const { return !Block[0] && !Block[1]; }
+
+    /// mask of the registers that are circular
+    unsigned regs() const {
+      unsigned mask = 0;
+      for (unsigned i = 0; i != NumCircRegs; ++i)
+        if (Mode[i])
+          mask |= 1 << i;
+      return mask;
+    }
+
+    /// adds register Reg addressing a buffer of 2^Log2 bytes, returns false
+    /// if the AMR can not hold this in addition
+    bool add(unsigned Reg, unsigned Log2) {
+      if (Mode[Reg])
+        return Block[Mode[Reg] - 1] == Log2;
+      for (unsigned i = 0; i != 2; ++i)
+        if (!Block[i] || Block[i] == Log2) {
+          Block[i] = Log2;
+          Mode[Reg] = i ? ModeBK1 : ModeBK0;
+          return true;
+        }
+      return false;
+    }
+
+    unsigned value() const {
+      unsigned val = 0;
+      for (unsigned i = 0; i != NumCircRegs; ++i)
+        val |= Mode[i] << (2 * i);
+      if (Block[0])
+        val |= (Block[0] - 1) << BK0Shift;
+      if (Block[1])
+        val |= (Block[1] - 1) << BK1Shift;
+      return val;
+    }
+  };
+
+  struct CircularAddressing : public MachineFunctionPass {
+    TargetMachine &TM;
+    const TMS320C64XInstrInfo *TII;
+    const TargetRegisterInfo *TRI;
+
+    static char ID;
+
+    CircularAddressing(TargetMachine &tm)
+    : MachineFunctionPass(ID),
+      TM(tm),
+      TII(static_cast<const TMS320C64XInstrInfo*>(tm.getInstrInfo())),
+      TRI(tm.getRegisterInfo())
+    {}
+
+    virtual const char *getPassName() const {
+      return "TMS320C64X Circular Addressing";
+    }
+
+    bool runOnMachineFunction(MachineFunction &MF);
+
+  private:
+    static bool isCircular(const MachineInstr *MI);
+    static int getCircReg(unsigned Reg);
+    unsigned getLinearUses(const MachineInstr *MI) const;
+    bool endsRun(const MachineInstr *MI) const;
+
+    bool setupFunction(MachineFunction &MF);
+    void setupBlock(MachineBasicBlock &MBB);
+
+    unsigned findScratch(MachineBasicBlock &MBB,
+                         MachineBasicBlock::iterator I) const;
+    void writeAMR(MachineBasicBlock &MBB, MachineBasicBlock::iterator I,
+                  unsigned Value) const;
+  };
+
+  char CircularAddressing::ID = 0;
+}
+
+//-----------------------------------------------------------------------------
+
+FunctionPass *llvm::createTMS320C64XCircularAddressingPass(TargetMachine &tm) {
+  return new CircularAddressing(tm);
+}
+
+//-----------------------------------------------------------------------------
+
+bool CircularAddressing::isCircular(const MachineInstr *MI) {
+  return MI->getDesc().TSFlags & TMS320C64XII::is_memcircular;
+}
+
+//-----------------------------------------------------------------------------
+
+/// returns the index of A4-A7 or -1 for any other register
+int CircularAddressing::getCircReg(unsigned Reg) {
+  switch (Reg) {
+    case TMS320C64X::A4: return 0;
+    case TMS320C64X::A5: return 1;
+    case TMS320C64X::A6: return 2;
+    case TMS320C64X::A7: return 3;
+    default: return -1;
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+/// returns the mask of A4-A7 used for address computations by an instruction
+/// that is not a circular access. These include the base of loads/stores and
+/// the operands of ADDA/SUBA, which honour the AMR as well
+unsigned CircularAddressing::getLinearUses(const MachineInstr *MI) const {
+  uint64_t flags = MI->getDesc().TSFlags;
+  unsigned mask = 0;
+
+  if (flags & TMS320C64XII::is_memaccess) {
+    const MachineOperand &MO =
+      MI->getOperand(TMS320C64XII::getMemBaseIdx(flags));
+    int reg = MO.isReg() ? getCircReg(MO.getReg()) : -1;
+    if (reg >= 0)
+      mask |= 1 << reg;
+    return mask;
+  }
+
+  switch (MI->getOpcode()) {
+    case TMS320C64X::add_am_d_1: case TMS320C64X::add_am_d_2:
+    case TMS320C64X::add_am_w_1: case TMS320C64X::add_am_w_2:
+    case TMS320C64X::add_am_h_1: case TMS320C64X::add_am_h_2:
+    case TMS320C64X::sub_am_w_1: case TMS320C64X::sub_am_w_2:
+    case TMS320C64X::sub_am_h_1: case TMS320C64X::sub_am_h_2:
+      for (unsigned i = 1; i != 3; ++i) {
+        const MachineOperand &MO = MI->getOperand(i);
+        int reg = MO.isReg() ? getCircReg(MO.getReg()) : -1;
+        if (reg >= 0)
+          mask |= 1 << reg;
+      }
+      break;
+  }
+  return mask;
+}
+
+//-----------------------------------------------------------------------------
+
+/// calls expect linear addressing, as does everything behind a terminator
+bool CircularAddressing::endsRun(const MachineInstr *MI) const {
+  const TargetInstrDesc &desc = MI->getDesc();
+  return desc.isCall() || desc.isTerminator() || MI->isInlineAsm();
+}
+
+//-----------------------------------------------------------------------------
+
+/// find a B register that is free in front of I, the value for the AMR is
+/// moved through it
+unsigned
+CircularAddressing::findScratch(MachineBasicBlock &MBB,
+                                MachineBasicBlock::iterator I) const
+{
+  MachineFunction &MF = *MBB.getParent();
+  BitVector Used = TRI->getReservedRegs(MF);
+  Used.set(TMS320C64X::B3);
+
+  // callee saved registers are only spilled if the allocator used them
+  for (const unsigned *CS = TRI->getCalleeSavedRegs(&MF); *CS; ++CS)
+    Used.set(*CS);
+
+  // live at I: live into a successor or read behind I before being defined
+  SmallVector<unsigned, 32> Live;
+  for (MachineBasicBlock::succ_iterator S = MBB.succ_begin(),
+       SE = MBB.succ_end(); S != SE; ++S)
+    for (MachineBasicBlock::livein_iterator LI = (*S)->livein_begin(),
+         LE = (*S)->livein_end(); LI != LE; ++LI)
+      Live.push_back(*LI);
+
+  BitVector LiveRegs(TRI->getNumRegs());
+  for (unsigned i = 0, e = Live.size(); i != e; ++i)
+    for (const unsigned *R = TRI->getOverlaps(Live[i]); *R; ++R)
+      LiveRegs.set(*R);
+
+  for (MachineBasicBlock::iterator MI = MBB.end(); MI != I; ) {
+    --MI;
+    for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+      const MachineOperand &MO = MI->getOperand(i);
+      if (MO.isReg() && MO.getReg() && MO.isDef() && !TII->isPredicated(MI))
+        for (const unsigned *R = TRI->getOverlaps(MO.getReg()); *R; ++R)
+          LiveRegs.reset(*R);
+    }
+    for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+      const MachineOperand &MO = MI->getOperand(i);
+      if (MO.isReg() && MO.getReg() && MO.isUse())
+        for (const unsigned *R = TRI->getOverlaps(MO.getReg()); *R; ++R)
+          LiveRegs.set(*R);
+    }
+  }
+
+  const TargetRegisterClass *RC = TMS320C64X::BRegsRegisterClass;
+  for (TargetRegisterClass::iterator R = RC->allocation_order_begin(MF),
+       RE = RC->allocation_order_end(MF); R != RE; ++R)
+    if (!Used.test(*R) && !LiveRegs.test(*R))
+      return *R;
+
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+
+void CircularAddressing::writeAMR(MachineBasicBlock &MBB,
+                                  MachineBasicBlock::iterator I,
+                                  unsigned Value) const
+{
+  unsigned Scratch = findScratch(MBB, I);
+  if (!Scratch)
+    report_fatal_error("no free register for setting up the AMR");
+
+  DebugLoc dl;
+  if (I != MBB.end())
+    dl = I->getDebugLoc();
+
+  if (TMS320C64XInstrInfo::check_sconst_fits(Value, 16))
+    TMS320C64XInstrInfo::addFormOp(TMS320C64XInstrInfo::addDefaultPred(
+      BuildMI(MBB, I, dl, TII->get(TMS320C64X::mvk_2), Scratch)
+        .addImm(Value)), TMS320C64XII::unit_s);
+  else {
+    TMS320C64XInstrInfo::addFormOp(TMS320C64XInstrInfo::addDefaultPred(
+      BuildMI(MBB, I, dl, TII->get(TMS320C64X::mvkl_2), Scratch)
+        .addImm(Value)), TMS320C64XII::unit_s);
+    TMS320C64XInstrInfo::addFormOp(TMS320C64XInstrInfo::addDefaultPred(
+      BuildMI(MBB, I, dl, TII->get(TMS320C64X::mvkh_2), Scratch)
+        .addImm(Value).addReg(Scratch)), TMS320C64XII::unit_s);
+  }
+
+  TMS320C64XInstrInfo::addDefaultPred(
+    BuildMI(MBB, I, dl, TII->get(TMS320C64X::mvc_amr), TMS320C64X::AMR)
+      .addReg(Scratch, RegState::Kill));
+  ++NumAMRWrites;
+}
+
+//-----------------------------------------------------------------------------
+
+/// sets up the AMR once for the whole function if possible
+bool CircularAddressing::setupFunction(MachineFunction &MF) {
+  AMRSetup setup;
+  unsigned linear = 0;
+
+  for (MachineFunction::iterator FI = MF.begin(), FE = MF.end();
+       FI != FE; ++FI)
+    for (MachineBasicBlock::iterator I = FI->begin(), E = FI->end();
+         I != E; ++I) {
+      if (isCircular(I)) {
+        uint64_t flags = I->getDesc().TSFlags;
+        int reg = getCircReg(
+          I->getOperand(TMS320C64XII::getMemBaseIdx(flags)).getReg());
+        unsigned log2 =
+          I->getOperand(TMS320C64XII::getMemBlockIdx(flags)).getImm();
+        if (!setup.add(reg, log2))
+          return false;
+      } else if (I->getDesc().isCall() || I->isInlineAsm())
+        return false;
+      else
+        linear |= getLinearUses(I);
+    }
+
+  if (linear & setup.regs())
+    return false;
+
+  // right behind the prolog of the entry block, and in front of each return
+  MachineBasicBlock &Entry = MF.front();
+  MachineBasicBlock::iterator I = Entry.begin();
+  while (I != Entry.end() && I->getOpcode() == TMS320C64X::prolog)
+    ++I;
+  writeAMR(Entry, I, setup.value());
+
+  for (MachineFunction::iterator FI = MF.begin(), FE = MF.end();
+       FI != FE; ++FI) {
+    MachineBasicBlock::iterator T = FI->getFirstTerminator();
+    if (T != FI->end() && T->getDesc().isReturn())
+      writeAMR(*FI, T, 0);
+  }
+
+  DEBUG(dbgs() << "AMR for all of " << MF.getFunction()->getName() << ": "
+        << format("0x%08x", setup.value()) << "\n");
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+/// sets up the AMR for each run of circular accesses within the block
+void CircularAddressing::setupBlock(MachineBasicBlock &MBB) {
+  AMRSetup setup;
+  MachineBasicBlock::iterator Begin = MBB.end();
+  unsigned linear = 0;
+
+  for (MachineBasicBlock::iterator I = MBB.begin(), E = MBB.end(); I != E;
+       ++I) {
+    if (isCircular(I)) {
+      uint64_t flags = I->getDesc().TSFlags;
+      int reg = getCircReg(
+        I->getOperand(TMS320C64XII::getMemBaseIdx(flags)).getReg());
+      unsigned log2 =
+        I->getOperand(TMS320C64XII::getMemBlockIdx(flags)).getImm();
+
+      // start a new run if the AMR can not serve this access too, the next
+      // run overwrites the AMR anyway
+      AMRSetup extended = setup;
+      if (!setup.empty()
+          && ((linear & (1 << reg)) || !extended.add(reg, log2))) {
+        writeAMR(MBB, Begin, setup.value());
+        setup.clear();
+      }
+      if (setup.empty()) {
+        Begin = I;
+        linear = 0;
+      }
+      setup.add(reg, log2);
+      continue;
+    }
+
+    if (setup.empty())
+      continue;
+
+    unsigned uses = getLinearUses(I);
+    if (endsRun(I) || (uses & setup.regs())) {
+      writeAMR(MBB, Begin, setup.value());
+      writeAMR(MBB, I, 0);
+      setup.clear();
+    } else
+      linear |= uses;
+  }
+
+  if (!setup.empty()) {
+    writeAMR(MBB, Begin, setup.value());
+    writeAMR(MBB, MBB.end(), 0);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+bool CircularAddressing::runOnMachineFunction(MachineFunction &MF) {
+  unsigned regs = 0;
+  for (MachineFunction::iterator FI = MF.begin(), FE = MF.end();
+       FI != FE; ++FI)
+    for (MachineBasicBlock::iterator I = FI->begin(), E = FI->end();
+         I != E; ++I)
+      if (isCircular(I)) {
+        const MachineOperand &MO =
+          I->getOperand(TMS320C64XII::getMemBaseIdx(I->getDesc().TSFlags));
+        int reg = getCircReg(MO.getReg());
+        assert(reg >= 0 && "circular access not based on A4-A7");
+        regs |= 1 << reg;
+        ++NumCircAccesses;
+      }
+
+  if (!regs)
+    return false;
+
+  // keep the post RA scheduler from moving the circular accesses, ordinary
+  // accesses through the same registers and calls across AMR writes. The
+  // circular accesses do not read the AMR implicitly by their description,
+  // that would clash with the earlyclobber dst of the loads.
+  for (MachineFunction::iterator FI = MF.begin(), FE = MF.end();
+       FI != FE; ++FI)
+    for (MachineBasicBlock::iterator I = FI->begin(), E = FI->end();
+         I != E; ++I)
+      if (isCircular(I) || (getLinearUses(I) & regs)
+          || I->getDesc().isCall())
+        I->addOperand(MachineOperand::CreateReg(TMS320C64X::AMR, false,
+                                                true));
+
+  if (!setupFunction(MF))
+    for (MachineFunction::iterator FI = MF.begin(), FE = MF.end();
+         FI != FE; ++FI)
+      setupBlock(*FI);
+
+  return true;
+}
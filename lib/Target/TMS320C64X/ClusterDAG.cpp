@@ -17,8 +17,11 @@
 #include "TMS320C64XInstrInfo.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include <set>
 
 //#undef DEBUG
 //#define DEBUG(x) x
@@ -29,6 +32,11 @@ using namespace llvm::TMS320C64X;
 STATISTIC(XccStalls, "Number of XPATH stalls avoided");
 STATISTIC(XccInserted, "Number of cross-cluster copies inserted");
 
+static cl::opt<unsigned> RPSlack("c64x-uas-rp-slack",
+  cl::Hidden, cl::desc("Free registers left on a side when UAS (uas-rp) "
+                       "starts to prefer the other side"),
+  cl::init(1));
+
 ClusterDAG::~ClusterDAG() {
   for (std::vector<SUnit*>::iterator I = CopySUs.begin(), E = CopySUs.end();
        I != E; ++I)
@@ -77,9 +85,13 @@ void UAS::ScheduleNodeTopDown(SUnit *SU, unsigned CurCycle, unsigned side) {
   DEBUG(SU->dump(this));
   // rewrite instruction if assigned to other cluster
   if (rewriteAssignedCluster(SU, side)) {
-    MachineOperand &MO = SU->getInstr()->getOperand(0);
-    if (MO.isReg() && MO.isDef()) {
-      // need to change the register class
+    // need to change the register class (loads modifying their base define
+    // the base as well)
+    MachineInstr *MI = SU->getInstr();
+    for (unsigned i = 0, e = MI->getDesc().getNumDefs(); i != e; ++i) {
+      MachineOperand &MO = MI->getOperand(i);
+      if (!MO.isReg() || !MO.isDef())
+        continue;
       const TargetRegisterClass *newRC = getChangedRegRC(MO.getReg(), side);
       MRI.setRegClass(MO.getReg(), newRC);
       CAState->addVChange(MO.getReg(), newRC);
@@ -94,6 +106,9 @@ void UAS::ScheduleNodeTopDown(SUnit *SU, unsigned CurCycle, unsigned side) {
 
   rewriteUses(SU);
 
+  if (PF == RegPressure)
+    updatePressure(SU);
+
   /*
   MachineOperand &MO = SU->getInstr()->getOperand(0);
   if (MO.isReg() && MO.isDef() &&
@@ -122,10 +137,22 @@ void UAS::Schedule() {
   DEBUG(for (unsigned su = 0, e = SUnits.size(); su != e; ++su)
           SUnits[su].dumpAll(this));
 
+  if (PF == RegPressure)
+    initPressure();
+
   AvailableQueue.initNodes(SUnits);
   ScheduleTopDown();
   AvailableQueue.releaseState();
 
+  DEBUG(if (PF == RegPressure)
+          dbgs() << "**** Max. pressure: A " << RP.getMaxPressure(0) << "/"
+                 << RP.getLimit(0) << ", B " << RP.getMaxPressure(1) << "/"
+                 << RP.getLimit(1) << "\n");
+  SUUses.clear();
+  XccUses.clear();
+  VRegUsers.clear();
+  CallPreds.clear();
+
   EmitSchedule();
 }
 
@@ -209,6 +236,12 @@ void UAS::ScheduleTopDown() {
               for (int i = 0, e = regs.size(); i < e; ++i) {
                 unsigned newreg = insertCopy(regs[i], c);
                 CurSUnit->getInstr()->getOperand(ops[i]).setReg(newreg);
+                if (PF == RegPressure) {
+                  // the copy is live until its user is scheduled
+                  RP.addUse(newreg);
+                  RP.def(newreg, c, 1);
+                  XccUses[CurSUnit].push_back(newreg);
+                }
               }
               preAssigned[CurSUnit] = ClusterPriority(c);
             }
@@ -312,6 +345,10 @@ unsigned UAS::getVRegSide(unsigned reg) {
     return 0; // ASide
   else if (RC == BRegsRegisterClass || RC->hasSuperClass(BRegsRegisterClass))
     return 1; // BSide
+  else if (RC == APairRegsRegisterClass)
+    return 0;
+  else if (RC == BPairRegsRegisterClass)
+    return 1;
 
   DEBUG(dbgs() << "Cannot determine cluster for reg in class: "
         << RC->getName() << "\n");
@@ -357,6 +394,10 @@ bool UAS::needCopy(SUnit *SU, unsigned side, SmallVector<unsigned,2> &regs,
         if (OpRC == PredRegsRegisterClass)
           continue;
 
+        // Register pairs are only stored, the data path reaches both sides.
+        if (OpRC == PairRegsRegisterClass)
+          continue;
+
         const TargetRegisterClass *RegRC = MRI.getRegClass(reg);
 
         // XXX most likely from a COPY, which still needs to be handled
@@ -456,17 +497,30 @@ void UAS::rewriteDefs(SUnit *SU) {
   if (!MI->getNumOperands())
     return;
 
+  // copies into packed values are side-less as well
   MachineOperand &MO = MI->getOperand(0);
   if (!MO.isReg() || !MO.isDef()
       || !TargetRegisterInfo::isVirtualRegister(MO.getReg())
-      || MRI.getRegClass(MO.getReg()) != GPRegsRegisterClass)
+      || (MRI.getRegClass(MO.getReg()) != GPRegsRegisterClass
+          && MRI.getRegClass(MO.getReg()) != VectorRegsRegisterClass))
     return;
 
-  if (MI->getOpcode() == COPY) {
+  // copies out of packed values are side-less as well, assign them like any
+  // other def (the copy is coalesced with the vector register later on)
+  if (MI->getOpcode() == COPY && (!MI->getOperand(1).isReg()
+      || !TargetRegisterInfo::isVirtualRegister(MI->getOperand(1).getReg())
+      || MRI.getRegClass(MI->getOperand(1).getReg())
+         != VectorRegsRegisterClass)) {
     MachineOperand &src = SU->getInstr()->getOperand(1);
-    assert(MRI.getRegClass(src.getReg()) != GPRegsRegisterClass);
-    MRI.setRegClass(MO.getReg(), MRI.getRegClass(src.getReg()));
-    CAState->addVChange(MO.getReg(), MRI.getRegClass(src.getReg()));
+    const TargetRegisterClass *srcRC = MRI.getRegClass(src.getReg());
+    assert(srcRC != GPRegsRegisterClass);
+    // halves of a register pair live on the side of the pair
+    if (srcRC == APairRegsRegisterClass || srcRC == PairRegsRegisterClass)
+      srcRC = ARegsRegisterClass;
+    else if (srcRC == BPairRegsRegisterClass)
+      srcRC = BRegsRegisterClass;
+    MRI.setRegClass(MO.getReg(), srcRC);
+    CAState->addVChange(MO.getReg(), srcRC);
     return;
   }
 
@@ -523,6 +577,10 @@ UAS::getChangedRegRC(unsigned reg, unsigned side) const {
   // pred regs need to remain pred regs on the destination side
   if (RC->hasSuperClass(PredRegsRegisterClass))
     return side ? BPredRegsRegisterClass : APredRegsRegisterClass;
+  // same for register pairs
+  else if (RC == PairRegsRegisterClass
+           || RC->hasSuperClass(PairRegsRegisterClass))
+    return side ? BPairRegsRegisterClass : APairRegsRegisterClass;
   else
     return sideToRC(side);
 }
@@ -535,12 +593,19 @@ ClusterPriority UAS::getClusterPriority(SUnit *SU) {
     return ClusterPriority(TMS320C64XInstrInfo::getSide(MI));
   }
 
+  // loop recurrences are kept on one side
+  int pinned = CAState->getPinnedSide(MI);
+  if (pinned >= 0)
+    return ClusterPriority(pinned);
+
   switch (PF) {
   case None:
     //return ClusterPriority(TMS320C64XInstrInfo::getSide(MI));
     return ClusterPriority(0, 1);
   case Random:
     return prioRandom(MI);
+  case RegPressure:
+    return prioRegPressure(MI);
   case MWP:
   default:
     return prioMWP(MI);
@@ -563,6 +628,258 @@ ClusterPriority UAS::prioMWP(MachineInstr *MI) {
   }
 }
 
+/// prioRegPressure - Prefer the side given by the operands (like MWP), unless
+/// the live registers on that side come within the slack of its register file
+/// size while the other side holds fewer. Once a side is full, instructions
+/// are held back until they can be placed on the other side. Values live
+/// across a call go where a callee saved register is left.
+ClusterPriority UAS::prioRegPressure(MachineInstr *MI) {
+  ClusterPriority cp = prioMWP(MI);
+
+  // only definitions add to the pressure
+  const MachineOperand *Def = MI->getNumOperands() ? &MI->getOperand(0) : 0;
+  if (!Def || !Def->isReg() || !Def->isDef()
+      || !TargetRegisterInfo::isVirtualRegister(Def->getReg())
+      || !RP.hasUses(Def->getReg()))
+    return cp;
+
+  std::pair<int,int> opcnt = countOperandSides(MI, MRI);
+  unsigned pref = (opcnt.second > opcnt.first) ? 1 : 0;
+  unsigned other = 1 - pref;
+
+  // without a callee saved register the value is spilled around the call,
+  // that outweighs the cross path copies
+  unsigned weight = MRI.getRegClass(Def->getReg())->getSize() / 4;
+  if (isLiveAcrossCall(Def->getReg())
+      && RP.getCSPressure(pref) + weight > RP.getCSLimit(pref)
+      && RP.getCSPressure(other) + weight <= RP.getCSLimit(other)) {
+    DEBUG(dbgs() << "**** Live across call, callee saved A "
+          << RP.getCSPressure(0) << ", B " << RP.getCSPressure(1)
+          << ", prefer cluster " << other << "\n");
+    return ClusterPriority(other, pref);
+  }
+
+  // switching sides costs cross path copies, only do so when the preferred
+  // side is about to run out of registers and the other side is less busy
+  if (RP.getPressure(pref) + RPSlack < RP.getLimit(pref)
+      || RP.getPressure(other) >= RP.getPressure(pref))
+    return cp;
+
+  DEBUG(dbgs() << "**** Pressure A " << RP.getPressure(0) << ", B "
+        << RP.getPressure(1) << ", prefer cluster " << other << "\n");
+
+  // a full side would spill, rather wait for a unit on the other side
+  if (RP.getPressure(pref) >= RP.getLimit(pref)
+      && RP.getPressure(other) < RP.getLimit(other))
+    return ClusterPriority(other);
+  return ClusterPriority(other, pref);
+}
+
+//-----------------------------------------------------------------------------
+
+void RegPressureTracker::reset(unsigned limitA, unsigned limitB,
+                               unsigned csLimitA, unsigned csLimitB) {
+  Limit[0] = limitA;
+  Limit[1] = limitB;
+  CSLimit[0] = csLimitA;
+  CSLimit[1] = csLimitB;
+  Pressure[0] = Pressure[1] = 0;
+  MaxPressure[0] = MaxPressure[1] = 0;
+  CSPressure[0] = CSPressure[1] = 0;
+  UsesLeft.clear();
+  Live.clear();
+  LiveOut.clear();
+  CrossCall.clear();
+  CopySrc.clear();
+}
+
+void RegPressureTracker::def(unsigned reg, unsigned side, unsigned weight) {
+  reg = getRoot(reg);
+  // dead defs do not occupy a register for long
+  if (!hasUses(reg) || Live.count(reg))
+    return;
+
+  Live[reg] = std::make_pair(side, weight);
+  Pressure[side] += weight;
+  MaxPressure[side] = std::max(MaxPressure[side], Pressure[side]);
+  if (CrossCall.count(reg))
+    CSPressure[side] += weight;
+}
+
+void RegPressureTracker::use(unsigned reg) {
+  reg = getRoot(reg);
+  DenseMap<unsigned, unsigned>::iterator UI = UsesLeft.find(reg);
+  if (UI == UsesLeft.end() || --UI->second)
+    return;
+  UsesLeft.erase(UI);
+
+  DenseMap<unsigned, std::pair<unsigned, unsigned> >::iterator LI =
+    Live.find(reg);
+  if (LI == Live.end() || LiveOut.count(reg))
+    return;
+
+  Pressure[LI->second.first] -= LI->second.second;
+  if (CrossCall.count(reg))
+    CSPressure[LI->second.first] -= LI->second.second;
+  Live.erase(LI);
+}
+
+/// getPressureSide - Side and number of physical registers of a vreg that
+/// is assigned to a register file side, false for unassigned classes.
+bool UAS::getPressureSide(unsigned reg, unsigned &side,
+                          unsigned &weight) const {
+  const TargetRegisterClass *RC = MRI.getRegClass(reg);
+  weight = 1;
+  if (RC == ARegsRegisterClass || RC->hasSuperClass(ARegsRegisterClass))
+    side = 0;
+  else if (RC == BRegsRegisterClass || RC->hasSuperClass(BRegsRegisterClass))
+    side = 1;
+  else if (RC == APairRegsRegisterClass || RC == BPairRegsRegisterClass) {
+    side = (RC == BPairRegsRegisterClass);
+    weight = 2;
+  } else
+    return false;
+  return true;
+}
+
+/// initPressure - Count the uses of each vreg within the region and find the
+/// vregs that live beyond it. Vregs that are live into the region already
+/// occupy their side.
+void UAS::initPressure() {
+  unsigned Limit[2] = { 0, 0 }, CSLimit[2] = { 0, 0 };
+  const TargetRegisterClass *SideRC[2] = {
+    ARegsRegisterClass, BRegsRegisterClass };
+  BitVector Reserved = TRI->getReservedRegs(MF);
+  for (unsigned side = 0; side != 2; ++side) {
+    const TargetRegisterClass *RC = SideRC[side];
+    for (TargetRegisterClass::iterator I = RC->allocation_order_begin(MF),
+         E = RC->allocation_order_end(MF); I != E; ++I)
+      if (!Reserved.test(*I))
+        ++Limit[side];
+    for (const unsigned *CSR = TRI->getCalleeSavedRegs(&MF); *CSR; ++CSR)
+      if (RC->contains(*CSR) && !Reserved.test(*CSR))
+        ++CSLimit[side];
+  }
+  RP.reset(Limit[0], Limit[1], CSLimit[0], CSLimit[1]);
+
+  SUUses.assign(SUnits.size(), SmallVector<unsigned, 4>());
+  std::set<unsigned> Defined;
+  for (unsigned su = 0, e = SUnits.size(); su != e; ++su) {
+    MachineInstr *MI = SUnits[su].getInstr();
+    if (MI->isCopy() && MI->getOperand(1).isReg()
+        && TargetRegisterInfo::isVirtualRegister(MI->getOperand(0).getReg())
+        && TargetRegisterInfo::isVirtualRegister(MI->getOperand(1).getReg()))
+      RP.addCopy(MI->getOperand(0).getReg(), MI->getOperand(1).getReg());
+  }
+  for (unsigned su = 0, e = SUnits.size(); su != e; ++su) {
+    MachineInstr *MI = SUnits[su].getInstr();
+    for (unsigned i = 0, ie = MI->getNumOperands(); i != ie; ++i) {
+      const MachineOperand &MO = MI->getOperand(i);
+      if (!MO.isReg() || !TargetRegisterInfo::isVirtualRegister(MO.getReg()))
+        continue;
+      if (MO.isUse()) {
+        RP.addUse(MO.getReg());
+        SUUses[su].push_back(MO.getReg());
+        VRegUsers[MO.getReg()].push_back(&SUnits[su]);
+      } else
+        Defined.insert(MO.getReg());
+    }
+  }
+
+  // vregs read by phis or outside of the region are live-out
+  for (std::set<unsigned>::iterator I = Defined.begin(), E = Defined.end();
+       I != E; ++I) {
+    for (MachineRegisterInfo::use_nodbg_iterator UI = MRI.use_nodbg_begin(*I),
+         UE = MRI.use_nodbg_end(); UI != UE; ++UI)
+      if (UI->isPHI() || !isBeingScheduled(UI->getParent())) {
+        RP.addLiveOut(*I);
+        break;
+      }
+  }
+
+  // the SUnits that have to be scheduled before each call
+  for (unsigned su = 0, e = SUnits.size(); su != e; ++su) {
+    if (!SUnits[su].isCall)
+      continue;
+    CallPreds.push_back(std::make_pair(&SUnits[su], BitVector(e)));
+    BitVector &Preds = CallPreds.back().second;
+    std::vector<SUnit*> WorkList(1, &SUnits[su]);
+    while (!WorkList.empty()) {
+      SUnit *SU = WorkList.back();
+      WorkList.pop_back();
+      for (SUnit::pred_iterator I = SU->Preds.begin(), E = SU->Preds.end();
+           I != E; ++I) {
+        unsigned N = I->getSUnit()->NodeNum;
+        if (N < e && !Preds.test(N)) {
+          Preds.set(N);
+          WorkList.push_back(I->getSUnit());
+        }
+      }
+    }
+  }
+
+  // vregs read but not defined in the region are live-in
+  for (unsigned su = 0, e = SUUses.size(); su != e; ++su)
+    for (unsigned i = 0, ie = SUUses[su].size(); i != ie; ++i) {
+      unsigned reg = SUUses[su][i], side, weight;
+      if (!Defined.count(reg) && getPressureSide(reg, side, weight)) {
+        if (isLiveAcrossCall(reg))
+          RP.addCallCrossing(reg);
+        RP.def(reg, side, weight);
+      }
+    }
+}
+
+/// isLiveAcrossCall - A vreg defined now lives across a call that is not
+/// scheduled yet, unless all of its readers have to precede the call.
+bool UAS::isLiveAcrossCall(unsigned reg) const {
+  std::map<unsigned, SmallVector<SUnit*, 4> >::const_iterator UI =
+    VRegUsers.find(reg);
+  for (unsigned c = 0, ce = CallPreds.size(); c != ce; ++c) {
+    if (CallPreds[c].first->isScheduled)
+      continue;
+    if (RP.isLiveOut(reg))
+      return true;
+    if (UI == VRegUsers.end())
+      continue;
+    for (unsigned i = 0, ie = UI->second.size(); i != ie; ++i)
+      if (!UI->second[i]->isScheduled
+          && !CallPreds[c].second.test(UI->second[i]->NodeNum))
+        return true;
+  }
+  return false;
+}
+
+/// updatePressure - Release the vregs whose last use is scheduled, then
+/// account for the definitions (on the side the SUnit was assigned to).
+void UAS::updatePressure(SUnit *SU) {
+  if (SU->NodeNum < SUUses.size())
+    for (unsigned i = 0, e = SUUses[SU->NodeNum].size(); i != e; ++i)
+      RP.use(SUUses[SU->NodeNum][i]);
+
+  std::map<SUnit*, SmallVector<unsigned, 2> >::iterator XI = XccUses.find(SU);
+  if (XI != XccUses.end()) {
+    for (unsigned i = 0, e = XI->second.size(); i != e; ++i)
+      RP.use(XI->second[i]);
+    XccUses.erase(XI);
+  }
+
+  MachineInstr *MI = SU->getInstr();
+  for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+    const MachineOperand &MO = MI->getOperand(i);
+    unsigned side, weight;
+    if (MO.isReg() && MO.isDef()
+        && TargetRegisterInfo::isVirtualRegister(MO.getReg())
+        && getPressureSide(MO.getReg(), side, weight)) {
+      if (isLiveAcrossCall(MO.getReg()))
+        RP.addCallCrossing(MO.getReg());
+      RP.def(MO.getReg(), side, weight);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+
 std::pair<int,int>
 TMS320C64X::countOperandSides(const MachineInstr *MI,
                               MachineRegisterInfo &MRI) {
@@ -605,6 +922,9 @@ ClusterDAG *TMS320C64X::createClusterDAG(AssignmentAlgorithm Algo,
   case ClusterUAS_rand:
     uas->setPriority(UAS::Random);
     break;
+  case ClusterUAS_rp:
+    uas->setPriority(UAS::RegPressure);
+    break;
   default:
     llvm_unreachable("not a DAG based algorithm");
   }
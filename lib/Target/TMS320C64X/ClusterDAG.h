@@ -18,7 +18,11 @@
 #include "TMS320C64XClusterAssignment.h"
 #include "Scheduling.h"
 #include "TMS320C64XHazardRecognizer.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/CodeGen/LatencyPriorityQueue.h"
+#include <map>
 
 namespace llvm {
   class SDNode;
@@ -77,12 +81,74 @@ namespace TMS320C64X {
     int getLast() const { return last; }
   };
 
+  /// RegPressureTracker - Counts the virtual registers live on either side
+  /// of the register file while a region is scheduled top-down. Registers are
+  /// live from their def (or the region entry) to their last use within the
+  /// region, registers used beyond the region stay live until its end.
+  /// Registers live across a call are also counted against the callee saved
+  /// registers of their side.
+  class RegPressureTracker {
+    unsigned Limit[2];
+    unsigned Pressure[2];
+    unsigned MaxPressure[2];
+    unsigned CSLimit[2];
+    unsigned CSPressure[2];
+
+    // remaining uses within the region
+    DenseMap<unsigned, unsigned> UsesLeft;
+    // side and number of registers a live vreg occupies
+    DenseMap<unsigned, std::pair<unsigned, unsigned> > Live;
+    DenseSet<unsigned> LiveOut;
+    // live across a call of the region
+    DenseSet<unsigned> CrossCall;
+    // vreg to vreg copies are coalesced, the copy shares the source register
+    DenseMap<unsigned, unsigned> CopySrc;
+
+    unsigned getRoot(unsigned reg) const {
+      DenseMap<unsigned, unsigned>::const_iterator I;
+      while ((I = CopySrc.find(reg)) != CopySrc.end())
+        reg = I->second;
+      return reg;
+    }
+
+  public:
+    RegPressureTracker() { reset(0, 0, 0, 0); }
+
+    void reset(unsigned limitA, unsigned limitB, unsigned csLimitA,
+               unsigned csLimitB);
+
+    void addCopy(unsigned dst, unsigned src) {
+      if (getRoot(src) != dst)
+        CopySrc[dst] = src;
+    }
+    void addUse(unsigned reg) { ++UsesLeft[getRoot(reg)]; }
+    void addLiveOut(unsigned reg) { LiveOut.insert(getRoot(reg)); }
+    void addCallCrossing(unsigned reg) { CrossCall.insert(getRoot(reg)); }
+    bool isLiveOut(unsigned reg) const { return LiveOut.count(getRoot(reg)); }
+    bool hasUses(unsigned reg) const {
+      reg = getRoot(reg);
+      return UsesLeft.count(reg) || LiveOut.count(reg);
+    }
+
+    // the register becomes live on the given side
+    void def(unsigned reg, unsigned side, unsigned weight);
+    // one of the uses of the register is scheduled
+    void use(unsigned reg);
+
+    unsigned getPressure(unsigned side) const { return Pressure[side]; }
+    unsigned getMaxPressure(unsigned side) const { return MaxPressure[side]; }
+    unsigned getLimit(unsigned side) const { return Limit[side]; }
+    unsigned getCSPressure(unsigned side) const { return CSPressure[side]; }
+    unsigned getCSLimit(unsigned side) const { return CSLimit[side]; }
+  };
+
   class UAS : public ClusterDAG {
   public:
     enum PriorityFunction {
       None,
       Random,
-      MWP
+      MWP,
+      RegPressure
     };
 
   private:
@@ -93,6 +159,22 @@ namespace TMS320C64X {
     unsigned RandState; // for randomized cluster priority
     unsigned NumCycles;
 
+    // register pressure for the RegPressure priority
+    RegPressureTracker RP;
+    // virtual registers read by each SUnit of the region
+    std::vector<SmallVector<unsigned, 4> > SUUses;
+    // cross cluster copies read by an SUnit instead of the original vreg
+    std::map<SUnit*, SmallVector<unsigned, 2> > XccUses;
+    // SUnits reading each virtual register
+    std::map<unsigned, SmallVector<SUnit*, 4> > VRegUsers;
+    // calls of the region and the SUnits that have to precede them
+    std::vector<std::pair<SUnit*, BitVector> > CallPreds;
+
+    void initPressure();
+    void updatePressure(SUnit *SU);
+    bool getPressureSide(unsigned reg, unsigned &side, unsigned &weight) const;
+    bool isLiveAcrossCall(unsigned reg) const;
+
     void ScheduleTopDown();
 
     void ReleaseSucc(SUnit *SU, SDep *SuccEdge);
@@ -106,6 +188,7 @@ namespace TMS320C64X {
     ClusterPriority getClusterPriority(SUnit *SU);
     ClusterPriority prioRandom(MachineInstr *MI);
     ClusterPriority prioMWP(MachineInstr *MI);
+    ClusterPriority prioRegPressure(MachineInstr *MI);
 
     // returns (assigned) side of an SUnit
     unsigned getAssignedSide(SUnit *SU);
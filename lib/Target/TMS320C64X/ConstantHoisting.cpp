@@ -0,0 +1,350 @@
+//===-- ConstantHoisting.cpp - TMS320C64X constant materialization --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Constants that do not fit into mvk and the addresses of globals, jump
+// tables and external symbols take a mvkl/mvkh pair. The isel selects them
+// per block, so a global accessed in several blocks is materialized in each
+// of them, and machine CSE only catches the copies dominated by another one.
+//
+// The isel emits the pair as a single mvklh instruction, which reads no
+// register and is rematerializable. The first pass here merges identical
+// materializations into one at the nearest common dominator of their blocks
+// and hoists it out of loops, as long as the profile (or its estimate) says
+// the new block does not execute more often than the blocks it replaces.
+// Long live ranges are cheap this way, the register allocator recomputes the
+// value where it would otherwise spill it.
+//
+// The second pass splits mvklh into mvkl/mvkh after register allocation.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "c64x-constants"
+#include "TMS320C64X.h"
+#include "TMS320C64XInstrInfo.h"
+#include "llvm/CodeGen/MachineDominators.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
+#include "llvm/CodeGen/MachineProfileAnalysis.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+STATISTIC(NumMerged, "Number of constant materializations merged");
+STATISTIC(NumHoisted, "Number of constant materializations hoisted");
+
+static cl::opt<bool> EnableConstantHoisting("c64x-hoist-constants",
+  cl::desc("Share and hoist mvkl/mvkh constant and address materializations"),
+  cl::init(true), cl::Hidden);
+
+namespace {
+
+  typedef SmallVector<MachineInstr*, 4> MaterializationList;
+
+  struct ConstantHoisting : public MachineFunctionPass {
+    static char ID;
+    const TMS320C64XInstrInfo *TII;
+    MachineRegisterInfo *MRI;
+    MachineDominatorTree *MDT;
+    MachineLoopInfo *MLI;
+    MachineProfileAnalysis *MPA;
+
+    ConstantHoisting(TargetMachine &tm)
+      : MachineFunctionPass(ID),
+        TII(static_cast<const TMS320C64XInstrInfo*>(tm.getInstrInfo())),
+        MRI(0), MDT(0), MLI(0), MPA(0)
+    {
+      initializeMachineProfileAnalysisAnalysisGroup(
+        *PassRegistry::getPassRegistry());
+    }
+
+    virtual const char *getPassName() const {
+      return "TMS320C64X Constant Hoisting";
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesCFG();
+      AU.addRequired<MachineDominatorTree>();
+      AU.addPreserved<MachineDominatorTree>();
+      AU.addRequired<MachineLoopInfo>();
+      AU.addPreserved<MachineLoopInfo>();
+      AU.addRequired<MachineProfileAnalysis>();
+      MachineFunctionPass::getAnalysisUsage(AU);
+    }
+
+    bool runOnMachineFunction(MachineFunction &MF);
+
+  private:
+    bool isMaterialization(const MachineInstr *MI) const;
+    bool isSameConstant(const MachineInstr *A, const MachineInstr *B) const;
+    double getFrequency(const MachineBasicBlock *MBB) const;
+    MachineBasicBlock *getHoistTarget(const MaterializationList &Group,
+                                      double &UseFrequency) const;
+    bool hoistGroup(const MaterializationList &Group);
+  };
+
+  char ConstantHoisting::ID = 0;
+
+  struct ConstantExpansion : public MachineFunctionPass {
+    static char ID;
+    const TMS320C64XInstrInfo *TII;
+
+    ConstantExpansion(TargetMachine &tm)
+      : MachineFunctionPass(ID),
+        TII(static_cast<const TMS320C64XInstrInfo*>(tm.getInstrInfo())) {}
+
+    virtual const char *getPassName() const {
+      return "TMS320C64X Constant Expansion";
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesCFG();
+      MachineFunctionPass::getAnalysisUsage(AU);
+    }
+
+    bool runOnMachineFunction(MachineFunction &MF);
+
+  private:
+    void expand(MachineInstr *MI);
+  };
+
+  char ConstantExpansion::ID = 0;
+}
+
+//-----------------------------------------------------------------------------
+
+FunctionPass *llvm::createTMS320C64XConstantHoisting(TargetMachine &tm) {
+  return new ConstantHoisting(tm);
+}
+
+FunctionPass *llvm::createTMS320C64XConstantExpansion(TargetMachine &tm) {
+  return new ConstantExpansion(tm);
+}
+
+//-----------------------------------------------------------------------------
+
+/// returns true if MI is an unconditional mvklh into a virtual register
+bool ConstantHoisting::isMaterialization(const MachineInstr *MI) const {
+  if (MI->getOpcode() != TMS320C64X::mvklh_1
+      && MI->getOpcode() != TMS320C64X::mvklh_2)
+    return false;
+
+  return !TII->isPredicated(MI)
+    && TargetRegisterInfo::isVirtualRegister(MI->getOperand(0).getReg());
+}
+
+//-----------------------------------------------------------------------------
+
+/// returns true if A and B materialize the same value into the same class
+bool ConstantHoisting::isSameConstant(const MachineInstr *A,
+                                      const MachineInstr *B) const
+{
+  return A->getOpcode() == B->getOpcode()
+    && A->getOperand(1).isIdenticalTo(B->getOperand(1))
+    && MRI->getRegClass(A->getOperand(0).getReg())
+       == MRI->getRegClass(B->getOperand(0).getReg());
+}
+
+//-----------------------------------------------------------------------------
+
+/// returns the execution count of MBB, falls back to a static estimate by the
+/// loop depth if the profile has none
+double ConstantHoisting::getFrequency(const MachineBasicBlock *MBB) const {
+  const double Count = MPA->getExecutionCount(MBB);
+  if (Count >= 0.0)
+    return Count;
+
+  double Frequency = 1.0;
+  for (unsigned Depth = MLI->getLoopDepth(MBB); Depth; --Depth)
+    Frequency *= 10.0;
+  return Frequency;
+}
+
+//-----------------------------------------------------------------------------
+
+/// returns the block all of Group can be materialized in at once, this is
+/// the nearest common dominator of their blocks, moved out of loops while
+/// the blocks entering them are executed less often. UseFrequency is set
+/// to the summed frequency of the blocks of Group
+MachineBasicBlock *
+ConstantHoisting::getHoistTarget(const MaterializationList &Group,
+                                 double &UseFrequency) const
+{
+  SmallPtrSet<MachineBasicBlock*, 8> Blocks;
+  MachineBasicBlock *Target = Group.front()->getParent();
+
+  UseFrequency = 0.0;
+  for (unsigned i = 0, e = Group.size(); i != e; ++i) {
+    MachineBasicBlock *MBB = Group[i]->getParent();
+    if (!Blocks.insert(MBB))
+      continue;
+    Target = MDT->findNearestCommonDominator(Target, MBB);
+    UseFrequency += getFrequency(MBB);
+  }
+
+  // the immediate dominator of the header is the preheader if the loop has
+  // one, it does not need to be
+  while (MachineLoop *L = MLI->getLoopFor(Target)) {
+    MachineDomTreeNode *IDom = MDT->getNode(L->getHeader())->getIDom();
+    if (!IDom || getFrequency(IDom->getBlock()) > getFrequency(Target))
+      break;
+    Target = IDom->getBlock();
+  }
+  return Target;
+}
+
+//-----------------------------------------------------------------------------
+
+/// replaces the materializations of Group with one in the block returned by
+/// getHoistTarget, if that is not executed more often than they were
+bool ConstantHoisting::hoistGroup(const MaterializationList &Group) {
+  double UseFrequency;
+  MachineBasicBlock *Target = getHoistTarget(Group, UseFrequency);
+
+  if (Group.size() == 1 && Target == Group.front()->getParent())
+    return false;
+
+  if (getFrequency(Target) > UseFrequency) {
+    // a cold use sits below a hot dominator, the others may still be
+    // hoisted out of their loops one by one
+    if (Group.size() == 1)
+      return false;
+
+    bool Changed = false;
+    for (unsigned i = 0, e = Group.size(); i != e; ++i) {
+      MaterializationList Single;
+      Single.push_back(Group[i]);
+      Changed |= hoistGroup(Single);
+    }
+    return Changed;
+  }
+
+  DEBUG(dbgs() << "c64x-constants: " << Group.size() << " x "
+               << *Group.front() << "  into BB#" << Target->getNumber()
+               << "\n");
+
+  // keep the first materialization within Target, if there is one
+  MachineInstr *Keep = 0;
+  for (MachineBasicBlock::iterator I = Target->begin(), E = Target->end();
+       I != E && !Keep; ++I)
+    for (unsigned i = 0, e = Group.size(); i != e; ++i)
+      if (Group[i] == &*I) {
+        Keep = Group[i];
+        break;
+      }
+
+  if (!Keep) {
+    Keep = Group.front();
+    Target->splice(Target->getFirstTerminator(), Keep->getParent(), Keep);
+    ++NumHoisted;
+  }
+
+  const unsigned Reg = Keep->getOperand(0).getReg();
+  for (unsigned i = 0, e = Group.size(); i != e; ++i) {
+    if (Group[i] == Keep)
+      continue;
+    MRI->replaceRegWith(Group[i]->getOperand(0).getReg(), Reg);
+    Group[i]->eraseFromParent();
+    ++NumMerged;
+  }
+
+  // the value is live across the former last uses now
+  MRI->clearKillFlags(Reg);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool ConstantHoisting::runOnMachineFunction(MachineFunction &MF) {
+  if (!EnableConstantHoisting)
+    return false;
+
+  MRI = &MF.getRegInfo();
+  MDT = &getAnalysis<MachineDominatorTree>();
+  MLI = &getAnalysis<MachineLoopInfo>();
+  MPA = &getAnalysis<MachineProfileAnalysis>();
+
+  // group the materializations by value, functions rarely have more than a
+  // handful of distinct ones
+  SmallVector<MaterializationList, 16> Groups;
+  for (MachineFunction::iterator BB = MF.begin(), BE = MF.end();
+       BB != BE; ++BB)
+    for (MachineBasicBlock::iterator I = BB->begin(), E = BB->end();
+         I != E; ++I) {
+      if (!isMaterialization(I))
+        continue;
+
+      unsigned i = 0, e = Groups.size();
+      while (i != e && !isSameConstant(Groups[i].front(), I))
+        ++i;
+      if (i == e)
+        Groups.push_back(MaterializationList());
+      Groups[i].push_back(I);
+    }
+
+  bool Changed = false;
+  for (unsigned i = 0, e = Groups.size(); i != e; ++i)
+    Changed |= hoistGroup(Groups[i]);
+  return Changed;
+}
+
+//-----------------------------------------------------------------------------
+
+/// replaces MI (a mvklh) by the mvkl/mvkh pair
+void ConstantExpansion::expand(MachineInstr *MI) {
+  MachineBasicBlock &MBB = *MI->getParent();
+  DebugLoc DL = MI->getDebugLoc();
+  const bool SideA = MI->getOpcode() == TMS320C64X::mvklh_1;
+  const unsigned Dst = MI->getOperand(0).getReg();
+
+  MachineInstrBuilder Lo = BuildMI(MBB, MI, DL,
+    TII->get(SideA ? TMS320C64X::mvkl_1 : TMS320C64X::mvkl_2), Dst);
+  MachineInstrBuilder Hi = BuildMI(MBB, MI, DL,
+    TII->get(SideA ? TMS320C64X::mvkh_1 : TMS320C64X::mvkh_2))
+    .addReg(Dst, RegState::Define
+                 | getDeadRegState(MI->getOperand(0).isDead()))
+    .addOperand(MI->getOperand(1))
+    .addReg(Dst);
+
+  // immediate, predicate and unit
+  for (unsigned i = 1, e = MI->getNumOperands(); i != e; ++i) {
+    MachineOperand MO = MI->getOperand(i);
+    if (MO.isReg())
+      MO.setIsKill(false);
+    Lo.addOperand(MO);
+    if (i > 1)
+      Hi.addOperand(MI->getOperand(i));
+  }
+  MI->eraseFromParent();
+}
+
+//-----------------------------------------------------------------------------
+
+bool ConstantExpansion::runOnMachineFunction(MachineFunction &MF) {
+  bool Changed = false;
+  for (MachineFunction::iterator BB = MF.begin(), BE = MF.end();
+       BB != BE; ++BB)
+    for (MachineBasicBlock::iterator I = BB->begin(), E = BB->end();
+         I != E; ) {
+      MachineInstr *MI = I++;
+      if (MI->getOpcode() == TMS320C64X::mvklh_1
+          || MI->getOpcode() == TMS320C64X::mvklh_2) {
+        expand(MI);
+        Changed = true;
+      }
+    }
+  return Changed;
+}
@@ -0,0 +1,248 @@
+//===-- CounterLoops.cpp - TMS320C64X loop counter preparation ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The C64x closes loops with bdec/bpos, branches that test a register for
+// being non-negative (and decrement it). Innermost loops usually end with an
+// add of the induction variable, a compare against the bound and the branch,
+// and the branch can not issue before the compare is done.
+//
+// This pass runs in front of instruction selection and gives loops with a
+// computable trip count a counter of their own. It starts at the backedge
+// taken count and the loop continues while the decremented counter is not
+// negative. The old exit test is removed, and so is the induction variable
+// if nothing else uses it. The machine code passes in BranchOnCounter.cpp
+// turn the new test into bpos/bdec.
+//
+// Loops that run more than 2^31 times can not be counted this way, the
+// trip count needs to be known to stay below. For a loop behind a guard the
+// backedge taken count is n-1, which wraps for n == 0, so it is the guard
+// that tells the count is in range.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "c64x-counter"
+#include "TMS320C64X.h"
+#include "llvm/Constants.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/Pass.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpander.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ConstantRange.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+using namespace llvm;
+
+STATISTIC(NumCounted, "Number of loops given a down counter");
+
+static cl::opt<bool> EnableCounterLoops("c64x-counter-loops",
+  cl::desc("Close countable loops with bdec/bpos on a counter register"),
+  cl::init(true), cl::Hidden);
+
+namespace {
+
+  struct CounterLoops : public FunctionPass {
+    static char ID;
+
+    CounterLoops() : FunctionPass(ID) {}
+
+    virtual const char *getPassName() const {
+      return "TMS320C64X Counter Loop Preparation";
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<LoopInfo>();
+      AU.addRequired<ScalarEvolution>();
+    }
+
+    bool runOnFunction(Function &F);
+
+  private:
+    ScalarEvolution *SE;
+
+    static bool isCheap(const SCEV *S);
+    bool isCountable(Loop *L, const SCEV *Trips);
+    bool convertLoop(Loop *L);
+  };
+
+  char CounterLoops::ID = 0;
+}
+
+//-----------------------------------------------------------------------------
+
+FunctionPass *llvm::createTMS320C64XCounterLoopPass() {
+  return new CounterLoops();
+}
+
+//-----------------------------------------------------------------------------
+
+/// returns true if S expands to a few instructions in the preheader, ie.
+/// there is no division (other than by a power of two) or multiplication of
+/// two unknowns, and no recurrence of an outer loop
+bool CounterLoops::isCheap(const SCEV *S) {
+  switch (S->getSCEVType()) {
+    case scConstant:
+    case scUnknown:
+      return true;
+    case scTruncate:
+    case scZeroExtend:
+    case scSignExtend:
+      return isCheap(cast<SCEVCastExpr>(S)->getOperand());
+    case scUDivExpr: {
+      const SCEVUDivExpr *Div = cast<SCEVUDivExpr>(S);
+      const SCEVConstant *D = dyn_cast<SCEVConstant>(Div->getRHS());
+      return D && D->getValue()->getValue().isPowerOf2()
+          && isCheap(Div->getLHS());
+    }
+    case scMulExpr:
+      if (!isa<SCEVConstant>(cast<SCEVMulExpr>(S)->getOperand(0))
+          || cast<SCEVMulExpr>(S)->getNumOperands() != 2)
+        return false;
+      // fall through
+    case scAddExpr:
+    case scSMaxExpr:
+    case scUMaxExpr: {
+      const SCEVNAryExpr *N = cast<SCEVNAryExpr>(S);
+      for (unsigned i = 0, e = N->getNumOperands(); i != e; ++i)
+        if (!isCheap(N->getOperand(i)))
+          return false;
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+/// returns true if the trip count (the backedge taken count plus one) is known
+/// to be in [1, 2^31 - 1], either from its range or from the loop guard
+bool CounterLoops::isCountable(Loop *L, const SCEV *Trips) {
+  if (SE->getSignedRange(Trips).getSignedMin().isStrictlyPositive())
+    return true;
+
+  const SCEV *Zero = SE->getConstant(Trips->getType(), 0);
+  if (SE->isLoopEntryGuardedByCond(L, ICmpInst::ICMP_SGT, Trips, Zero))
+    return true;
+
+  // an unsigned guard (n != 0) does it as well if n stays below 2^31
+  return !SE->getUnsignedRange(Trips).getUnsignedMax().isNegative()
+      && SE->isLoopEntryGuardedByCond(L, ICmpInst::ICMP_NE, Trips, Zero);
+}
+
+//-----------------------------------------------------------------------------
+
+bool CounterLoops::convertLoop(Loop *L) {
+  BasicBlock *Header = L->getHeader();
+  BasicBlock *Latch = L->getLoopLatch();
+  if (!Latch || L->getExitingBlock() != Latch)
+    return false;
+
+  BranchInst *BI = dyn_cast<BranchInst>(Latch->getTerminator());
+  if (!BI || !BI->isConditional())
+    return false;
+
+  const SCEV *Count = SE->getBackedgeTakenCount(L);
+  if (isa<SCEVCouldNotCompute>(Count) || !isCheap(Count))
+    return false;
+
+  // the counter is tested as a signed value
+  const IntegerType *I32 = Type::getInt32Ty(Header->getContext());
+  if (SE->getTypeSizeInBits(Count->getType()) > 32)
+    return false;
+  Count = SE->getNoopOrZeroExtend(Count, I32);
+  if (!isCountable(L, SE->getAddExpr(Count, SE->getConstant(I32, 1))))
+    return false;
+
+  // a constant test is left to the dag, the loop runs once or forever
+  Instruction *OldCond = dyn_cast<Instruction>(BI->getCondition());
+  if (!OldCond)
+    return false;
+
+  // CodeGenPrepare folds empty preheaders into the guard, put one back for
+  // the counter init
+  BasicBlock *Preheader = L->getLoopPreheader();
+  if (!Preheader) {
+    SmallVector<BasicBlock*, 4> Outside;
+    for (pred_iterator PI = pred_begin(Header), PE = pred_end(Header);
+         PI != PE; ++PI)
+      if (!L->contains(*PI)) {
+        if (isa<IndirectBrInst>((*PI)->getTerminator()))
+          return false;
+        Outside.push_back(*PI);
+      }
+    Preheader = SplitBlockPredecessors(Header, Outside.data(), Outside.size(),
+                                       ".preheader", this);
+  }
+
+  SE->forgetLoop(L);
+  SCEVExpander Rewriter(*SE);
+  Value *Init = Rewriter.expandCodeFor(Count, I32, Preheader->getTerminator());
+
+  PHINode *Counter = PHINode::Create(I32, "c64x.count", Header->begin());
+  BinaryOperator *Next =
+    BinaryOperator::CreateAdd(Counter, ConstantInt::get(I32, -1),
+                              "c64x.count.next", BI);
+  Counter->addIncoming(Init, Preheader);
+  Counter->addIncoming(Next, Latch);
+
+  // continue while Next >= 0
+  ICmpInst *Cond = new ICmpInst(BI, ICmpInst::ICMP_SGT, Next,
+                                ConstantInt::get(I32, -1), "c64x.count.cmp");
+  if (BI->getSuccessor(0) != Header) {
+    BasicBlock *Exit = BI->getSuccessor(0);
+    BI->setSuccessor(0, Header);
+    BI->setSuccessor(1, Exit);
+  }
+  BI->setCondition(Cond);
+
+  RecursivelyDeleteTriviallyDeadInstructions(OldCond);
+  DeleteDeadPHIs(Header);
+
+  DEBUG(dbgs() << "c64x-counter: loop " << Header->getName()
+               << " counts " << *Count << "\n");
+  ++NumCounted;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool CounterLoops::runOnFunction(Function &F) {
+  if (!EnableCounterLoops)
+    return false;
+
+  LoopInfo &LI = getAnalysis<LoopInfo>();
+  SE = &getAnalysis<ScalarEvolution>();
+
+  // innermost loops only, the branch of an outer loop is rarely on the
+  // critical path
+  SmallVector<Loop*, 8> Worklist(LI.begin(), LI.end());
+  SmallVector<Loop*, 8> Innermost;
+  while (!Worklist.empty()) {
+    Loop *L = Worklist.pop_back_val();
+    if (L->empty())
+      Innermost.push_back(L);
+    else
+      Worklist.append(L->begin(), L->end());
+  }
+
+  bool Changed = false;
+  for (unsigned i = 0, e = Innermost.size(); i != e; ++i)
+    Changed |= convertLoop(Innermost[i]);
+  return Changed;
+}
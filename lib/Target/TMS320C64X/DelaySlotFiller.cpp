@@ -6,37 +6,98 @@
 // License. See LICENSE.TXT for details.
 //
 //===----------------------------------------------------------------------===//
+//
+// Without the post RA scheduler every instruction is issued in an execute
+// packet of its own, in program order. The filler makes sure that no result
+// is read before the delay slots of its producer have passed, and inserts
+// NOPs only where the program order does not provide independent work:
+//
+//  - the instructions following a load or a multiply fill its delay slots,
+//    as long as they do not depend on the result
+//  - the delay slots of a branch are filled with independent instructions
+//    moved down from before the branch, and with the first instructions of
+//    the target if the branch is always (or, given a profile, likely) taken
+//  - adjacent NOPs are merged into multi-cycle NOPs
+//
+//===----------------------------------------------------------------------===//
 
 #define DEBUG_TYPE "delayslotfiller"
 #include "TMS320C64X.h"
 #include "TMS320C64XInstrInfo.h"
 #include "llvm/CodeGen/MachineFunctionPass.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineProfileAnalysis.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetInstrInfo.h"
+#include "llvm/Target/TargetInstrItineraries.h"
+#include "llvm/Target/TargetRegisterInfo.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
 
 using namespace llvm;
 
+STATISTIC(FilledFromBefore, "Number of delay slots filled from above");
+STATISTIC(FilledFromTarget, "Number of delay slots filled from the target");
+STATISTIC(NopCycles, "Number of NOP cycles inserted");
+
+static cl::opt<bool>
+FillLikelyTarget("c64x-fill-likely-target",
+  cl::desc("Fill the delay slots of conditional branches from the branch "
+           "target if the profile says the branch is likely taken"),
+  cl::init(false));
+
 namespace {
+
+  // a branch takes effect after its delay slots
+  const unsigned BranchDelay = 5;
+
+  // the number of cycles a single NOP instruction can cover
+  const unsigned MaxNopCycles = 9;
+
+  // do not look further above a branch for instructions to move down
+  const unsigned FillWindow = 16;
+
   struct Filler : public MachineFunctionPass {
     TargetMachine &TM;
-    const TargetInstrInfo *TII;
+    const TMS320C64XInstrInfo *TII;
+    const TargetRegisterInfo *TRI;
+    const InstrItineraryData *IID;
+    MachineProfileAnalysis *MPA;
 
     static char ID;
 
     Filler(TargetMachine &tm)
     : MachineFunctionPass(ID),
       TM(tm),
-      TII(tm.getInstrInfo())
-    {}
+      TII(static_cast<const TMS320C64XInstrInfo*>(tm.getInstrInfo())),
+      TRI(tm.getRegisterInfo()),
+      IID(tm.getInstrItineraryData()),
+      MPA(0)
+    {
+      if (FillLikelyTarget)
+        initializeMachineProfileAnalysisAnalysisGroup(
+          *PassRegistry::getPassRegistry());
+    }
 
     virtual const char *getPassName() const {
       return "TMS320C64X Delay Slot Filler";
     }
 
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      if (FillLikelyTarget)
+        AU.addRequired<MachineProfileAnalysis>();
+      MachineFunctionPass::getAnalysisUsage(AU);
+    }
+
     bool runOnMachineBasicBlock(MachineBasicBlock &MBB);
     bool runOnMachineFunction(MachineFunction &F) {
+      if (FillLikelyTarget)
+        MPA = &getAnalysis<MachineProfileAnalysis>();
+
       bool Changed = false;
       for (MachineFunction::iterator FI = F.begin(), FE = F.end();
            FI != FE; ++FI)
@@ -44,6 +105,22 @@ namespace {
       return Changed;
     }
 
+  private:
+    bool isBarrier(const MachineInstr *MI) const;
+    unsigned getLatency(const MachineInstr *MI, unsigned Reg) const;
+    bool isDelayedBranch(const MachineInstr *MI) const;
+    bool isMovable(const MachineInstr *MI) const;
+    bool hasDependence(const MachineInstr *A, const MachineInstr *B) const;
+    bool definesLiveIn(const MachineInstr *MI,
+                       const MachineBasicBlock *MBB) const;
+
+    void fillFromBefore(MachineBasicBlock &MBB, MachineInstr *Branch);
+    void fillFromTarget(MachineBasicBlock &MBB, MachineInstr *Branch);
+
+    bool issue(MachineBasicBlock &MBB, bool InsertNops);
+    void insertNop(MachineBasicBlock &MBB, MachineBasicBlock::iterator I,
+                   unsigned Cycles);
+    void mergeNops(MachineBasicBlock &MBB);
   };
 
   char Filler::ID = 0;
@@ -58,23 +135,398 @@ FunctionPass *llvm::createTMS320C64XDelaySlotFillerPass(TargetMachine &tm) {
   return new Filler(tm);
 }
 
+//-----------------------------------------------------------------------------
+
+/// isBarrier - Instructions whose timing is not known to the filler (calls,
+/// the prolog/epilog and other pseudos that are expanded on emission). All
+/// pending results are written before they are issued.
+bool Filler::isBarrier(const MachineInstr *MI) const {
+  const TargetInstrDesc &TID = MI->getDesc();
+  if (TID.isCall() || MI->hasUnmodeledSideEffects() || MI->isInlineAsm() ||
+      MI->isLabel())
+    return true;
+
+  if (TID.isTerminator() && !isDelayedBranch(MI))
+    return true;
+
+  // without itineraries the pseudos are told apart by their missing
+  // predicate operand
+  if (IID->isEmpty())
+    return MI->findFirstPredOperandIdx() == -1;
+
+  // pseudos have no itinerary stages (the classes are numbered by name, so
+  // NoItinerary is not necessarily class 0)
+  unsigned Class = TID.getSchedClass();
+  return IID->beginStage(Class) == IID->endStage(Class);
+}
+
+/// getLatency - The cycles until Reg, written by MI, can be read. Without
+/// itineraries that is after the delay slots of the instruction.
+unsigned Filler::getLatency(const MachineInstr *MI, unsigned Reg) const {
+  if (IID->isEmpty())
+    return GET_DELAY_SLOTS(MI->getDesc().TSFlags) + 1;
+  return TII->getDefLatency(IID, MI, Reg);
+}
+
+bool Filler::isDelayedBranch(const MachineInstr *MI) const {
+  const TargetInstrDesc &TID = MI->getDesc();
+  return TID.hasDelaySlot() &&
+         (TID.isBranch() || TID.isReturn() || TID.isCall());
+}
+
+bool Filler::isMovable(const MachineInstr *MI) const {
+  const TargetInstrDesc &TID = MI->getDesc();
+  return !isBarrier(MI) && !TID.isTerminator() && !TID.isBranch() &&
+         !MI->isKill() && !MI->isImplicitDef() && !MI->isDebugValue() &&
+         MI->getOpcode() != TMS320C64X::noop;
+}
+
+/// hasDependence - Returns true if A and B may not be reordered.
+bool Filler::hasDependence(const MachineInstr *A, const MachineInstr *B) const {
+  const TargetInstrDesc &TA = A->getDesc();
+  const TargetInstrDesc &TB = B->getDesc();
+  if (A->hasUnmodeledSideEffects() || B->hasUnmodeledSideEffects())
+    return true;
+
+  // we have no alias information here
+  if ((TA.mayStore() && (TB.mayLoad() || TB.mayStore())) ||
+      (TB.mayStore() && TA.mayLoad()))
+    return true;
+
+  for (unsigned i = 0, e = A->getNumOperands(); i != e; ++i) {
+    const MachineOperand &MA = A->getOperand(i);
+    if (!MA.isReg() || !MA.getReg())
+      continue;
+    for (unsigned j = 0, f = B->getNumOperands(); j != f; ++j) {
+      const MachineOperand &MB = B->getOperand(j);
+      if (!MB.isReg() || !MB.getReg() || (MA.isUse() && MB.isUse()))
+        continue;
+      if (TRI->regsOverlap(MA.getReg(), MB.getReg()))
+        return true;
+    }
+  }
+  return false;
+}
+
+bool Filler::definesLiveIn(const MachineInstr *MI,
+                           const MachineBasicBlock *MBB) const {
+  for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+    const MachineOperand &MO = MI->getOperand(i);
+    if (!MO.isReg() || !MO.isDef() || !MO.getReg())
+      continue;
+    for (MachineBasicBlock::livein_iterator I = MBB->livein_begin(),
+         E = MBB->livein_end(); I != E; ++I)
+      if (TRI->regsOverlap(MO.getReg(), *I))
+        return true;
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+
+/// fillFromBefore - Moves instructions that neither the branch nor the
+/// instructions in between depend on into the delay slots. They are
+/// executed on both paths, just as before.
+void Filler::fillFromBefore(MachineBasicBlock &MBB, MachineInstr *Branch) {
+  // the instructions a candidate would be moved across, including the branch
+  // and the terminators following it
+  SmallVector<MachineInstr*, 16> Between;
+  for (MachineBasicBlock::iterator I = Branch; I != MBB.end(); ++I)
+    Between.push_back(I);
+
+  // candidates in reverse program order
+  SmallVector<MachineInstr*, BranchDelay> Moved;
+  MachineBasicBlock::iterator I = Branch;
+  for (unsigned Window = 0; I != MBB.begin() && Window != FillWindow &&
+       Moved.size() != BranchDelay; ++Window) {
+    MachineInstr *MI = --I;
+    if (MI->isDebugValue())
+      continue;
+    if (isBarrier(MI))
+      break;
+
+    bool Dependent = !isMovable(MI);
+    for (unsigned i = 0, e = Between.size(); i != e && !Dependent; ++i)
+      Dependent = hasDependence(MI, Between[i]);
+
+    if (Dependent)
+      Between.push_back(MI);
+    else
+      Moved.push_back(MI);
+  }
+
+  MachineBasicBlock::iterator InsertPos = llvm::next(
+    MachineBasicBlock::iterator(Branch));
+  for (unsigned i = Moved.size(); i-- > 0; )
+    MBB.splice(InsertPos, &MBB, Moved[i]);
+
+  // results that arrive too late make it back above the branch, the earliest
+  // candidate first, which keeps the order
+  while (!Moved.empty() && !issue(MBB, false)) {
+    MBB.splice(Branch, &MBB, Moved.back());
+    Moved.pop_back();
+  }
+
+  FilledFromBefore += Moved.size();
+}
+
+/// fillFromTarget - Moves the first instructions of the target into the
+/// delay slots left. The target must not be reached otherwise. If the branch
+/// is conditional, the instructions must be harmless on the fall through
+/// path.
+void Filler::fillFromTarget(MachineBasicBlock &MBB, MachineInstr *Branch) {
+  const TargetInstrDesc &TID = Branch->getDesc();
+  if (!TID.isBranch() || TID.isIndirectBranch() || TID.isCall() ||
+      !Branch->getOperand(0).isMBB())
+    return;
+
+  MachineBasicBlock *Target = Branch->getOperand(0).getMBB();
+  if (Target == &MBB || Target->pred_size() != 1 ||
+      Target->hasAddressTaken() || Target->isLandingPad())
+    return;
+
+  unsigned Slots = BranchDelay;
+  for (MachineBasicBlock::iterator I = llvm::next(
+       MachineBasicBlock::iterator(Branch)); I != MBB.end(); ++I)
+    if (!I->isDebugValue() && Slots)
+      --Slots;
+
+  MachineBasicBlock *FallThrough = 0;
+  if (TID.isConditionalBranch() || TII->isPredicated(Branch)) {
+    if (!FillLikelyTarget || MBB.succ_size() != 2 ||
+        MBB.getFirstTerminator() != MachineBasicBlock::iterator(Branch))
+      return;
+
+    FallThrough = *MBB.succ_begin() == Target ? *llvm::next(MBB.succ_begin())
+                                              : *MBB.succ_begin();
+    double Taken = MPA->getEdgeWeight(&MBB, Target);
+    double NotTaken = MPA->getEdgeWeight(&MBB, FallThrough);
+    if (Taken < 0 || NotTaken < 0 || Taken <= NotTaken)
+      return;
+  }
+
+  SmallVector<MachineInstr*, BranchDelay> Moved;
+  MachineBasicBlock::iterator I = Target->begin();
+  while (I != Target->end() && Moved.size() != Slots) {
+    MachineInstr *MI = I++;
+    if (MI->isDebugValue())
+      continue;
+    if (!isMovable(MI))
+      break;
+
+    // executed on the fall through path as well, where it must not fault nor
+    // clobber anything
+    if (FallThrough) {
+      const TargetInstrDesc &MTID = MI->getDesc();
+      if (MTID.mayLoad() || MTID.mayStore() || definesLiveIn(MI, FallThrough))
+        break;
+    }
+
+    MBB.splice(MBB.end(), Target, MI);
+    Moved.push_back(MI);
+  }
+
+  while (!Moved.empty() && !issue(MBB, false)) {
+    Target->splice(Target->begin(), &MBB, Moved.back());
+    Moved.pop_back();
+  }
+
+  // the registers written in the slots are live into the target now
+  for (unsigned i = 0, e = Moved.size(); i != e; ++i)
+    for (unsigned j = 0, f = Moved[i]->getNumOperands(); j != f; ++j) {
+      const MachineOperand &MO = Moved[i]->getOperand(j);
+      if (MO.isReg() && MO.isDef() && MO.getReg() &&
+          !Target->isLiveIn(MO.getReg()))
+        Target->addLiveIn(MO.getReg());
+    }
+
+  FilledFromTarget += Moved.size();
+}
+
+//-----------------------------------------------------------------------------
+
+/// getUnitIndex - The functional unit (unit << 1 | side) of an instruction.
+static unsigned getUnitIndex(const MachineInstr *MI) {
+  const TargetInstrDesc &Desc = MI->getDesc();
+  unsigned Unit = GET_UNIT(Desc.TSFlags);
+  if (TMS320C64XInstrInfo::isFlexible(Desc))
+    Unit = MI->getOperand(Desc.getNumOperands() - 1).getImm() >> 1;
+  return (Unit << 1) | (IS_BSIDE(Desc.TSFlags) ? 1 : 0);
+}
+
+//-----------------------------------------------------------------------------
+
+/// issue - Walks the block in program order, one instruction per cycle. An
+/// instruction is issued once the results it reads are written, and late
+/// enough for its own results to be written after the ones still pending.
+/// An instruction also waits for its functional unit to be free. Everything
+/// must be written when the block is left. If InsertNops is set,
+/// the NOPs for the cycles waited are inserted. Otherwise returns false if
+/// the delay slots of a branch do not suffice for the instructions placed
+/// into them.
+bool Filler::issue(MachineBasicBlock &MBB, bool InsertNops) {
+  DenseMap<unsigned, unsigned> Ready; // first cycle the register is readable
+  unsigned UnitFree[8] = { 0 };       // first cycle the unit is free again
+  unsigned Cycle = 0;
+  unsigned Pending = 0;               // all results are readable from here
+  unsigned BranchOccurs = 0;
+  bool InSlots = false;
+
+  for (MachineBasicBlock::iterator I = MBB.begin(), E = MBB.end(); I != E;
+       ++I) {
+    MachineInstr *MI = I;
+    if (MI->isDebugValue() || MI->isKill() || MI->isImplicitDef())
+      continue;
+
+    if (MI->getOpcode() == TMS320C64X::noop) {
+      Cycle += MI->getOperand(0).getImm();
+      continue;
+    }
+
+    bool Barrier = isBarrier(MI);
+    bool IsBranch = isDelayedBranch(MI);
+    unsigned Unit = getUnitIndex(MI);
+    unsigned Earliest = std::max(Cycle, UnitFree[Unit]);
+    if (Barrier)
+      Earliest = std::max(Earliest, Pending);
+    else
+      for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+        const MachineOperand &MO = MI->getOperand(i);
+        if (!MO.isReg() || !MO.getReg())
+          continue;
+        DenseMap<unsigned, unsigned>::iterator R = Ready.find(MO.getReg());
+        if (R == Ready.end())
+          continue;
+        if (MO.isUse())
+          Earliest = std::max(Earliest, R->second);
+        else {
+          unsigned Latency = getLatency(MI, MO.getReg());
+          if (R->second > Latency)
+            Earliest = std::max(Earliest, R->second - Latency + 1);
+        }
+      }
+
+    // the block is left when the branch occurs, all results must be written
+    // by then
+    if (IsBranch && Pending > Earliest + BranchDelay + 1)
+      Earliest = Pending - BranchDelay - 1;
+
+    // the delay slots of a branch only take the instructions moved there, a
+    // following branch is issued when the first one did not branch. The
+    // first one may have, with everything in its slots written by then
+    if (InSlots) {
+      if (Barrier || IsBranch) {
+        if (Pending > BranchOccurs) {
+          assert(!InsertNops && "delay slots overflow!");
+          return false;
+        }
+        Earliest = std::max(Earliest, BranchOccurs);
+      } else if (Earliest >= BranchOccurs) {
+        assert(!InsertNops && "delay slots overflow!");
+        return false;
+      }
+    }
+
+    if (Earliest > Cycle) {
+      if (InsertNops)
+        insertNop(MBB, I, Earliest - Cycle);
+      Cycle = Earliest;
+    }
+
+    if (Barrier)
+      Ready.clear();
+    else
+      for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+        const MachineOperand &MO = MI->getOperand(i);
+        if (!MO.isReg() || !MO.isDef() || !MO.getReg())
+          continue;
+        unsigned Reg = MO.getReg();
+        unsigned At = Cycle + getLatency(MI, Reg);
+        Ready[Reg] = At;
+        for (const unsigned *Alias = TRI->getAliasSet(Reg); *Alias; ++Alias)
+          Ready[*Alias] = std::max(Ready[*Alias], At);
+        Pending = std::max(Pending, At);
+      }
+
+    // the not fully pipelined instructions keep their unit for longer
+    UnitFree[Unit] = Cycle + 1 + GET_UNIT_BUSY(MI->getDesc().TSFlags);
+
+    if (IsBranch) {
+      BranchOccurs = Cycle + BranchDelay + 1;
+      InSlots = true;
+    }
+    ++Cycle;
+    Pending = std::max(Pending, Cycle);
+  }
+
+  // the successor starts when the branch occurs, with all results written
+  if (InSlots) {
+    if (Pending > BranchOccurs) {
+      assert(!InsertNops && "delay slots overflow!");
+      return false;
+    }
+    Pending = BranchOccurs;
+  }
+
+  if (InsertNops && Pending > Cycle)
+    insertNop(MBB, MBB.end(), Pending - Cycle);
+  return true;
+}
+
+void Filler::insertNop(MachineBasicBlock &MBB, MachineBasicBlock::iterator I,
+                       unsigned Cycles) {
+  DebugLoc DL = I != MBB.end() ? I->getDebugLoc() : DebugLoc();
+  NopCycles += Cycles;
+  for (; Cycles; Cycles -= std::min(Cycles, MaxNopCycles))
+    TMS320C64XInstrInfo::addDefaultPred(BuildMI(MBB, I, DL,
+      TII->get(TMS320C64X::noop)).addImm(std::min(Cycles, MaxNopCycles)));
+}
+
+/// mergeNops - Adjacent NOPs are combined into multi-cycle NOPs.
+void Filler::mergeNops(MachineBasicBlock &MBB) {
+  MachineInstr *Prev = 0;
+  for (MachineBasicBlock::iterator I = MBB.begin(); I != MBB.end(); ) {
+    MachineInstr *MI = I++;
+    if (MI->isDebugValue())
+      continue;
+    if (MI->getOpcode() != TMS320C64X::noop || TII->isPredicated(MI)) {
+      Prev = 0;
+      continue;
+    }
+
+    if (Prev) {
+      int64_t Cycles = Prev->getOperand(0).getImm() + MI->getOperand(0).getImm();
+      if (Cycles <= MaxNopCycles) {
+        Prev->getOperand(0).setImm(Cycles);
+        MI->eraseFromParent();
+        continue;
+      }
+    }
+    Prev = MI;
+  }
+}
+
+//-----------------------------------------------------------------------------
+
 /// runOnMachineBasicBlock - Fill in delay slots for the given basic block.
-/// Currently, we fill delay slots with NOPs. We insert 4 nops
 ///
 
 bool Filler::runOnMachineBasicBlock(MachineBasicBlock &MBB) {
-
-  int delay;
-  bool Changed = false;
+  MachineInstr *FirstBranch = 0, *LastBranch = 0;
   for (MachineBasicBlock::iterator I = MBB.begin(); I != MBB.end(); ++I)
-    if (I->getDesc().hasDelaySlot()) {
-      MachineBasicBlock::iterator J = I;
-      delay = GET_DELAY_SLOTS(I->getDesc().TSFlags);
-      ++J;
-      TMS320C64XInstrInfo::addDefaultPred(BuildMI(MBB, J, I->getDebugLoc(),
-        TII->get(TMS320C64X::noop)).addImm(delay));
-
-      Changed = true;
+    if (isDelayedBranch(I)) {
+      if (!FirstBranch)
+        FirstBranch = I;
+      LastBranch = I;
     }
-  return Changed;
+
+  if (FirstBranch) {
+    if (!FirstBranch->getDesc().isCall())
+      fillFromBefore(MBB, FirstBranch);
+    fillFromTarget(MBB, LastBranch);
+  }
+
+  issue(MBB, true);
+  mergeNops(MBB);
+  return true;
 }
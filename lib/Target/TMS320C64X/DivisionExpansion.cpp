@@ -0,0 +1,434 @@
+//===-- DivisionExpansion.cpp - TMS320C64X inline integer division --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The C64x has no divide instruction, 32 bit divisions by a non-constant
+// divisor end up as calls to the runtime. Besides the call overhead, a call
+// in a loop body also prevents software pipelining. This pass runs in front
+// of instruction selection and replaces these divisions with inline code
+// (constant divisors are left alone, the DAG turns them into multiplications
+// already):
+//
+//  - if the divisor is invariant in a loop containing the division, a
+//    reciprocal is computed once in the preheader and the division becomes
+//    a 32x32 high multiplication (mpy32u) plus a few adds and shifts in the
+//    loop. The reciprocal itself is developed in front of the loop by 32
+//    subc steps, like the quotient of a variable divisor below
+//  - otherwise the dividend and divisor are aligned using lmbd and the
+//    quotient is developed one bit per step using subc. The loop consists of
+//    a single block and is a candidate for the modulo scheduler
+//
+// Signed divisions operate on the absolute values and fix up the signs of
+// the results afterwards. Functions optimized for size keep the calls.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "c64x-div"
+#include "TMS320C64X.h"
+#include "llvm/Constants.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/IntrinsicInst.h"
+#include "llvm/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/IRBuilder.h"
+#include "llvm/Support/raw_ostream.h"
+#include <map>
+
+using namespace llvm;
+
+STATISTIC(NumReciprocal, "Number of divisions by loop invariant divisors");
+STATISTIC(NumExpanded, "Number of divisions expanded to subc loops");
+
+static cl::opt<bool> EnableInlineDiv("c64x-inline-div",
+  cl::desc("Expand 32 bit divisions inline instead of calling the runtime"),
+  cl::init(true), cl::Hidden);
+
+namespace {
+
+  /// reciprocal of a loop invariant divisor, see Granlund/Montgomery,
+  /// "Division by invariant integers using multiplication" (fig. 4.1)
+  struct Reciprocal {
+    Value *Divisor;   // the (absolute) divisor
+    Value *Multiplier;
+    Value *Shift1;    // min(l, 1)
+    Value *Shift2;    // max(l - 1, 0)
+  };
+
+  struct DivisionExpansion : public FunctionPass {
+    static char ID;
+
+    DivisionExpansion() : FunctionPass(ID) {}
+
+    virtual const char *getPassName() const {
+      return "TMS320C64X Division Expansion";
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<LoopInfo>();
+    }
+
+    bool runOnFunction(Function &F);
+
+  private:
+    // the reciprocals per loop and (signed or unsigned) divisor
+    typedef std::pair<Loop*, std::pair<Value*, bool> > ReciprocalKey;
+    typedef std::map<ReciprocalKey, Reciprocal> ReciprocalMap;
+
+    LoopInfo *LI;
+    const IntegerType *I32;
+    Constant *Zero;
+    Constant *One;
+    ReciprocalMap Reciprocals;
+
+    static bool isSigned(BinaryOperator *BO);
+    static bool isRemainder(BinaryOperator *BO);
+
+    Value *createAbs(IRBuilder<> &B, Value *V, Value *&IsNeg);
+    Value *createCtlz(IRBuilder<> &B, Value *V);
+
+    Loop *findHoistLoop(Loop *L, Value *D) const;
+    const Reciprocal &getReciprocal(Loop *L, Value *D, bool Signed);
+    void divideByReciprocal(BinaryOperator *BO, Loop *L);
+
+    std::pair<Value*, Value*> createSubcLoop(Instruction *I, Value *N,
+                                             Value *D);
+    void expandSubcLoop(BinaryOperator *BO);
+  };
+
+  char DivisionExpansion::ID = 0;
+}
+
+//-----------------------------------------------------------------------------
+
+FunctionPass *llvm::createTMS320C64XDivisionExpansionPass() {
+  return new DivisionExpansion();
+}
+
+//-----------------------------------------------------------------------------
+
+bool DivisionExpansion::isSigned(BinaryOperator *BO) {
+  return BO->getOpcode() == Instruction::SDiv
+      || BO->getOpcode() == Instruction::SRem;
+}
+
+bool DivisionExpansion::isRemainder(BinaryOperator *BO) {
+  return BO->getOpcode() == Instruction::URem
+      || BO->getOpcode() == Instruction::SRem;
+}
+
+//-----------------------------------------------------------------------------
+
+/// returns |V| (as an unsigned value) and sets IsNeg to V < 0
+Value *DivisionExpansion::createAbs(IRBuilder<> &B, Value *V, Value *&IsNeg) {
+  IsNeg = B.CreateICmpSLT(V, Zero);
+  return B.CreateSelect(IsNeg, B.CreateNeg(V), V);
+}
+
+Value *DivisionExpansion::createCtlz(IRBuilder<> &B, Value *V) {
+  const Type *Tys[] = { I32 };
+  Module *M = B.GetInsertBlock()->getParent()->getParent();
+  return B.CreateCall(Intrinsic::getDeclaration(M, Intrinsic::ctlz, Tys, 1),
+                      V);
+}
+
+//-----------------------------------------------------------------------------
+
+/// returns the outermost loop around L (including L) that has a preheader
+/// and leaves D invariant, or 0 if there is none
+Loop *DivisionExpansion::findHoistLoop(Loop *L, Value *D) const {
+  Loop *Best = 0;
+  for (; L && L->isLoopInvariant(D) && L->getLoopPreheader();
+       L = L->getParentLoop())
+    Best = L;
+  return Best;
+}
+
+//-----------------------------------------------------------------------------
+
+/// returns the reciprocal of D, creating it in front of L if this
+/// is the first division by D within L
+const Reciprocal &DivisionExpansion::getReciprocal(Loop *L, Value *D,
+                                                   bool Signed) {
+  std::pair<ReciprocalMap::iterator, bool> it =
+    Reciprocals.insert(std::make_pair(
+      ReciprocalKey(L, std::make_pair(D, Signed)), Reciprocal()));
+  Reciprocal &R = it.first->second;
+  if (!it.second)
+    return R;
+
+  BasicBlock *Pre = L->getLoopPreheader();
+  Function *F = Pre->getParent();
+  Function *Subc =
+    Intrinsic::getDeclaration(F->getParent(), Intrinsic::c64x_subc);
+
+  BasicBlock *Done = Pre->splitBasicBlock(Pre->getTerminator(), "recip.done");
+  Pre->getTerminator()->eraseFromParent();
+  BasicBlock *Body = BasicBlock::Create(Pre->getContext(), "recip.loop", F,
+                                        Done);
+  if (Loop *Parent = L->getParentLoop()) {
+    Parent->addBasicBlockToLoop(Body, LI->getBase());
+    Parent->addBasicBlockToLoop(Done, LI->getBase());
+  }
+
+  IRBuilder<> B(Pre);
+  Value *IsNeg;
+  R.Divisor = Signed ? createAbs(B, D, IsNeg) : D;
+
+  // the setup runs even if the division in the loop does not, keep it from
+  // dividing by zero
+  Value *NZ = B.CreateSelect(B.CreateICmpEQ(R.Divisor, Zero), One, R.Divisor);
+
+  // l = ceil(log2(d)), m = 2^32 * (2^l - d) / d + 1. The numerator starts
+  // with h = 2^l - d < d, its low word is zero
+  Value *Lz = createCtlz(B, B.CreateSub(NZ, One));
+  Value *L2 = B.CreateSub(ConstantInt::get(I32, 32), Lz);
+  Value *IsOne = B.CreateICmpEQ(L2, Zero);
+  Value *H = B.CreateSelect(IsOne, Zero,
+    B.CreateAnd(B.CreateNeg(NZ),
+                B.CreateLShr(Constant::getAllOnesValue(I32), Lz)));
+
+  // a step doubles the partial remainder x and subtracts d if possible.
+  // subc against ceil(d/2) compares 2x with d without overflowing and leaves
+  // 2x - d with the quotient bit in bit 0. For an even d the bit is cleared
+  // again, for an odd d it is bit 0 of 2x - d
+  Value *Half = B.CreateAdd(B.CreateLShr(NZ, One), B.CreateAnd(NZ, One));
+  Value *Mask = B.CreateOr(NZ, ConstantInt::get(I32, ~1U));
+  B.CreateBr(Body);
+
+  B.SetInsertPoint(Body);
+  PHINode *Rem = B.CreatePHI(I32, "recip.rem");
+  PHINode *Quot = B.CreatePHI(I32, "recip.quot");
+  PHINode *Cnt = B.CreatePHI(I32, "recip.cnt");
+  Value *Step = B.CreateCall2(Subc, Rem, Half);
+  Value *RemNext = B.CreateAnd(Step, Mask);
+  Value *QuotNext = B.CreateOr(B.CreateShl(Quot, One),
+                               B.CreateAnd(Step, One));
+  Value *CntNext = B.CreateSub(Cnt, One);
+  B.CreateCondBr(B.CreateICmpEQ(CntNext, Zero), Done, Body);
+  Rem->addIncoming(H, Pre);
+  Rem->addIncoming(RemNext, Body);
+  Quot->addIncoming(Zero, Pre);
+  Quot->addIncoming(QuotNext, Body);
+  Cnt->addIncoming(ConstantInt::get(I32, 32), Pre);
+  Cnt->addIncoming(CntNext, Body);
+
+  B.SetInsertPoint(Done->getTerminator());
+  R.Multiplier = B.CreateAdd(QuotNext, One);
+
+  R.Shift1 = B.CreateSelect(IsOne, Zero, One);
+  R.Shift2 = B.CreateSelect(IsOne, Zero, B.CreateSub(L2, One));
+  return R;
+}
+
+//-----------------------------------------------------------------------------
+
+/// replaces a division by a loop invariant divisor by a multiplication with
+/// its reciprocal: q = (t + ((n - t) >> sh1)) >> sh2, t = mulhu(m, n)
+void DivisionExpansion::divideByReciprocal(BinaryOperator *BO, Loop *L) {
+  bool Signed = isSigned(BO);
+  const Reciprocal &R = getReciprocal(L, BO->getOperand(1), Signed);
+  const IntegerType *I64 = IntegerType::get(BO->getContext(), 64);
+
+  IRBuilder<> B(BO);
+  Value *N = BO->getOperand(0);
+  Value *NegN = 0;
+  Value *AN = Signed ? createAbs(B, N, NegN) : N;
+
+  Value *Prod = B.CreateMul(B.CreateZExt(R.Multiplier, I64),
+                            B.CreateZExt(AN, I64));
+  Value *T = B.CreateTrunc(B.CreateLShr(Prod, ConstantInt::get(I64, 32)),
+                           I32);
+  Value *Q = B.CreateLShr(B.CreateAdd(T, B.CreateLShr(B.CreateSub(AN, T),
+                                                      R.Shift1)),
+                          R.Shift2);
+
+  Value *Res;
+  if (isRemainder(BO)) {
+    // the remainder takes the sign of the dividend
+    Res = B.CreateSub(AN, B.CreateMul(Q, R.Divisor));
+    if (Signed)
+      Res = B.CreateSelect(NegN, B.CreateNeg(Res), Res);
+  }
+  else {
+    Res = Q;
+    if (Signed) {
+      Value *NegD = B.CreateICmpSLT(BO->getOperand(1), Zero);
+      Res = B.CreateSelect(B.CreateXor(NegN, NegD), B.CreateNeg(Q), Q);
+    }
+  }
+
+  Res->takeName(BO);
+  BO->replaceAllUsesWith(Res);
+  BO->eraseFromParent();
+  ++NumReciprocal;
+}
+
+//-----------------------------------------------------------------------------
+
+/// creates the unsigned division N / D in front of I, which ends up at the
+/// top of a new block. Returns the quotient and the remainder. With the
+/// divisor aligned to the dividend (d' = d << s), each subc step compares
+/// the partial remainder against d', subtracts if possible and shifts the
+/// quotient bit in from the right:
+///
+///   if (n < d) q = 0, r = n
+///   else
+///     s = lmbd(1, d) - lmbd(1, n), d' = d << s
+///     q0 = n >= d', n -= q0 ? d' : 0
+///     s times: n = subc(n, d' >> 1)
+///     q = q0 << s | (n & (1 << s) - 1), r = n >> s
+std::pair<Value*, Value*>
+DivisionExpansion::createSubcLoop(Instruction *I, Value *N, Value *D) {
+  LLVMContext &C = I->getContext();
+  BasicBlock *Head = I->getParent();
+  Function *F = Head->getParent();
+  Function *Subc =
+    Intrinsic::getDeclaration(F->getParent(), Intrinsic::c64x_subc);
+
+  BasicBlock *Done = Head->splitBasicBlock(I, "div.done");
+  Head->getTerminator()->eraseFromParent();
+  BasicBlock *Norm = BasicBlock::Create(C, "div.norm", F, Done);
+  BasicBlock *Pre = BasicBlock::Create(C, "div.pre", F, Done);
+  BasicBlock *Body = BasicBlock::Create(C, "div.loop", F, Done);
+  BasicBlock *Exit = BasicBlock::Create(C, "div.exit", F, Done);
+
+  IRBuilder<> B(Head);
+  B.CreateCondBr(B.CreateICmpULT(N, D), Done, Norm);
+
+  B.SetInsertPoint(Norm);
+  Value *S = B.CreateSub(createCtlz(B, D), createCtlz(B, N));
+  Value *DS = B.CreateShl(D, S);
+  Value *GE = B.CreateICmpUGE(N, DS);
+  Value *Q0 = B.CreateZExt(GE, I32);
+  Value *N0 = B.CreateSelect(GE, B.CreateSub(N, DS), N);
+  B.CreateCondBr(B.CreateICmpEQ(S, Zero), Done, Pre);
+
+  B.SetInsertPoint(Pre);
+  Value *D2 = B.CreateLShr(DS, One);
+  B.CreateBr(Body);
+
+  B.SetInsertPoint(Body);
+  PHINode *Acc = B.CreatePHI(I32, "div.acc");
+  PHINode *Cnt = B.CreatePHI(I32, "div.cnt");
+  Value *AccNext = B.CreateCall2(Subc, Acc, D2);
+  Value *CntNext = B.CreateSub(Cnt, One);
+  B.CreateCondBr(B.CreateICmpEQ(CntNext, Zero), Exit, Body);
+  Acc->addIncoming(N0, Pre);
+  Acc->addIncoming(AccNext, Body);
+  Cnt->addIncoming(S, Pre);
+  Cnt->addIncoming(CntNext, Body);
+
+  B.SetInsertPoint(Exit);
+  Value *Mask = B.CreateSub(B.CreateShl(One, S), One);
+  Value *Q = B.CreateOr(B.CreateShl(Q0, S), B.CreateAnd(AccNext, Mask));
+  Value *R = B.CreateLShr(AccNext, S);
+  B.CreateBr(Done);
+
+  B.SetInsertPoint(Done, Done->begin());
+  PHINode *QPhi = B.CreatePHI(I32, "div.q");
+  PHINode *RPhi = B.CreatePHI(I32, "div.r");
+  QPhi->addIncoming(Zero, Head);
+  QPhi->addIncoming(Q0, Norm);
+  QPhi->addIncoming(Q, Exit);
+  RPhi->addIncoming(N, Head);
+  RPhi->addIncoming(N0, Norm);
+  RPhi->addIncoming(R, Exit);
+  return std::make_pair(QPhi, RPhi);
+}
+
+//-----------------------------------------------------------------------------
+
+void DivisionExpansion::expandSubcLoop(BinaryOperator *BO) {
+  bool Signed = isSigned(BO);
+  Value *N = BO->getOperand(0);
+  Value *D = BO->getOperand(1);
+  Value *NegN = 0, *NegD = 0;
+
+  if (Signed) {
+    IRBuilder<> B(BO);
+    N = createAbs(B, N, NegN);
+    D = createAbs(B, D, NegD);
+  }
+
+  std::pair<Value*, Value*> QR = createSubcLoop(BO, N, D);
+
+  IRBuilder<> B(BO);
+  Value *Res;
+  if (isRemainder(BO)) {
+    Res = QR.second;
+    if (Signed)
+      Res = B.CreateSelect(NegN, B.CreateNeg(Res), Res);
+  }
+  else {
+    Res = QR.first;
+    if (Signed)
+      Res = B.CreateSelect(B.CreateXor(NegN, NegD), B.CreateNeg(Res), Res);
+  }
+
+  Res->takeName(BO);
+  BO->replaceAllUsesWith(Res);
+  BO->eraseFromParent();
+  ++NumExpanded;
+}
+
+//-----------------------------------------------------------------------------
+
+bool DivisionExpansion::runOnFunction(Function &F) {
+  if (!EnableInlineDiv || F.hasFnAttr(Attribute::OptimizeForSize))
+    return false;
+
+  I32 = Type::getInt32Ty(F.getContext());
+  Zero = ConstantInt::get(I32, 0);
+  One = ConstantInt::get(I32, 1);
+  Reciprocals.clear();
+
+  SmallVector<BinaryOperator*, 8> Divs;
+  for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I) {
+      BinaryOperator *BO = dyn_cast<BinaryOperator>(I);
+      if (!BO || BO->getType() != I32 || isa<Constant>(BO->getOperand(1)))
+        continue;
+      switch (BO->getOpcode()) {
+        case Instruction::UDiv: case Instruction::SDiv:
+        case Instruction::URem: case Instruction::SRem:
+          Divs.push_back(BO);
+          break;
+        default: break;
+      }
+    }
+
+  if (Divs.empty())
+    return false;
+
+  // the reciprocals first, their loops go in front of the loops and keep the
+  // loop info valid. The rest gets expanded afterwards
+  LI = &getAnalysis<LoopInfo>();
+  SmallVector<BinaryOperator*, 8> Rest;
+  for (unsigned i = 0, e = Divs.size(); i != e; ++i) {
+    BinaryOperator *BO = Divs[i];
+    Loop *L = findHoistLoop(LI->getLoopFor(BO->getParent()),
+                            BO->getOperand(1));
+    if (L)
+      divideByReciprocal(BO, L);
+    else
+      Rest.push_back(BO);
+  }
+
+  for (unsigned i = 0, e = Rest.size(); i != e; ++i)
+    expandSubcLoop(Rest[i]);
+
+  DEBUG(dbgs() << "c64x-div: " << F.getName() << ", " << Divs.size()
+               << " divisions expanded\n");
+  return true;
+}
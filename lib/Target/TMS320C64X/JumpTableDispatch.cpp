@@ -0,0 +1,231 @@
+//===-- JumpTableDispatch.cpp - TMS320C64X jump table dispatch ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A switch lowered to a jump table is a range check branching to the default
+// block, followed by a block that materializes the table address, loads the
+// entry and branches to it. Both branches have five delay slots, and the
+// load four more, which leaves little for the post RA scheduler to overlap
+// within the dispatch block.
+//
+// This pass runs on the SSA form before register allocation (machine sinking
+// would undo it any earlier) and hoists the dispatch into the block of the
+// range check, so the address computation and the table load execute in the
+// delay slots of the range check branch. The load is predicated on the range
+// check (it must not read past the table), everything else is speculated,
+// and the dispatch block is left with the indirect branch alone.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "c64x-jump-tables"
+#include "TMS320C64X.h"
+#include "TMS320C64XInstrInfo.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineMemOperand.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/PseudoSourceValue.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+STATISTIC(NumDispatches, "Number of jump table dispatches hoisted");
+
+static cl::opt<bool> EnableDispatchHoisting("c64x-hoist-jump-tables",
+  cl::desc("Load jump table entries in the delay slots of the range check"),
+  cl::init(true), cl::Hidden);
+
+namespace {
+
+  struct JumpTableDispatch : public MachineFunctionPass {
+    static char ID;
+    const TMS320C64XInstrInfo *TII;
+    MachineRegisterInfo *MRI;
+
+    JumpTableDispatch(TargetMachine &tm)
+      : MachineFunctionPass(ID),
+        TII(static_cast<const TMS320C64XInstrInfo*>(tm.getInstrInfo())),
+        MRI(0) {}
+
+    virtual const char *getPassName() const {
+      return "TMS320C64X Jump Table Dispatch";
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesCFG();
+      MachineFunctionPass::getAnalysisUsage(AU);
+    }
+
+    bool runOnMachineFunction(MachineFunction &MF);
+
+  private:
+    bool isTableLoad(const MachineInstr *MI) const;
+    bool isHoistable(MachineInstr *MI) const;
+    void sinkCompare(MachineInstr *PredCopy, MachineInstr *Pos);
+    bool hoistDispatch(MachineBasicBlock &MBB);
+  };
+
+  char JumpTableDispatch::ID = 0;
+}
+
+//-----------------------------------------------------------------------------
+
+FunctionPass *llvm::createTMS320C64XJumpTableDispatch(TargetMachine &tm) {
+  return new JumpTableDispatch(tm);
+}
+
+//-----------------------------------------------------------------------------
+
+/// returns true if MI only reads jump table entries
+bool JumpTableDispatch::isTableLoad(const MachineInstr *MI) const {
+  if (MI->memoperands_empty())
+    return false;
+
+  for (MachineInstr::mmo_iterator I = MI->memoperands_begin(),
+       E = MI->memoperands_end(); I != E; ++I)
+    if ((*I)->getValue() != PseudoSourceValue::getJumpTable())
+      return false;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+/// returns true if MI may execute ahead of the range check, table loads
+/// are predicated on it when moved
+bool JumpTableDispatch::isHoistable(MachineInstr *MI) const {
+  const TargetInstrDesc &TID = MI->getDesc();
+  if (MI->isPHI() || TID.isCall() || TID.mayStore() || TID.isTerminator()
+      || TID.hasUnmodeledSideEffects() || TII->isPredicated(MI))
+    return false;
+
+  if (TID.mayLoad() && (!isTableLoad(MI) || !TII->isPredicable(MI)))
+    return false;
+
+  for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+    const MachineOperand &MO = MI->getOperand(i);
+    if (MO.isReg() && MO.getReg()
+        && !TargetRegisterInfo::isVirtualRegister(MO.getReg()))
+      return false;
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+/// moves the copy into a predicate register in front of Pos, along with the
+/// compare it reads if nothing else does
+void JumpTableDispatch::sinkCompare(MachineInstr *PredCopy,
+                                    MachineInstr *Pos)
+{
+  MachineBasicBlock *MBB = Pos->getParent();
+  MBB->splice(Pos, MBB, PredCopy);
+
+  unsigned Reg = PredCopy->getOperand(1).getReg();
+  if (!TargetRegisterInfo::isVirtualRegister(Reg)
+      || !MRI->hasOneNonDBGUse(Reg))
+    return;
+
+  MachineInstr *Cmp = MRI->getVRegDef(Reg);
+  const TargetInstrDesc &TID = Cmp->getDesc();
+  if (Cmp->getParent() != MBB || Cmp->isPHI() || TID.mayLoad()
+      || TID.mayStore() || TID.hasUnmodeledSideEffects())
+    return;
+
+  MBB->splice(PredCopy, MBB, Cmp);
+}
+
+//-----------------------------------------------------------------------------
+
+/// moves the dispatch of MBB (ending with an indirect branch) in front of
+/// the conditional branch of its only predecessor
+bool JumpTableDispatch::hoistDispatch(MachineBasicBlock &MBB) {
+  MachineBasicBlock::iterator Term = MBB.getFirstTerminator();
+  if (Term == MBB.end() || Term->getOpcode() != TMS320C64X::branch_reg
+      || TII->isPredicated(Term) || MBB.pred_size() != 1)
+    return false;
+
+  MachineBasicBlock *Pred = *MBB.pred_begin();
+  MachineBasicBlock *TBB = 0, *FBB = 0;
+  SmallVector<MachineOperand, 2> Cond;
+  if (Pred == &MBB || TII->AnalyzeBranch(*Pred, TBB, FBB, Cond, false)
+      || Cond.empty())
+    return false;
+
+  // the condition the dispatch block is entered on
+  if (TBB != &MBB && TII->ReverseBranchCondition(Cond))
+    return false;
+
+  if (Cond[1].isReg() && !TargetRegisterInfo::isVirtualRegister(
+        Cond[1].getReg()))
+    return false;
+
+  bool HasLoad = false;
+  for (MachineBasicBlock::iterator I = MBB.begin(); I != Term; ++I) {
+    if (I->isDebugValue())
+      continue;
+    if (!isHoistable(I))
+      return false;
+    HasLoad |= I->getDesc().mayLoad();
+  }
+  if (!HasLoad)
+    return false;
+
+  DEBUG(dbgs() << "c64x-jump-tables: hoisting dispatch of BB#"
+               << MBB.getNumber() << " into BB#" << Pred->getNumber() << "\n");
+
+  const unsigned PredReg = Cond[1].getReg();
+  MachineInstr *PredCopy = MRI->getVRegDef(PredReg);
+  if (PredCopy && (PredCopy->getParent() != Pred || !PredCopy->isCopy()))
+    PredCopy = 0;
+
+  MachineBasicBlock::iterator Pos = Pred->getFirstTerminator();
+  for (MachineBasicBlock::iterator I = MBB.begin(); I != Term; ) {
+    MachineInstr *MI = I++;
+    if (MI->isDebugValue()) {
+      MI->eraseFromParent();
+      continue;
+    }
+
+    Pred->splice(Pos, &MBB, MI);
+    if (MI->getDesc().mayLoad()) {
+      bool Predicated = TII->PredicateInstruction(MI, Cond);
+      assert(Predicated && "Can not predicate the jump table load!");
+      (void)Predicated;
+
+      // keep the predicate (and the compare it is copied from) live as
+      // briefly as before, the coalescer does not join them otherwise
+      if (PredCopy) {
+        sinkCompare(PredCopy, MI);
+        PredCopy = 0;
+      }
+    }
+  }
+
+  // the range check outlives its branch now
+  MRI->clearKillFlags(PredReg);
+  ++NumDispatches;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool JumpTableDispatch::runOnMachineFunction(MachineFunction &MF) {
+  if (!EnableDispatchHoisting || !MF.getJumpTableInfo())
+    return false;
+
+  MRI = &MF.getRegInfo();
+
+  bool Changed = false;
+  for (MachineFunction::iterator I = MF.begin(), E = MF.end(); I != E; ++I)
+    Changed |= hoistDispatch(*I);
+  return Changed;
+}
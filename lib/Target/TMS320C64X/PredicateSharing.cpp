@@ -0,0 +1,342 @@
+//===-- PredicateSharing.cpp - TMS320C64X predicate reuse -----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Only A0-A2 and B0-B2 can predicate an instruction. Instruction selection
+// gives every branch its own compare and copies the result into one of them,
+// and the if-conversion predicates the merged blocks on those copies. Big
+// converted regions end up with lots of predicate registers, many holding
+// the same condition (or its inverse) computed over and over.
+//
+// This pass runs on the SSA form after the if-conversion and shares them:
+//
+//  - conditions are normalized (x < y is y > x, x > c is not x < c + 1, an
+//    xor 1 of a compare is its inverse), so equal and inverse compares are
+//    recognized no matter how they were written
+//  - a predicate use whose condition is available from a dominating compare
+//    reads that one. An inverse condition is tested on zero ([!A1]) instead
+//    of being computed again, a compare computing an equal condition is
+//    removed altogether
+//  - predicate registers are only copied from the compare results in the
+//    block using them. Across blocks the condition lives in a general
+//    purpose register, which keeps the live ranges of the predicate
+//    registers short and leaves the allocator the rest of the register file
+//    for anything that has to survive longer
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "c64x-predicates"
+#include "TMS320C64X.h"
+#include "TMS320C64XInstrInfo.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/CodeGen/MachineDominators.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include <map>
+
+using namespace llvm;
+
+STATISTIC(NumCompares, "Number of compares removed");
+STATISTIC(NumInverted, "Number of predicates tested on zero instead");
+STATISTIC(NumShared, "Number of predicate uses reading another compare");
+
+static cl::opt<bool> EnablePredicateSharing("c64x-share-predicates",
+  cl::desc("Reuse and invert predicates of dominating compares"),
+  cl::init(true), cl::Hidden);
+
+namespace {
+
+  struct PredicateSharing : public MachineFunctionPass {
+    static char ID;
+    const TMS320C64XInstrInfo *TII;
+    MachineRegisterInfo *MRI;
+    MachineDominatorTree *MDT;
+
+    PredicateSharing(TargetMachine &tm)
+      : MachineFunctionPass(ID),
+        TII(static_cast<const TMS320C64XInstrInfo*>(tm.getInstrInfo())),
+        MRI(0), MDT(0) {
+      initializeMachineDominatorTreePass(*PassRegistry::getPassRegistry());
+    }
+
+    virtual const char *getPassName() const {
+      return "TMS320C64X Predicate Sharing";
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesCFG();
+      AU.addRequired<MachineDominatorTree>();
+      AU.addPreserved<MachineDominatorTree>();
+      MachineFunctionPass::getAnalysisUsage(AU);
+    }
+
+    bool runOnMachineFunction(MachineFunction &MF);
+
+  private:
+    typedef std::map<PredicateCondition,
+                     SmallVector<std::pair<PredicateCondition,
+                                           MachineBasicBlock*>, 2> >
+      AvailableMap;
+
+    // compares computing each condition, in the blocks visited so far
+    AvailableMap Available;
+
+    // predicate registers copied from compare results in the current block
+    DenseMap<unsigned, unsigned> LocalPreds;
+
+    // registers that may have lost their last use
+    SmallVector<unsigned, 16> MaybeDead;
+
+    const PredicateCondition *getAvailable(const PredicateCondition &Cond,
+                                           MachineBasicBlock *MBB) const;
+    unsigned getLocalPredicate(MachineInstr *MI, unsigned CompareReg);
+    bool shareCompare(MachineInstr *MI);
+    bool sharePredicate(MachineInstr *MI);
+    bool processBlock(MachineBasicBlock &MBB);
+    void eraseIfDead(unsigned Reg);
+  };
+
+  char PredicateSharing::ID = 0;
+}
+
+//-----------------------------------------------------------------------------
+
+FunctionPass *llvm::createTMS320C64XPredicateSharing(TargetMachine &tm) {
+  return new PredicateSharing(tm);
+}
+
+//-----------------------------------------------------------------------------
+
+/// returns a compare computing Cond (or its inverse) whose block dominates
+/// MBB. The blocks are visited in dominator tree order, so a compare in MBB
+/// itself has been seen before the current instruction
+const PredicateCondition *
+PredicateSharing::getAvailable(const PredicateCondition &Cond,
+                               MachineBasicBlock *MBB) const
+{
+  AvailableMap::const_iterator I = Available.find(Cond);
+  if (I == Available.end())
+    return 0;
+
+  for (unsigned i = 0, e = I->second.size(); i != e; ++i)
+    if (MDT->dominates(I->second[i].second, MBB))
+      return &I->second[i].first;
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+
+/// returns a predicate register holding CompareReg in front of MI, copying
+/// it in the first time it is needed within the block
+unsigned PredicateSharing::getLocalPredicate(MachineInstr *MI,
+                                             unsigned CompareReg)
+{
+  DenseMap<unsigned, unsigned>::iterator I = LocalPreds.find(CompareReg);
+  if (I != LocalPreds.end())
+    return I->second;
+
+  MachineBasicBlock &MBB = *MI->getParent();
+  MachineBasicBlock::iterator Pos = MI;
+  if (MI->getDesc().isTerminator())
+    Pos = MBB.getFirstTerminator();
+
+  unsigned Reg = MRI->createVirtualRegister(TMS320C64X::PredRegsRegisterClass);
+  BuildMI(MBB, Pos, MI->getDebugLoc(), TII->get(TargetOpcode::COPY), Reg)
+    .addReg(CompareReg);
+
+  // the compare result lives longer now
+  MRI->clearKillFlags(CompareReg);
+  LocalPreds[CompareReg] = Reg;
+  return Reg;
+}
+
+//-----------------------------------------------------------------------------
+
+/// removes MI if it is a compare of a condition a dominating compare already
+/// computes, otherwise makes it available for the blocks it dominates
+bool PredicateSharing::shareCompare(MachineInstr *MI) {
+  if (!MI->getNumOperands() || !MI->getOperand(0).isReg()
+      || !MI->getOperand(0).isDef())
+    return false;
+
+  unsigned Reg = MI->getOperand(0).getReg();
+  PredicateCondition Cond;
+  if (!TargetRegisterInfo::isVirtualRegister(Reg)
+      || !TII->analyzePredicate(*MRI, Reg, Cond) || Cond.CompareReg != Reg)
+    return false;
+
+  const PredicateCondition *Avail = getAvailable(Cond, MI->getParent());
+  if (!Avail) {
+    Available[Cond].push_back(std::make_pair(Cond, MI->getParent()));
+    return false;
+  }
+
+  // an inverse compare stays for its other uses, its predicate uses are
+  // rewritten one by one
+  if (Avail->Inverted != Cond.Inverted
+      || MRI->getRegClass(Avail->CompareReg) != MRI->getRegClass(Reg))
+    return false;
+
+  DEBUG(dbgs() << "c64x-predicates: removed " << *MI);
+
+  SmallVector<unsigned, 2> Uses;
+  for (unsigned i = 1, e = MI->getNumOperands(); i != e; ++i)
+    if (MI->getOperand(i).isReg() && MI->getOperand(i).getReg())
+      Uses.push_back(MI->getOperand(i).getReg());
+
+  MRI->replaceRegWith(Reg, Avail->CompareReg);
+  MRI->clearKillFlags(Avail->CompareReg);
+  MI->eraseFromParent();
+  MaybeDead.append(Uses.begin(), Uses.end());
+  ++NumCompares;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+/// lets the predicate of MI read the dominating compare of its condition,
+/// through a predicate register copied in the block of MI
+bool PredicateSharing::sharePredicate(MachineInstr *MI) {
+  int PredIdx = MI->findFirstPredOperandIdx();
+  if (PredIdx == -1 || !TII->isPredicated(MI))
+    return false;
+
+  MachineOperand &PredImm = MI->getOperand(PredIdx);
+  MachineOperand &PredReg = MI->getOperand(PredIdx + 1);
+  if (!PredReg.isReg()
+      || !TargetRegisterInfo::isVirtualRegister(PredReg.getReg()))
+    return false;
+
+  PredicateCondition Cond;
+  if (!TII->analyzePredicate(*MRI, PredReg.getReg(), Cond))
+    return false;
+
+  const PredicateCondition *Avail = getAvailable(Cond, MI->getParent());
+  if (!Avail)
+    return false;
+
+  unsigned OldReg = PredReg.getReg();
+  unsigned NewReg = getLocalPredicate(MI, Avail->CompareReg);
+  bool Invert = Avail->Inverted != Cond.Inverted;
+  if (NewReg == OldReg && !Invert)
+    return false;
+
+  PredReg.setReg(NewReg);
+  PredReg.setIsKill(false);
+  if (Invert) {
+    PredImm.setImm(!PredImm.getImm());
+    ++NumInverted;
+  }
+  if (Cond.CompareReg != Avail->CompareReg)
+    ++NumShared;
+
+  MaybeDead.push_back(OldReg);
+  DEBUG(dbgs() << "c64x-predicates: rewrote " << *MI);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool PredicateSharing::processBlock(MachineBasicBlock &MBB) {
+  bool Changed = false;
+  LocalPreds.clear();
+
+  for (MachineBasicBlock::iterator I = MBB.begin(); I != MBB.end(); ) {
+    MachineInstr *MI = I++;
+
+    // predicate registers the block already has copies of
+    if (MI->isCopy() && !TII->isPredicated(MI)) {
+      unsigned Dst = MI->getOperand(0).getReg();
+      unsigned Src = MI->getOperand(1).getReg();
+      if (TargetRegisterInfo::isVirtualRegister(Dst)
+          && TargetRegisterInfo::isVirtualRegister(Src)
+          && MRI->getRegClass(Dst) == TMS320C64X::PredRegsRegisterClass
+          && !LocalPreds.count(Src))
+        LocalPreds[Src] = Dst;
+      continue;
+    }
+
+    if (shareCompare(MI)) {
+      Changed = true;
+      continue;
+    }
+    Changed |= sharePredicate(MI);
+  }
+  return Changed;
+}
+
+//-----------------------------------------------------------------------------
+
+/// erases the copies, inversions and compares nothing reads any more
+void PredicateSharing::eraseIfDead(unsigned Reg) {
+  if (!TargetRegisterInfo::isVirtualRegister(Reg)
+      || !MRI->use_nodbg_empty(Reg))
+    return;
+
+  MachineInstr *Def = MRI->getVRegDef(Reg);
+  if (!Def || TII->isPredicated(Def) || !Def->getOperand(0).isReg()
+      || Def->getOperand(0).getReg() != Reg)
+    return;
+
+  switch (Def->getOpcode()) {
+    case TargetOpcode::COPY:
+    case TMS320C64X::xor_p_ri:
+    case TMS320C64X::cmpeq_p_rr:
+    case TMS320C64X::cmpeq_p_ri:
+    case TMS320C64X::cmpgt_p_rr:
+    case TMS320C64X::cmpgtu_p_rr:
+    case TMS320C64X::cmplt_p_rr:
+    case TMS320C64X::cmpltu_p_rr:
+    case TMS320C64X::mvk_1:
+    case TMS320C64X::mvk_2:
+      break;
+    default:
+      return;
+  }
+
+  SmallVector<unsigned, 2> Uses;
+  for (unsigned i = 1, e = Def->getNumOperands(); i != e; ++i) {
+    const MachineOperand &MO = Def->getOperand(i);
+    if (MO.isReg() && MO.getReg() && MO.isUse())
+      Uses.push_back(MO.getReg());
+  }
+
+  Def->eraseFromParent();
+  for (unsigned i = 0, e = Uses.size(); i != e; ++i)
+    eraseIfDead(Uses[i]);
+}
+
+//-----------------------------------------------------------------------------
+
+bool PredicateSharing::runOnMachineFunction(MachineFunction &MF) {
+  if (!EnablePredicateSharing)
+    return false;
+
+  MRI = &MF.getRegInfo();
+  MDT = &getAnalysis<MachineDominatorTree>();
+  Available.clear();
+  MaybeDead.clear();
+
+  bool Changed = false;
+  for (df_iterator<MachineDomTreeNode*> I = df_begin(MDT->getRootNode()),
+       E = df_end(MDT->getRootNode()); I != E; ++I)
+    Changed |= processBlock(*I->getBlock());
+
+  for (unsigned i = 0, e = MaybeDead.size(); i != e; ++i)
+    eraseIfDead(MaybeDead[i]);
+  return Changed;
+}
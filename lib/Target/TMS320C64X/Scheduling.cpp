@@ -14,6 +14,7 @@
 
 #define DEBUG_TYPE "scheduling"
 #include "Scheduling.h"
+#include "TMS320C64XInstrInfo.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/CodeGen/MachineRegions.h"
 #include "llvm/Target/TargetInstrInfo.h"
@@ -126,6 +127,10 @@ void TMS320C64X::SchedulerBase::BuildSchedGraph(AliasAnalysis *AA) {
     else
       ComputeLatency(SU);
 
+    // AJO: KILL and IMPLICIT_DEF are not emitted and take no time
+    if (MI->isKill() || MI->isImplicitDef())
+      SU->Latency = 0;
+
     // Add register-based dependencies (data, anti, and output).
     for (unsigned j = 0, n = MI->getNumOperands(); j != n; ++j) {
       const MachineOperand &MO = MI->getOperand(j);
@@ -159,7 +164,8 @@ void TMS320C64X::SchedulerBase::BuildSchedGraph(AliasAnalysis *AA) {
         if (DefSU != SU &&
             (Kind != SDep::Output || !MO.isDead() ||
              !DefSU->getInstr()->registerDefIsDead(Reg)))
-          DefSU->addPred(SDep(SU, Kind, AOLatency, /*Reg=*/Reg));
+          DefSU->addPred(SDep(SU, Kind, Kind == SDep::Anti ? AOLatency
+                                : getOutputLatency(SU, DefSU, Reg), Reg));
       }
       // GB: added 1 lines
       if (TRI->isPhysicalRegister(Reg)) {
@@ -173,7 +179,9 @@ void TMS320C64X::SchedulerBase::BuildSchedGraph(AliasAnalysis *AA) {
             if (DefSU != SU &&
                 (Kind != SDep::Output || !MO.isDead() ||
                  !DefSU->getInstr()->registerDefIsDead(*Alias)))
-              DefSU->addPred(SDep(SU, Kind, AOLatency, /*Reg=*/ *Alias));
+              DefSU->addPred(SDep(SU, Kind, Kind == SDep::Anti ? AOLatency
+                                    : getOutputLatency(SU, DefSU, *Alias),
+                                  *Alias));
           }
         }
       // GB: added 1 lines
@@ -585,6 +593,10 @@ void TMS320C64X::SchedulerBase::BuildSchedGraph(ForwardIter first,
     else
       ComputeLatency(SU);
 
+    // AJO: KILL and IMPLICIT_DEF are not emitted and take no time
+    if (MI->isKill() || MI->isImplicitDef())
+      SU->Latency = 0;
+
     // Add register-based dependencies (data, anti, and output).
     for (unsigned j = 0, n = MI->getNumOperands(); j != n; ++j) {
       const MachineOperand &MO = MI->getOperand(j);
@@ -618,7 +630,8 @@ void TMS320C64X::SchedulerBase::BuildSchedGraph(ForwardIter first,
         if (DefSU != SU &&
             (Kind != SDep::Output || !MO.isDead() ||
              !DefSU->getInstr()->registerDefIsDead(Reg)))
-          DefSU->addPred(SDep(SU, Kind, AOLatency, /*Reg=*/Reg));
+          DefSU->addPred(SDep(SU, Kind, Kind == SDep::Anti ? AOLatency
+                                : getOutputLatency(SU, DefSU, Reg), Reg));
       }
       // GB: added 1 lines
       if (TRI->isPhysicalRegister(Reg)) {
@@ -632,7 +645,9 @@ void TMS320C64X::SchedulerBase::BuildSchedGraph(ForwardIter first,
             if (DefSU != SU &&
                 (Kind != SDep::Output || !MO.isDead() ||
                  !DefSU->getInstr()->registerDefIsDead(*Alias)))
-              DefSU->addPred(SDep(SU, Kind, AOLatency, /*Reg=*/ *Alias));
+              DefSU->addPred(SDep(SU, Kind, Kind == SDep::Anti ? AOLatency
+                                    : getOutputLatency(SU, DefSU, *Alias),
+                                  *Alias));
           }
         }
       // GB: added 1 lines
@@ -942,6 +957,21 @@ bool SchedulerBase::hasSideEffects(const MachineInstr *MI) {
   return (TID.mayLoad() || TID.mayStore() || TID.hasUnmodeledSideEffects());
 }
 
+/// getOutputLatency - The results of the C64x+ are written at the end of the
+/// delay slots. A def with fewer delay slots than an earlier one of the same
+/// register would otherwise be overwritten by the latter.
+unsigned SchedulerBase::getOutputLatency(SUnit *Earlier, SUnit *Later,
+                                         unsigned Reg) const {
+  if (ForceUnitLatencies() || !Earlier->isInstr() || !Later->isInstr())
+    return 1;
+
+  const TMS320C64XInstrInfo *TII =
+    static_cast<const TMS320C64XInstrInfo*>(this->TII);
+  int Diff = (int) TII->getDefLatency(InstrItins, Earlier->getInstr(), Reg)
+           - (int) TII->getDefLatency(InstrItins, Later->getInstr(), Reg);
+  return std::max(1, Diff + 1);
+}
+
 void TMS320C64X::RegionScheduler::BuildSchedGraph(AliasAnalysis *AA) {
   MachineSingleEntryPathRegion::instr_reverse_iterator begin, end;
   begin = MR->instr_rbegin();
@@ -38,6 +38,11 @@ namespace TMS320C64X {
     void BuildSchedGraph(ForwardIter first, ForwardIter last,
                                 AliasAnalysis *AA);
     static bool hasSideEffects(const MachineInstr *MI);
+
+    // latency of an output dependence on Reg, the later def needs to write
+    // after the earlier one
+    unsigned getOutputLatency(SUnit *Earlier, SUnit *Later,
+                              unsigned Reg) const;
   };
 
   class RegionScheduler : protected SchedulerBase {
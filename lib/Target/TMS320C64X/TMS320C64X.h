@@ -33,6 +33,11 @@ namespace llvm {
   class TMS320C64XTargetMachine;
   class PassRegistry;
   class FunctionPass;
+  class MCCodeEmitter;
+  class MCContext;
+  class MCInst;
+  class Target;
+  class TargetAsmBackend;
 
   namespace TMS320C64X {
     /// cluster assignment algorithms available through options
@@ -42,7 +47,8 @@ namespace llvm {
       ClusterUAS,
       ClusterUAS_none,
       ClusterUAS_rand,
-      ClusterUAS_mwp
+      ClusterUAS_mwp,
+      ClusterUAS_rp
     };
   }
 
@@ -54,15 +60,44 @@ namespace llvm {
                                       TMS320C64X::AssignmentAlgorithm alg);
   FunctionPass *createTMS320C64XDelaySlotFillerPass(TargetMachine &tm);
   FunctionPass *createTMS320C64XScheduler(TargetMachine &tm);
+  FunctionPass *createTMS320C64XModuloScheduler(TargetMachine &tm);
   FunctionPass *createTMS320C64XBranchDelayExpander(TargetMachine &tm);
   FunctionPass *createTMS320C64XBranchDelayReducer(TargetMachine &tm);
+  FunctionPass *createTMS320C64XBranchOnCounterSelect(TargetMachine &tm);
+  FunctionPass *createTMS320C64XBranchOnCounterFusion(TargetMachine &tm);
+  FunctionPass *createTMS320C64XCircularAddressingPass(TargetMachine &tm);
+  FunctionPass *createTMS320C64XPredicateSharing(TargetMachine &tm);
+  FunctionPass *createTMS320C64XJumpTableDispatch(TargetMachine &tm);
+  FunctionPass *createTMS320C64XConstantHoisting(TargetMachine &tm);
+  FunctionPass *createTMS320C64XConstantExpansion(TargetMachine &tm);
   FunctionPass* createTMS320C64XCallTimerPass(TMS320C64XTargetMachine &TM);
+  FunctionPass *createTMS320C64XDivisionExpansionPass();
+  FunctionPass *createTMS320C64XCounterLoopPass();
 
   /// createTMS320C64XIfConversionPass - create a pass for converting if/
   /// else structures for the machine basic blocks for the TMS320C64X target.
   /// This pass processes machine functions and needs to be run before RA
   FunctionPass *createTMS320C64XIfConversionPass(TMS320C64XTargetMachine &TM);
 
+  // object file emission (ELF)
+  MCCodeEmitter *createTMS320C64XMCCodeEmitter(const Target &,
+                                               TargetMachine &TM,
+                                               MCContext &Ctx);
+  TargetAsmBackend *createTMS320C64XAsmBackend(const Target &,
+                                               const std::string &);
+
+  namespace TMS320C64X {
+    /// getCompactEncoding - returns true if the lowered instruction has a
+    /// 16-bit (C64x+ compact) form and stores its encoding in Bits. Only the
+    /// header expansion PROT=RS=DSZ=BR=SAT=0 is supported.
+    bool getCompactEncoding(const MCInst &MI, const TargetMachine &TM,
+                            unsigned &Bits);
+
+    /// hasUnitEncoding - returns true if the flexible instruction Opcode can
+    /// be encoded for the given functional unit (TMS320C64XII::unit_*).
+    bool hasUnitEncoding(unsigned Opcode, unsigned Unit);
+  }
+
   extern Target TheTMS320C64XTarget;
 }
 
@@ -0,0 +1,169 @@
+//===-- TMS320C64XAsmBackend.cpp - TMS320C64X Assembler Backend -----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The assembler backend for ELF objects: patches fixups into the 32-bit
+// instruction words and selects the C6000 ELF object writer.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TMS320C64X.h"
+#include "TMS320C64XFixupKinds.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/MC/MCAssembler.h"
+#include "llvm/MC/MCELFObjectWriter.h"
+#include "llvm/MC/MCFixupKindInfo.h"
+#include "llvm/MC/MCInst.h"
+#include "llvm/MC/MCObjectWriter.h"
+#include "llvm/Support/ELF.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetAsmBackend.h"
+#include "llvm/Target/TargetRegistry.h"
+using namespace llvm;
+
+namespace {
+
+class TMS320C64XELFObjectWriter : public MCELFObjectTargetWriter {
+public:
+  TMS320C64XELFObjectWriter(Triple::OSType OSType)
+    : MCELFObjectTargetWriter(/*is64Bit*/ false, OSType, ELF::EM_TI_C6000,
+                              /*HasRelocationAddend*/ true) {}
+};
+
+class TMS320C64XAsmBackend : public TargetAsmBackend {
+  Triple::OSType OSType;
+
+public:
+  TMS320C64XAsmBackend(const Target &T, Triple::OSType _OSType)
+    : TargetAsmBackend(), OSType(_OSType) {}
+
+  unsigned getNumFixupKinds() const {
+    return TMS320C64X::NumTargetFixupKinds;
+  }
+
+  const MCFixupKindInfo &getFixupKindInfo(MCFixupKind Kind) const {
+    const static MCFixupKindInfo Infos[TMS320C64X::NumTargetFixupKinds] = {
+// This table *must* be in the order that the fixup_* kinds are defined in
+// TMS320C64XFixupKinds.h.
+//
+// Name                  Offset (bits) Size (bits)     Flags
+{ "fixup_c64x_abs_l16",  7,            16,  0 },
+{ "fixup_c64x_abs_h16",  7,            16,  0 },
+{ "fixup_c64x_pcr_s21",  7,            21,  MCFixupKindInfo::FKF_IsPCRel |
+                                   MCFixupKindInfo::FKF_IsAlignedDownTo32Bytes },
+{ "fixup_c64x_pcr_s10",  13,           10,  MCFixupKindInfo::FKF_IsPCRel |
+                                   MCFixupKindInfo::FKF_IsAlignedDownTo32Bytes }
+    };
+
+    if (Kind < FirstTargetFixupKind)
+      return TargetAsmBackend::getFixupKindInfo(Kind);
+
+    assert(unsigned(Kind - FirstTargetFixupKind) < getNumFixupKinds() &&
+           "Invalid kind!");
+    return Infos[Kind - FirstTargetFixupKind];
+  }
+
+  // instruction sizes are fixed, there is nothing to relax
+  bool MayNeedRelaxation(const MCInst &Inst) const { return false; }
+
+  void RelaxInstruction(const MCInst &Inst, MCInst &Res) const {
+    llvm_unreachable("TMS320C64X instructions are never relaxed");
+  }
+
+  bool WriteNopData(uint64_t Count, MCObjectWriter *OW) const;
+
+  void ApplyFixup(const MCFixup &Fixup, char *Data, unsigned DataSize,
+                  uint64_t Value) const;
+
+  MCObjectWriter *createObjectWriter(raw_ostream &OS) const {
+    return createELFObjectWriter(new TMS320C64XELFObjectWriter(OSType), OS,
+                                 /*IsLittleEndian*/ true);
+  }
+};
+
+} // end anonymous namespace
+
+//-----------------------------------------------------------------------------
+
+bool TMS320C64XAsmBackend::WriteNopData(uint64_t Count,
+                                        MCObjectWriter *OW) const
+{
+  if ((Count % 4) != 0)
+    return false;
+
+  // an all-zero word is a single cycle nop
+  for (uint64_t i = 0; i < Count; i += 4)
+    OW->Write32(0x00000000);
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void TMS320C64XAsmBackend::ApplyFixup(const MCFixup &Fixup, char *Data,
+                                      unsigned DataSize, uint64_t Value) const
+{
+  unsigned Offset = Fixup.getOffset();
+  unsigned Bits, Shift;
+
+  switch ((unsigned) Fixup.getKind()) {
+    case FK_Data_1: Bits = 8; Shift = 0; break;
+    case FK_Data_2: Bits = 16; Shift = 0; break;
+    case FK_Data_4: Bits = 32; Shift = 0; break;
+
+    case TMS320C64X::fixup_c64x_abs_l16:
+      Value &= 0xffff;
+      Bits = 16; Shift = 7;
+      break;
+
+    case TMS320C64X::fixup_c64x_abs_h16:
+      Value = (Value >> 16) & 0xffff;
+      Bits = 16; Shift = 7;
+      break;
+
+    case TMS320C64X::fixup_c64x_pcr_s21:
+      // displacement is counted in instruction words
+      Value = (int64_t) Value >> 2;
+      if ((int64_t) Value < -(1 << 20) || (int64_t) Value >= (1 << 20))
+        report_fatal_error("branch target out of range");
+      Bits = 21; Shift = 7;
+      break;
+
+    case TMS320C64X::fixup_c64x_pcr_s10:
+      Value = (int64_t) Value >> 2;
+      if ((int64_t) Value < -(1 << 9) || (int64_t) Value >= (1 << 9))
+        report_fatal_error("bdec/bpos target out of range");
+      Bits = 10; Shift = 13;
+      break;
+
+    default:
+      llvm_unreachable("Unknown fixup kind!");
+  }
+
+  unsigned Size = (Bits + Shift + 7) / 8;
+  assert(Offset + Size <= DataSize && "Invalid fixup offset!");
+
+  uint64_t Mask = (Bits == 32) ? 0xffffffffULL : ((1ULL << Bits) - 1);
+  Mask <<= Shift;
+  Value = (Value << Shift) & Mask;
+
+  // little endian, read-modify-write the affected bytes
+  for (unsigned i = 0; i != Size; ++i) {
+    uint8_t M = uint8_t(Mask >> (i * 8));
+    uint8_t V = uint8_t(Value >> (i * 8));
+    Data[Offset + i] = (Data[Offset + i] & ~M) | (V & M);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+TargetAsmBackend *llvm::createTMS320C64XAsmBackend(const Target &T,
+                                                   const std::string &TT) {
+  return new TMS320C64XAsmBackend(T, Triple(TT).getOS());
+}
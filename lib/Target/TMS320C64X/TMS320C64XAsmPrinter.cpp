@@ -42,21 +42,32 @@
 #include "llvm/CodeGen/MachineInstr.h"
 #include "llvm/CodeGen/MachineModuleInfo.h"
 #include "llvm/CodeGen/MachineModuleInfoImpls.h"
+#include "llvm/MC/MCContext.h"
+#include "llvm/MC/MCExpr.h"
+#include "llvm/MC/MCInst.h"
 #include "llvm/MC/MCStreamer.h"
 #include "llvm/MC/MCSymbol.h"
 #include "llvm/Target/TargetLoweringObjectFile.h"
 #include "llvm/Target/TargetRegistry.h"
 #include "llvm/Target/Mangler.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/FormattedStream.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/STLExtras.h"
 
 using namespace llvm;
 
+static cl::opt<bool> EnableCompact("c64x-compact",
+  cl::Hidden, cl::desc("Use 16-bit instructions in object files (c64x+)"),
+  cl::init(false));
+
+STATISTIC(NumHeaderPackets, "Number of header based fetch packets");
+
 namespace {
 
     typedef MachineBasicBlock::const_iterator MIiter;
@@ -68,6 +79,17 @@ class TMS320C64XAsmPrinter : public AsmPrinter {
     const TMS320C64XSubtarget &ST;
     bool BundleMode;
 
+    // header based fetch packets need the layout of the whole function, the
+    // code is queued and emitted by emit_fetch_packets
+    struct QueuedInst {
+      MCInst Inst;
+      SmallVector<MCSymbol*, 1> Labels; // labels preceding the instruction
+    };
+
+    bool CompactMode;
+    std::vector<QueuedInst> FunctionCode;
+    SmallVector<MCSymbol*, 2> QueuedLabels;
+
   public:
     explicit TMS320C64XAsmPrinter(TargetMachine &TM, MCStreamer &MCS);
 
@@ -95,6 +117,23 @@ class TMS320C64XAsmPrinter : public AsmPrinter {
     MIiter emit_instructions(MIRange mir);
     MIiter emit_bundle(MIRange mir);
 
+    // object file emission. Instructions are lowered to MCInsts which carry
+    // an additional flags operand (p-bit) for the code emitter.
+    bool isObjectMode() const { return !OutStreamer.hasRawTextSupport(); }
+
+    MIiter emit_mc_bundle(MIRange mir);
+    void emit_mc_packet(SmallVectorImpl<const MachineInstr*> &Packet,
+                        bool serial);
+    void emit_mc_prolog(const MachineInstr *MI);
+    void emit_mc_epilog(const MachineInstr *MI);
+    void emit_mc(MCInst &Inst, bool parallel);
+    void emit_mc_label(MCSymbol *Sym);
+    void emit_fetch_packets();
+
+    bool lowerOperand(const MachineOperand &MO, MCOperand &MCOp);
+    void lowerInstruction(const MachineInstr *MI, MCInst &Inst);
+    void lowerMove(const MachineInstr *MI, unsigned unit, MCInst &Inst);
+
     bool runOnMachineFunction(MachineFunction &F);
 
     virtual void EmitGlobalVariable(const GlobalVariable *GVar);
@@ -106,6 +145,9 @@ class TMS320C64XAsmPrinter : public AsmPrinter {
     void printOperand(const MachineInstr *MI, int opNum, raw_ostream &O);
 
     void printMemOperand(const MachineInstr *MI, int opNum, raw_ostream &O);
+    void printPreModOperand(const MachineInstr *MI, int opNum, raw_ostream &O);
+    void printPostModOperand(const MachineInstr *MI, int opNum,
+                             raw_ostream &O);
 
     void printInstruction(const MachineInstr *MI, raw_ostream &O);
 
@@ -140,7 +182,8 @@ TMS320C64XAsmPrinter::TMS320C64XAsmPrinter(TargetMachine &TM, MCStreamer &MCS)
 : AsmPrinter(TM, MCS),
   UnitStrings(TMS320C64XInstrInfo::getUnitStrings()),
   ST(TM.getSubtarget<TMS320C64XSubtarget>()),
-  BundleMode(ST.enablePostRAScheduler())
+  BundleMode(ST.enablePostRAScheduler()),
+  CompactMode(false)
 {}
 
 //-----------------------------------------------------------------------------
@@ -154,9 +197,16 @@ bool TMS320C64XAsmPrinter::runOnMachineFunction(MachineFunction &MF) {
   SetupMachineFunction(MF);
   EmitConstantPool();
 
-  OutStreamer.EmitRawText(StringRef("\n\n"));
+  CompactMode = isObjectMode() && EnableCompact;
+
+  if (!isObjectMode())
+    OutStreamer.EmitRawText(StringRef("\n\n"));
   EmitAlignment(F->getAlignment(), F);
 
+  // the headers are located at the end of the 32 byte fetch packets
+  if (CompactMode)
+    EmitAlignment(5);
+
   EmitFunctionBodyStart();
   EmitFunctionHeader();
 
@@ -167,12 +217,24 @@ bool TMS320C64XAsmPrinter::runOnMachineFunction(MachineFunction &MF) {
   for (MBB = MF.begin(); MBB != MF.end(); ++MBB) {
 
     // print block info right before the block
-    OutStreamer.EmitRawText(NewLine);
-    printMBBInfo(MBB);
+    if (!isObjectMode()) {
+      OutStreamer.EmitRawText(NewLine);
+      printMBBInfo(MBB);
+    }
 
     if (MBB != MF.begin()) {
-      EmitBasicBlockStart(MBB);
-      OutStreamer.EmitRawText(NewLine);
+      if (CompactMode) {
+        if (MBB->hasAddressTaken()) {
+          std::vector<MCSymbol*> Syms =
+            MMI->getAddrLabelSymbolToEmit(MBB->getBasicBlock());
+          for (unsigned i = 0, e = Syms.size(); i != e; ++i)
+            emit_mc_label(Syms[i]);
+        }
+        emit_mc_label(MBB->getSymbol());
+      }
+      else EmitBasicBlockStart(MBB);
+      if (!isObjectMode())
+        OutStreamer.EmitRawText(NewLine);
     }
 
 
@@ -188,6 +250,9 @@ bool TMS320C64XAsmPrinter::runOnMachineFunction(MachineFunction &MF) {
     }
   }
 
+  if (CompactMode)
+    emit_fetch_packets();
+
   // Print out jump tables referenced by the function.
   EmitJumpTableInfo();
 
@@ -210,6 +275,9 @@ bool TMS320C64XAsmPrinter::handleSoftFloatCall(const char *SymbolName) {
 
 void TMS320C64XAsmPrinter::emit_prolog(const MachineInstr *MI) {
 
+  if (isObjectMode())
+    return emit_mc_prolog(MI);
+
   // See instr info td file for why we do this here
 
   SmallString<256> prologueString;
@@ -254,6 +322,9 @@ void TMS320C64XAsmPrinter::emit_prolog(const MachineInstr *MI) {
 
 void TMS320C64XAsmPrinter::emit_epilog(const MachineInstr *MI) {
 
+  if (isObjectMode())
+    return emit_mc_epilog(MI);
+
   // See instr info td file for why we do this here
 
   SmallString<256> epilogueString;
@@ -282,7 +353,18 @@ MIiter TMS320C64XAsmPrinter::emit_instructions(MIRange mir) {
 
   // if code is bundled, emit a bundle at a time
   if (BundleMode)
-    return emit_bundle(mir);
+    return isObjectMode() ? emit_mc_bundle(mir) : emit_bundle(mir);
+
+  // otherwise every instruction is an execute packet of its own
+  if (isObjectMode()) {
+    SmallVector<const MachineInstr*, 1> Packet;
+    unsigned opc = MI->getDesc().getOpcode();
+    if (opc != TMS320C64X::BR_PREPARE && opc != TMS320C64X::BR_OCCURS &&
+        opc != TMS320C64X::BUNDLE_END)
+      Packet.push_back(MI);
+    emit_mc_packet(Packet, true);
+    return mir.first;
+  }
 
   // emit a single (ordinary) instruction
   SmallString<64> str;
@@ -322,6 +404,10 @@ MIiter TMS320C64XAsmPrinter::emit_bundle(MIRange mir) {
         break; // end the current bundle
     }
 
+    // liveness markers don't occupy a slot
+    if (MI->isKill() || MI->isImplicitDef())
+      continue;
+
     // this instructions marks the end of the delay slots following a branch.
     // the branch acutally happened in the cycle before, thus we print the
     // informational output before the contents of the current bundle.
@@ -344,7 +430,8 @@ MIiter TMS320C64XAsmPrinter::emit_bundle(MIRange mir) {
     bundleSize++;
     OS << "\n";
   }
-  assert(bundleSize <= 8);
+  // runs of nops (eg. the epilog of an expanded loop) may be longer
+  assert((nopBundle || bundleSize <= 8) && "too many instructions in bundle");
   if (bundleSize) {
     OS << "\n";
     OutStreamer.EmitRawText(OS.str());
@@ -357,13 +444,26 @@ bool TMS320C64XAsmPrinter::emit_special(const MachineInstr *MI) {
   raw_svector_ostream OS(str);
   switch (MI->getDesc().getOpcode()) {
     case TargetOpcode::INLINEASM:
+      if (isObjectMode())
+        report_fatal_error("inline assembly is not supported in object files");
       OS << MI->getOperand(0).getSymbolName();
       break;
 
+    // sub-register liveness markers (register pairs), there is nothing to
+    // emit for these
+    case TargetOpcode::KILL:
+    case TargetOpcode::IMPLICIT_DEF:
+      return true;
+
     case TMS320C64X::call_return_label:
       // instead of calling printInstruction we emit the label directly,
       // this allows us to avoid tabs being inserted automatically
       assert(MI->getOperand(0).isSymbol() && "Bad symbol operand!");
+      if (isObjectMode()) {
+        emit_mc_label(OutContext.GetOrCreateSymbol(
+          StringRef(MI->getOperand(0).getSymbolName())));
+        return true;
+      }
       OS << "\n" << MI->getOperand(0).getSymbolName() << ":\t\t"
          << MAI->getCommentString() << " return label for reg-calls\n";
       break;
@@ -377,6 +477,420 @@ bool TMS320C64XAsmPrinter::emit_special(const MachineInstr *MI) {
   return true;
 }
 
+//-----------------------------------------------------------------------------
+// Object file emission
+
+// returns the functional unit (unit_l .. unit_d) an instruction executes on
+static unsigned getInstrUnit(const MachineInstr *MI) {
+  const TargetInstrDesc &TID = MI->getDesc();
+
+  if (TID.TSFlags & TMS320C64XII::is_side_inst)
+    return MI->getOperand(TID.getNumOperands() - 1).getImm() >> 1;
+  return GET_UNIT(TID.TSFlags);
+}
+
+static void addNoPredicate(MCInst &Inst) {
+  Inst.addOperand(MCOperand::CreateImm(-1));
+  Inst.addOperand(MCOperand::CreateReg(0));
+}
+
+//-----------------------------------------------------------------------------
+
+MIiter TMS320C64XAsmPrinter::emit_mc_bundle(MIRange mir) {
+  SmallVector<const MachineInstr*, 8> Packet;
+  bool nopBundle = false;
+
+  // same bundle boundaries as for the textual output, see emit_bundle
+  MIiter I = mir.first;
+  for (; I != mir.second; ++I) {
+    const MachineInstr *MI = I;
+    unsigned opc = MI->getDesc().getOpcode();
+
+    if (opc == TMS320C64X::noop)
+      nopBundle = true;
+
+    if (opc == TMS320C64X::BUNDLE_END) {
+      MIiter next = llvm::next(I);
+      if (nopBundle && next != mir.second &&
+          next->getDesc().getOpcode() == TMS320C64X::noop)
+        continue;
+      else
+        break;
+    }
+
+    // markers without encoding
+    if (MI->isKill() || MI->isImplicitDef() ||
+        opc == TMS320C64X::BR_PREPARE || opc == TMS320C64X::BR_OCCURS)
+      continue;
+
+    // return labels are placed at the start of the packet
+    if (opc == TMS320C64X::call_return_label) {
+      emit_special(MI);
+      continue;
+    }
+
+    Packet.push_back(MI);
+  }
+  assert((nopBundle || Packet.size() <= 8) && "too many instructions");
+  emit_mc_packet(Packet, nopBundle);
+  return I;
+}
+
+//-----------------------------------------------------------------------------
+
+void TMS320C64XAsmPrinter::emit_mc_packet(
+  SmallVectorImpl<const MachineInstr*> &Packet, bool serial)
+{
+  // the moves are left to the assembler in textual output, we need to pick a
+  // unit that is not taken by the rest of the packet (per side, unit bitmap)
+  unsigned busy[2] = { 0, 0 };
+
+  for (unsigned i = 0, e = Packet.size(); i != e; ++i) {
+    const MachineInstr *MI = Packet[i];
+    unsigned opc = MI->getDesc().getOpcode();
+    if (opc == TMS320C64X::mv || opc == TMS320C64X::mvselect)
+      continue;
+    busy[IS_BSIDE(MI->getDesc().TSFlags) ? 1 : 0] |= 1 << getInstrUnit(MI);
+  }
+
+  for (unsigned i = 0, e = Packet.size(); i != e; ++i) {
+    const MachineInstr *MI = Packet[i];
+    unsigned opc = MI->getDesc().getOpcode();
+    MCInst Inst;
+
+    if (opc == TMS320C64X::mv || opc == TMS320C64X::mvselect) {
+      static const unsigned moveUnits[] = {
+        TMS320C64XII::unit_l, TMS320C64XII::unit_s, TMS320C64XII::unit_d };
+
+      unsigned side =
+        TMS320C64X::isBSideReg(MI->getOperand(0).getReg()) ? 1 : 0;
+
+      unsigned u = 0, numUnits = array_lengthof(moveUnits);
+      while (u < numUnits && (busy[side] & (1 << moveUnits[u])))
+        ++u;
+
+      if (u == numUnits)
+        report_fatal_error("no free unit for a move in execute packet");
+
+      busy[side] |= 1 << moveUnits[u];
+      lowerMove(MI, moveUnits[u], Inst);
+    }
+    else lowerInstruction(MI, Inst);
+
+    emit_mc(Inst, !serial && i + 1 != e);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+void TMS320C64XAsmPrinter::emit_mc(MCInst &Inst, bool parallel) {
+  Inst.addOperand(MCOperand::CreateImm(parallel ? TMS320C64XII::mc_parallel
+                                                : 0));
+  if (!CompactMode) {
+    OutStreamer.EmitInstruction(Inst);
+    return;
+  }
+
+  FunctionCode.push_back(QueuedInst());
+  FunctionCode.back().Inst = Inst;
+  FunctionCode.back().Labels.append(QueuedLabels.begin(), QueuedLabels.end());
+  QueuedLabels.clear();
+}
+
+void TMS320C64XAsmPrinter::emit_mc_label(MCSymbol *Sym) {
+  if (CompactMode)
+    QueuedLabels.push_back(Sym);
+  else
+    OutStreamer.EmitLabel(Sym);
+}
+
+//-----------------------------------------------------------------------------
+
+void TMS320C64XAsmPrinter::emit_fetch_packets() {
+
+  const unsigned numInsts = FunctionCode.size();
+
+  SmallVector<bool, 64> compact(numInsts);
+  for (unsigned i = 0; i != numInsts; ++i) {
+    unsigned bits;
+    compact[i] = TMS320C64X::getCompactEncoding(FunctionCode[i].Inst, TM, bits);
+  }
+
+  unsigned idx = 0;
+  while (idx < numInsts) {
+
+    // try to fill the 7 words of a header based fetch packet. Only adjacent
+    // compact instructions can share a word, branch targets remain aligned
+    unsigned end = idx, words = 0, layout = 0;
+    while (words < 7 && end < numInsts) {
+      if (end + 1 < numInsts && compact[end] && compact[end + 1] &&
+          FunctionCode[end + 1].Labels.empty()) {
+        layout |= 1 << words;
+        end += 2;
+      }
+      else ++end;
+      ++words;
+    }
+
+    // use a header only if it gets more instructions into the fetch packet
+    unsigned plainEnd = std::min(idx + 8, numInsts);
+    if (end <= plainEnd) {
+      end = plainEnd;
+      layout = 0;
+    }
+
+    // the p-bits of 16-bit instructions are moved to the header
+    unsigned header = 0xe0000000 | (layout << 21);
+    for (unsigned half = 0; idx != end; ++idx) {
+      QueuedInst &Q = FunctionCode[idx];
+      for (unsigned i = 0, e = Q.Labels.size(); i != e; ++i)
+        OutStreamer.EmitLabel(Q.Labels[i]);
+
+      MCOperand &flags = Q.Inst.getOperand(Q.Inst.getNumOperands() - 1);
+      if (layout & (1 << (half / 2))) {
+        if (flags.getImm() & TMS320C64XII::mc_parallel)
+          header |= 1 << half;
+        flags.setImm(TMS320C64XII::mc_compact);
+        ++half;
+      }
+      else half += 2;
+
+      OutStreamer.EmitInstruction(Q.Inst);
+    }
+
+    if (layout) {
+      // only the last packet of a function may be short, pad with nops
+      for (; words < 7; ++words)
+        OutStreamer.EmitIntValue(0, 4, 0);
+      OutStreamer.EmitIntValue(header, 4, 0);
+      ++NumHeaderPackets;
+    }
+  }
+
+  for (unsigned i = 0, e = QueuedLabels.size(); i != e; ++i)
+    OutStreamer.EmitLabel(QueuedLabels[i]);
+
+  FunctionCode.clear();
+  QueuedLabels.clear();
+}
+
+//-----------------------------------------------------------------------------
+
+bool TMS320C64XAsmPrinter::lowerOperand(const MachineOperand &MO,
+                                        MCOperand &MCOp)
+{
+  const MCExpr *Expr;
+
+  switch (MO.getType()) {
+    case MachineOperand::MO_Register:
+      if (MO.isImplicit())
+        return false;
+      MCOp = MCOperand::CreateReg(MO.getReg());
+      return true;
+
+    case MachineOperand::MO_Immediate:
+      MCOp = MCOperand::CreateImm(MO.getImm());
+      return true;
+
+    case MachineOperand::MO_MachineBasicBlock:
+      Expr = MCSymbolRefExpr::Create(MO.getMBB()->getSymbol(), OutContext);
+      break;
+
+    case MachineOperand::MO_GlobalAddress:
+      Expr = MCSymbolRefExpr::Create(Mang->getSymbol(MO.getGlobal()),
+                                     OutContext);
+      if (MO.getOffset())
+        Expr = MCBinaryExpr::CreateAdd(Expr,
+          MCConstantExpr::Create(MO.getOffset(), OutContext), OutContext);
+      break;
+
+    case MachineOperand::MO_ExternalSymbol:
+      // local labels and softfloat calls are not mangled, see printOperand
+      if (MO.getTargetFlags() || ST.hasLibcall(MO.getSymbolName()))
+        Expr = MCSymbolRefExpr::Create(
+          OutContext.GetOrCreateSymbol(StringRef(MO.getSymbolName())),
+          OutContext);
+      else
+        Expr = MCSymbolRefExpr::Create(
+          GetExternalSymbolSymbol(MO.getSymbolName()), OutContext);
+      break;
+
+    case MachineOperand::MO_JumpTableIndex:
+      Expr = MCSymbolRefExpr::Create(GetJTISymbol(MO.getIndex()), OutContext);
+      break;
+
+    case MachineOperand::MO_ConstantPoolIndex:
+    default:
+      llvm_unreachable("Unknown operand type");
+  }
+
+  MCOp = MCOperand::CreateExpr(Expr);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void TMS320C64XAsmPrinter::lowerInstruction(const MachineInstr *MI,
+                                            MCInst &Inst)
+{
+  Inst.setOpcode(MI->getOpcode());
+
+  for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+    MCOperand MCOp;
+    if (lowerOperand(MI->getOperand(i), MCOp))
+      Inst.addOperand(MCOp);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+void TMS320C64XAsmPrinter::lowerMove(const MachineInstr *MI,
+                                     unsigned unit,
+                                     MCInst &Inst)
+{
+  // mv is an alias for add src, 0, dst. mv: dst, src, pred;
+  // mvselect: dst, src, (tied dst), pred
+  unsigned dst = MI->getOperand(0).getReg();
+  int pred_idx = MI->findFirstPredOperandIdx();
+  assert(pred_idx != -1 && "move without predicate operands");
+
+  Inst.setOpcode(TMS320C64X::isBSideReg(dst) ? TMS320C64X::add_ri_2
+                                             : TMS320C64X::add_ri_1);
+  Inst.addOperand(MCOperand::CreateReg(dst));
+  Inst.addOperand(MCOperand::CreateReg(MI->getOperand(1).getReg()));
+  Inst.addOperand(MCOperand::CreateImm(0));
+  Inst.addOperand(MCOperand::CreateImm(MI->getOperand(pred_idx).getImm()));
+  Inst.addOperand(MCOperand::CreateReg(MI->getOperand(pred_idx+1).getReg()));
+
+  // the cross path is derived from the registers by the code emitter
+  Inst.addOperand(MCOperand::CreateImm(unit << 1));
+}
+
+//-----------------------------------------------------------------------------
+
+void TMS320C64XAsmPrinter::emit_mc_prolog(const MachineInstr *MI) {
+
+  // same sequence as the textual prolog in emit_prolog
+  int stackSize = MI->getOperand(0).getImm();
+  bool smallStack = TMS320C64XInstrInfo::check_sconst_fits(stackSize, 16);
+  const unsigned unitL = TMS320C64XII::unit_l << 1;
+  const unsigned unitS = TMS320C64XII::unit_s << 1;
+  const unsigned unitD = TMS320C64XII::unit_d << 1;
+
+  // mvk(l) .S1 size, A0 || mv .L1X B15, A1
+  MCInst mvk;
+  mvk.setOpcode(smallStack ? TMS320C64X::mvk_1 : TMS320C64X::mvkl_1);
+  mvk.addOperand(MCOperand::CreateReg(TMS320C64X::A0));
+  mvk.addOperand(MCOperand::CreateImm(stackSize));
+  addNoPredicate(mvk);
+  mvk.addOperand(MCOperand::CreateImm(unitS));
+  emit_mc(mvk, true);
+
+  MCInst mvA1;
+  mvA1.setOpcode(TMS320C64X::add_ri_1);
+  mvA1.addOperand(MCOperand::CreateReg(TMS320C64X::A1));
+  mvA1.addOperand(MCOperand::CreateReg(TMS320C64X::B15));
+  mvA1.addOperand(MCOperand::CreateImm(0));
+  addNoPredicate(mvA1);
+  mvA1.addOperand(MCOperand::CreateImm(unitL));
+  emit_mc(mvA1, false);
+
+  // mvkh .S1 size, A0
+  if (!smallStack) {
+    MCInst mvkh;
+    mvkh.setOpcode(TMS320C64X::mvkh_1);
+    mvkh.addOperand(MCOperand::CreateReg(TMS320C64X::A0));
+    mvkh.addOperand(MCOperand::CreateImm(stackSize));
+    mvkh.addOperand(MCOperand::CreateReg(TMS320C64X::A0));
+    addNoPredicate(mvkh);
+    mvkh.addOperand(MCOperand::CreateImm(unitS));
+    emit_mc(mvkh, false);
+  }
+
+  // stw .D2T1 A15, *B15 || stw .D1T2 B3, *-A1[1]
+  MCInst stFP;
+  stFP.setOpcode(TMS320C64X::word_store_2);
+  stFP.addOperand(MCOperand::CreateReg(TMS320C64X::B15));
+  stFP.addOperand(MCOperand::CreateImm(0));
+  stFP.addOperand(MCOperand::CreateReg(TMS320C64X::A15));
+  addNoPredicate(stFP);
+  stFP.addOperand(MCOperand::CreateImm(unitD));
+  emit_mc(stFP, true);
+
+  MCInst stRA;
+  stRA.setOpcode(TMS320C64X::word_store_1);
+  stRA.addOperand(MCOperand::CreateReg(TMS320C64X::A1));
+  stRA.addOperand(MCOperand::CreateImm(-1));
+  stRA.addOperand(MCOperand::CreateReg(TMS320C64X::B3));
+  addNoPredicate(stRA);
+  stRA.addOperand(MCOperand::CreateImm(unitD | 1));
+  emit_mc(stRA, true);
+
+  // || mv .S1X B15, A15 || sub .L2X B15, A0, B15
+  MCInst mvFP;
+  mvFP.setOpcode(TMS320C64X::add_ri_1);
+  mvFP.addOperand(MCOperand::CreateReg(TMS320C64X::A15));
+  mvFP.addOperand(MCOperand::CreateReg(TMS320C64X::B15));
+  mvFP.addOperand(MCOperand::CreateImm(0));
+  addNoPredicate(mvFP);
+  mvFP.addOperand(MCOperand::CreateImm(unitS));
+  emit_mc(mvFP, true);
+
+  MCInst subSP;
+  subSP.setOpcode(TMS320C64X::sub_rr_2);
+  subSP.addOperand(MCOperand::CreateReg(TMS320C64X::B15));
+  subSP.addOperand(MCOperand::CreateReg(TMS320C64X::B15));
+  subSP.addOperand(MCOperand::CreateReg(TMS320C64X::A0));
+  addNoPredicate(subSP);
+  subSP.addOperand(MCOperand::CreateImm(unitL));
+  emit_mc(subSP, false);
+}
+
+//-----------------------------------------------------------------------------
+
+void TMS320C64XAsmPrinter::emit_mc_epilog(const MachineInstr *MI) {
+
+  // same sequence as the textual epilog in emit_epilog
+  const unsigned unitS = TMS320C64XII::unit_s << 1;
+  const unsigned unitD = TMS320C64XII::unit_d << 1;
+
+  // ldw .D1T2 *-A15[1], B3
+  MCInst ldRA;
+  ldRA.setOpcode(TMS320C64X::word_load_1);
+  ldRA.addOperand(MCOperand::CreateReg(TMS320C64X::B3));
+  ldRA.addOperand(MCOperand::CreateReg(TMS320C64X::A15));
+  ldRA.addOperand(MCOperand::CreateImm(-1));
+  addNoPredicate(ldRA);
+  ldRA.addOperand(MCOperand::CreateImm(unitD | 1));
+  emit_mc(ldRA, false);
+
+  // mv .S2X A15, B15 || ldw .D1T1 *A15, A15
+  MCInst mvSP;
+  mvSP.setOpcode(TMS320C64X::add_ri_2);
+  mvSP.addOperand(MCOperand::CreateReg(TMS320C64X::B15));
+  mvSP.addOperand(MCOperand::CreateReg(TMS320C64X::A15));
+  mvSP.addOperand(MCOperand::CreateImm(0));
+  addNoPredicate(mvSP);
+  mvSP.addOperand(MCOperand::CreateImm(unitS));
+  emit_mc(mvSP, true);
+
+  MCInst ldFP;
+  ldFP.setOpcode(TMS320C64X::word_load_1);
+  ldFP.addOperand(MCOperand::CreateReg(TMS320C64X::A15));
+  ldFP.addOperand(MCOperand::CreateReg(TMS320C64X::A15));
+  ldFP.addOperand(MCOperand::CreateImm(0));
+  addNoPredicate(ldFP);
+  ldFP.addOperand(MCOperand::CreateImm(unitD));
+  emit_mc(ldFP, false);
+
+  // nop 4
+  MCInst nop;
+  nop.setOpcode(TMS320C64X::noop);
+  nop.addOperand(MCOperand::CreateImm(4));
+  addNoPredicate(nop);
+  emit_mc(nop, false);
+}
+
 //-----------------------------------------------------------------------------
 
 void TMS320C64XAsmPrinter::printFU(const MachineInstr *MI,
@@ -449,6 +963,10 @@ void TMS320C64XAsmPrinter::EmitGlobalVariable(const GlobalVariable *GVar) {
 
   if (EmitSpecialLLVMGlobal(GVar)) return;
 
+  // the tweaks below are for the TI assembler only
+  if (isObjectMode())
+    return AsmPrinter::EmitGlobalVariable(GVar);
+
   OutStreamer.EmitRawText(StringRef("\n\n"));
 
   SmallString<60> NameStr;
@@ -559,7 +1077,7 @@ void TMS320C64XAsmPrinter::printOperand(const MachineInstr *MI,
   switch(MO.getType()) {
     case MachineOperand::MO_Register:
       if (TargetRegisterInfo::isPhysicalRegister(MO.getReg()))
-        OS << RI.getName(MO.getReg());
+        OS << getRegisterName(MO.getReg());
       else llvm_unreachable("Nonphysical register being printed");
       break;
 
@@ -659,6 +1177,32 @@ void TMS320C64XAsmPrinter::printMemOperand(const MachineInstr *MI,
 
 //-----------------------------------------------------------------------------
 
+/// printPreModOperand - Prints the base (the operand in front of the offset)
+/// modified before the access, ie. *++R[n] or *--R[n].
+void TMS320C64XAsmPrinter::printPreModOperand(const MachineInstr *MI,
+                                              int op_num,
+                                              raw_ostream &OS)
+{
+  int offset = MI->getOperand(op_num).getImm();
+  OS << "*" << (offset < 0 ? "--" : "++");
+  printOperand(MI, op_num-1, OS);
+  OS << "[" << abs(offset) << "]";
+}
+
+/// printPostModOperand - Prints the base modified after the access, ie.
+/// *R++[n] or *R--[n].
+void TMS320C64XAsmPrinter::printPostModOperand(const MachineInstr *MI,
+                                               int op_num,
+                                               raw_ostream &OS)
+{
+  int offset = MI->getOperand(op_num).getImm();
+  OS << "*";
+  printOperand(MI, op_num-1, OS);
+  OS << (offset < 0 ? "--" : "++") << "[" << abs(offset) << "]";
+}
+
+//-----------------------------------------------------------------------------
+
 void TMS320C64XAsmPrinter::printCCOperand(const MachineInstr *MI, int opNum) {
   llvm_unreachable_internal("Unimplemented function printCCOperand");
 }
@@ -717,6 +1261,9 @@ void TMS320C64XAsmPrinter::refContents(Constant *C) {
 
 void TMS320C64XAsmPrinter::EmitStartOfAsmFile(Module &) {
 
+  if (isObjectMode())
+    return;
+
   SmallString<256> str;
   raw_svector_ostream OS(str);
 
@@ -733,6 +1280,10 @@ void TMS320C64XAsmPrinter::EmitStartOfAsmFile(Module &) {
 //-----------------------------------------------------------------------------
 
 void TMS320C64XAsmPrinter::EmitEndOfAsmFile(Module &M) {
+  // undefined symbols in ELF objects need no explicit references
+  if (isObjectMode())
+    return;
+
   MachineModuleInfoMachO &MMIMacho =
     MMI->getObjFileInfo<MachineModuleInfoMachO>();
   MachineModuleInfoMachO::SymbolListTy Stubs = MMIMacho.GetFnStubList();
@@ -768,6 +1319,9 @@ TMS320C64XAsmPrinter::printMBBInfo(const MachineBasicBlock *MBB) {
 
 void TMS320C64XAsmPrinter::EmitFunctionBodyStart() {
 
+  if (isObjectMode())
+    return;
+
   const TMS320C64XMachineFunctionInfo *MFI =
     MF->getInfo<TMS320C64XMachineFunctionInfo>();
 
@@ -258,18 +258,25 @@ bool TMS320C64XCallTimer::runOnMachineBasicBlock(MachineBasicBlock &MBB) {
   bool Changed = false;
 
   for (MachineBasicBlock::iterator I = MBB.begin(), E = MBB.end(); I != E; ++I) {
-    if (I->getOpcode() == TMS320C64X::mvc_start) {
-      // remove from instruction list
+    if (I->getOpcode() == TMS320C64X::mvc_tscl_w) {
+      // remove from instruction list, along with the read of the stamp that
+      // follows the write starting the counter
       MachineInstr *start = MBB.remove(I++);
+      while (I->getOpcode() != TMS320C64X::mvc_tscl_r) {
+        assert(I != MBB.end());
+        ++I;
+      }
+      MachineInstr *stamp = MBB.remove(I++);
       while (!I->getDesc().isCall()) {
         assert(I != MBB.end());
         ++I;
       }
       // insert right before call
       MBB.insert(I, start);
+      MBB.insert(I, stamp);
       MachineBasicBlock::iterator callIt = I;
 
-      while (I->getOpcode() != TMS320C64X::mvc_end) {
+      while (I->getOpcode() != TMS320C64X::mvc_tscl_r) {
         assert(I != MBB.end());
         ++I;
       }
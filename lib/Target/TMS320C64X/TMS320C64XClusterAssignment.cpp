@@ -19,6 +19,7 @@
 #include "ClusterDAG.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
 #include "llvm/CodeGen/MachineRegions.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/CodeGen/ScheduleDAG.h"
@@ -28,26 +29,44 @@
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 #include <queue>
+#include <set>
 
 using namespace llvm;
 using namespace llvm::TMS320C64X;
 
 namespace C64XII = TMS320C64XII;
 
+STATISTIC(NumRecurrences, "Number of loop recurrences pinned to a cluster");
+STATISTIC(NumPinnedInstrs, "Number of instructions pinned to a cluster");
+
+static cl::opt<bool> LoopPartition("c64x-loop-partition",
+  cl::Hidden, cl::desc("Keep loop recurrences on one cluster side (UAS)"),
+  cl::init(false));
+
 namespace {
 
 /// helper that does register class narrowing - if required is more specific
 /// return required, otherwise actual.
 const TargetRegisterClass *narrowRC(const TargetRegisterClass *Actual,
                                     const TargetRegisterClass *Required) {
-  // restrict to A or B regs if required
+  // already restricted further than required (eg. A4-A7 circular bases)
+  if (Actual->hasSuperClass(Required))
+    return Actual;
+
+  // restrict to A or B regs (or a part of them, eg. A4-A7) if required
   if (Required == TMS320C64X::ARegsRegisterClass ||
-      Required == TMS320C64X::BRegsRegisterClass)
+      Required == TMS320C64X::BRegsRegisterClass ||
+      Required->hasSuperClass(TMS320C64X::ARegsRegisterClass) ||
+      Required->hasSuperClass(TMS320C64X::BRegsRegisterClass) ||
+      Required == TMS320C64X::APairRegsRegisterClass ||
+      Required == TMS320C64X::BPairRegsRegisterClass)
     return Required;
 
-  // no restriction when only GP reg class is required
-  assert(Required == TMS320C64X::GPRegsRegisterClass);
+  // no restriction when only GP reg (or reg pair) class is required
+  assert(Required == TMS320C64X::GPRegsRegisterClass ||
+         Required == TMS320C64X::PairRegsRegisterClass);
   return Actual;
 }
 
@@ -105,6 +124,10 @@ struct DagAssign : public TMS320C64XClusterAssignment {
   bool runOnMachineFunction(MachineFunction &Fn);
   void applyXccUses(MachineFunction &Fn, const AssignmentState &State);
   void assignPHIs(AssignmentState *State, MachineBasicBlock *MBB);
+
+  void partitionLoops(MachineFunction &Fn, const MachineLoopInfo &MLI,
+                      AssignmentState *State);
+  void partitionLoop(MachineLoop *L, AssignmentState *State);
 };
 }
 
@@ -346,6 +369,9 @@ bool DagAssign::runOnMachineFunction(MachineFunction &Fn) {
     TMS320C64XInstrInfo::CreateFunctionalUnitScheduler(&TM);
   Scheduler->setFunctionalUnitScheduler(RA);
 
+  if (LoopPartition)
+    partitionLoops(Fn, MLI, &State);
+
   // index the superblocks by their entry block
   for (MachineSuperBlockMapTy::iterator MSBI = MSBs.begin(), MSBE = MSBs.end();
        MSBI != MSBE; ++MSBI) {
@@ -372,9 +398,15 @@ bool DagAssign::runOnMachineFunction(MachineFunction &Fn) {
       // if MBB is part of a suberblock, schedule the whole superblock
       MSB = it->second;
     } else {
-      // single MBB: schedule as trivial region
-      if (!MBB->size())
+      // single MBB: schedule as trivial region. Empty blocks are only passed
+      // through, the blocks behind them still need to be assigned
+      if (!MBB->size()) {
+        Scheduled.insert(MBB);
+        for (MachineBasicBlock::succ_iterator SI = MBB->succ_begin(),
+             SE = MBB->succ_end(); SI != SE; ++SI)
+          ScheduleQ.push(*SI);
         continue;
+      }
       ownedMSB = std::auto_ptr<MachineSuperBlock>(
         new MachineSuperBlock(Fn, *MBB));
       MSB = ownedMSB.get();
@@ -415,6 +447,11 @@ void DagAssign::assignPHIs(AssignmentState *State, MachineBasicBlock *MBB) {
 
     const TargetRegisterClass *RC =
       (opcnt.first > opcnt.second) ? BRegsRegisterClass : ARegsRegisterClass;
+
+    // recurrences stay on the side chosen for the loop
+    int pinned = State->getPinnedSide(MI);
+    if (pinned >= 0)
+      RC = pinned ? BRegsRegisterClass : ARegsRegisterClass;
     DEBUG(dbgs() << "PHI assign: " << *MI << " [A: " << opcnt.first << ", B: "
           << opcnt.second << "] -> " << RC->getName() << "\n");
     MachineOperand &MO = MI->getOperand(0);
@@ -423,6 +460,217 @@ void DagAssign::assignPHIs(AssignmentState *State, MachineBasicBlock *MBB) {
   }
 }
 
+/// getSideOfRC - cluster side of a register class, -1 if it is not bound to a
+/// side (yet).
+static int getSideOfRC(const TargetRegisterClass *RC) {
+  if (RC == ARegsRegisterClass || RC->hasSuperClass(ARegsRegisterClass)
+      || RC == APairRegsRegisterClass)
+    return 0;
+  if (RC == BRegsRegisterClass || RC->hasSuperClass(BRegsRegisterClass)
+      || RC == BPairRegsRegisterClass)
+    return 1;
+  return -1;
+}
+
+/// getBoundSide - side of an instruction that is pinned or cannot change its
+/// side, -1 if it is still open.
+static int getBoundSide(const MachineInstr *MI, const AssignmentState *State) {
+  int pinned = State->getPinnedSide(MI);
+  if (pinned >= 0)
+    return pinned;
+  if (MI->isPHI() || MI->isCopy() || MI->isImplicitDef())
+    return -1;
+  if (!TMS320C64XInstrInfo::isFlexible(MI))
+    return TMS320C64XInstrInfo::getSide(MI);
+  return -1;
+}
+
+namespace {
+  struct DeeperLoop {
+    bool operator()(const MachineLoop *L1, const MachineLoop *L2) const {
+      return L1->getLoopDepth() > L2->getLoopDepth();
+    }
+  };
+}
+
+/// collectLoopReach - Collects the instructions of loop L that are reachable
+/// from Start along def-use edges (or use-def edges, if not Forward). Values
+/// flowing into the header phis close the loop carried cycles.
+static void collectLoopReach(MachineInstr *Start, MachineLoop *L,
+                             MachineRegisterInfo &MRI, bool Forward,
+                             std::set<MachineInstr*> &Reach) {
+  SmallVector<MachineInstr*, 16> Worklist;
+  Worklist.push_back(Start);
+
+  while (!Worklist.empty()) {
+    MachineInstr *MI = Worklist.pop_back_val();
+    for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+      const MachineOperand &MO = MI->getOperand(i);
+      if (!MO.isReg() || !TargetRegisterInfo::isVirtualRegister(MO.getReg()))
+        continue;
+
+      if (Forward && MO.isDef()) {
+        for (MachineRegisterInfo::use_nodbg_iterator
+             UI = MRI.use_nodbg_begin(MO.getReg()), UE = MRI.use_nodbg_end();
+             UI != UE; ++UI)
+          if (L->contains(UI->getParent()) && Reach.insert(&*UI).second)
+            Worklist.push_back(&*UI);
+      } else if (!Forward && MO.isUse()) {
+        MachineInstr *DefMI = MRI.getVRegDef(MO.getReg());
+        if (DefMI && L->contains(DefMI->getParent())
+            && Reach.insert(DefMI).second)
+          Worklist.push_back(DefMI);
+      }
+    }
+  }
+}
+
+/// partitionLoops - Assign the recurrences of all loops to a cluster side
+/// before the regions are scheduled. Deeper loops are assumed to run more
+/// often, they are partitioned first and outer loops respect their choice.
+void DagAssign::partitionLoops(MachineFunction &Fn,
+                               const MachineLoopInfo &MLI,
+                               AssignmentState *State) {
+  std::vector<MachineLoop*> Loops;
+  SmallVector<MachineLoop*, 8> Worklist(MLI.begin(), MLI.end());
+  while (!Worklist.empty()) {
+    MachineLoop *L = Worklist.pop_back_val();
+    Loops.push_back(L);
+    Worklist.append(L->begin(), L->end());
+  }
+
+  std::stable_sort(Loops.begin(), Loops.end(), DeeperLoop());
+  for (unsigned i = 0, e = Loops.size(); i != e; ++i)
+    partitionLoop(Loops[i], State);
+}
+
+/// partitionLoop - A recurrence is the strongly connected component of a
+/// header phi in the loop's data dependence graph. Values that go around the
+/// loop through a cross path cost a copy or an xpath stall on every
+/// iteration, so each recurrence is pinned to one side as a whole. Larger
+/// recurrences are placed first, on the side that keeps the resource bound
+/// of the loop lowest, and among those on the side that cuts the fewest edges
+/// to instructions already bound to a side.
+void DagAssign::partitionLoop(MachineLoop *L, AssignmentState *State) {
+  MachineBasicBlock *Header = L->getHeader();
+  MachineRegisterInfo &MRI = Header->getParent()->getRegInfo();
+
+  // the work already bound to either side, and the cross path uses of the
+  // recurrences placed so far
+  unsigned Load[2] = { 0, 0 };
+  unsigned XLoad[2] = { 0, 0 };
+  for (MachineLoop::block_iterator BI = L->block_begin(), BE = L->block_end();
+       BI != BE; ++BI)
+    for (MachineBasicBlock::iterator I = (*BI)->begin(), E = (*BI)->end();
+         I != E; ++I) {
+      int side = getBoundSide(I, State);
+      if (side >= 0 && !I->getDesc().isTerminator())
+        ++Load[side];
+    }
+
+  std::vector<std::vector<MachineInstr*> > Recurrences;
+  std::set<MachineInstr*> Seen;
+  for (MachineBasicBlock::iterator I = Header->begin(),
+       E = Header->getFirstNonPHI(); I != E; ++I) {
+    if (Seen.count(I))
+      continue;
+
+    std::set<MachineInstr*> Fwd, Bwd;
+    collectLoopReach(I, L, MRI, true, Fwd);
+    if (!Fwd.count(I))
+      continue; // phi value is not carried around the loop
+    collectLoopReach(I, L, MRI, false, Bwd);
+
+    std::vector<MachineInstr*> SCC;
+    for (std::set<MachineInstr*>::iterator SI = Fwd.begin(), SE = Fwd.end();
+         SI != SE; ++SI)
+      if (Bwd.count(*SI)) {
+        SCC.push_back(*SI);
+        Seen.insert(*SI);
+      }
+    Recurrences.push_back(SCC);
+  }
+
+  // largest recurrences first
+  for (unsigned i = 0, e = Recurrences.size(); i != e; ++i)
+    for (unsigned j = i + 1; j != e; ++j)
+      if (Recurrences[j].size() > Recurrences[i].size())
+        Recurrences[i].swap(Recurrences[j]);
+
+  for (unsigned r = 0, re = Recurrences.size(); r != re; ++r) {
+    std::vector<MachineInstr*> &SCC = Recurrences[r];
+    std::set<MachineInstr*> Members(SCC.begin(), SCC.end());
+
+    // edges into and out of the recurrence, by the side of the other end;
+    // fixed members must not be separated from the rest
+    unsigned Cut[2] = { 0, 0 };
+    unsigned Flexible = 0;
+    for (unsigned m = 0, me = SCC.size(); m != me; ++m) {
+      MachineInstr *MI = SCC[m];
+      int own = getBoundSide(MI, State);
+      if (own >= 0) {
+        Cut[own] += SCC.size();
+        continue;
+      }
+      if (!MI->isPHI() && !MI->isCopy() && !MI->isImplicitDef())
+        ++Flexible;
+
+      for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+        const MachineOperand &MO = MI->getOperand(i);
+        if (!MO.isReg() || !TargetRegisterInfo::isVirtualRegister(MO.getReg()))
+          continue;
+        if (MO.isUse()) {
+          MachineInstr *DefMI = MRI.getVRegDef(MO.getReg());
+          if (DefMI && Members.count(DefMI))
+            continue;
+          int side = DefMI ? getBoundSide(DefMI, State) : -1;
+          if (side < 0)
+            side = getSideOfRC(MRI.getRegClass(MO.getReg()));
+          if (side >= 0)
+            ++Cut[side];
+        } else {
+          for (MachineRegisterInfo::use_nodbg_iterator
+               UI = MRI.use_nodbg_begin(MO.getReg()), UE = MRI.use_nodbg_end();
+               UI != UE; ++UI) {
+            if (Members.count(&*UI))
+              continue;
+            int side = getBoundSide(&*UI, State);
+            if (side >= 0)
+              ++Cut[side];
+          }
+        }
+      }
+    }
+
+    // the resource bound of the loop dominates: four units per side, and
+    // one cross path per side that every cut edge uses once per iteration
+    unsigned Cost[2];
+    for (unsigned s = 0; s != 2; ++s) {
+      unsigned Bound = std::max((Load[s] + Flexible + 3) / 4,
+                                (Load[1 - s] + 3) / 4);
+      Bound = std::max(Bound, std::max(XLoad[s] + Cut[1 - s], XLoad[1 - s]));
+      Cost[s] = Bound * 4 + Cut[1 - s];
+    }
+    unsigned side = Cost[1] < Cost[0] ? 1 : 0;
+
+    DEBUG(dbgs() << "Loop recurrence in BB#" << Header->getNumber() << " ("
+          << SCC.size() << " instrs, cut A " << Cut[0] << ", B " << Cut[1]
+          << ", load A " << Load[0] << ", B " << Load[1] << ") -> "
+          << (side ? "B" : "A") << "\n");
+
+    for (unsigned m = 0, me = SCC.size(); m != me; ++m) {
+      MachineInstr *MI = SCC[m];
+      if (getBoundSide(MI, State) >= 0)
+        continue;
+      State->pinSide(MI, side);
+      ++NumPinnedInstrs;
+    }
+    Load[side] += Flexible;
+    XLoad[side] += Cut[1 - side];
+    ++NumRecurrences;
+  }
+}
+
 void DagAssign::applyXccUses(MachineFunction &MF, const AssignmentState &State) {
   // XXX this may replace the use fixing in TMS320C64XClusterAssignment above
 
@@ -459,6 +707,11 @@ void DagAssign::applyXccUses(MachineFunction &MF, const AssignmentState &State)
 
         const TargetRegisterClass *RCreg = MRI.getRegClass(reg);
 
+        // register pairs are only stored, the data path reaches both sides
+        if (RCreg == PairRegsRegisterClass
+            || RCreg->hasSuperClass(PairRegsRegisterClass))
+          continue;
+
         // enforce predicate register rewrites
         unsigned predReg =
           State.getXccVReg(reg, TMS320C64XInstrInfo::getSide(MI));
@@ -529,6 +782,11 @@ void AssignmentState::addVChange(unsigned reg, const TargetRegisterClass *RC) {
   VirtMap[reg] = RC;
 }
 
+int AssignmentState::getPinnedSide(const MachineInstr *MI) const {
+  DenseMap<const MachineInstr*, unsigned>::const_iterator I = Pinned.find(MI);
+  return I == Pinned.end() ? -1 : (int) I->second;
+}
+
 const TargetRegisterClass *AssignmentState::getVChange(unsigned reg) const {
   if (!VirtMap.inBounds(reg))
     return NULL;
@@ -547,6 +805,7 @@ FunctionPass *llvm::createTMS320C64XClusterAssignment(
   case ClusterUAS_none:
   case ClusterUAS_rand:
   case ClusterUAS_mwp:
+  case ClusterUAS_rp:
                     return new DagAssign(tm, alg);
   }
 }
@@ -34,6 +34,7 @@ class AssignmentState {
   IndexedMap<unsigned, VirtReg2IndexFunctor> VXcc[2];
   typedef IndexedMap<const TargetRegisterClass*, VirtReg2IndexFunctor> VirtMap_t;
   VirtMap_t VirtMap;
+  DenseMap<const MachineInstr*, unsigned> Pinned;
 public:
   virtual ~AssignmentState() {}
   void addXccSplit(unsigned srcReg, unsigned dstReg, unsigned dstSide,
@@ -47,6 +48,11 @@ public:
 
   // returns NULL, if reg has not changed class
   const TargetRegisterClass *getVChange(unsigned reg) const;
+
+  // instructions pinned to a cluster side before scheduling (eg. loop
+  // recurrences), returns -1 if MI is not pinned
+  void pinSide(const MachineInstr *MI, unsigned side) { Pinned[MI] = side; }
+  int getPinnedSide(const MachineInstr *MI) const;
 };
 
 class TMS320C64XClusterAssignment : public MachineFunctionPass {
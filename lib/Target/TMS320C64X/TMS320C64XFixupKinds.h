@@ -0,0 +1,37 @@
+//===-- TMS320C64XFixupKinds.h - TMS320C64X Fixup Entries -------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TARGET_TMS320C64X_FIXUPKINDS_H
+#define LLVM_TARGET_TMS320C64X_FIXUPKINDS_H
+
+#include "llvm/MC/MCFixup.h"
+
+namespace llvm {
+namespace TMS320C64X {
+  enum Fixups {
+    // lower/upper half of an absolute address in the cst16 field of
+    // mvkl/mvkh (bits 22-7)
+    fixup_c64x_abs_l16 = FirstTargetFixupKind,
+    fixup_c64x_abs_h16,
+
+    // word displacement of a branch/call relative to the fetch packet of the
+    // branch, in the cst21 field (bits 27-7)
+    fixup_c64x_pcr_s21,
+
+    // same for bdec/bpos, in the scst10 field (bits 22-13)
+    fixup_c64x_pcr_s10,
+
+    // Marker
+    LastTargetFixupKind,
+    NumTargetFixupKinds = LastTargetFixupKind - FirstTargetFixupKind
+  };
+}
+}
+
+#endif
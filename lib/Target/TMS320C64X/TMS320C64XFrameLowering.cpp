@@ -13,16 +13,107 @@
 
 #include "TMS320C64XFrameLowering.h"
 #include "TMS320C64XInstrInfo.h"
+#include "TMS320C64XMachineFunctionInfo.h"
 #include "TMS320C64XTargetMachine.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/MachineFrameInfo.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/CodeGen/RegisterScavenging.h"
+#include "llvm/ADT/SmallVector.h"
 
 using namespace llvm;
 
 //-----------------------------------------------------------------------------
 
+// Callee saved registers that are spilled together by stdw/lddw if both
+// need saving. The even register is the low word of the pair
+static const unsigned CalleeSavedPairs[][3] = {
+  { TMS320C64X::A10, TMS320C64X::A11, TMS320C64X::PA10 },
+  { TMS320C64X::A12, TMS320C64X::A13, TMS320C64X::PA12 },
+  { TMS320C64X::B10, TMS320C64X::B11, TMS320C64X::PB10 },
+  { TMS320C64X::B12, TMS320C64X::B13, TMS320C64X::PB12 }
+};
+
+static const unsigned NumCalleeSavedPairs =
+  sizeof(CalleeSavedPairs) / sizeof(CalleeSavedPairs[0]);
+
+//-----------------------------------------------------------------------------
+
+/// returns true if Reg (or any register overlapping it) is written within
+/// the function, the same test the prolog/epilog inserter uses for picking
+/// the callee saved registers to save
+static bool isRegUsed(const MachineFunction &MF, unsigned Reg) {
+  const MachineRegisterInfo &MRI = MF.getRegInfo();
+  if (MRI.isPhysRegUsed(Reg))
+    return true;
+
+  const TargetRegisterInfo *TRI = MF.getTarget().getRegisterInfo();
+  for (const unsigned *Alias = TRI->getAliasSet(Reg); *Alias; ++Alias)
+    if (MRI.isPhysRegUsed(*Alias))
+      return true;
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+
+/// returns true if anything within the function changes the return address
+/// in B3, ie. a call or the register allocator handing out B3. Leaf functions
+/// can leave it where it is
+static bool isReturnAddressClobbered(const MachineFunction &MF) {
+  const TargetRegisterInfo *TRI = MF.getTarget().getRegisterInfo();
+  for (MachineFunction::const_iterator BI = MF.begin(), BE = MF.end();
+       BI != BE; ++BI)
+    for (MachineBasicBlock::const_iterator I = BI->begin(), E = BI->end();
+         I != E; ++I)
+      if (I->getDesc().isCall()
+          || I->modifiesRegister(TMS320C64X::B3, TRI))
+        return true;
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+
+/// returns the register pair holding CSI[i] and another entry of CSI if both
+/// were given the halves of a double word slot, 0 otherwise. Paired tells the
+/// index of the other half
+static unsigned getSpillPair(const MachineFunction &MF,
+                             const std::vector<CalleeSavedInfo> &CSI,
+                             unsigned i, unsigned &Paired)
+{
+  const TMS320C64XMachineFunctionInfo *FI =
+    MF.getInfo<TMS320C64XMachineFunctionInfo>();
+  const MachineFrameInfo *MFI = MF.getFrameInfo();
+
+  for (unsigned p = 0; p < NumCalleeSavedPairs; ++p) {
+    const unsigned *pair = CalleeSavedPairs[p];
+    if (CSI[i].getReg() != pair[0] && CSI[i].getReg() != pair[1])
+      continue;
+
+    unsigned other = CSI[i].getReg() == pair[0] ? pair[1] : pair[0];
+    for (unsigned j = 0; j < CSI.size(); ++j) {
+      if (CSI[j].getReg() != other)
+        continue;
+
+      int lo = CSI[CSI[i].getReg() == pair[0] ? i : j].getFrameIdx();
+      int hi = CSI[CSI[i].getReg() == pair[0] ? j : i].getFrameIdx();
+      int slot;
+
+      // only the slots handed out by processFunctionBeforeCalleeSavedScan
+      if (!FI->getCalleeSavedSlot(pair[0], slot) || slot != lo
+          || MFI->getObjectOffset(hi) != MFI->getObjectOffset(lo) + 4
+          || MFI->getObjectOffset(lo) % 8)
+        return 0;
+
+      Paired = j;
+      return pair[2];
+    }
+    return 0;
+  }
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+
 bool
 TMS320C64XFrameLowering::spillCalleeSavedRegisters(MachineBasicBlock &MBB,
                                         MachineBasicBlock::iterator MBBI,
@@ -30,13 +121,27 @@ TMS320C64XFrameLowering::spillCalleeSavedRegisters(MachineBasicBlock &MBB,
                                         const TargetRegisterInfo *TRI) const
 {
   const MachineFunction *MF;
-  unsigned int i, reg;
+  unsigned int i, j, reg;
   bool is_kill;
 
   MF = MBB.getParent();
   const MachineRegisterInfo &MRI = MF->getRegInfo();
+  const TargetInstrInfo &TII = *(MF->getTarget().getInstrInfo());
+
+  SmallVector<bool, 8> done(CSI.size(), false);
 
   for (i = 0; i < CSI.size(); ++i) {
+    if (done[i])
+      continue;
+
+    // pairs in a double word slot are stored together by stdw
+    unsigned regs[2] = { CSI[i].getReg(), 0 };
+    reg = getSpillPair(*MF, CSI, i, j);
+    if (reg) {
+      regs[1] = CSI[j].getReg();
+      done[j] = true;
+    } else
+      reg = regs[0];
 
     // Should this be a kill? Unfortunately the argument registers
     // and nonvolatile registers on the target overlap, which leads
@@ -46,24 +151,77 @@ TMS320C64XFrameLowering::spillCalleeSavedRegisters(MachineBasicBlock &MBB,
     // a _function_ LiveIn too.
 
     is_kill = true;
-    reg = CSI[i].getReg();
 
-    MachineRegisterInfo::livein_iterator li = MRI.livein_begin();
+    for (unsigned k = 0; k < 2 && regs[k]; ++k) {
+      MachineRegisterInfo::livein_iterator li = MRI.livein_begin();
 
-    for (; li != MRI.livein_end(); li++) {
-      if (li->first == reg) {
-        is_kill = false;
-        break;
+      for (; li != MRI.livein_end(); li++) {
+        if (li->first == regs[k]) {
+          is_kill = false;
+          break;
+        }
       }
+
+      MBB.addLiveIn(regs[k]);
     }
 
-    MBB.addLiveIn(reg);
+    // the pair itself is read by the store
+    if (regs[1])
+      MBB.addLiveIn(reg);
 
-    const TargetInstrInfo &TII = *(MF->getTarget().getInstrInfo());
+    // the slot of the even register holds the pair
+    int frame_index = CSI[i].getFrameIdx();
+    if (regs[1] && TRI->getSubReg(reg, TMS320C64X::sub_lo) == regs[1])
+      frame_index = CSI[j].getFrameIdx();
 
     // register class and target reg info unused
-    TII.storeRegToStackSlot(
-      MBB, MBBI, reg, is_kill, CSI[i].getFrameIdx(), 0, 0);
+    TII.storeRegToStackSlot(MBB, MBBI, reg, is_kill, frame_index, 0, 0);
+  }
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+unsigned TMS320C64XFrameLowering::
+getCalleeSavedSpillPartner(const MachineFunction &MF,
+                           const std::vector<CalleeSavedInfo> &CSI,
+                           unsigned Idx) const
+{
+  unsigned Paired;
+  return getSpillPair(MF, CSI, Idx, Paired) ? Paired : Idx;
+}
+
+//-----------------------------------------------------------------------------
+
+bool
+TMS320C64XFrameLowering::restoreCalleeSavedRegisters(MachineBasicBlock &MBB,
+                                        MachineBasicBlock::iterator MBBI,
+                                        const std::vector<CalleeSavedInfo> &CSI,
+                                        const TargetRegisterInfo *TRI) const
+{
+  const MachineFunction *MF = MBB.getParent();
+  const TargetInstrInfo &TII = *(MF->getTarget().getInstrInfo());
+
+  SmallVector<bool, 8> done(CSI.size(), false);
+
+  for (unsigned i = 0; i < CSI.size(); ++i) {
+    if (done[i])
+      continue;
+
+    // see above, pairs are loaded by lddw
+    unsigned j;
+    unsigned reg = getSpillPair(*MF, CSI, i, j);
+    int frame_index = CSI[i].getFrameIdx();
+
+    if (reg) {
+      done[j] = true;
+      if (TRI->getSubReg(reg, TMS320C64X::sub_lo) == CSI[j].getReg())
+        frame_index = CSI[j].getFrameIdx();
+    } else
+      reg = CSI[i].getReg();
+
+    TII.loadRegFromStackSlot(MBB, MBBI, reg, frame_index, 0, 0);
   }
 
   return true;
@@ -96,10 +254,57 @@ void TMS320C64XFrameLowering::emitPrologue(MachineFunction &MF) const {
 
   const TMS320C64XInstrInfo &TII = *TM.getInstrInfo();
 
-  // Different to epilogue, we always use the prolog pseudo function, which
-  // will emit a 2- or 3-cycle prologue.
-  TMS320C64XInstrInfo::addDefaultPred(BuildMI(MBB, MBBI, dl,
-    TII.get(TMS320C64X::prolog)).addImm(frame_size));
+  if (!TM.getSubtarget<TMS320C64XSubtarget>().enablePostRAScheduler()) {
+
+    // prologue via pseudo instruction (is a scheduling boundary), which
+    // will emit a 2- or 3-cycle prologue.
+    TMS320C64XInstrInfo::addDefaultPred(BuildMI(MBB, MBBI, dl,
+      TII.get(TMS320C64X::prolog)).addImm(frame_size));
+    return;
+  }
+
+  // unbundled prologue instructions (weaved into other bundles)
+
+  // save caller's frame pointer
+  TMS320C64XInstrInfo::addFormOp(
+    TMS320C64XInstrInfo::addDefaultPred(
+      BuildMI(MBB, MBBI, dl, TII.get(TMS320C64X::word_store_2))
+      .addReg(TMS320C64X::B15).addImm(0).addReg(TMS320C64X::A15)),
+    TMS320C64XII::unit_d, false);
+
+  // save return address (B3), unless the function leaves it alone
+  if (isReturnAddressClobbered(MF))
+    TMS320C64XInstrInfo::addFormOp(
+      TMS320C64XInstrInfo::addDefaultPred(
+        BuildMI(MBB, MBBI, dl, TII.get(TMS320C64X::word_store_2))
+        .addReg(TMS320C64X::B15).addImm(-1).addReg(TMS320C64X::B3)),
+      TMS320C64XII::unit_d, true);
+
+  // set up frame pointer
+  TMS320C64XInstrInfo::addDefaultPred(
+    BuildMI(MBB, MBBI, dl, TII.get(TMS320C64X::mv))
+    .addReg(TMS320C64X::A15, RegState::Define).addReg(TMS320C64X::B15));
+
+  // allocate the frame. B0 neither passes arguments nor is callee saved, so
+  // it is free on entry
+  if (TMS320C64XInstrInfo::check_sconst_fits(frame_size, 16))
+    TMS320C64XInstrInfo::addFormOp(TMS320C64XInstrInfo::addDefaultPred(
+      BuildMI(MBB, MBBI, dl, TII.get(TMS320C64X::mvk_2), TMS320C64X::B0)
+        .addImm(frame_size)), TMS320C64XII::unit_s);
+  else {
+    TMS320C64XInstrInfo::addFormOp(TMS320C64XInstrInfo::addDefaultPred(
+      BuildMI(MBB, MBBI, dl, TII.get(TMS320C64X::mvkl_2), TMS320C64X::B0)
+        .addImm(frame_size)), TMS320C64XII::unit_s);
+    TMS320C64XInstrInfo::addFormOp(TMS320C64XInstrInfo::addDefaultPred(
+      BuildMI(MBB, MBBI, dl, TII.get(TMS320C64X::mvkh_2), TMS320C64X::B0)
+        .addImm(frame_size).addReg(TMS320C64X::B0)), TMS320C64XII::unit_s);
+  }
+
+  TMS320C64XInstrInfo::addFormOp(
+    TMS320C64XInstrInfo::addDefaultPred(
+      BuildMI(MBB, MBBI, dl, TII.get(TMS320C64X::sub_rr_2), TMS320C64X::B15)
+      .addReg(TMS320C64X::B15).addReg(TMS320C64X::B0, RegState::Kill)),
+    TMS320C64XII::unit_l, false);
 }
 
 //-----------------------------------------------------------------------------
@@ -124,15 +329,17 @@ void TMS320C64XFrameLowering::emitEpilogue(MachineFunction &MF,
 
     // unbundled epilogue instructions (weaved into other bundles)
 
-    // restore return address (B3)
-    TMS320C64XInstrInfo::addFormOp(
-      TMS320C64XInstrInfo::addDefaultPred(
-        BuildMI(MBB, MBBI, DL, TII.get(TMS320C64X::word_load_1))
-        .addReg(TMS320C64X::B3, RegState::Define).addReg(TMS320C64X::A15)
-        .addImm(-1)), TMS320C64XII::unit_d, true);
+    // restore return address (B3), if the prologue saved it
+    if (isReturnAddressClobbered(MF)) {
+      TMS320C64XInstrInfo::addFormOp(
+        TMS320C64XInstrInfo::addDefaultPred(
+          BuildMI(MBB, MBBI, DL, TII.get(TMS320C64X::word_load_1))
+          .addReg(TMS320C64X::B3, RegState::Define).addReg(TMS320C64X::A15)
+          .addImm(-1)), TMS320C64XII::unit_d, true);
 
-    // add the (implicit) use of B3 to ret
-    MBBI->addOperand(MachineOperand::CreateReg(TMS320C64X::B3, false, true));
+      // add the (implicit) use of B3 to ret
+      MBBI->addOperand(MachineOperand::CreateReg(TMS320C64X::B3, false, true));
+    }
 
     // reset stack pointer
     TMS320C64XInstrInfo::addDefaultPred(
@@ -183,4 +390,22 @@ processFunctionBeforeCalleeSavedScan(MachineFunction &MF,
                                                        RC->getAlignment(),
                                                        false));
   }
+
+  // Callee saved pairs that both need saving get a double word slot below
+  // the return address, so they can be spilled and restored by stdw/lddw.
+  // The frame pointer is double word aligned, the slots start at -16
+  TMS320C64XMachineFunctionInfo *FI =
+    MF.getInfo<TMS320C64XMachineFunctionInfo>();
+  int offset = -8;
+
+  for (unsigned p = 0; p < NumCalleeSavedPairs; ++p) {
+    const unsigned *pair = CalleeSavedPairs[p];
+    if (!isRegUsed(MF, pair[0]) || !isRegUsed(MF, pair[1]))
+      continue;
+
+    offset -= 8;
+    FI->setCalleeSavedSlot(pair[0], MFI->CreateFixedObject(4, offset, true));
+    FI->setCalleeSavedSlot(pair[1],
+                           MFI->CreateFixedObject(4, offset + 4, true));
+  }
 }
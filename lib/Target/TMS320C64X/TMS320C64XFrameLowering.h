@@ -35,6 +35,17 @@ class TMS320C64XFrameLowering : public TargetFrameLowering {
                                            const std::vector<CalleeSavedInfo> &,
                                            const TargetRegisterInfo*) const;
 
+    virtual bool restoreCalleeSavedRegisters(MachineBasicBlock &MBB,
+                                             MachineBasicBlock::iterator MBBI,
+                                        const std::vector<CalleeSavedInfo> &,
+                                             const TargetRegisterInfo*) const;
+
+    // pairs in a double word slot are saved by a single stdw
+    virtual unsigned
+    getCalleeSavedSpillPartner(const MachineFunction &MF,
+                               const std::vector<CalleeSavedInfo> &CSI,
+                               unsigned Idx) const;
+
     // pure virtual methods need to be implemented
     void emitPrologue(MachineFunction &MF) const;
     void emitEpilogue(MachineFunction &MF, MachineBasicBlock &MBB) const;
@@ -24,40 +24,80 @@
 
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/CodeGen/ScheduleDAG.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
+#include <deque>
 #include <set>
 
 using namespace llvm;
 using namespace TMS320C64X;
 
+STATISTIC(NumUnitsRepicked, "Number of instructions moved to another unit");
+
 namespace llvm {
 
 namespace TMS320C64X {
+  /// Units, moves and extra resources in use. The units are tracked for the
+  /// current and the following cycles, the not fully pipelined floating point
+  /// instructions keep their unit for more than the issue cycle. Cycles[k] is
+  /// k cycles after the current one in program order, when scheduling bottom-
+  /// up these are the cycles already filled.
   class MachineHazards {
 
     static const int UNITS = 4;
     static const int SIDES = 2;
-    std::set<unsigned> Active[SIDES];
+
+    struct CycleUse {
+      unsigned Units; // bit per unit index
+      int MovesOnSide[SIDES];
+      CycleUse() : Units(0) {
+        for (int i = 0; i < SIDES; ++i)
+          MovesOnSide[i] = 0;
+      }
+    };
+
+    std::deque<CycleUse> Cycles;
     int ExtraActive[NumExtra];
-    int MovesOnSide[SIDES];
+    bool BottomUp;
+
+    bool isBusyAt(unsigned unit, unsigned dist) {
+      if (dist >= Cycles.size())
+        return false;
+      if (Cycles[dist].Units & (1 << unit))
+        return true;
+      return isLSD(unit) && moveUnitsAvailable(unit & 0x1, dist) < 1;
+    }
 
   public:
+    explicit MachineHazards(bool bottomUp) : BottomUp(bottomUp) {}
+
     void reset() {
-      for (int i = 0; i < SIDES; ++i)
-        Active[i].clear();
+      Cycles.assign(1, CycleUse());
       for (int i = 0; i < NumExtra; ++i)
         ExtraActive[i] = 0;
-      for (int i = 0; i < SIDES; ++i)
-        MovesOnSide[i] = 0;
     }
-    bool isUnitBusy(unsigned unit) {
+    void advance() {
+      if (BottomUp) {
+        Cycles.push_front(CycleUse());
+        // nothing reaches further back than the longest unit occupation
+        if (Cycles.size() > 4)
+          Cycles.pop_back();
+      } else {
+        Cycles.pop_front();
+        if (Cycles.empty())
+          Cycles.push_back(CycleUse());
+      }
+      for (int i = 0; i < NumExtra; ++i)
+        ExtraActive[i] = 0;
+    }
+    /// isUnitBusy - Whether the unit is taken in the current cycle or in one
+    /// of the busy cycles following it.
+    bool isUnitBusy(unsigned unit, unsigned busy = 0) {
       assert(unit < UNITS * SIDES);
-      unsigned side = unit & 0x1;
-      if (Active[side].count(unit))
-        return true;
-      if (isLSD(unit >> 1) && moveUnitsAvailable(side) < 1)
-        return true;
+      for (unsigned i = 0; i <= busy; ++i)
+        if (isBusyAt(unit, i))
+          return true;
       return false;
     }
     bool isXResBusy(unsigned xres) {
@@ -72,23 +112,31 @@ namespace TMS320C64X {
       }
       return false;
     }
-    unsigned moveUnitsAvailable(unsigned side) {
+    unsigned moveUnitsAvailable(unsigned side, unsigned dist = 0) {
       assert(side < (unsigned) SIDES);
+      if (dist >= Cycles.size())
+        return UNITS - 1;
       // return number of available units not counting .M
-      return UNITS - 1 /* .M unit */ - MovesOnSide[side]
-        - count_if(Active[side].begin(), Active[side].end(), isLSD);
+      const CycleUse &C = Cycles[dist];
+      unsigned n = UNITS - 1 /* .M unit */ - C.MovesOnSide[side];
+      for (unsigned unit = side; unit < UNITS * SIDES; unit += SIDES)
+        if (isLSD(unit) && (C.Units & (1 << unit)))
+          --n;
+      return n;
     }
-    void book(unsigned unit, unsigned xres) {
+    void book(unsigned unit, unsigned xres, unsigned busy = 0) {
       assert(unit < UNITS * SIDES);
-      unsigned side = unit & 0x1;
-      Active[side].insert(unit);
+      while (Cycles.size() <= busy)
+        Cycles.push_back(CycleUse());
+      for (unsigned i = 0; i <= busy; ++i)
+        Cycles[i].Units |= 1 << unit;
 
       if (xres != None)
         ExtraActive[xres] = 1;
     }
     void bookMove(unsigned side, unsigned xres) {
       assert(side < (unsigned) SIDES);
-      MovesOnSide[side]++;
+      Cycles[0].MovesOnSide[side]++;
 
       if (xres != None)
         ExtraActive[xres] = 1;
@@ -98,9 +146,10 @@ namespace TMS320C64X {
 
 }
 
-ResourceAssignment::ResourceAssignment(const TargetInstrInfo &tii)
+ResourceAssignment::ResourceAssignment(const TargetInstrInfo &tii,
+                                       bool BottomUp)
 : TII(tii),
-  Hzd(new TMS320C64X::MachineHazards())
+  Hzd(new TMS320C64X::MachineHazards(BottomUp))
 {
   Hzd->reset();
 }
@@ -109,7 +158,7 @@ ResourceAssignment::~ResourceAssignment() { delete Hzd; }
 
 void ResourceAssignment::Reset() { Hzd->reset(); }
 
-void ResourceAssignment::AdvanceCycle() { Hzd->reset(); }
+void ResourceAssignment::AdvanceCycle() { Hzd->advance(); }
 
 bool ResourceAssignment::Schedule(SUnit *SU) {
   if (isPseudo(SU))
@@ -139,7 +188,8 @@ bool ResourceAssignment::ScheduleOnSide(SUnit *SU, unsigned side) {
     for (int i = 0, e = array_lengthof(unit_prio); i != e; ++i) {
       unit = unit_prio[i];
       if ((support >> unit) & 0x1) {
-        MachineOperand &unitOp = MI->getOperand(MI->getNumOperands() - 1);
+        MachineOperand &unitOp =
+          MI->getOperand(MI->getDesc().getNumOperands() - 1);
         unitOp.setImm(unit << 1);
         DEBUG(DBGSCHED(dbgs(), MI) << "scheduled on unit ."
           << TMS320C64XInstrInfo::getUnitStrings()[unit] << "\n");
@@ -167,7 +217,8 @@ bool ResourceAssignment::ScheduleOnSide(SUnit *SU, unsigned side) {
 
   assert(udx >= 0 && "FU not scheduled");
 
-  if (Hzd->isUnitBusy(udx)) {
+  unsigned busy = GET_UNIT_BUSY(desc.TSFlags);
+  if (Hzd->isUnitBusy(udx, busy)) {
     DEBUG(dbgUnitBusy(SU, udx));
     return false;
   }
@@ -177,7 +228,7 @@ bool ResourceAssignment::ScheduleOnSide(SUnit *SU, unsigned side) {
     return false;
   }
 
-  Hzd->book(udx, xuse);
+  Hzd->book(udx, xuse, busy);
   return true;
 }
 
@@ -199,6 +250,44 @@ bool ResourceAssignment::XPathOnSideAvailable(unsigned dstSide) {
   return !Hzd->isXResBusy(xuse);
 }
 
+/// repickUnit - The unit of a flexible instruction is fixed by the cluster
+/// assignment, which picks the first unit supported. If that unit is already
+/// taken in the current cycle, move the instruction to another free unit on
+/// the same side the instruction can be encoded for. The side itself is given
+/// by the registers. Returns true if a free unit was found.
+bool ResourceAssignment::repickUnit(SUnit *SU) {
+  using namespace TMS320C64XII;
+
+  MachineInstr *MI = SU->getInstr();
+  const TargetInstrDesc &desc = MI->getDesc();
+
+  // memory accesses are bound to .D
+  if (!isFlexibleInstruction(desc) || (desc.TSFlags & is_memaccess))
+    return false;
+
+  MachineOperand &unitOp = MI->getOperand(MI->getDesc().getNumOperands() - 1);
+  unsigned side = IS_BSIDE(desc.TSFlags) ? 1 : 0;
+  unsigned support = desc.TSFlags & unit_support_mask;
+
+  static const int unit_prio[] = { unit_l, unit_s, unit_m, unit_d };
+  for (int i = 0, e = array_lengthof(unit_prio); i != e; ++i) {
+    int unit = unit_prio[i];
+    if (!((support >> unit) & 0x1)
+        || !TMS320C64X::hasUnitEncoding(MI->getOpcode(), unit)
+        || Hzd->isUnitBusy(getUnitIndex(side, unit),
+                           GET_UNIT_BUSY(desc.TSFlags)))
+      continue;
+
+    // keep the xpath bit
+    DEBUG(DBGSCHED(dbgs(), MI) << "unit re-picked: ."
+          << TMS320C64XInstrInfo::getUnitStrings()[unit] << "\n");
+    unitOp.setImm((unit << 1) | (unitOp.getImm() & 0x1));
+    ++NumUnitsRepicked;
+    return true;
+  }
+  return false;
+}
+
 bool ResourceAssignment::isPseudo(SUnit *SU) const {
   return (!SU->getInstr());
 }
@@ -233,7 +322,7 @@ ResourceAssignment::analyzeOpRegs(const MachineInstr *MI) {
           continue;
       } else {
         // it's a physreg
-        regside = TMS320C64X::BRegsRegClass.contains(reg)?1:0;
+        regside = TMS320C64X::isBSideReg(reg)?1:0;
       }
       // initialize the result object
       if (result.second < 0)
@@ -257,9 +346,11 @@ ResourceAssignment::getOperandRCs(const MachineInstr *MI) {
   const TargetInstrDesc desc = MI->getDesc();
   std::set<const TargetRegisterClass*> result;
 
-  for (MachineInstr::const_mop_iterator MOI = MI->operands_begin(),
-       MOE = MI->operands_end(); MOI != MOE; ++MOI) {
-    const MachineOperand &op = *MOI;
+  for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+    const MachineOperand &op = MI->getOperand(i);
+    // predicates are read from either side without a cross path
+    if (i < desc.getNumOperands() && desc.OpInfo[i].isPredicate())
+      continue;
     if (op.isReg() && op.isUse()) {
       unsigned reg = op.getReg();
       if (TargetRegisterInfo::isVirtualRegister(reg)) {
@@ -267,7 +358,7 @@ ResourceAssignment::getOperandRCs(const MachineInstr *MI) {
         result.insert(resolveSide(RC));
       } else {
         // it's a physreg
-        result.insert(TMS320C64X::BRegsRegClass.contains(reg) ?
+        result.insert(TMS320C64X::isBSideReg(reg) ?
                         BRegsRegisterClass :
                         ARegsRegisterClass);
       }
@@ -311,7 +402,7 @@ unsigned ResourceAssignment::getExtraUse(SUnit *SU) {
     return xuse;
   }
 
-  const MachineOperand &op = MI->getOperand(MI->getNumOperands() - 1);
+  const MachineOperand &op = MI->getOperand(MI->getDesc().getNumOperands() - 1);
 
   return getExtraUse(desc, op);
 }
@@ -354,7 +445,8 @@ unsigned ResourceAssignment::getUnitIndex(SUnit *SU) {
   }
 
   // the unit is defined via the operand
-  const MachineOperand &unitOp = MI->getOperand(MI->getNumOperands() - 1);
+  const MachineOperand &unitOp =
+    MI->getOperand(MI->getDesc().getNumOperands() - 1);
   return getUnitIndex(side, unitOp.getImm() >> 1);
 }
 
@@ -396,7 +488,8 @@ TMS320C64XHazardRecognizer::getHazardType(SUnit *SU, int stalls) {
   fixResources(SU);
 
   unsigned idx = getUnitIndex(SU);
-  if (Hzd->isUnitBusy(idx)) {
+  unsigned busy = GET_UNIT_BUSY(SU->getInstr()->getDesc().TSFlags);
+  if (Hzd->isUnitBusy(idx, busy) && !repickUnit(SU)) {
     DEBUG(dbgUnitBusy(SU, idx));
     return NoopHazard;
   }
@@ -421,7 +514,8 @@ void TMS320C64XHazardRecognizer::EmitInstruction(SUnit *SU) {
   if (emitMove(SU))
     return;
 
-  Hzd->book(getUnitIndex(SU), getExtraUse(SU));
+  Hzd->book(getUnitIndex(SU), getExtraUse(SU),
+            GET_UNIT_BUSY(SU->getInstr()->getDesc().TSFlags));
 }
 
 void TMS320C64XHazardRecognizer::EmitNoop() {
@@ -447,15 +541,16 @@ void TMS320C64XHazardRecognizer::fixResources(SUnit *SU) {
   if (desc.TSFlags & TMS320C64XII::is_memaccess) {
     if (desc.TSFlags & TMS320C64XII::is_store) {
       // store
-      MachineOperand &reg = MI->getOperand(2);
+      MachineOperand &reg =
+        MI->getOperand(TMS320C64XII::getMemDataIdx(desc.TSFlags));
       assert(reg.isReg() && reg.isUse());
-      regside = TMS320C64X::BRegsRegClass.contains(reg.getReg())? 1:0;
+      regside = TMS320C64X::isBSideReg(reg.getReg())? 1:0;
     }
     else {
       // load
       MachineOperand &dst = MI->getOperand(0);
       assert(dst.isReg() && dst.isDef() && !dst.isImplicit());
-      regside = TMS320C64X::BRegsRegClass.contains(dst.getReg())? 1:0;
+      regside = TMS320C64X::isBSideReg(dst.getReg())? 1:0;
     }
     // strict ld/st: addr regs must be on the same side as the D unit
     //instside = IS_BSIDE(desc.TSFlags) ? 1 : 0;
@@ -497,8 +592,9 @@ void ResourceAssignment::setXPath(MachineInstr *MI, bool set) {
     return;
   }
 
-  // machine instructions must have the format operand at the end
-  MachineOperand &op = MI->getOperand(MI->getNumOperands() - 1);
+  // machine instructions must have the format operand at the end (of their
+  // explicit operands)
+  MachineOperand &op = MI->getOperand(MI->getDesc().getNumOperands() - 1);
   assert(op.isImm());
   unsigned oldval = op.getImm() & 0x1;
   unsigned newval = set ? 0x1 : 0x0;
@@ -49,10 +49,12 @@ protected:
 
   void Reset();
   bool isPseudo(SUnit *SU) const;
+  bool repickUnit(SUnit *SU);
   unsigned getUnitIndex(unsigned side, unsigned unit);
   unsigned getUnitIndex(SUnit *SU);
 public:
-  ResourceAssignment(const TargetInstrInfo &TII);
+  /// BottomUp tells whether the cycles are filled in reverse program order.
+  ResourceAssignment(const TargetInstrInfo &TII, bool BottomUp = false);
   virtual ~ResourceAssignment();
 
   /// Try to schedule SU in the current cycle, return true if successful.
@@ -102,8 +104,9 @@ class TMS320C64XHazardRecognizer : public ScheduleHazardRecognizer,
 public:
   static std::pair<unsigned,unsigned> analyzeMove(SUnit *SU);
 
-  TMS320C64XHazardRecognizer(const TargetInstrInfo &TII)
-    : ResourceAssignment(TII)
+  TMS320C64XHazardRecognizer(const TargetInstrInfo &TII,
+                             bool BottomUp = false)
+    : ResourceAssignment(TII, BottomUp)
   {}
 
   virtual HazardType getHazardType(SUnit *SU, int stalls);
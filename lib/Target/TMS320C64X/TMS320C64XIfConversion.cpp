@@ -14,6 +14,7 @@
 #define DEBUG_TYPE "ifconversion"
 #include "TMS320C64X.h"
 #include "TMS320C64XTargetMachine.h"
+#include "llvm/Analysis/ProfileInfo.h"
 #include "llvm/CodeGen/MachineFunctionPass.h"
 #include "llvm/CodeGen/MachineInstr.h"
 #include "llvm/CodeGen/MachineProfileAnalysis.h"
@@ -29,12 +30,14 @@
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DepthFirstIterator.h"
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/MC/MCSymbol.h"
 #include <list>
+#include <map>
 
 using namespace llvm;
 
@@ -70,6 +73,11 @@ typedef std::pair<unsigned, unsigned> UIntPair;
 typedef std::pair<unsigned, UIntPair> PHIEntryInfo;
 typedef SmallVector<MachineOperand, 4> SmallPredVector;
 
+// an instruction sequence handed to the cycle estimation. Each instruction is
+// paired with the predicate register it would be guarded with additionally
+// after the conversion (0 if it stays as it is)
+typedef SmallVector<std::pair<MachineInstr*, unsigned>, 64> EstimationSeq;
+
 // @enum CONVERSION_PREFERENCE: This enum is provided to improve readability
 // of the code and is used to specify the preference for the conversion, i.e.
 // which of both outcomes of a structure is to be preferred for conditional
@@ -276,6 +284,9 @@ class TMS320C64XIfConversion : public MachineFunctionPass {
     // analyzed and stored within this map. The map is rebuilt each iteration
     std::map<MachineBasicBlock*, BBInfo> analyzedBlocks;
 
+    // number of registers available for predicates (A0-A2, B0-B2)
+    unsigned NumPredRegs;
+
     // local function statistics
     unsigned NumRemovedBranches;
     unsigned NumPredicatedBlocks;
@@ -331,6 +342,10 @@ class TMS320C64XIfConversion : public MachineFunctionPass {
     // cated, adjusted and merged with the corresponding head block
     CONVERSION_PREFERENCE getConversionPreference(IfConvertible &IC);
 
+    // the fast (static) variant of the above, only inspects block sizes, the
+    // latency sums and the loop structure
+    CONVERSION_PREFERENCE getFastConversionPreference(IfConvertible &IC);
+
     // provided for debugging purposes, this method prints the information
     // what machine basic blocks the given convertible structure consists of
     void printCandidate(const IfConvertible &candidate) const;
@@ -360,6 +375,23 @@ class TMS320C64XIfConversion : public MachineFunctionPass {
     // is stored in a working list of convertible candidates
     void extractIfPattern(BBInfo &headBlock);
 
+    // appends the instructions of the specified block to the sequence, eit-
+    // her the body, the terminators or both. Instructions are marked to be
+    // guarded by 'predReg' when it is specified
+    void appendToSequence(EstimationSeq &seq, MachineBasicBlock *MBB,
+                          bool body, bool terms, unsigned predReg = 0) const;
+
+    // list-schedules the given sequence on the functional units of both
+    // sides and returns the number of cycles until all results and branches
+    // are done. This uses the resources and latencies the post-RA scheduler
+    // and its hazard recognizer are working with, but does not care about
+    // cluster sides or cross paths, those are not assigned before the RA
+    unsigned estimateCycles(const EstimationSeq &seq) const;
+
+    // returns the max number of predicate registers that are live at the
+    // same time within the sequence (regarding its instructions only)
+    unsigned getPredicatePressure(const EstimationSeq &seq) const;
+
     // a handy helper whether it is profitable to duplicate the specified BB.
     // the estimation is done statically by inspecting the size of the block,
     // the number of its successors/predecessors, etc
@@ -1015,15 +1047,15 @@ TMS320C64XIfConversion::getPHISourceRegIndex(const MachineInstr &PHIInstr,
 }
 
 //------------------------------------------------------------------------------
-// getConversionPreference:
+// getFastConversionPreference:
 //
 // Given a specified info struct about a basic block (which is assumed to be
 // a head of a convertible structure, its branching structure is inspected
-// and analyzed with respect to the profitability/execution counts. Depending
-// on this analysis a suggestion is given whether and what to convert
+// and analyzed with respect to the static execution estimates. Depending on
+// this analysis a suggestion is given whether and what to convert
 
 CONVERSION_PREFERENCE
-TMS320C64XIfConversion::getConversionPreference(IfConvertible &candidate) {
+TMS320C64XIfConversion::getFastConversionPreference(IfConvertible &candidate) {
 
   BBInfo &headBBI = candidate.headInfo;
   BBInfo &infoFBB = candidate.FBBInfo;
@@ -1036,43 +1068,28 @@ TMS320C64XIfConversion::getConversionPreference(IfConvertible &candidate) {
   if (infoFBB.MBB->succ_size() != 1 && infoTBB.MBB->succ_size() != 1)
     return PREFER_NONE;
 
-  double execFreqFBB = 0.0;
-  double execFreqTBB = 0.0;
-  double execFreqHead = 0.0;
+  MachineBasicBlock *FBB = infoFBB.MBB;
+  MachineBasicBlock *TBB = infoTBB.MBB;
 
   // for a fast estimation we only require the machine-loop-analysis to be
   // present. We inspect the program structure and decide upon block proper-
-  // ties such as being a loop header, nesting level, etc.
-  if (FastEstimation) {
+  // ties such as being a loop header, nesting level, etc. Estimate the exec.
+  // frequency first (prefer deeper nested blocks)
+  double execFreqFBB = (MLI->getLoopDepth(FBB) * 100.0) + 1.0;
+  double execFreqTBB = (MLI->getLoopDepth(TBB) * 100.0) + 1.0;
 
-    MachineBasicBlock *FBB = infoFBB.MBB;
-    MachineBasicBlock *TBB = infoTBB.MBB;
+  MachineLoop *mlFBB = MLI->getLoopFor(FBB);
+  MachineLoop *mlTBB = MLI->getLoopFor(TBB);
 
-    // estimate exec. frequency (prefer deeper nested blocks)
-    execFreqFBB = (MLI->getLoopDepth(FBB) * 100.0) + 1.0;
-    execFreqTBB = (MLI->getLoopDepth(TBB) * 100.0) + 1.0;
+  // backedges to the headers are usually more frequent than non-backedges,
+  // NOTE, that we do not yet prefer header-blocks over non-header blocks
+  if (mlFBB && FBB->isSuccessor(mlFBB->getHeader())) execFreqFBB *= 10.0;
+  if (mlTBB && TBB->isSuccessor(mlTBB->getHeader())) execFreqTBB *= 10.0;
 
-    MachineLoop *mlFBB = MLI->getLoopFor(FBB);
-    MachineLoop *mlTBB = MLI->getLoopFor(TBB);
-
-    // backedges to the headers are usually more frequent than non-backedges,
-    // NOTE, that we do not yet prefer header-blocks over non-header blocks
-    if (mlFBB && FBB->isSuccessor(mlFBB->getHeader())) execFreqFBB *= 10.0;
-    if (mlTBB && TBB->isSuccessor(mlTBB->getHeader())) execFreqTBB *= 10.0;
-
-    // finally, consider predecessor num
-    execFreqFBB *= (FBB->pred_size() + 1.0);
-    execFreqTBB *= (TBB->pred_size() + 1.0);
-    execFreqHead = execFreqFBB + execFreqTBB;
-  }
-  else {
-    // for a profile based estimation, we use basic block counts for now, but
-    // will probably change later to use profiled weights for edges between
-    // machine basic blocks
-    execFreqFBB = MPI->getExecutionCount(infoFBB.MBB);
-    execFreqTBB = MPI->getExecutionCount(infoTBB.MBB);
-    execFreqHead = MPI->getExecutionCount(headBBI.MBB);
-  }
+  // finally, consider predecessor num
+  execFreqFBB *= (FBB->pred_size() + 1.0);
+  execFreqTBB *= (TBB->pred_size() + 1.0);
+  const double execFreqHead = execFreqFBB + execFreqTBB;
 
   unsigned sizeLimit = AggressiveConversion ? 128 : 64;
 
@@ -1136,6 +1153,376 @@ TMS320C64XIfConversion::getConversionPreference(IfConvertible &candidate) {
   return PREFER_NONE;
 }
 
+//------------------------------------------------------------------------------
+// getConversionPreference:
+//
+// Given a specified info struct about a basic block (which is assumed to be
+// a head of a convertible structure, its branching structure is inspected
+// and analyzed with respect to the profitability/execution counts. Depending
+// on this analysis a suggestion is given whether and what to convert.
+//
+// Unless the fast estimation is requested, both alternatives are scheduled,
+// the structure as it is and the head with the predicated blocks merged into
+// it. Each block is weighted with the profiled frequency of the edge leading
+// into it, and the conversion is only suggested if the weighted cycle count
+// drops. Merging the result again with its neighbours in later iterations
+// forms the hyperblocks
+
+CONVERSION_PREFERENCE
+TMS320C64XIfConversion::getConversionPreference(IfConvertible &candidate) {
+
+  if (FastEstimation) return getFastConversionPreference(candidate);
+
+  BBInfo &headBBI = candidate.headInfo;
+  BBInfo &infoFBB = candidate.FBBInfo;
+  BBInfo &infoTBB = candidate.TBBInfo;
+
+  if (candidate.type == BAD_IF_STRUCTURE) return PREFER_NONE;
+  assert(headBBI.MBB && infoFBB.MBB && infoTBB.MBB && "Invalid blocks!");
+
+  // for the time being we can only convert blocks which have 1 succ
+  if (infoFBB.MBB->succ_size() != 1 && infoTBB.MBB->succ_size() != 1)
+    return PREFER_NONE;
+
+  MachineBasicBlock *head = headBBI.MBB;
+
+  // the arms are weighted by the edges leading into them from the head, the
+  // blocks may have other predecessors (they are duplicated before merging)
+  const double execFreqHead = MPI->getExecutionCount(head);
+  const double execFreqFBB = MPI->getEdgeWeight(head, infoFBB.MBB);
+  const double execFreqTBB = MPI->getEdgeWeight(head, infoTBB.MBB);
+
+  if (execFreqHead == ProfileInfo::MissingValue
+  || execFreqFBB == ProfileInfo::MissingValue
+  || execFreqTBB == ProfileInfo::MissingValue)
+    return PREFER_NONE;
+
+  const unsigned sizeLimit = AggressiveConversion ? 128 : 64;
+  const unsigned predReg = headBBI.branchCond[1].getReg();
+
+  EstimationSeq headSeq;
+  appendToSequence(headSeq, head, true, true);
+  const double headCost = execFreqHead * estimateCycles(headSeq);
+
+  if (candidate.type == IF_OPEN) {
+
+    // we can merge either of the targets into the head, the other one then
+    // remains to be branched to. Pick the one that saves most cycles
+    CONVERSION_PREFERENCE preference = PREFER_NONE;
+    double bestGain = 0.0;
+
+    for (unsigned I = 0; I < 2; ++I) {
+      BBInfo &conv = I ? infoTBB : infoFBB;
+      const double execFreqConv = I ? execFreqTBB : execFreqFBB;
+
+      if (headBBI.size + conv.size > sizeLimit) continue;
+      if (!canPredicateBlock(conv) || !canMergeBlock(conv, headBBI)) continue;
+
+      EstimationSeq convSeq;
+      appendToSequence(convSeq, conv.MBB, true, true);
+
+      EstimationSeq mergedSeq;
+      appendToSequence(mergedSeq, head, true, false);
+      appendToSequence(mergedSeq, conv.MBB, true, false, predReg);
+      appendToSequence(mergedSeq, head, false, true);
+      appendToSequence(mergedSeq, conv.MBB, false, true, predReg);
+
+      if (getPredicatePressure(mergedSeq) > NumPredRegs) continue;
+
+      const double branchCost =
+        headCost + execFreqConv * estimateCycles(convSeq);
+      const double predCost = execFreqHead * estimateCycles(mergedSeq);
+      const double gain = branchCost - predCost;
+
+      DEBUG(dbgs() << "Estimated IF_OPEN '" << head->getName() << "'/'"
+                   << conv.MBB->getName() << "': " << branchCost
+                   << " cycles branching, " << predCost
+                   << " cycles predicated\n");
+
+      if (gain > bestGain || (AggressiveConversion && gain == 0.0
+                              && preference == PREFER_NONE)) {
+        preference = I ? PREFER_TBB : PREFER_FBB;
+        bestGain = gain;
+      }
+    }
+    return preference;
+  }
+
+  EstimationSeq branchSeq;
+  EstimationSeq mergedSeq;
+  double branchCost = headCost;
+
+  if (headBBI.size + infoFBB.size + infoTBB.size > sizeLimit)
+    return PREFER_NONE;
+
+  appendToSequence(mergedSeq, head, true, false);
+
+  if (candidate.type == IF_TRIANGLE) {
+
+    // we only consider merging both blocks (FBB and tail) into the head, NOTE,
+    // we always refer the tail block as TBB here !
+    appendToSequence(branchSeq, infoFBB.MBB, true, true);
+    branchCost += execFreqFBB * estimateCycles(branchSeq);
+
+    branchSeq.clear();
+    appendToSequence(branchSeq, infoTBB.MBB, true, true);
+    branchCost += execFreqHead * estimateCycles(branchSeq);
+
+    appendToSequence(mergedSeq, infoFBB.MBB, true, false, predReg);
+    appendToSequence(mergedSeq, infoTBB.MBB, true, true);
+  }
+  else if (candidate.type == IF_DIAMOND) {
+
+    // diamonds are only collapsed completely, the tail is executed as often
+    // as the head in both versions
+    BBInfo &tail = candidate.tailInfo;
+
+    appendToSequence(branchSeq, infoFBB.MBB, true, true);
+    branchCost += execFreqFBB * estimateCycles(branchSeq);
+
+    branchSeq.clear();
+    appendToSequence(branchSeq, infoTBB.MBB, true, true);
+    branchCost += execFreqTBB * estimateCycles(branchSeq);
+
+    branchSeq.clear();
+    appendToSequence(branchSeq, tail.MBB, true, true);
+    branchCost += execFreqHead * estimateCycles(branchSeq);
+
+    appendToSequence(mergedSeq, infoTBB.MBB, true, false, predReg);
+    appendToSequence(mergedSeq, infoFBB.MBB, true, false, predReg);
+    appendToSequence(mergedSeq, tail.MBB, true, true);
+  }
+  else return PREFER_NONE;
+
+  if (getPredicatePressure(mergedSeq) > NumPredRegs) return PREFER_NONE;
+
+  const double predCost = execFreqHead * estimateCycles(mergedSeq);
+
+  DEBUG(dbgs() << "Estimated '" << head->getName() << "': " << branchCost
+               << " cycles branching, " << predCost << " cycles predicated\n");
+
+  if (predCost < branchCost || (AggressiveConversion && predCost == branchCost))
+    return PREFER_ALL;
+  return PREFER_NONE;
+}
+
+//------------------------------------------------------------------------------
+// appendToSequence:
+//
+// Appends the instructions of the specified block to the sequence used for
+// the cycle estimation. Pseudos which do not make it into the final code are
+// skipped, so are phi-instructions, they are at the beginning of the block
+
+void TMS320C64XIfConversion::appendToSequence(EstimationSeq &seq,
+                                              MachineBasicBlock *MBB,
+                                              bool body,
+                                              bool terms,
+                                              unsigned predReg) const
+{
+  MachineBasicBlock::iterator firstTerm = MBB->getFirstTerminator();
+  MachineBasicBlock::iterator MI = body ? MBB->begin() : firstTerm;
+  MachineBasicBlock::iterator E = terms ? MBB->end() : firstTerm;
+
+  for (; MI != E; ++MI) {
+    if (MI->isDebugValue() || MI->isPHI() || isPredicatelessPseudoMI(*MI))
+      continue;
+    seq.push_back(std::make_pair(&*MI, predReg));
+  }
+}
+
+//------------------------------------------------------------------------------
+// estimateCycles:
+//
+// A simple list scheduler. The instructions are placed in order, each at the
+// earliest cycle its operands are available in, that has a free functional
+// unit the instruction can be executed on. The resources of both sides are
+// considered to be one pool, since the cluster assignment is not done yet.
+// Memory accesses keep their order with respect to stores, calls and other
+// instructions with side effects their order with respect to anything. The
+// sequence is not finished before the results of all instructions are ready
+// and the delay slots of all branches have passed
+
+unsigned
+TMS320C64XIfConversion::estimateCycles(const EstimationSeq &seq) const {
+
+  using namespace TMS320C64XII;
+
+  static const unsigned unitPrio[] = { unit_l, unit_s, unit_m, unit_d };
+
+  // for each cycle a mask of the booked units (unit << 1 | side)
+  std::vector<unsigned> bookedUnits;
+  DenseMap<unsigned, unsigned> readyCycle;
+
+  unsigned loadCycle = 0;
+  unsigned storeCycle = 0;
+  unsigned barrierCycle = 0;
+  unsigned lastIssue = 0;
+  unsigned length = 0;
+
+  for (unsigned I = 0; I < seq.size(); ++I) {
+    MachineInstr *MI = seq[I].first;
+    const TargetInstrDesc &MID = MI->getDesc();
+    const bool isBarrier = MID.isCall() || MID.hasUnmodeledSideEffects();
+
+    unsigned earliest = isBarrier ? lastIssue : barrierCycle;
+
+    // wait for the operands and the predicate added by the conversion
+    if (seq[I].second)
+      earliest = std::max(earliest, readyCycle.lookup(seq[I].second));
+
+    for (unsigned J = 0; J < MI->getNumOperands(); ++J) {
+      const MachineOperand &MO = MI->getOperand(J);
+      if (MO.isReg() && MO.getReg() && MO.isUse())
+        earliest = std::max(earliest, readyCycle.lookup(MO.getReg()));
+    }
+
+    if (MID.mayLoad()) earliest = std::max(earliest, loadCycle);
+    if (MID.mayStore()) earliest = std::max(earliest, storeCycle);
+
+    // get the units the instruction can be issued on. Copies become moves,
+    // branches are issued on the .S units, anything else tells by its flags
+    unsigned support;
+    if (MI->isCopy())
+      support = (1 << unit_l) | (1 << unit_s) | (1 << unit_d);
+    else if (MID.isBranch() || MID.isCall() || MID.isReturn())
+      support = 1 << unit_s;
+    else if (TMS320C64XInstrInfo::isFlexible(MID))
+      support = MID.TSFlags & unit_support_mask;
+    else
+      support = 1 << GET_UNIT(MID.TSFlags);
+
+    const unsigned busyCycles = GET_UNIT_BUSY(MID.TSFlags) + 1;
+
+    unsigned issue = earliest;
+    for (;; ++issue) {
+      if (bookedUnits.size() < issue + busyCycles)
+        bookedUnits.resize(issue + busyCycles, 0);
+
+      unsigned unitMask = 0;
+      for (unsigned U = 0; U < array_lengthof(unitPrio) && !unitMask; ++U) {
+        if (!(support & (1 << unitPrio[U]))) continue;
+
+        for (unsigned side = 0; side < NUM_SIDES && !unitMask; ++side) {
+          const unsigned mask = 1 << (unitPrio[U] << 1 | side);
+
+          bool isFree = true;
+          for (unsigned C = issue; C < issue + busyCycles; ++C)
+            if (bookedUnits[C] & mask) isFree = false;
+          if (isFree) unitMask = mask;
+        }
+      }
+
+      if (unitMask) {
+        for (unsigned C = issue; C < issue + busyCycles; ++C)
+          bookedUnits[C] |= unitMask;
+        break;
+      }
+    }
+
+    // branches are done after their delay slots, other instructions when
+    // their results are available
+    const unsigned latency = MID.isBranch() || MID.isCall()
+      ? BRANCH_CYCLES + 1
+      : (unsigned) std::max(TII->getInstrLatency(IID, MI), 1);
+
+    for (unsigned J = 0; J < MI->getNumOperands(); ++J) {
+      const MachineOperand &MO = MI->getOperand(J);
+      if (MO.isReg() && MO.getReg() && MO.isDef())
+        readyCycle[MO.getReg()] = issue + latency;
+    }
+
+    if (MID.mayLoad()) storeCycle = std::max(storeCycle, issue);
+    if (MID.mayStore()) {
+      loadCycle = std::max(loadCycle, issue + 1);
+      storeCycle = std::max(storeCycle, issue + 1);
+    }
+    if (isBarrier) barrierCycle = issue + 1;
+
+    lastIssue = std::max(lastIssue, issue);
+    length = std::max(length, issue + latency);
+  }
+  return length;
+}
+
+//------------------------------------------------------------------------------
+// getPredicatePressure:
+//
+// Returns the max number of predicate registers being live at the same time
+// within the given instruction sequence. A predicate is considered to be live
+// from its definition (or the beginning of the sequence) to its last use as
+// a predicate, which is what the register allocator later has to fit into
+// the A0-A2 and B0-B2 registers. Predicates testing the same condition (or
+// its inverse) are counted once, the predicate sharing pass merges them
+
+unsigned
+TMS320C64XIfConversion::getPredicatePressure(const EstimationSeq &seq) const {
+
+  // the first definition of each register within the sequence
+  DenseMap<unsigned, unsigned> defIndex;
+
+  for (unsigned I = 0; I < seq.size(); ++I) {
+    MachineInstr *MI = seq[I].first;
+    for (unsigned J = 0; J < MI->getNumOperands(); ++J) {
+      const MachineOperand &MO = MI->getOperand(J);
+      if (MO.isReg() && MO.getReg() && MO.isDef())
+        defIndex.insert(std::make_pair(MO.getReg(), I));
+    }
+  }
+
+  // live range of each register used as a predicate
+  DenseMap<unsigned, UIntPair> liveRanges;
+
+  // the first register seen for each condition
+  std::map<PredicateCondition, unsigned> condRegs;
+  const MachineRegisterInfo *MRI = 0;
+  if (!seq.empty())
+    MRI = &seq.front().first->getParent()->getParent()->getRegInfo();
+
+  for (unsigned I = 0; I < seq.size(); ++I) {
+    MachineInstr *MI = seq[I].first;
+    SmallVector<unsigned, 2> predRegs;
+
+    if (seq[I].second) predRegs.push_back(seq[I].second);
+
+    const int predIndex = MI->findFirstPredOperandIdx();
+    if (predIndex != -1 && TII->isPredicated(MI)) {
+      const MachineOperand &predRegMO = MI->getOperand(predIndex + 1);
+      if (predRegMO.isReg() && predRegMO.getReg())
+        predRegs.push_back(predRegMO.getReg());
+    }
+
+    for (unsigned J = 0; J < predRegs.size(); ++J) {
+      unsigned reg = predRegs[J];
+
+      unsigned start = 0;
+      DenseMap<unsigned, unsigned>::iterator DI = defIndex.find(reg);
+      if (DI != defIndex.end() && DI->second < I) start = DI->second;
+
+      PredicateCondition cond;
+      if (TargetRegisterInfo::isVirtualRegister(reg)
+          && TII->analyzePredicate(*MRI, reg, cond))
+        reg = condRegs.insert(std::make_pair(cond, reg)).first->second;
+
+      DenseMap<unsigned, UIntPair>::iterator LI = liveRanges.find(reg);
+      if (LI == liveRanges.end()) liveRanges[reg] = UIntPair(start, I);
+      else {
+        LI->second.first = std::min(LI->second.first, start);
+        LI->second.second = I;
+      }
+    }
+  }
+
+  unsigned pressure = 0;
+  for (unsigned I = 0; I < seq.size(); ++I) {
+    unsigned live = 0;
+    DenseMap<unsigned, UIntPair>::iterator LI;
+    for (LI = liveRanges.begin(); LI != liveRanges.end(); ++LI)
+      if (LI->second.first <= I && I <= LI->second.second) ++live;
+    pressure = std::max(pressure, live);
+  }
+  return pressure;
+}
+
 //------------------------------------------------------------------------------
 // duplicateBlock:
 //
@@ -1797,6 +2184,10 @@ bool TMS320C64XIfConversion::runOnMachineFunction(MachineFunction &MF) {
 
   MLI = &getAnalysis<MachineLoopInfo>();
 
+  const TargetRegisterClass *predRC = TMS320C64X::PredRegsRegisterClass;
+  NumPredRegs = predRC->allocation_order_end(MF)
+              - predRC->allocation_order_begin(MF);
+
   DEBUG(dbgs() << "Run 'TMS320C64XIfConversion' pass for '"
                << MF.getFunction()->getNameStr() << "'\n");
 
@@ -1840,8 +2231,9 @@ bool TMS320C64XIfConversion::runOnMachineFunction(MachineFunction &MF) {
 
     // convert aggressively/exhaustively if desired to do so, otherwise limit
     // the number of conversions per function to the number specified on the
-    // command line by the user...
-    if (AggressiveConversion) continueConversion = true;
+    // command line by the user. The limit only applies to the fast estima-
+    // tion, otherwise each conversion has to pay off on its own
+    if (AggressiveConversion || !FastEstimation) continueConversion = true;
     else continueConversion = --maxConversions > 0;
   }
 
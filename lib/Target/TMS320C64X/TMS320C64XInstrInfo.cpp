@@ -55,6 +55,24 @@ TMS320C64XInstrInfo::UnitStrings_t
 std::string TMS320C64XInstrInfo::Res_a[] = { "L1", "S1", "M1", "D1" };
 std::string TMS320C64XInstrInfo::Res_b[] = { "L2", "S2", "M2", "D2" };
 
+//-----------------------------------------------------------------------------
+// Spill helpers, these deal with physical registers and virtual ones (whose
+// RC is given) alike
+
+static bool isRegPair(unsigned reg, const TargetRegisterClass *RC) {
+  if (TargetRegisterInfo::isPhysicalRegister(reg))
+    return C64X::PairRegsRegClass.contains(reg);
+  return RC == C64X::PairRegsRegisterClass
+      || RC == C64X::APairRegsRegisterClass
+      || RC == C64X::BPairRegsRegisterClass;
+}
+
+static bool isBSidePair(unsigned reg, const TargetRegisterClass *RC) {
+  if (TargetRegisterInfo::isPhysicalRegister(reg))
+    return C64X::isBSideReg(reg);
+  return RC == C64X::BPairRegsRegisterClass;
+}
+
 //-----------------------------------------------------------------------------
 
 TMS320C64XInstrInfo::TMS320C64XInstrInfo()
@@ -120,6 +138,7 @@ TMS320C64XInstrInfo::TMS320C64XInstrInfo()
     ,{ C64X::srl_rr_1,       C64X::srl_rr_2 }
     ,{ C64X::srl_ri_1,       C64X::srl_ri_2 }
     ,{ C64X::neg_1,          C64X::neg_2 }
+    ,{ C64X::andn_rr_1,      C64X::andn_rr_2 }
 
     ,{ C64X::add_am_d_1,     C64X::add_am_d_2 }
     ,{ C64X::add_am_w_1,     C64X::add_am_w_2 }
@@ -132,6 +151,7 @@ TMS320C64XInstrInfo::TMS320C64XInstrInfo()
     ,{ C64X::mvkh_1,         C64X::mvkh_2 }
     ,{ C64X::mvkl_label_1,   C64X::mvkl_label_2 }
     ,{ C64X::mvkh_label_1,   C64X::mvkh_label_2 }
+    ,{ C64X::mvklh_1,        C64X::mvklh_2 }
 
     ,{ C64X::word_load_1,    C64X::word_load_2 }
     ,{ C64X::word_store_1,   C64X::word_store_2 }
@@ -142,8 +162,76 @@ TMS320C64XInstrInfo::TMS320C64XInstrInfo()
     ,{ C64X::byte_sload_1,   C64X::byte_sload_2 }
     ,{ C64X::byte_store_1,   C64X::byte_store_2 }
     ,{ C64X::ubyte_sload_1,  C64X::ubyte_sload_2 }
+    ,{ C64X::dword_load_1,   C64X::dword_load_2 }
+    ,{ C64X::dword_store_1,  C64X::dword_store_2 }
+    ,{ C64X::ndword_load_1,  C64X::ndword_load_2 }
+    ,{ C64X::ndword_store_1, C64X::ndword_store_2 }
+
+    // base modifying loads/stores
+    ,{ C64X::word_preload_1,    C64X::word_preload_2 }
+    ,{ C64X::word_postload_1,   C64X::word_postload_2 }
+    ,{ C64X::word_prestore_1,   C64X::word_prestore_2 }
+    ,{ C64X::word_poststore_1,  C64X::word_poststore_2 }
+    ,{ C64X::hword_preload_1,   C64X::hword_preload_2 }
+    ,{ C64X::hword_postload_1,  C64X::hword_postload_2 }
+    ,{ C64X::hword_prestore_1,  C64X::hword_prestore_2 }
+    ,{ C64X::hword_poststore_1, C64X::hword_poststore_2 }
+    ,{ C64X::uhword_preload_1,  C64X::uhword_preload_2 }
+    ,{ C64X::uhword_postload_1, C64X::uhword_postload_2 }
+    ,{ C64X::byte_preload_1,    C64X::byte_preload_2 }
+    ,{ C64X::byte_postload_1,   C64X::byte_postload_2 }
+    ,{ C64X::byte_prestore_1,   C64X::byte_prestore_2 }
+    ,{ C64X::byte_poststore_1,  C64X::byte_poststore_2 }
+    ,{ C64X::ubyte_preload_1,   C64X::ubyte_preload_2 }
+    ,{ C64X::ubyte_postload_1,  C64X::ubyte_postload_2 }
+
     ,{ C64X::ext_1,          C64X::ext_2 }
     ,{ C64X::ext_v_1,        C64X::ext_v_2 }
+    ,{ C64X::extu_1,         C64X::extu_2 }
+    ,{ C64X::extu_v_1,       C64X::extu_v_2 }
+
+    // packed SIMD
+    ,{ C64X::add2_1,         C64X::add2_2 }
+    ,{ C64X::sub2_1,         C64X::sub2_2 }
+    ,{ C64X::add4_1,         C64X::add4_2 }
+    ,{ C64X::sub4_1,         C64X::sub4_2 }
+    ,{ C64X::max2_1,         C64X::max2_2 }
+    ,{ C64X::min2_1,         C64X::min2_2 }
+    ,{ C64X::cmpgt2_1,       C64X::cmpgt2_2 }
+    ,{ C64X::cmpeq4_1,       C64X::cmpeq4_2 }
+    ,{ C64X::shr2_ri_1,      C64X::shr2_ri_2 }
+    ,{ C64X::shru2_ri_1,     C64X::shru2_ri_2 }
+    ,{ C64X::pack2_1,        C64X::pack2_2 }
+    ,{ C64X::packh2_1,       C64X::packh2_2 }
+    ,{ C64X::packhl2_1,      C64X::packhl2_2 }
+    ,{ C64X::packlh2_1,      C64X::packlh2_2 }
+    ,{ C64X::avgu4_1,        C64X::avgu4_2 }
+    ,{ C64X::dotp2_1,        C64X::dotp2_2 }
+    ,{ C64X::dotpu4_1,       C64X::dotpu4_2 }
+
+    // saturating arithmetic and bit operations
+    ,{ C64X::sadd_1,         C64X::sadd_2 }
+    ,{ C64X::ssub_1,         C64X::ssub_2 }
+    ,{ C64X::sshl_rr_1,      C64X::sshl_rr_2 }
+    ,{ C64X::sshl_ri_1,      C64X::sshl_ri_2 }
+    ,{ C64X::norm_1,         C64X::norm_2 }
+    ,{ C64X::lmbd_rr_1,      C64X::lmbd_rr_2 }
+    ,{ C64X::lmbd_ri_1,      C64X::lmbd_ri_2 }
+    ,{ C64X::sadd2_1,        C64X::sadd2_2 }
+    ,{ C64X::saddu4_1,       C64X::saddu4_2 }
+    ,{ C64X::smpy_1,         C64X::smpy_2 }
+    ,{ C64X::subc_1,         C64X::subc_2 }
+
+    // C674x single precision floating point
+    ,{ C64X::addsp_1,        C64X::addsp_2 }
+    ,{ C64X::subsp_1,        C64X::subsp_2 }
+    ,{ C64X::mpysp_1,        C64X::mpysp_2 }
+    ,{ C64X::cmpeqsp_1,      C64X::cmpeqsp_2 }
+    ,{ C64X::cmpgtsp_1,      C64X::cmpgtsp_2 }
+    ,{ C64X::cmpltsp_1,      C64X::cmpltsp_2 }
+    ,{ C64X::intsp_1,        C64X::intsp_2 }
+    ,{ C64X::intspu_1,       C64X::intspu_2 }
+    ,{ C64X::sptrunc_1,      C64X::sptrunc_2 }
   };
 
   for (unsigned i = 0, e = array_lengthof(SideOpTbl); i != e; ++i) {
@@ -182,7 +270,8 @@ TMS320C64XInstrInfo::CreatePostRAHazardRecognizer(const TargetMachine *TM)
   const TargetInstrInfo *TII = TM->getInstrInfo();
   assert(TII && "No InstrInfo? Can not create a hazard recognizer!");
 
-  return new TMS320C64XHazardRecognizer(*TII);
+  // the post RA scheduler fills the cycles bottom-up
+  return new TMS320C64XHazardRecognizer(*TII, true);
 }
 
 //-----------------------------------------------------------------------------
@@ -198,6 +287,23 @@ TMS320C64XInstrInfo::CreateFunctionalUnitScheduler(const TargetMachine *TM)
 
 //-----------------------------------------------------------------------------
 
+unsigned
+TMS320C64XInstrInfo::getDefLatency(const InstrItineraryData *ItinData,
+                                   const MachineInstr *MI,
+                                   unsigned Reg) const
+{
+  int DefIdx = MI->findRegisterDefOperandIdx(Reg, false, true, &RI);
+  if (DefIdx >= 0 && ItinData && !ItinData->isEmpty()) {
+    int Cycle = ItinData->getOperandCycle(MI->getDesc().getSchedClass(),
+                                          DefIdx);
+    if (Cycle >= 0)
+      return Cycle;
+  }
+  return getInstrLatency(ItinData, MI);
+}
+
+//-----------------------------------------------------------------------------
+
 bool TMS320C64XInstrInfo::getImmPredValue(const MachineInstr &MI) const {
 
   const int predIndex = MI.findFirstPredOperandIdx();
@@ -236,6 +342,17 @@ void TMS320C64XInstrInfo::copyPhysReg(MachineBasicBlock &MBB,
     return;
   }
 
+  // register pairs are copied by halves, pairs never overlap partially
+  if (TMS320C64X::PairRegsRegClass.contains(DestReg)
+      && TMS320C64X::PairRegsRegClass.contains(SrcReg))
+  {
+    copyPhysReg(MBB, I, DL, RI.getSubReg(DestReg, TMS320C64X::sub_lo),
+                RI.getSubReg(SrcReg, TMS320C64X::sub_lo), KillSrc);
+    copyPhysReg(MBB, I, DL, RI.getSubReg(DestReg, TMS320C64X::sub_hi),
+                RI.getSubReg(SrcReg, TMS320C64X::sub_hi), KillSrc);
+    return;
+  }
+
   llvm_unreachable("Can not copy physical registers!");
 }
 
@@ -286,9 +403,16 @@ TMS320C64XInstrInfo::storeRegToStackSlot(MachineBasicBlock &MBB,
 
   // the address is in A15, if the data is on B side, use T2
   bool xdata = (rc == TMS320C64X::BRegsRegisterClass);
+  unsigned opc = TMS320C64X::word_store_1;
+
+  // register pairs are spilled into a double word slot
+  if (isRegPair(srcReg, RC)) {
+    xdata = isBSidePair(srcReg, RC);
+    opc = TMS320C64X::dword_store_1;
+  }
 
   addFormOp(
-    addDefaultPred(BuildMI(MBB, MI, DL, get(TMS320C64X::word_store_1))
+    addDefaultPred(BuildMI(MBB, MI, DL, get(opc))
       .addReg(TMS320C64X::A15).addFrameIndex(frameIndex)
       .addReg(srcReg, getKillRegState(isKill))),
     TMS320C64XII::unit_d, xdata);
@@ -320,9 +444,16 @@ TMS320C64XInstrInfo::loadRegFromStackSlot(MachineBasicBlock &MBB,
 
   // the address is in A15, if the data is on B side, use T2
   bool xdata = (rc == TMS320C64X::BRegsRegisterClass);
+  unsigned opc = TMS320C64X::word_load_1;
+
+  // see above
+  if (isRegPair(dstReg, RC)) {
+    xdata = isBSidePair(dstReg, RC);
+    opc = TMS320C64X::dword_load_1;
+  }
 
   addFormOp(
-    addDefaultPred(BuildMI(MBB, MI, DL, get(TMS320C64X::word_load_1))
+    addDefaultPred(BuildMI(MBB, MI, DL, get(opc))
       .addReg(dstReg, RegState::Define)
       .addReg(TMS320C64X::A15).addFrameIndex(frameIndex)),
     TMS320C64XII::unit_d, xdata);
@@ -354,6 +485,12 @@ TMS320C64XInstrInfo::AnalyzeBranch(MachineBasicBlock &MBB,
   if (LastInstr->getOpcode() == TMS320C64X::BUNDLE_END)
     return true;
 
+  // bdec/bpos can not be expressed as a condition, leave such blocks alone
+  for (MachineBasicBlock::iterator T = MBB.getFirstTerminator();
+       T != MBB.end(); ++T)
+    if (isCounterBranch(T))
+      return true;
+
   if (!(LastInstr->getDesc().isBranch())) {
     if (LastInstr->getDesc().isBarrier())
       // block ends with a return (ret)
@@ -778,6 +915,204 @@ int TMS320C64XInstrInfo::getSide(const MachineInstr *MI) {
 
 //-----------------------------------------------------------------------------
 
+bool TMS320C64XInstrInfo::isBarrierBlock(const MachineBasicBlock *MBB) const {
+  for (MachineBasicBlock::const_iterator I = MBB->begin(), E = MBB->end();
+       I != E; ++I)
+    // the marker of a scheduled block follows any branch, taken or not
+    if (I->getDesc().isBarrier() && !isPredicated(I) &&
+        I->getOpcode() != TMS320C64X::BR_OCCURS)
+      return true;
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+
+bool
+TMS320C64XInstrInfo::findBranchTargetPos(MachineFunction::iterator From,
+                                         MachineFunction::iterator &Pos) const
+{
+  MachineFunction::iterator E = From->getParent()->end();
+  for (MachineFunction::iterator I = From; I != E; ++I)
+    if (isBarrierBlock(I)) {
+      Pos = llvm::next(I);
+      return true;
+    }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+
+bool TMS320C64XInstrInfo::isCounterBranch(const MachineInstr *MI) {
+  switch (MI->getOpcode()) {
+    case TMS320C64X::bdec_1:
+    case TMS320C64X::bdec_2:
+    case TMS320C64X::bpos_1:
+    case TMS320C64X::bpos_2:
+      return true;
+    default:
+      return false;
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+/// returns the definition of a virtual register, or 0 if the register is
+/// defined more than once (predicated copies of the if-conversion)
+static MachineInstr *getUniqueVRegDef(const MachineRegisterInfo &MRI,
+                                      unsigned Reg) {
+  if (!TargetRegisterInfo::isVirtualRegister(Reg))
+    return 0;
+
+  MachineRegisterInfo::def_iterator I = MRI.def_begin(Reg);
+  if (I == MRI.def_end() || llvm::next(I) != MRI.def_end())
+    return 0;
+  return &*I;
+}
+
+//-----------------------------------------------------------------------------
+
+/// reads a compare operand, copies are looked through and mvk constants are
+/// returned as immediates (Reg = 0)
+static bool getCompareOperand(const TMS320C64XInstrInfo &TII,
+                              const MachineRegisterInfo &MRI,
+                              const MachineOperand &MO,
+                              unsigned &Reg,
+                              int64_t &Imm) {
+  Imm = 0;
+  Reg = 0;
+
+  if (MO.isImm()) {
+    Imm = MO.getImm();
+    return true;
+  }
+  if (!MO.isReg() || !TargetRegisterInfo::isVirtualRegister(MO.getReg()))
+    return false;
+
+  Reg = MO.getReg();
+  while (MachineInstr *Def = getUniqueVRegDef(MRI, Reg)) {
+    if (TII.isPredicated(Def))
+      break;
+
+    if (Def->isCopy()
+        && TargetRegisterInfo::isVirtualRegister(Def->getOperand(1).getReg())) {
+      Reg = Def->getOperand(1).getReg();
+      continue;
+    }
+
+    if ((Def->getOpcode() == TMS320C64X::mvk_1
+         || Def->getOpcode() == TMS320C64X::mvk_2)
+        && Def->getOperand(1).isImm()) {
+      Imm = Def->getOperand(1).getImm();
+      Reg = 0;
+    }
+    break;
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool TMS320C64XInstrInfo::analyzePredicate(const MachineRegisterInfo &MRI,
+                                           unsigned Reg,
+                                           PredicateCondition &Cond) const
+{
+  bool Inverted = false;
+  MachineInstr *Def;
+
+  // a compare yields 0 or 1, so xor 1 on the way inverts the condition
+  for (;;) {
+    Def = getUniqueVRegDef(MRI, Reg);
+    if (!Def || isPredicated(Def))
+      return false;
+
+    if (Def->isCopy())
+      Reg = Def->getOperand(1).getReg();
+    else if (Def->getOpcode() == TMS320C64X::xor_p_ri
+             && Def->getOperand(2).isImm()
+             && Def->getOperand(2).getImm() == 1) {
+      Reg = Def->getOperand(1).getReg();
+      Inverted = !Inverted;
+    }
+    else break;
+  }
+
+  switch (Def->getOpcode()) {
+    case TMS320C64X::cmpeq_p_rr:
+    case TMS320C64X::cmpeq_p_ri:
+    case TMS320C64X::cmpgt_p_rr:
+    case TMS320C64X::cmpgtu_p_rr:
+    case TMS320C64X::cmplt_p_rr:
+    case TMS320C64X::cmpltu_p_rr:
+      break;
+    default:
+      return false;
+  }
+
+  unsigned LHS, RHS;
+  int64_t LHSImm, RHSImm;
+  if (!getCompareOperand(*this, MRI, Def->getOperand(1), LHS, LHSImm)
+      || !getCompareOperand(*this, MRI, Def->getOperand(2), RHS, RHSImm)
+      || (!LHS && !RHS))
+    return false;
+
+  // x < y is y > x, equality is kept with the constant (or the higher
+  // register) on the right
+  unsigned Opcode = Def->getOpcode();
+  switch (Opcode) {
+    case TMS320C64X::cmpeq_p_rr:
+    case TMS320C64X::cmpeq_p_ri:
+      Opcode = TMS320C64X::cmpeq_p_rr;
+      if (!LHS || (RHS && RHS < LHS)) {
+        std::swap(LHS, RHS);
+        std::swap(LHSImm, RHSImm);
+      }
+      break;
+    case TMS320C64X::cmplt_p_rr:
+      std::swap(LHS, RHS);
+      std::swap(LHSImm, RHSImm);
+      // fall through
+    case TMS320C64X::cmpgt_p_rr:
+      Opcode = TMS320C64X::cmpgt_p_rr;
+      break;
+    case TMS320C64X::cmpltu_p_rr:
+      std::swap(LHS, RHS);
+      std::swap(LHSImm, RHSImm);
+      // fall through
+    case TMS320C64X::cmpgtu_p_rr:
+      Opcode = TMS320C64X::cmpgtu_p_rr;
+      break;
+    default:
+      llvm_unreachable("Not a compare!");
+  }
+
+  const bool isUnsigned = Opcode == TMS320C64X::cmpgtu_p_rr;
+  if (!LHS) {
+    // c > x is the inverse of x > c - 1
+    int64_t C = isUnsigned ? (int64_t) (uint32_t) LHSImm
+                           : (int64_t) (int32_t) LHSImm;
+    if (C == (isUnsigned ? 0 : (int64_t) INT32_MIN))
+      return false;
+
+    LHS = RHS;
+    RHS = 0;
+    RHSImm = C - 1;
+    Inverted = !Inverted;
+  }
+  else if (!RHS)
+    RHSImm = isUnsigned ? (int64_t) (uint32_t) RHSImm
+                        : (int64_t) (int32_t) RHSImm;
+
+  Cond.Opcode = Opcode;
+  Cond.LHS = LHS;
+  Cond.RHS = RHS;
+  Cond.RHSImm = RHSImm;
+  Cond.Inverted = Inverted;
+  Cond.CompareReg = Def->getOperand(0).getReg();
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
 const MachineInstrBuilder &
 TMS320C64XInstrInfo::addDefaultPred(const MachineInstrBuilder &MIB) {
   return MIB.addImm(-1).addReg(TMS320C64X::NoRegister);
@@ -933,4 +1268,8 @@ TMS320C64XInstrInfo::dumpFlags(const TargetInstrDesc &Desc, raw_ostream &os) {
     << ((flags & mem_align_amt_mask) >> mem_align_amt_shift) << "\n";
   os << "Flag[MemLoadStore] = " << ((flags & is_store) ? "Store" : "Load")
     << "\n";
+  os << "Flag[MemWriteBack] = " << PRETTY(flags & is_memwriteback) << "\n";
+  os << "Flag[MemPreModify] = " << PRETTY(flags & is_premodify) << "\n";
+  os << "Flag[MemCircular] = " << PRETTY(flags & is_memcircular) << "\n";
+  os << "Flag[UnitBusy] = " << GET_UNIT_BUSY(flags) << "\n";
 }
@@ -51,7 +51,11 @@ enum {
   mem_align_amt_shift = 9,
   fixed_unit_mask = 0x3000,
   fixed_unit_shift = 12,
-  is_side_inst = 0x4000
+  is_side_inst = 0x4000,
+  is_memwriteback = 0x8000,
+  is_premodify = 0x10000,
+  is_memcircular = 0x20000,
+  unit_busy_shift = 19
 };
 
 // unit support value that signifies: instruction is fixed
@@ -64,7 +68,26 @@ enum {
 // get the cluster side of an instructions, works for all instructions
 #define IS_BSIDE(x) ((x) & TMS320C64XII::is_bside)
 // get number of delay slots, also for all instructions
-#define GET_DELAY_SLOTS(x) (((x) >> 5) & 0x7)
+#define GET_DELAY_SLOTS(x) ((((x) >> 5) & 0x7) | (((x) >> 15) & 0x8))
+// get the number of cycles the unit stays busy after the issue cycle
+#define GET_UNIT_BUSY(x) (((x) >> TMS320C64XII::unit_busy_shift) & 0x3)
+
+// operand layout of memory accesses, loads: dst, base, offset and stores:
+// base, offset, data. Accesses modifying their base define the new base after
+// the loaded value (if any)
+inline unsigned getMemBaseIdx(uint64_t flags) {
+  return ((flags & is_store) ? 0 : 1) + ((flags & is_memwriteback) ? 1 : 0);
+}
+
+inline unsigned getMemDataIdx(uint64_t flags) {
+  return (flags & is_store) ? getMemBaseIdx(flags) + 2 : 0;
+}
+
+// circular accesses carry the log2 of their buffer size behind the offset
+// (loads) or the stored data (stores)
+inline unsigned getMemBlockIdx(uint64_t flags) {
+  return getMemBaseIdx(flags) + ((flags & is_store) ? 3 : 2);
+}
 
 // bit 0 xflag
 // bits 1..2 unit number
@@ -89,8 +112,36 @@ enum Sides {
   ASide = 0,
   BSide = 1
 };
+
+// flags carried by the trailing immediate operand of lowered MCInsts
+enum MCInstFlags {
+  mc_parallel = 0x1, // executes in parallel with the next instruction (p-bit)
+  mc_compact = 0x2   // 16-bit encoding within a header based fetch packet
+};
 } // namespace TMS320C64XII
 
+// the condition held by a predicate register. Compares are normalized, so that
+// equivalent conditions have the same key (opcode and operands) and inverse
+// conditions have the same key with the opposite 'Inverted' flag. The right
+// hand side is a register or (RHS == 0) a constant
+struct PredicateCondition {
+  unsigned Opcode;
+  unsigned LHS;
+  unsigned RHS;
+  int64_t RHSImm;
+  bool Inverted;
+
+  // the register defined by the compare the condition was found at
+  unsigned CompareReg;
+
+  bool operator<(const PredicateCondition &C) const {
+    if (Opcode != C.Opcode) return Opcode < C.Opcode;
+    if (LHS != C.LHS) return LHS < C.LHS;
+    if (RHS != C.RHS) return RHS < C.RHS;
+    return RHSImm < C.RHSImm;
+  }
+};
+
 class TMS320C64XInstrInfo : public TargetInstrInfoImpl {
 public:
   typedef SmallVector<const char *, 4> UnitStrings_t;
@@ -131,6 +182,12 @@ public:
     static TMS320C64X::ResourceAssignment*
     CreateFunctionalUnitScheduler(const TargetMachine *TM);
 
+    // returns the cycles until MI has written Reg (or a register overlapping
+    // it), ie. the operand cycle of the def in the itinerary of MI. Falls back
+    // to the latency of the whole instruction
+    unsigned getDefLatency(const InstrItineraryData *ItinData,
+                           const MachineInstr *MI, unsigned Reg) const;
+
     virtual void copyPhysReg(MachineBasicBlock &MBB,
                              MachineBasicBlock::iterator I,
                              DebugLoc DL,
@@ -204,6 +261,24 @@ public:
     // returns cluster side for MI (ASide = 0, BSide = 1)
     static int getSide(const MachineInstr *MI);
 
+    // returns true for bdec/bpos, the branches testing a loop counter
+    static bool isCounterBranch(const MachineInstr *MI);
+
+    // returns true if MBB never falls through into its layout successor, ie.
+    // it holds an unpredicated branch or return
+    bool isBarrierBlock(const MachineBasicBlock *MBB) const;
+
+    // finds a layout position at or after From where a block reached only by
+    // branches can be inserted without becoming a fallthrough target, that is
+    // behind the first barrier block. Returns false if there is none
+    bool findBranchTargetPos(MachineFunction::iterator From,
+                             MachineFunction::iterator &Pos) const;
+
+    // looks through copies and inversions (xor 1) of the virtual register
+    // Reg for the compare computing it, returns false if there is none
+    bool analyzePredicate(const MachineRegisterInfo &MRI, unsigned Reg,
+                          PredicateCondition &Cond) const;
+
     // defunct. was used with pseudo opcodes.
     virtual bool PredicateInstruction(MachineInstr *MI,
                            const SmallVectorImpl<MachineOperand> &pred) const;
@@ -30,6 +30,7 @@
 
 #include "llvm/DerivedTypes.h"
 #include "llvm/Function.h"
+#include "llvm/Instructions.h"
 #include "llvm/Intrinsics.h"
 #include "llvm/CallingConv.h"
 #include "llvm/GlobalVariable.h"
@@ -51,6 +52,7 @@
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/MC/MCSymbol.h"
+#include "llvm/Target/TargetData.h"
 
 using namespace llvm;
 
@@ -263,10 +265,11 @@ TMS320C64XLowering::TMS320C64XLowering(TargetMachine &tm)
   setLibcallCustom(RTLIB::SDIV_I64, "divlli");
   setLibcallCustom(RTLIB::UDIV_I64, "divull");
 
-  // signed/unsigned long long shifting stuff
-  setLibcallCustom(RTLIB::SHL_I64, "llshl");
-  setLibcallCustom(RTLIB::SRA_I64, "llshr");
-  setLibcallCustom(RTLIB::SRL_I64, "llshru");
+  // long long shifts are expanded inline into a handful of 32 bit shifts
+  // and selects, which is cheaper than calling llshl/llshr/llshru
+  setLibcallName(RTLIB::SHL_I64, 0);
+  setLibcallName(RTLIB::SRA_I64, 0);
+  setLibcallName(RTLIB::SRL_I64, 0);
 
   // We can generate two conditional instructions for select, not so
   // easy for select_cc
@@ -280,18 +283,35 @@ TMS320C64XLowering::TMS320C64XLowering(TargetMachine &tm)
   setOperationAction(ISD::BRCOND, MVT::Other, Expand);
   setOperationAction(ISD::BRCOND, MVT::i32, Expand);
   setOperationAction(ISD::BR_CC, MVT::i32, Custom);
+
+  // Jump tables expand to an entry load (selected as ldw *table[index]) and
+  // an indirect branch, see JumpTableDispatch.cpp. Every level of a compare
+  // tree, and each bit test, costs a taken branch with five delay slots,
+  // whereas a table dispatches with two. So use them for sparse ranges too,
+  // and in favour of bit tests
   setOperationAction(ISD::BR_JT, MVT::Other, Expand);
+  setMinimumJumpTableDensity(10);
+  setPreferJumpTablesToBitTests();
 
   // Probably is a membarrier, but I'm not aware of it right now
   setOperationAction(ISD::MEMBARRIER, MVT::Other, Expand);
 
+  // mpy32/mpy32u deliver the full 64 bit product to a register pair. The
+  // high word multiplies are expanded to these, which also makes divisions
+  // by constants cheap multiplications by their reciprocal
+  setOperationAction(ISD::MULHS, MVT::i32, Expand);
+  setOperationAction(ISD::MULHU, MVT::i32, Expand);
+  if (ST->hasMPY32()) {
+    setOperationAction(ISD::SMUL_LOHI, MVT::i32, Legal);
+    setOperationAction(ISD::UMUL_LOHI, MVT::i32, Legal);
+  } else {
+    setOperationAction(ISD::SMUL_LOHI, MVT::i32, Expand);
+    setOperationAction(ISD::UMUL_LOHI, MVT::i32, Expand);
+  }
+
   // Should also inject other invalid operations here
   // The following might be supported, but I can't be bothered or don't
   // have enough time to work on
-  setOperationAction(ISD::MULHS, MVT::i32, Expand);
-  setOperationAction(ISD::MULHU, MVT::i32, Expand);
-  setOperationAction(ISD::SMUL_LOHI, MVT::i32, Expand);
-  setOperationAction(ISD::UMUL_LOHI, MVT::i32, Expand);
   setOperationAction(ISD::SHL_PARTS, MVT::i32, Expand);
   setOperationAction(ISD::SRA_PARTS, MVT::i32, Expand);
   setOperationAction(ISD::SRL_PARTS, MVT::i32, Expand);
@@ -304,6 +324,13 @@ TMS320C64XLowering::TMS320C64XLowering(TargetMachine &tm)
   setOperationAction(ISD::ADDE, MVT::i32, Expand);
   setOperationAction(ISD::SUBE, MVT::i32, Expand);
 
+  // i64 is no legal type, but plain loads/stores are done on register pairs
+  // using (non-aligned) double word accesses. Additions use the carry that
+  // is delivered by the 40 bit addu
+  setOperationAction(ISD::LOAD, MVT::i64, Custom);
+  setOperationAction(ISD::STORE, MVT::i64, Custom);
+  setOperationAction(ISD::ADD, MVT::i64, Custom);
+
   // counting leading zeros is natively possible
   setOperationAction(ISD::CTLZ, MVT::i32, Legal);
   setOperationAction(ISD::CTLZ, MVT::i16, Legal);
@@ -318,6 +345,122 @@ TMS320C64XLowering::TMS320C64XLowering(TargetMachine &tm)
   setOperationAction(ISD::VAEND, MVT::Other, Expand);
 
   setOperationAction(ISD::INTRINSIC_W_CHAIN, MVT::Other, Custom);
+  setOperationAction(ISD::INTRINSIC_VOID, MVT::Other, Custom);
+  setOperationAction(ISD::INTRINSIC_WO_CHAIN, MVT::Other, Custom);
+
+  // Packed SIMD values. Both vector types live in the ordinary registers,
+  // loads, stores and bitwise operations are therefore done on the word.
+  addRegisterClass(MVT::v4i8, TMS320C64X::VectorRegsRegisterClass);
+  addRegisterClass(MVT::v2i16, TMS320C64X::VectorRegsRegisterClass);
+
+  static const MVT::SimpleValueType PackedVTs[] = { MVT::v4i8, MVT::v2i16 };
+
+  for (unsigned i = 0; i < array_lengthof(PackedVTs); ++i) {
+    MVT::SimpleValueType VT = PackedVTs[i];
+
+    setOperationAction(ISD::LOAD, VT, Promote);
+    AddPromotedToType(ISD::LOAD, VT, MVT::i32);
+    setOperationAction(ISD::STORE, VT, Promote);
+    AddPromotedToType(ISD::STORE, VT, MVT::i32);
+
+    setOperationAction(ISD::AND, VT, Promote);
+    AddPromotedToType(ISD::AND, VT, MVT::i32);
+    setOperationAction(ISD::OR, VT, Promote);
+    AddPromotedToType(ISD::OR, VT, MVT::i32);
+    setOperationAction(ISD::XOR, VT, Promote);
+    AddPromotedToType(ISD::XOR, VT, MVT::i32);
+    setOperationAction(ISD::SELECT, VT, Promote);
+    AddPromotedToType(ISD::SELECT, VT, MVT::i32);
+
+    // add2/sub2 and add4/sub4
+    setOperationAction(ISD::ADD, VT, Legal);
+    setOperationAction(ISD::SUB, VT, Legal);
+
+    setOperationAction(ISD::BUILD_VECTOR, VT, Custom);
+    setOperationAction(ISD::EXTRACT_VECTOR_ELT, VT, Custom);
+
+    // everything else is done element-wise
+    setOperationAction(ISD::MUL, VT, Expand);
+    setOperationAction(ISD::SDIV, VT, Expand);
+    setOperationAction(ISD::UDIV, VT, Expand);
+    setOperationAction(ISD::SREM, VT, Expand);
+    setOperationAction(ISD::UREM, VT, Expand);
+    setOperationAction(ISD::SDIVREM, VT, Expand);
+    setOperationAction(ISD::UDIVREM, VT, Expand);
+    setOperationAction(ISD::MULHS, VT, Expand);
+    setOperationAction(ISD::MULHU, VT, Expand);
+    setOperationAction(ISD::SMUL_LOHI, VT, Expand);
+    setOperationAction(ISD::UMUL_LOHI, VT, Expand);
+    setOperationAction(ISD::SHL, VT, Expand);
+    setOperationAction(ISD::SRA, VT, Expand);
+    setOperationAction(ISD::SRL, VT, Expand);
+    setOperationAction(ISD::ROTL, VT, Expand);
+    setOperationAction(ISD::ROTR, VT, Expand);
+    setOperationAction(ISD::CTPOP, VT, Expand);
+    setOperationAction(ISD::CTTZ, VT, Expand);
+    setOperationAction(ISD::CTLZ, VT, Expand);
+    setOperationAction(ISD::SETCC, VT, Expand);
+    setOperationAction(ISD::VSETCC, VT, Expand);
+    setOperationAction(ISD::SELECT_CC, VT, Expand);
+    setOperationAction(ISD::SIGN_EXTEND_INREG, VT, Expand);
+    setOperationAction(ISD::TRUNCATE, VT, Expand);
+    setOperationAction(ISD::SIGN_EXTEND, VT, Expand);
+    setOperationAction(ISD::ZERO_EXTEND, VT, Expand);
+    setOperationAction(ISD::ANY_EXTEND, VT, Expand);
+    setOperationAction(ISD::SINT_TO_FP, VT, Expand);
+    setOperationAction(ISD::UINT_TO_FP, VT, Expand);
+    setOperationAction(ISD::FP_TO_SINT, VT, Expand);
+    setOperationAction(ISD::FP_TO_UINT, VT, Expand);
+    setOperationAction(ISD::VECTOR_SHUFFLE, VT, Expand);
+    setOperationAction(ISD::INSERT_VECTOR_ELT, VT, Expand);
+    setOperationAction(ISD::SCALAR_TO_VECTOR, VT, Expand);
+    setOperationAction(ISD::EXTRACT_SUBVECTOR, VT, Expand);
+    setOperationAction(ISD::INSERT_SUBVECTOR, VT, Expand);
+  }
+
+  // loads and stores can modify their base register by a constant number of
+  // elements, either before or after the access
+  static const MVT::SimpleValueType IndexedVTs[] = {
+    MVT::i8, MVT::i16, MVT::i32
+  };
+
+  for (unsigned i = 0; i < array_lengthof(IndexedVTs); ++i) {
+    MVT::SimpleValueType VT = IndexedVTs[i];
+    setIndexedLoadAction(ISD::PRE_INC, VT, Legal);
+    setIndexedLoadAction(ISD::PRE_DEC, VT, Legal);
+    setIndexedLoadAction(ISD::POST_INC, VT, Legal);
+    setIndexedLoadAction(ISD::POST_DEC, VT, Legal);
+    setIndexedStoreAction(ISD::PRE_INC, VT, Legal);
+    setIndexedStoreAction(ISD::PRE_DEC, VT, Legal);
+    setIndexedStoreAction(ISD::POST_INC, VT, Legal);
+    setIndexedStoreAction(ISD::POST_DEC, VT, Legal);
+  }
+
+  // halfword moves can do any v2i16 shuffle, shr2/shru2 do splat shifts
+  setOperationAction(ISD::VECTOR_SHUFFLE, MVT::v2i16, Custom);
+  setOperationAction(ISD::SRA, MVT::v2i16, Custom);
+  setOperationAction(ISD::SRL, MVT::v2i16, Custom);
+
+  // saturating arithmetic is recognized from clamps of wider results
+  setTargetDAGCombine(ISD::SELECT);
+  setTargetDAGCombine(ISD::SELECT_CC);
+  setTargetDAGCombine(ISD::TRUNCATE);
+
+  // the C674x floating point instructions replace the run time library calls
+  // before the float types are softened to integers
+  if (ST->hasFP()) {
+    setTargetDAGCombine(ISD::FADD);
+    setTargetDAGCombine(ISD::FSUB);
+    setTargetDAGCombine(ISD::FMUL);
+    setTargetDAGCombine(ISD::SETCC);
+    setTargetDAGCombine(ISD::BR_CC);
+    setTargetDAGCombine(ISD::FP_TO_SINT);
+    setTargetDAGCombine(ISD::FP_TO_UINT);
+    setTargetDAGCombine(ISD::SINT_TO_FP);
+    setTargetDAGCombine(ISD::UINT_TO_FP);
+    setTargetDAGCombine(ISD::FP_EXTEND);
+    setTargetDAGCombine(ISD::FP_ROUND);
+  }
 
   setStackPointerRegisterToSaveRestore(TMS320C64X::A15);
   computeRegisterProperties();
@@ -331,6 +474,16 @@ TMS320C64XLowering::~TMS320C64XLowering() {}
 //-----------------------------------------------------------------------------
 
 TargetRegisterClass *TMS320C64XLowering::getRegClassFor(EVT VT) const {
+  // packed values, the allocation order restricts them to side A as well
+  // when no cluster assignment is done
+  if (VT.isVector())
+    return TMS320C64X::VectorRegsRegisterClass;
+
+  // register pairs, these only appear when selecting 64 bit nodes. Same as
+  // the pair load/store operands, so that the pairs coalesce
+  if (VT == MVT::i64)
+    return TMS320C64X::PairRegsRegisterClass;
+
   // depends whether we do cluster assignment or not
   if (ST->enableClusterAssignment())
     return TMS320C64X::GPRegsRegisterClass;
@@ -341,6 +494,18 @@ TargetRegisterClass *TMS320C64XLowering::getRegClassFor(EVT VT) const {
 
 //-----------------------------------------------------------------------------
 
+/// findRepresentativeClass - i64 is not a legal type, but register pairs do
+/// appear in loops (eg. the results of mpy32) and the register pressure
+/// tracking of MachineLICM needs a class for them. A pair costs two words.
+std::pair<const TargetRegisterClass*, uint8_t>
+TMS320C64XLowering::findRepresentativeClass(EVT VT) const {
+  if (VT == MVT::i64)
+    return std::make_pair(TMS320C64X::GPRegsRegisterClass, 2);
+  return TargetLowering::findRepresentativeClass(VT);
+}
+
+//-----------------------------------------------------------------------------
+
 const char *TMS320C64XLowering::getTargetNodeName(unsigned op) const {
   switch (op) {
     default: return NULL;
@@ -383,8 +548,104 @@ const char *TMS320C64XLowering::getTargetNodeName(unsigned op) const {
     case TMSISD::TSC_START:
       return "TMSISD::TSC_START";
 
-    case TMSISD::TSC_END:
-      return "TMSISD::TSC_END";
+    case TMSISD::TSC_READ:
+      return "TMSISD::TSC_READ";
+
+    case TMSISD::ADDU:
+      return "TMSISD::ADDU";
+
+    case TMSISD::MPY2:
+      return "TMSISD::MPY2";
+
+    case TMSISD::ADDSP:
+      return "TMSISD::ADDSP";
+
+    case TMSISD::SUBSP:
+      return "TMSISD::SUBSP";
+
+    case TMSISD::MPYSP:
+      return "TMSISD::MPYSP";
+
+    case TMSISD::CMPEQSP:
+      return "TMSISD::CMPEQSP";
+
+    case TMSISD::CMPGTSP:
+      return "TMSISD::CMPGTSP";
+
+    case TMSISD::CMPLTSP:
+      return "TMSISD::CMPLTSP";
+
+    case TMSISD::INTSP:
+      return "TMSISD::INTSP";
+
+    case TMSISD::INTSPU:
+      return "TMSISD::INTSPU";
+
+    case TMSISD::SPTRUNC:
+      return "TMSISD::SPTRUNC";
+
+    case TMSISD::ADDDP:
+      return "TMSISD::ADDDP";
+
+    case TMSISD::SUBDP:
+      return "TMSISD::SUBDP";
+
+    case TMSISD::MPYDP:
+      return "TMSISD::MPYDP";
+
+    case TMSISD::CMPEQDP:
+      return "TMSISD::CMPEQDP";
+
+    case TMSISD::CMPGTDP:
+      return "TMSISD::CMPGTDP";
+
+    case TMSISD::CMPLTDP:
+      return "TMSISD::CMPLTDP";
+
+    case TMSISD::INTDP:
+      return "TMSISD::INTDP";
+
+    case TMSISD::INTDPU:
+      return "TMSISD::INTDPU";
+
+    case TMSISD::SPDP:
+      return "TMSISD::SPDP";
+
+    case TMSISD::DPSP:
+      return "TMSISD::DPSP";
+
+    case TMSISD::DPTRUNC:
+      return "TMSISD::DPTRUNC";
+
+    case TMSISD::LDDW:
+      return "TMSISD::LDDW";
+
+    case TMSISD::LDNDW:
+      return "TMSISD::LDNDW";
+
+    case TMSISD::STDW:
+      return "TMSISD::STDW";
+
+    case TMSISD::STNDW:
+      return "TMSISD::STNDW";
+
+    case TMSISD::PACK2:
+      return "TMSISD::PACK2";
+
+    case TMSISD::PACKH2:
+      return "TMSISD::PACKH2";
+
+    case TMSISD::PACKHL2:
+      return "TMSISD::PACKHL2";
+
+    case TMSISD::PACKLH2:
+      return "TMSISD::PACKLH2";
+
+    case TMSISD::SHR2:
+      return "TMSISD::SHR2";
+
+    case TMSISD::SHRU2:
+      return "TMSISD::SHRU2";
   }
 }
 
@@ -445,6 +706,8 @@ TMS320C64XLowering::LowerFormalArguments(SDValue Chain,
       case MVT::i8:
       case MVT::i16:
       case MVT::i32:
+      case MVT::v4i8:
+      case MVT::v2i16:
         if (!Ins[i].Used && (!isVarArg || i != last_fixed_arg)) {
           if (arg_idx < 10)
             arg_idx++;
@@ -461,7 +724,9 @@ TMS320C64XLowering::LowerFormalArguments(SDValue Chain,
           MF.getRegInfo().addLiveIn(arg_reg, reg);
           SDValue Arg = DAG.getCopyFromReg(Chain, dl, reg, MVT::i32);
 
-          if (ObjectVT != MVT::i32) {
+          if (ObjectVT.isVector())
+            Arg = DAG.getNode(ISD::BITCAST, dl, ObjectVT, Arg);
+          else if (ObjectVT != MVT::i32) {
             Arg = DAG.getNode(
               ISD::AssertSext, dl, MVT::i32, Arg, DAG.getValueType(ObjectVT));
 
@@ -480,10 +745,14 @@ TMS320C64XLowering::LowerFormalArguments(SDValue Chain,
 
           MachinePointerInfo MPI;
 
-          if (ObjectVT == MVT::i32) {
+          if (ObjectVT == MVT::i32 || ObjectVT.isVector()) {
             // XXX - Non temporal? Eh?
             load = DAG.getLoad(
               MVT::i32, dl, Chain, FIPtr, MPI, false, false, 4);
+
+            // packed vectors occupy a full word on the stack
+            if (ObjectVT.isVector())
+              load = DAG.getNode(ISD::BITCAST, dl, ObjectVT, load);
           }
           else {
             // XXX - work out alignment
@@ -614,6 +883,9 @@ SDValue TMS320C64XLowering::LowerCall(SDValue Chain,
       case CCValAssign::AExt:
         arg = DAG.getNode(ISD::ANY_EXTEND, dl,  va.getLocVT(), arg);
         break;
+      case CCValAssign::BCvt:
+        arg = DAG.getNode(ISD::BITCAST, dl, va.getLocVT(), arg);
+        break;
     }
 
     if (arg_idx < 10 && (!isVarArg || i < fixed_args - 1)) {
@@ -795,6 +1067,9 @@ TMS320C64XLowering::LowerOperation(SDValue op,  SelectionDAG &DAG) const {
     // We only ever get custom loads when it's an extload
     case ISD::LOAD:
       return LowerExtLoad(op, DAG);
+    // ...and custom stores when storing register pairs
+    case ISD::STORE:
+      return LowerStore(op, DAG);
     case ISD::SELECT:
       return LowerSelect(op, DAG);
     case ISD::VASTART:
@@ -802,7 +1077,19 @@ TMS320C64XLowering::LowerOperation(SDValue op,  SelectionDAG &DAG) const {
     case ISD::VAARG:
       return LowerVAARG(op, DAG);
     case ISD::INTRINSIC_W_CHAIN:
+    case ISD::INTRINSIC_VOID:
       return LowerIntrinsic(op, DAG);
+    case ISD::INTRINSIC_WO_CHAIN:
+      return LowerPureIntrinsic(op, DAG);
+    case ISD::BUILD_VECTOR:
+      return LowerBuildVector(op, DAG);
+    case ISD::VECTOR_SHUFFLE:
+      return LowerVectorShuffle(op, DAG);
+    case ISD::EXTRACT_VECTOR_ELT:
+      return LowerExtractElement(op, DAG);
+    case ISD::SRA:
+    case ISD::SRL:
+      return LowerVectorShift(op, DAG);
     default:
       llvm_unreachable(op.getNode()->getOperationName().c_str());
   }
@@ -812,6 +1099,112 @@ TMS320C64XLowering::LowerOperation(SDValue op,  SelectionDAG &DAG) const {
 
 //-----------------------------------------------------------------------------
 
+/// isLegalAddressingMode - Loads and stores add either a ucst5 or an offset
+/// register to the base, both are scaled by the access width. Telling loop
+/// strength reduction keeps it from sharing an induction variable among
+/// streams by means of scaled indices, the pointers of the streams are then
+/// combined into base modifying accesses.
+bool TMS320C64XLowering::isLegalAddressingMode(const AddrMode &AM,
+                                               const Type *Ty) const {
+  if (!Ty || !Ty->isSized())
+    return TargetLowering::isLegalAddressingMode(AM, Ty);
+
+  if (AM.BaseGV)
+    return false;
+
+  int64_t Size = getTargetData()->getTypeStoreSize(Ty);
+  if (AM.BaseOffs) {
+    if (AM.Scale || AM.BaseOffs % Size)
+      return false;
+    return AM.BaseOffs / Size <= 31 && AM.BaseOffs / Size >= -31;
+  }
+
+  // an index register is selected unscaled and shifted down in front of the
+  // access (see select_addr), that only comes for free with bytes
+  return AM.Scale == 0 || (AM.Scale == 1 && (Size == 1 || !AM.HasBaseReg));
+}
+
+//-----------------------------------------------------------------------------
+
+/// getIndexedAddressParts - Returns true if Op adds a constant to the base
+/// that the access N can apply to the base register itself. The offset is
+/// scaled by the access width and limited to ucst5 (*++R[n], *R--[n], ...).
+static bool getIndexedAddressParts(SDNode *N, SDNode *Op, SDValue &Base,
+                                   SDValue &Offset, bool &IsInc,
+                                   SelectionDAG &DAG) {
+  EVT VT;
+  unsigned Align;
+  if (LoadSDNode *LD = dyn_cast<LoadSDNode>(N)) {
+    // any-extending loads are lowered to sign-extending ones later on, and
+    // combined then
+    if (LD->getExtensionType() == ISD::EXTLOAD)
+      return false;
+    VT = LD->getMemoryVT();
+    Align = LD->getAlignment();
+  } else if (StoreSDNode *ST = dyn_cast<StoreSDNode>(N)) {
+    VT = ST->getMemoryVT();
+    Align = ST->getAlignment();
+  } else
+    return false;
+
+  if (VT != MVT::i8 && VT != MVT::i16 && VT != MVT::i32)
+    return false;
+
+  int64_t Size = VT.getStoreSize();
+  if (Align < Size)
+    return false;
+
+  if (Op->getOpcode() != ISD::ADD && Op->getOpcode() != ISD::SUB)
+    return false;
+
+  ConstantSDNode *CN = dyn_cast<ConstantSDNode>(Op->getOperand(1));
+  if (!CN || isa<FrameIndexSDNode>(Op->getOperand(0)))
+    return false;
+
+  int64_t Val = CN->getSExtValue();
+  if (Op->getOpcode() == ISD::SUB)
+    Val = -Val;
+
+  if (!Val || Val % Size || Val / Size > 31 || Val / Size < -31)
+    return false;
+
+  Base = Op->getOperand(0);
+  Offset = DAG.getConstant(Val < 0 ? -Val : Val, MVT::i32);
+  IsInc = Val > 0;
+  return true;
+}
+
+bool TMS320C64XLowering::getPreIndexedAddressParts(SDNode *N, SDValue &Base,
+                                                   SDValue &Offset,
+                                                   ISD::MemIndexedMode &AM,
+                                                   SelectionDAG &DAG) const {
+  SDValue Ptr = cast<LSBaseSDNode>(N)->getBasePtr();
+  bool IsInc;
+
+  if (!getIndexedAddressParts(N, Ptr.getNode(), Base, Offset, IsInc, DAG))
+    return false;
+
+  AM = IsInc ? ISD::PRE_INC : ISD::PRE_DEC;
+  return true;
+}
+
+bool TMS320C64XLowering::getPostIndexedAddressParts(SDNode *N, SDNode *Op,
+                                                    SDValue &Base,
+                                                    SDValue &Offset,
+                                                    ISD::MemIndexedMode &AM,
+                                                    SelectionDAG &DAG) const {
+  SDValue Ptr = cast<LSBaseSDNode>(N)->getBasePtr();
+  bool IsInc;
+
+  if (!getIndexedAddressParts(N, Op, Base, Offset, IsInc, DAG) || Base != Ptr)
+    return false;
+
+  AM = IsInc ? ISD::POST_INC : ISD::POST_DEC;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
 SDValue
 TMS320C64XLowering::LowerGlobalAddress(SDValue op, SelectionDAG &DAG) const
 {
@@ -1094,18 +1487,856 @@ TMS320C64XLowering::LowerIntrinsic(SDValue op, SelectionDAG &DAG) const {
 //  MachineRegisterInfo &RegInfo = MF.getRegInfo();
   DebugLoc dl = op.getDebugLoc();
   unsigned IntNo = cast<ConstantSDNode>(op.getOperand(1))->getZExtValue();
-  unsigned Opc = 0;
+  SDValue Chain = op.getOperand(0);
   switch (IntNo) {
   default: llvm_unreachable("unknown intrinsic"); break;
-  case Intrinsic::c64x_timestamp_start: Opc = TMSISD::TSC_START; break;
-  case Intrinsic::c64x_timestamp_end: Opc = TMSISD::TSC_END; break;
+  case Intrinsic::c64x_timestamp_start:
+    // any write to TSCL starts the counter, the stamp is read after it
+    Chain = DAG.getNode(TMSISD::TSC_START, dl, MVT::Other, Chain,
+                        DAG.getConstant(0, MVT::i32));
+    break;
+  case Intrinsic::c64x_timestamp_end: break;
+  case Intrinsic::c64x_nassert: return op.getOperand(0);
+  case Intrinsic::c64x_circ_ldw:
+  case Intrinsic::c64x_circ_ldh:
+  case Intrinsic::c64x_circ_ldhu:
+  case Intrinsic::c64x_circ_ldb:
+  case Intrinsic::c64x_circ_ldbu:
+  case Intrinsic::c64x_circ_stw:
+  case Intrinsic::c64x_circ_sth:
+  case Intrinsic::c64x_circ_stb:
+    return LowerCircular(op, DAG);
   }
 
   // return i32 result and chain
   SDVTList Results = DAG.getVTList(MVT::i32, MVT::Other);
-  // only incoming operand is the chain
-  SDValue Chain = DAG.getNode(Opc, dl, Results, op.getOperand(0));
+  return DAG.getNode(TMSISD::TSC_READ, dl, Results, Chain);
+}
 
-  return Chain;
+//-----------------------------------------------------------------------------
+
+// The TI intrinsics without side effects are matched by patterns, except for
+// _mpy2 that delivers a register pair
+
+SDValue
+TMS320C64XLowering::LowerPureIntrinsic(SDValue op, SelectionDAG &DAG) const {
+  unsigned IntNo = cast<ConstantSDNode>(op.getOperand(0))->getZExtValue();
+  if (IntNo != Intrinsic::c64x_mpy2)
+    return SDValue();
+
+  return DAG.getNode(TMSISD::MPY2, op.getDebugLoc(),
+    DAG.getVTList(MVT::i32, MVT::i32), op.getOperand(1), op.getOperand(2));
+}
+
+//-----------------------------------------------------------------------------
+
+// Circular buffer accesses stay intrinsic nodes and are selected manually, we
+// only make sure here that they are encodable. The step and the buffer size
+// are the last two operands of both loads and stores
+
+SDValue
+TMS320C64XLowering::LowerCircular(SDValue op, SelectionDAG &DAG) const {
+  unsigned NumOps = op.getNumOperands();
+  ConstantSDNode *Step = dyn_cast<ConstantSDNode>(op.getOperand(NumOps - 2));
+  ConstantSDNode *Size = dyn_cast<ConstantSDNode>(op.getOperand(NumOps - 1));
+
+  if (!Step || !Size)
+    report_fatal_error("circular buffer access needs a constant step and "
+                       "buffer size");
+
+  // the step is the ucst5 offset of *R++[n]/*R--[n], the AMR block size
+  // field encodes 2^(N+1) bytes
+  MemIntrinsicSDNode *Mem = cast<MemIntrinsicSDNode>(op);
+  int64_t step = Step->getSExtValue();
+  uint64_t size = Size->getZExtValue();
+  if (step < -31 || step > 31)
+    report_fatal_error("circular buffer step out of range [-31, 31]");
+  if (!isPowerOf2_64(size) || size < 2
+      || size < Mem->getMemoryVT().getStoreSize())
+    report_fatal_error("circular buffer size must be a power of two");
+
+  return op;
+}
+
+//-----------------------------------------------------------------------------
+
+bool TMS320C64XLowering::getTgtMemIntrinsic(IntrinsicInfo &Info,
+                                            const CallInst &I,
+                                            unsigned Intrinsic) const {
+  bool IsStore = false;
+  switch (Intrinsic) {
+  default: return false;
+  case Intrinsic::c64x_circ_ldw: Info.memVT = MVT::i32; break;
+  case Intrinsic::c64x_circ_ldh:
+  case Intrinsic::c64x_circ_ldhu: Info.memVT = MVT::i16; break;
+  case Intrinsic::c64x_circ_ldb:
+  case Intrinsic::c64x_circ_ldbu: Info.memVT = MVT::i8; break;
+  case Intrinsic::c64x_circ_stw: Info.memVT = MVT::i32; IsStore = true; break;
+  case Intrinsic::c64x_circ_sth: Info.memVT = MVT::i16; IsStore = true; break;
+  case Intrinsic::c64x_circ_stb: Info.memVT = MVT::i8; IsStore = true; break;
+  }
+
+  // the access goes to the incoming pointer, the update wraps around later
+  Info.opc = ISD::INTRINSIC_W_CHAIN;
+  Info.ptrVal = I.getArgOperand(0);
+  Info.offset = 0;
+  Info.align = Info.memVT.getStoreSize();
+  Info.vol = false;
+  Info.readMem = !IsStore;
+  Info.writeMem = IsStore;
+  return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+SDValue
+TMS320C64XLowering::LowerBuildVector(SDValue op, SelectionDAG &DAG) const {
+
+  DebugLoc dl = op.getDebugLoc();
+  EVT VT = op.getValueType();
+  unsigned NumElems = VT.getVectorNumElements();
+  unsigned EltBits = VT.getVectorElementType().getSizeInBits();
+
+  // a vector of constants is just a (packed) constant word, undefined
+  // elements are taken as zero
+  bool isConstant = true;
+  unsigned Packed = 0;
+
+  for (unsigned i = 0; i < NumElems; ++i) {
+    SDValue Elt = op.getOperand(i);
+    if (Elt.getOpcode() == ISD::UNDEF)
+      continue;
+
+    ConstantSDNode *C = dyn_cast<ConstantSDNode>(Elt);
+    if (!C) {
+      isConstant = false;
+      break;
+    }
+
+    unsigned Mask = (1u << EltBits) - 1;
+    Packed |= (C->getZExtValue() & Mask) << (i * EltBits);
+  }
+
+  if (isConstant)
+    return DAG.getNode(ISD::BITCAST, dl, VT,
+                       DAG.getConstant(Packed, MVT::i32));
+
+  // two halfwords can be packed by a single pack2, the elements have been
+  // promoted to words already. Bytes go through the stack instead.
+  if (VT != MVT::v2i16)
+    return SDValue();
+
+  SDValue Lo = op.getOperand(0);
+  SDValue Hi = op.getOperand(1);
+
+  if (Lo.getOpcode() == ISD::UNDEF)
+    Lo = Hi;
+  else if (Hi.getOpcode() == ISD::UNDEF)
+    Hi = Lo;
+
+  assert(Lo.getValueType() == MVT::i32 && "Elements not promoted?");
+
+  return DAG.getNode(TMSISD::PACK2, dl, VT,
+                     DAG.getNode(ISD::BITCAST, dl, VT, Hi),
+                     DAG.getNode(ISD::BITCAST, dl, VT, Lo));
+}
+
+//-----------------------------------------------------------------------------
+
+SDValue
+TMS320C64XLowering::LowerVectorShuffle(SDValue op, SelectionDAG &DAG) const {
+
+  ShuffleVectorSDNode *SVN = cast<ShuffleVectorSDNode>(op.getNode());
+  DebugLoc dl = op.getDebugLoc();
+  EVT VT = op.getValueType();
+
+  assert(VT == MVT::v2i16 && "Only halfword shuffles are custom lowered");
+
+  int LoIdx = SVN->getMaskElt(0);
+  int HiIdx = SVN->getMaskElt(1);
+
+  // undefined elements are free to pick whatever the other one picks
+  if (LoIdx < 0)
+    LoIdx = HiIdx < 0 ? 0 : HiIdx;
+  if (HiIdx < 0)
+    HiIdx = LoIdx;
+
+  // each of the 4 pack instructions moves one halfword of src1 into the
+  // upper and one halfword of src2 into the lower half of the result
+  SDValue Src1 = op.getOperand(HiIdx < 2 ? 0 : 1);
+  SDValue Src2 = op.getOperand(LoIdx < 2 ? 0 : 1);
+  bool HiFromHi = HiIdx & 1;
+  bool LoFromHi = LoIdx & 1;
+
+  unsigned Opc;
+  if (HiFromHi)
+    Opc = LoFromHi ? TMSISD::PACKH2 : TMSISD::PACKHL2;
+  else
+    Opc = LoFromHi ? TMSISD::PACKLH2 : TMSISD::PACK2;
+
+  return DAG.getNode(Opc, dl, VT, Src1, Src2);
+}
+
+//-----------------------------------------------------------------------------
+
+bool TMS320C64XLowering::isShuffleMaskLegal(const SmallVectorImpl<int> &Mask,
+                                            EVT VT) const {
+  // any halfword shuffle is a single pack instruction
+  return VT == MVT::v2i16;
 }
 
+//-----------------------------------------------------------------------------
+
+SDValue
+TMS320C64XLowering::LowerExtractElement(SDValue op, SelectionDAG &DAG) const {
+
+  ConstantSDNode *Idx = dyn_cast<ConstantSDNode>(op.getOperand(1));
+
+  // variable indices go through the stack
+  if (!Idx)
+    return SDValue();
+
+  DebugLoc dl = op.getDebugLoc();
+  SDValue Vec = op.getOperand(0);
+  EVT VT = Vec.getValueType();
+  unsigned EltBits = VT.getVectorElementType().getSizeInBits();
+
+  assert(op.getValueType() == MVT::i32 && "Elements not promoted?");
+
+  // the result is any-extended, hence shifting the element down is enough
+  SDValue Word = DAG.getNode(ISD::BITCAST, dl, MVT::i32, Vec);
+  unsigned Shift = Idx->getZExtValue() * EltBits;
+
+  if (!Shift)
+    return Word;
+
+  return DAG.getNode(ISD::SRL, dl, MVT::i32, Word,
+                     DAG.getConstant(Shift, MVT::i32));
+}
+
+//-----------------------------------------------------------------------------
+
+SDValue
+TMS320C64XLowering::LowerVectorShift(SDValue op, SelectionDAG &DAG) const {
+
+  // shr2/shru2 shift both halves by the same amount, anything else is done
+  // element-wise
+  BuildVectorSDNode *Amount =
+    dyn_cast<BuildVectorSDNode>(op.getOperand(1).getNode());
+
+  if (!Amount)
+    return SDValue();
+
+  APInt SplatValue, SplatUndef;
+  unsigned SplatBits;
+  bool HasAnyUndefs;
+
+  if (!Amount->isConstantSplat(SplatValue, SplatUndef, SplatBits,
+                               HasAnyUndefs, 16)
+      || SplatBits != 16 || SplatValue.getZExtValue() > 15)
+    return SDValue();
+
+  unsigned Opc = op.getOpcode() == ISD::SRA ? TMSISD::SHR2 : TMSISD::SHRU2;
+
+  return DAG.getNode(Opc, op.getDebugLoc(), op.getValueType(),
+                     op.getOperand(0),
+                     DAG.getConstant(SplatValue.getZExtValue(), MVT::i32));
+}
+
+//-----------------------------------------------------------------------------
+
+void
+TMS320C64XLowering::ReplaceNodeResults(SDNode *N,
+                                       SmallVectorImpl<SDValue> &Results,
+                                       SelectionDAG &DAG) const
+{
+  DebugLoc dl = N->getDebugLoc();
+
+  switch (N->getOpcode()) {
+    case ISD::LOAD: {
+      LoadSDNode *LD = cast<LoadSDNode>(N);
+
+      // extending and indexed loads are left to the legalizer
+      if (!ISD::isNormalLoad(LD))
+        return;
+
+      unsigned Opc = (LD->getAlignment() >= 8) ? TMSISD::LDDW : TMSISD::LDNDW;
+      SDValue Ops[] = { LD->getChain(), LD->getBasePtr() };
+
+      SDValue Pair = DAG.getMemIntrinsicNode(Opc, dl,
+        DAG.getVTList(MVT::i32, MVT::i32, MVT::Other), Ops, 2,
+        MVT::i64, LD->getMemOperand());
+
+      Results.push_back(DAG.getNode(ISD::BUILD_PAIR, dl, MVT::i64,
+                                    Pair.getValue(0), Pair.getValue(1)));
+      Results.push_back(Pair.getValue(2));
+      return;
+    }
+    case ISD::ADD: {
+      SDValue LHS = N->getOperand(0);
+      SDValue RHS = N->getOperand(1);
+
+      SDValue LHSLo = DAG.getNode(ISD::EXTRACT_ELEMENT, dl, MVT::i32, LHS,
+                                  DAG.getIntPtrConstant(0));
+      SDValue LHSHi = DAG.getNode(ISD::EXTRACT_ELEMENT, dl, MVT::i32, LHS,
+                                  DAG.getIntPtrConstant(1));
+      SDValue RHSLo = DAG.getNode(ISD::EXTRACT_ELEMENT, dl, MVT::i32, RHS,
+                                  DAG.getIntPtrConstant(0));
+      SDValue RHSHi = DAG.getNode(ISD::EXTRACT_ELEMENT, dl, MVT::i32, RHS,
+                                  DAG.getIntPtrConstant(1));
+
+      // addu delivers the low word and the carry out of it in one go
+      SDValue Lo = DAG.getNode(TMSISD::ADDU, dl,
+        DAG.getVTList(MVT::i32, MVT::i32), LHSLo, RHSLo);
+
+      SDValue Hi = DAG.getNode(ISD::ADD, dl, MVT::i32, LHSHi, RHSHi);
+      Hi = DAG.getNode(ISD::ADD, dl, MVT::i32, Hi, Lo.getValue(1));
+
+      Results.push_back(DAG.getNode(ISD::BUILD_PAIR, dl, MVT::i64, Lo, Hi));
+      return;
+    }
+    default:
+      llvm_unreachable("Unexpected node for result replacement");
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+SDValue
+TMS320C64XLowering::LowerStore(SDValue op, SelectionDAG &DAG) const {
+  StoreSDNode *Store = cast<StoreSDNode>(op);
+  SDValue Value = Store->getValue();
+  DebugLoc dl = op.getDebugLoc();
+
+  // truncating and indexed stores are left to the legalizer
+  if (!ISD::isNormalStore(Store) || Value.getValueType() != MVT::i64)
+    return SDValue();
+
+  unsigned Opc = (Store->getAlignment() >= 8) ? TMSISD::STDW : TMSISD::STNDW;
+
+  // note: MemSDNode expects the address right behind the chain
+  SDValue Ops[] = {
+    Store->getChain(),
+    Store->getBasePtr(),
+    DAG.getNode(ISD::EXTRACT_ELEMENT, dl, MVT::i32, Value,
+                DAG.getIntPtrConstant(0)),
+    DAG.getNode(ISD::EXTRACT_ELEMENT, dl, MVT::i32, Value,
+                DAG.getIntPtrConstant(1))
+  };
+
+  return DAG.getMemIntrinsicNode(Opc, dl, DAG.getVTList(MVT::Other), Ops, 4,
+                                 MVT::i64, Store->getMemOperand());
+}
+
+//-----------------------------------------------------------------------------
+// Saturating arithmetic. Fixed-point code spells saturation as a clamp of the
+// exact result, min(max(x, lo), hi), which reaches the DAG as two selects.
+// Where the clamp is what one of the saturating instructions does anyway, the
+// selects are replaced by the intrinsic node of that instruction
+
+/// isMinMax - Match the select(setcc) and select_cc forms of
+/// "Cmp > C ? C : Arm" (a min) and "Cmp > C ? Arm : C" (a max) for a constant
+/// C. All predicates are normalized to this form. Comparing against C - 1
+/// splits the values at the same point, instcombine likes to produce that.
+static bool isMinMax(SDValue N, SDValue &Cmp, SDValue &Arm, int64_t &C,
+                     bool &IsMax, bool &IsSigned) {
+  SDValue RHS, T, F;
+  ISD::CondCode CC;
+
+  if (N.getOpcode() == ISD::SELECT_CC) {
+    Cmp = N.getOperand(0);
+    RHS = N.getOperand(1);
+    T = N.getOperand(2);
+    F = N.getOperand(3);
+    CC = cast<CondCodeSDNode>(N.getOperand(4))->get();
+  } else if (N.getOpcode() == ISD::SELECT &&
+             N.getOperand(0).getOpcode() == ISD::SETCC) {
+    SDValue Cond = N.getOperand(0);
+    Cmp = Cond.getOperand(0);
+    RHS = Cond.getOperand(1);
+    T = N.getOperand(1);
+    F = N.getOperand(2);
+    CC = cast<CondCodeSDNode>(Cond.getOperand(2))->get();
+  } else
+    return false;
+
+  if (isa<ConstantSDNode>(Cmp)) {
+    std::swap(Cmp, RHS);
+    CC = ISD::getSetCCSwappedOperands(CC);
+  }
+
+  ConstantSDNode *K = dyn_cast<ConstantSDNode>(RHS);
+  if (!K || Cmp.getValueType() != N.getValueType())
+    return false;
+
+  IsSigned = !ISD::isUnsignedIntSetCC(CC);
+  int64_t Bound = IsSigned ? K->getSExtValue() : K->getZExtValue();
+
+  // Cmp > Bound ? T : F
+  switch (CC) {
+    case ISD::SETGT:
+    case ISD::SETUGT:
+      break;
+    case ISD::SETGE:
+    case ISD::SETUGE:
+      --Bound;
+      break;
+    case ISD::SETLT:
+    case ISD::SETULT:
+      --Bound;
+      std::swap(T, F);
+      break;
+    case ISD::SETLE:
+    case ISD::SETULE:
+      std::swap(T, F);
+      break;
+    default:
+      return false;
+  }
+
+  ConstantSDNode *Cst;
+  if ((Cst = dyn_cast<ConstantSDNode>(T))) {
+    IsMax = false;
+    Arm = F;
+  } else if ((Cst = dyn_cast<ConstantSDNode>(F))) {
+    IsMax = true;
+    Arm = T;
+  } else
+    return false;
+
+  C = IsSigned ? Cst->getSExtValue() : Cst->getZExtValue();
+
+  // unsigned compares are only taken as long as they agree with signed ones
+  if (!IsSigned && (Bound < 0 || C < 0))
+    return false;
+
+  return Bound == C || Bound == C - 1;
+}
+
+/// isClamp - Match signed max(min(X, Hi), Lo) and min(max(X, Lo), Hi). The
+/// outer select may test X itself instead of the inner result, as in
+/// "x < lo ? lo : (x > hi ? hi : x)".
+static bool isClamp(SDValue N, SDValue &X, int64_t &Lo, int64_t &Hi) {
+  SDValue OuterCmp, Inner, InnerCmp;
+  int64_t OuterC, InnerC;
+  bool OuterMax, InnerMax, Signed;
+
+  if (!isMinMax(N, OuterCmp, Inner, OuterC, OuterMax, Signed) || !Signed)
+    return false;
+  if (!isMinMax(Inner, InnerCmp, X, InnerC, InnerMax, Signed) || !Signed)
+    return false;
+
+  if (InnerCmp != X || (OuterCmp != Inner && OuterCmp != X) ||
+      OuterMax == InnerMax)
+    return false;
+
+  Lo = OuterMax ? OuterC : InnerC;
+  Hi = OuterMax ? InnerC : OuterC;
+  return Lo <= Hi;
+}
+
+/// isByteAdd - Whether N is the sum of two unsigned bytes.
+static bool isByteAdd(SDValue N, SelectionDAG &DAG) {
+  if (N.getOpcode() != ISD::ADD)
+    return false;
+
+  APInt High = APInt::getHighBitsSet(32, 24);
+  return DAG.MaskedValueIsZero(N.getOperand(0), High) &&
+         DAG.MaskedValueIsZero(N.getOperand(1), High);
+}
+
+static SDValue getIntrinsicNode(SelectionDAG &DAG, DebugLoc dl,
+                                unsigned IntNo, SDValue A, SDValue B) {
+  return DAG.getNode(ISD::INTRINSIC_WO_CHAIN, dl, MVT::i32,
+                     DAG.getConstant(IntNo, MVT::i32), A, B);
+}
+
+/// PerformClampCombine - Clamps of 32 bit values to a signed bit width are
+/// done by a saturating shift to the top of the word and a shift back, or by
+/// sadd2/smpy if the operands are halfwords. saddu4 does unsigned bytes.
+static SDValue PerformClampCombine(SDNode *N, SelectionDAG &DAG) {
+  if (N->getValueType(0) != MVT::i32)
+    return SDValue();
+
+  DebugLoc dl = N->getDebugLoc();
+  SDValue X, Arm;
+  int64_t Lo, Hi, C;
+  bool IsMax, IsSigned;
+
+  // the sum of two bytes is in [0, 510], a max with 0 is redundant
+  if (isClamp(SDValue(N, 0), X, Lo, Hi)) {
+    if (Lo == 0 && Hi == 255 && isByteAdd(X, DAG))
+      return getIntrinsicNode(DAG, dl, Intrinsic::c64x_saddu4,
+                              X.getOperand(0), X.getOperand(1));
+  } else if (isMinMax(SDValue(N, 0), X, Arm, C, IsMax, IsSigned) &&
+             X == Arm && !IsMax && C == 255 && isByteAdd(X, DAG)) {
+    return getIntrinsicNode(DAG, dl, Intrinsic::c64x_saddu4,
+                            X.getOperand(0), X.getOperand(1));
+  } else
+    return SDValue();
+
+  if (Lo != -Hi - 1 || !isPowerOf2_64(Hi + 1) || Hi + 1 > (1 << 30))
+    return SDValue();
+
+  unsigned Shift = 31 - Log2_64(Hi + 1);
+
+  if (Shift == 16 && X.getOpcode() == ISD::ADD &&
+      DAG.ComputeNumSignBits(X.getOperand(0)) > 16 &&
+      DAG.ComputeNumSignBits(X.getOperand(1)) > 16) {
+    // sadd2 saturates the lower halfword, the upper one is thrown away
+    SDValue Sum = getIntrinsicNode(DAG, dl, Intrinsic::c64x_sadd2,
+                                   X.getOperand(0), X.getOperand(1));
+    return DAG.getNode(ISD::SIGN_EXTEND_INREG, dl, MVT::i32, Sum,
+                       DAG.getValueType(MVT::i16));
+  }
+
+  if (Shift == 16 && X.getOpcode() == ISD::SRA &&
+      isa<ConstantSDNode>(X.getOperand(1)) &&
+      cast<ConstantSDNode>(X.getOperand(1))->getZExtValue() == 15 &&
+      X.getOperand(0).getOpcode() == ISD::MUL) {
+    // Q15 multiplication, the only product that needs saturation is the one
+    // of -1 and -1, smpy does that
+    SDValue Mul = X.getOperand(0);
+    if (DAG.ComputeNumSignBits(Mul.getOperand(0)) > 16 &&
+        DAG.ComputeNumSignBits(Mul.getOperand(1)) > 16) {
+      SDValue Prod = getIntrinsicNode(DAG, dl, Intrinsic::c64x_smpy,
+                                      Mul.getOperand(0), Mul.getOperand(1));
+      return DAG.getNode(ISD::SRA, dl, MVT::i32, Prod,
+                         DAG.getConstant(16, MVT::i32));
+    }
+  }
+
+  SDValue Amt = DAG.getConstant(Shift, MVT::i32);
+  SDValue Top = getIntrinsicNode(DAG, dl, Intrinsic::c64x_sshl, X, Amt);
+  return DAG.getNode(ISD::SRA, dl, MVT::i32, Top, Amt);
+}
+
+/// PerformTruncCombine - Q31 arithmetic is done on 64 bits and clamped to
+/// the 32 bit range before it is truncated. If the 64 bit operation cannot
+/// overflow, this is exactly sadd, ssub, sshl or smpy.
+static SDValue PerformTruncCombine(SDNode *N, SelectionDAG &DAG) {
+  SDValue X;
+  int64_t Lo, Hi;
+
+  if (N->getValueType(0) != MVT::i32 ||
+      !isClamp(N->getOperand(0), X, Lo, Hi) ||
+      Lo != -0x80000000LL || Hi != 0x7fffffffLL)
+    return SDValue();
+
+  if (X.getOpcode() != ISD::ADD && X.getOpcode() != ISD::SUB &&
+      X.getOpcode() != ISD::SHL)
+    return SDValue();
+
+  DebugLoc dl = N->getDebugLoc();
+  SDValue A = X.getOperand(0);
+  SDValue B = X.getOperand(1);
+
+  if (X.getOpcode() == ISD::SHL) {
+    ConstantSDNode *Amt = dyn_cast<ConstantSDNode>(B);
+    if (!Amt || Amt->getZExtValue() > 31)
+      return SDValue();
+
+    // Q15 x Q15 -> Q31
+    if (Amt->getZExtValue() == 1 && A.getOpcode() == ISD::MUL &&
+        DAG.ComputeNumSignBits(A.getOperand(0)) > 48 &&
+        DAG.ComputeNumSignBits(A.getOperand(1)) > 48)
+      return getIntrinsicNode(DAG, dl, Intrinsic::c64x_smpy,
+        DAG.getNode(ISD::TRUNCATE, dl, MVT::i32, A.getOperand(0)),
+        DAG.getNode(ISD::TRUNCATE, dl, MVT::i32, A.getOperand(1)));
+
+    if (DAG.ComputeNumSignBits(A) <= 32)
+      return SDValue();
+
+    return getIntrinsicNode(DAG, dl, Intrinsic::c64x_sshl,
+      DAG.getNode(ISD::TRUNCATE, dl, MVT::i32, A),
+      DAG.getConstant(Amt->getZExtValue(), MVT::i32));
+  }
+
+  if (DAG.ComputeNumSignBits(A) <= 32 || DAG.ComputeNumSignBits(B) <= 32)
+    return SDValue();
+
+  unsigned IntNo = (X.getOpcode() == ISD::ADD) ? Intrinsic::c64x_sadd
+                                               : Intrinsic::c64x_ssub;
+  return getIntrinsicNode(DAG, dl, IntNo,
+                          DAG.getNode(ISD::TRUNCATE, dl, MVT::i32, A),
+                          DAG.getNode(ISD::TRUNCATE, dl, MVT::i32, B));
+}
+
+//-----------------------------------------------------------------------------
+// C674x floating point. Floats and doubles are no legal types, they are
+// softened to the i32/i64 values of their bits like for the run time library
+// calls. The native operations are put on these bits right before, the
+// double precision nodes take and deliver the low and high words
+
+static bool isFloatType(EVT VT) {
+  return VT == MVT::f32 || VT == MVT::f64;
+}
+
+/// getFloatBits - The bits of a float, or the low word of a double (with the
+/// high one in Hi).
+static SDValue getFloatBits(SelectionDAG &DAG, DebugLoc dl, SDValue V,
+                            SDValue &Hi) {
+  if (V.getValueType() == MVT::f32)
+    return DAG.getNode(ISD::BITCAST, dl, MVT::i32, V);
+
+  SDValue W = DAG.getNode(ISD::BITCAST, dl, MVT::i64, V);
+  Hi = DAG.getNode(ISD::EXTRACT_ELEMENT, dl, MVT::i32, W,
+                   DAG.getIntPtrConstant(1));
+  return DAG.getNode(ISD::EXTRACT_ELEMENT, dl, MVT::i32, W,
+                     DAG.getIntPtrConstant(0));
+}
+
+/// getDouble - A double from the two word results of a double node.
+static SDValue getDouble(SelectionDAG &DAG, DebugLoc dl, SDValue Words) {
+  SDValue W = DAG.getNode(ISD::BUILD_PAIR, dl, MVT::i64,
+                          Words.getValue(0), Words.getValue(1));
+  return DAG.getNode(ISD::BITCAST, dl, MVT::f64, W);
+}
+
+/// getFloatOp - A binary operation on floats or doubles, SPOpc or DPOpc.
+static SDValue getFloatOp(SelectionDAG &DAG, DebugLoc dl, unsigned SPOpc,
+                          unsigned DPOpc, SDValue A, SDValue B) {
+  SDValue AHi, BHi;
+  SDValue ALo = getFloatBits(DAG, dl, A, AHi);
+  SDValue BLo = getFloatBits(DAG, dl, B, BHi);
+
+  if (A.getValueType() == MVT::f32)
+    return DAG.getNode(SPOpc, dl, MVT::i32, ALo, BLo);
+
+  // compares deliver a word, arithmetic another double
+  if (DPOpc == TMSISD::CMPEQDP || DPOpc == TMSISD::CMPGTDP ||
+      DPOpc == TMSISD::CMPLTDP)
+    return DAG.getNode(DPOpc, dl, MVT::i32, ALo, AHi, BLo, BHi);
+
+  SDValue Ops[] = { ALo, AHi, BLo, BHi };
+  return DAG.getNode(DPOpc, dl, DAG.getVTList(MVT::i32, MVT::i32), Ops, 4);
+}
+
+static SDValue getFloatCmp(SelectionDAG &DAG, DebugLoc dl, unsigned SPOpc,
+                           SDValue A, SDValue B) {
+  unsigned DPOpc = TMSISD::CMPEQDP;
+  if (SPOpc == TMSISD::CMPGTSP)
+    DPOpc = TMSISD::CMPGTDP;
+  else if (SPOpc == TMSISD::CMPLTSP)
+    DPOpc = TMSISD::CMPLTDP;
+  return getFloatOp(DAG, dl, SPOpc, DPOpc, A, B);
+}
+
+/// getFloatCondition - Evaluate the float compare CC of A and B to 0 or 1.
+/// The compares of the C674x are false for unordered operands, the other
+/// conditions are built from two of them or from the inverse condition, in
+/// which case Negate is set and the result is to be inverted.
+static SDValue getFloatCondition(SelectionDAG &DAG, DebugLoc dl,
+                                 ISD::CondCode CC, SDValue A, SDValue B,
+                                 bool &Negate) {
+  unsigned C1, C2 = 0;
+  Negate = false;
+
+  switch (CC) {
+    case ISD::SETOEQ:
+    case ISD::SETEQ:  C1 = TMSISD::CMPEQSP; break;
+    case ISD::SETOGT:
+    case ISD::SETGT:  C1 = TMSISD::CMPGTSP; break;
+    case ISD::SETOLT:
+    case ISD::SETLT:  C1 = TMSISD::CMPLTSP; break;
+    case ISD::SETOGE: C1 = TMSISD::CMPGTSP; C2 = TMSISD::CMPEQSP; break;
+    case ISD::SETOLE: C1 = TMSISD::CMPLTSP; C2 = TMSISD::CMPEQSP; break;
+    case ISD::SETONE: C1 = TMSISD::CMPLTSP; C2 = TMSISD::CMPGTSP; break;
+    case ISD::SETUEQ:
+      C1 = TMSISD::CMPLTSP; C2 = TMSISD::CMPGTSP; Negate = true; break;
+    case ISD::SETUNE:
+    case ISD::SETNE:  C1 = TMSISD::CMPEQSP; Negate = true; break;
+    case ISD::SETUGT:
+      C1 = TMSISD::CMPLTSP; C2 = TMSISD::CMPEQSP; Negate = true; break;
+    case ISD::SETUGE:
+    case ISD::SETGE:  C1 = TMSISD::CMPLTSP; Negate = true; break;
+    case ISD::SETULT:
+      C1 = TMSISD::CMPGTSP; C2 = TMSISD::CMPEQSP; Negate = true; break;
+    case ISD::SETULE:
+    case ISD::SETLE:  C1 = TMSISD::CMPGTSP; Negate = true; break;
+    case ISD::SETO:
+    case ISD::SETUO:
+      // a value not equal to itself is a NaN
+      Negate = (CC == ISD::SETUO);
+      return DAG.getNode(ISD::AND, dl, MVT::i32,
+                         getFloatCmp(DAG, dl, TMSISD::CMPEQSP, A, A),
+                         getFloatCmp(DAG, dl, TMSISD::CMPEQSP, B, B));
+    default:
+      return SDValue();
+  }
+
+  SDValue R = getFloatCmp(DAG, dl, C1, A, B);
+  if (C2)
+    R = DAG.getNode(ISD::OR, dl, MVT::i32, R,
+                    getFloatCmp(DAG, dl, C2, A, B));
+  return R;
+}
+
+static SDValue PerformFloatCompareCombine(SDNode *N, SelectionDAG &DAG) {
+  DebugLoc dl = N->getDebugLoc();
+  unsigned LHSIdx, CCIdx;
+
+  switch (N->getOpcode()) {
+    case ISD::SETCC:     LHSIdx = 0; CCIdx = 2; break;
+    case ISD::BR_CC:     LHSIdx = 2; CCIdx = 1; break;
+    case ISD::SELECT_CC: LHSIdx = 0; CCIdx = 4; break;
+    default:
+      llvm_unreachable("not a float compare");
+  }
+
+  ISD::CondCode CC = cast<CondCodeSDNode>(N->getOperand(CCIdx))->get();
+  bool Negate;
+  SDValue Cond = getFloatCondition(DAG, dl, CC, N->getOperand(LHSIdx),
+                                   N->getOperand(LHSIdx + 1), Negate);
+  if (!Cond.getNode())
+    return SDValue();
+
+  if (N->getOpcode() == ISD::BR_CC)
+    return DAG.getNode(ISD::BR_CC, dl, MVT::Other, N->getOperand(0),
+                       DAG.getCondCode(Negate ? ISD::SETEQ : ISD::SETNE),
+                       Cond, DAG.getConstant(0, MVT::i32), N->getOperand(4));
+
+  // there is no SELECT_CC to legalize into, select on the 0/1 result
+  if (N->getOpcode() == ISD::SELECT_CC)
+    return DAG.getNode(ISD::SELECT, dl, N->getValueType(0), Cond,
+                       N->getOperand(Negate ? 3 : 2),
+                       N->getOperand(Negate ? 2 : 3));
+
+  if (Negate)
+    Cond = DAG.getNode(ISD::XOR, dl, MVT::i32, Cond,
+                       DAG.getConstant(1, MVT::i32));
+  return DAG.getZExtOrTrunc(Cond, dl, N->getValueType(0));
+}
+
+/// PerformFloatCombine - Put the C674x floating point instructions on the
+/// bits of the operands. Divisions, and conversions from and to 64 bit
+/// integers are left to the run time library.
+static SDValue PerformFloatCombine(SDNode *N, SelectionDAG &DAG) {
+  DebugLoc dl = N->getDebugLoc();
+  EVT VT = N->getValueType(0);
+  SDValue Op = N->getOperand(0);
+  SDValue Hi;
+
+  switch (N->getOpcode()) {
+    case ISD::FADD:
+    case ISD::FSUB:
+    case ISD::FMUL: {
+      if (!isFloatType(VT))
+        return SDValue();
+
+      unsigned SPOpc = TMSISD::ADDSP, DPOpc = TMSISD::ADDDP;
+      if (N->getOpcode() == ISD::FSUB) {
+        SPOpc = TMSISD::SUBSP;
+        DPOpc = TMSISD::SUBDP;
+      } else if (N->getOpcode() == ISD::FMUL) {
+        SPOpc = TMSISD::MPYSP;
+        DPOpc = TMSISD::MPYDP;
+      }
+
+      SDValue R = getFloatOp(DAG, dl, SPOpc, DPOpc, Op, N->getOperand(1));
+      if (VT == MVT::f32)
+        return DAG.getNode(ISD::BITCAST, dl, MVT::f32, R);
+      return getDouble(DAG, dl, R);
+    }
+
+    case ISD::SETCC:
+    case ISD::SELECT_CC:
+    case ISD::BR_CC: {
+      unsigned LHSIdx = (N->getOpcode() == ISD::BR_CC) ? 2 : 0;
+      if (!isFloatType(N->getOperand(LHSIdx).getValueType()))
+        return SDValue();
+      return PerformFloatCompareCombine(N, DAG);
+    }
+
+    case ISD::FP_TO_SINT:
+    case ISD::FP_TO_UINT: {
+      if (VT != MVT::i32 || !isFloatType(Op.getValueType()))
+        return SDValue();
+
+      bool IsDouble = Op.getValueType() == MVT::f64;
+      SDValue Lo = getFloatBits(DAG, dl, Op, Hi);
+      SDValue R = IsDouble ? DAG.getNode(TMSISD::DPTRUNC, dl, MVT::i32, Lo, Hi)
+                           : DAG.getNode(TMSISD::SPTRUNC, dl, MVT::i32, Lo);
+      if (N->getOpcode() == ISD::FP_TO_SINT)
+        return R;
+
+      // values from 2^31 on are brought into the signed range first and the
+      // top bit is put back in afterwards
+      SDValue Big = IsDouble ? DAG.getConstantFP(2147483648.0, MVT::f64)
+                             : DAG.getConstantFP(2147483648.0f, MVT::f32);
+      SDValue InRange = getFloatCmp(DAG, dl, TMSISD::CMPLTSP, Op, Big);
+      SDValue Sub = getFloatOp(DAG, dl, TMSISD::SUBSP, TMSISD::SUBDP, Op, Big);
+      SDValue Top = IsDouble
+        ? DAG.getNode(TMSISD::DPTRUNC, dl, MVT::i32, Sub.getValue(0),
+                      Sub.getValue(1))
+        : DAG.getNode(TMSISD::SPTRUNC, dl, MVT::i32, Sub);
+      Top = DAG.getNode(ISD::XOR, dl, MVT::i32, Top,
+                        DAG.getConstant(0x80000000, MVT::i32));
+      return DAG.getNode(ISD::SELECT, dl, MVT::i32, InRange, R, Top);
+    }
+
+    case ISD::SINT_TO_FP:
+    case ISD::UINT_TO_FP: {
+      EVT SrcVT = Op.getValueType();
+      if (!isFloatType(VT) || !SrcVT.isInteger() || SrcVT.bitsGT(MVT::i32))
+        return SDValue();
+
+      bool IsSigned = N->getOpcode() == ISD::SINT_TO_FP;
+      Op = IsSigned ? DAG.getSExtOrTrunc(Op, dl, MVT::i32)
+                    : DAG.getZExtOrTrunc(Op, dl, MVT::i32);
+
+      if (VT == MVT::f32)
+        return DAG.getNode(ISD::BITCAST, dl, MVT::f32,
+          DAG.getNode(IsSigned ? TMSISD::INTSP : TMSISD::INTSPU, dl,
+                      MVT::i32, Op));
+
+      return getDouble(DAG, dl,
+        DAG.getNode(IsSigned ? TMSISD::INTDP : TMSISD::INTDPU, dl,
+                    DAG.getVTList(MVT::i32, MVT::i32), &Op, 1));
+    }
+
+    case ISD::FP_EXTEND: {
+      if (VT != MVT::f64 || Op.getValueType() != MVT::f32)
+        return SDValue();
+      SDValue Bits = getFloatBits(DAG, dl, Op, Hi);
+      return getDouble(DAG, dl, DAG.getNode(TMSISD::SPDP, dl,
+        DAG.getVTList(MVT::i32, MVT::i32), &Bits, 1));
+    }
+
+    case ISD::FP_ROUND: {
+      if (VT != MVT::f32 || Op.getValueType() != MVT::f64)
+        return SDValue();
+      SDValue Lo = getFloatBits(DAG, dl, Op, Hi);
+      return DAG.getNode(ISD::BITCAST, dl, MVT::f32,
+                         DAG.getNode(TMSISD::DPSP, dl, MVT::i32, Lo, Hi));
+    }
+  }
+
+  return SDValue();
+}
+
+SDValue TMS320C64XLowering::PerformDAGCombine(SDNode *N,
+                                              DAGCombinerInfo &DCI) const {
+  // the clamps are matched before legalization turns the selects into
+  // conditional moves and splits the 64 bit values, the float operations
+  // before they are softened
+  if (!DCI.isBeforeLegalize())
+    return SDValue();
+
+  if (ST->hasFP()) {
+    SDValue R = PerformFloatCombine(N, DCI.DAG);
+    if (R.getNode())
+      return R;
+  }
+
+  switch (N->getOpcode()) {
+    case ISD::SELECT:
+    case ISD::SELECT_CC:
+      return PerformClampCombine(N, DCI.DAG);
+    case ISD::TRUNCATE:
+      return PerformTruncCombine(N, DCI.DAG);
+  }
+
+  return SDValue();
+}
@@ -53,8 +53,48 @@ enum {
   RETURN_LABEL_OPERAND,
   SELECT,
   TSC_START,
-  TSC_END,
-  WRAPPER
+  TSC_READ,
+  WRAPPER,
+  // packed halfword moves, src1 delivers the upper, src2 the lower half
+  PACK2,
+  PACKH2,
+  PACKHL2,
+  PACKLH2,
+  // packed halfword shifts
+  SHR2,
+  SHRU2,
+  // 40 bit unsigned add, delivers the low word sum and the carry
+  ADDU,
+  // products of the lower and of the upper halfwords
+  MPY2,
+  // C674x single precision operations on the bits of floats in i32 values,
+  // the compares deliver 0 or 1
+  ADDSP,
+  SUBSP,
+  MPYSP,
+  CMPEQSP,
+  CMPGTSP,
+  CMPLTSP,
+  INTSP,
+  INTSPU,
+  SPTRUNC,
+  // double precision, doubles are passed as their low and high words
+  ADDDP,
+  SUBDP,
+  MPYDP,
+  CMPEQDP,
+  CMPGTDP,
+  CMPLTDP,
+  INTDP,
+  INTDPU,
+  SPDP,
+  DPSP,
+  DPTRUNC,
+  // register pair (64 bit) loads and stores, aligned and non-aligned ones
+  LDDW = ISD::FIRST_TARGET_MEMORY_OPCODE,
+  LDNDW,
+  STDW,
+  STNDW
 };
 }
 
@@ -75,6 +115,8 @@ class TMS320C64XLowering : public TargetLowering {
 
     unsigned getFunctionAlignment(const Function *F) const;
     virtual TargetRegisterClass *getRegClassFor(EVT VT) const;
+    virtual std::pair<const TargetRegisterClass*, uint8_t>
+    findRepresentativeClass(EVT VT) const;
     const char *getTargetNodeName(unsigned op) const;
 
     virtual
@@ -117,11 +159,18 @@ class TMS320C64XLowering : public TargetLowering {
 
     virtual SDValue LowerOperation(SDValue op, SelectionDAG &DAG) const;
 
+    virtual void ReplaceNodeResults(SDNode *N,
+                                    SmallVectorImpl<SDValue> &Results,
+                                    SelectionDAG &DAG) const;
+
+    virtual SDValue PerformDAGCombine(SDNode *N, DAGCombinerInfo &DCI) const;
+
     SDValue LowerGlobalAddress(SDValue op, SelectionDAG &DAG) const;
 
     SDValue LowerJumpTable(SDValue op, SelectionDAG &DAG) const;
     SDValue LowerReturnAddr(SDValue op, SelectionDAG &DAG) const;
     SDValue LowerExtLoad(SDValue op, SelectionDAG &DAG) const;
+    SDValue LowerStore(SDValue op, SelectionDAG &DAG) const;
 
     SDValue LowerBRCC(SDValue op, SelectionDAG &DAG) const;
     SDValue LowerSETCC(SDValue op, SelectionDAG &DAG) const;
@@ -131,6 +180,31 @@ class TMS320C64XLowering : public TargetLowering {
     SDValue LowerVAARG(SDValue op, SelectionDAG &DAG) const;
 
     SDValue LowerIntrinsic(SDValue op, SelectionDAG &DAG) const;
+    SDValue LowerPureIntrinsic(SDValue op, SelectionDAG &DAG) const;
+    SDValue LowerCircular(SDValue op, SelectionDAG &DAG) const;
+
+    virtual bool getTgtMemIntrinsic(IntrinsicInfo &Info, const CallInst &I,
+                                    unsigned Intrinsic) const;
+
+    SDValue LowerBuildVector(SDValue op, SelectionDAG &DAG) const;
+    SDValue LowerVectorShuffle(SDValue op, SelectionDAG &DAG) const;
+    SDValue LowerExtractElement(SDValue op, SelectionDAG &DAG) const;
+    SDValue LowerVectorShift(SDValue op, SelectionDAG &DAG) const;
+
+    virtual bool isLegalAddressingMode(const AddrMode &AM,
+                                       const Type *Ty) const;
+
+    virtual bool getPreIndexedAddressParts(SDNode *N, SDValue &Base,
+                                           SDValue &Offset,
+                                           ISD::MemIndexedMode &AM,
+                                           SelectionDAG &DAG) const;
+    virtual bool getPostIndexedAddressParts(SDNode *N, SDNode *Op,
+                                            SDValue &Base, SDValue &Offset,
+                                            ISD::MemIndexedMode &AM,
+                                            SelectionDAG &DAG) const;
+
+    virtual bool isShuffleMaskLegal(const SmallVectorImpl<int> &Mask,
+                                    EVT VT) const;
 
     std::pair<SDValue,bool> ConvertSETCC(SDValue op, SelectionDAG &DAG) const;
 
@@ -0,0 +1,975 @@
+//===-- TMS320C64XMCCodeEmitter.cpp - Convert TMS320C64X code to machine code //
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the TMS320C64XMCCodeEmitter class, which encodes
+// MCInsts lowered by the asm printer into 32-bit instruction words. The field
+// layouts and opcodes follow the opcode maps of the C64x/C64x+ instruction set
+// reference (SPRU732). Every MCInst carries a trailing flags operand which
+// tells whether it executes in parallel with the next instruction (p-bit),
+// and whether it is to be emitted in its 16-bit compact form.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "mccodeemitter"
+#include "TMS320C64X.h"
+#include "TMS320C64XFixupKinds.h"
+#include "TMS320C64XInstrInfo.h"
+#include "TMS320C64XRegisterInfo.h"
+#include "llvm/MC/MCCodeEmitter.h"
+#include "llvm/MC/MCExpr.h"
+#include "llvm/MC/MCFixup.h"
+#include "llvm/MC/MCInst.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+
+using namespace llvm;
+
+namespace C64X = llvm::TMS320C64X;
+
+STATISTIC(MCNumEmitted, "Number of MC instructions emitted");
+STATISTIC(MCNumCompact, "Number of 16-bit instructions emitted");
+
+namespace {
+
+// instruction word formats of the functional units
+enum Format {
+  NA = 0, // no encoding for this unit
+  FL,     // .L, 1 or 2 sources, op in bits 11-5
+  FLU,    // .L, unary (op 0011010), sub-op in the src1 field
+  FS,     // .S, 1 or 2 sources, op in bits 11-6
+  FSN,    // .S, 1 or 2 sources, nonconditional, op in bits 11-6
+  FSX,    // .S, extended C64x (op in bits 9-6)
+  FD,     // .D, basic (op in bits 12-7), no xpath, src fields swapped
+  FDX,    // .D, extended C64x (op in bits 9-6)
+  FM,     // .M, 16x16 multiply (op in bits 11-7)
+  FMX,    // .M, extended C64x (op in bits 10-6)
+  FMU     // .M, unary (op 00011), sub-op in the src1 field
+};
+
+// maps explicit operands onto the src1/src2 fields. The src2 field is the one
+// that may be read through the cross path.
+enum Layout {
+  RR,     // dst, src1, src2
+  RRC,    // dst, src1, src2, commutable (to get the xpath operand right)
+  RI,     // dst, src2, cst (the constant goes to the src1 field)
+  RIN,    // dst, src2, cst, constant is negated (sub via add)
+  RS,     // dst, src2, src1 (shift value first, amount second)
+  NEG,    // dst, src2 (src1 field is a zero constant)
+  UN      // dst, src2 (src1 field is the unary sub-op)
+};
+
+struct UnitOp {
+  unsigned char Fmt, Op;
+};
+
+struct ALUEncoding {
+  unsigned OpA, OpB;
+  unsigned char Layout;
+  UnitOp Unit[4]; // indexed by TMS320C64XII::unit_l/s/m/d
+};
+
+#define N_A { NA, 0 }
+
+static const ALUEncoding ALUTbl[] = {
+  // flexible, side-specific instructions
+   { C64X::add_rr_1, C64X::add_rr_2, RRC,
+     {{ FL, 0x03 }, { FS, 0x07 }, N_A, { FDX, 0xa }}}
+  ,{ C64X::add_ri_1, C64X::add_ri_2, RI,
+     {{ FL, 0x02 }, { FS, 0x06 }, N_A, { FDX, 0xb }}}
+  ,{ C64X::sub_rr_1, C64X::sub_rr_2, RR,
+     {{ FL, 0x07 }, { FS, 0x17 }, N_A, { FDX, 0xc }}}
+  ,{ C64X::sub_ri_1, C64X::sub_ri_2, RIN,
+     {{ FL, 0x02 }, { FS, 0x06 }, N_A, { FDX, 0xb }}}
+  ,{ C64X::srl_rr_1, C64X::srl_rr_2, RS,
+     { N_A, { FS, 0x27 }, N_A, N_A }}
+  ,{ C64X::srl_ri_1, C64X::srl_ri_2, RI,
+     { N_A, { FS, 0x26 }, N_A, N_A }}
+  ,{ C64X::neg_1, C64X::neg_2, NEG,
+     {{ FL, 0x06 }, { FS, 0x16 }, N_A, N_A }}
+  ,{ C64X::mpy32_1, C64X::mpy32_2, RRC,
+     { N_A, N_A, { FMX, 0x10 }, N_A }}
+  ,{ C64X::andn_rr_1, C64X::andn_rr_2, RR,
+     {{ FL, 0x7c }, { FSX, 0x6 }, N_A, { FDX, 0x0 }}}
+  ,{ C64X::lmbd_rr_1, C64X::lmbd_rr_2, RR,
+     {{ FL, 0x6b }, N_A, N_A, N_A }}
+  ,{ C64X::lmbd_ri_1, C64X::lmbd_ri_2, RI,
+     {{ FL, 0x6a }, N_A, N_A, N_A }}
+  ,{ C64X::add_am_d_1, C64X::add_am_d_2, RR,
+     { N_A, N_A, N_A, { FD, 0x3c }}}
+  ,{ C64X::add_am_w_1, C64X::add_am_w_2, RR,
+     { N_A, N_A, N_A, { FD, 0x38 }}}
+  ,{ C64X::add_am_h_1, C64X::add_am_h_2, RR,
+     { N_A, N_A, N_A, { FD, 0x34 }}}
+  ,{ C64X::sub_am_w_1, C64X::sub_am_w_2, RR,
+     { N_A, N_A, N_A, { FD, 0x39 }}}
+  ,{ C64X::sub_am_h_1, C64X::sub_am_h_2, RR,
+     { N_A, N_A, N_A, { FD, 0x35 }}}
+
+  // packed SIMD
+  ,{ C64X::add2_1, C64X::add2_2, RRC,
+     {{ FL, 0x05 }, { FS, 0x01 }, N_A, { FDX, 0x4 }}}
+  ,{ C64X::sub2_1, C64X::sub2_2, RR,
+     {{ FL, 0x04 }, { FS, 0x11 }, N_A, { FDX, 0x5 }}}
+  ,{ C64X::add4_1, C64X::add4_2, RRC,
+     {{ FL, 0x65 }, N_A, N_A, N_A }}
+  ,{ C64X::sub4_1, C64X::sub4_2, RR,
+     {{ FL, 0x66 }, N_A, N_A, N_A }}
+  ,{ C64X::max2_1, C64X::max2_2, RRC,
+     {{ FL, 0x42 }, N_A, N_A, N_A }}
+  ,{ C64X::min2_1, C64X::min2_2, RRC,
+     {{ FL, 0x41 }, N_A, N_A, N_A }}
+  ,{ C64X::pack2_1, C64X::pack2_2, RR,
+     {{ FL, 0x00 }, { FSX, 0xf }, N_A, N_A }}
+  ,{ C64X::packh2_1, C64X::packh2_2, RR,
+     {{ FL, 0x1e }, { FS, 0x09 }, N_A, N_A }}
+  ,{ C64X::packhl2_1, C64X::packhl2_2, RR,
+     {{ FL, 0x1c }, { FS, 0x08 }, N_A, N_A }}
+  ,{ C64X::packlh2_1, C64X::packlh2_2, RR,
+     {{ FL, 0x1b }, { FS, 0x10 }, N_A, N_A }}
+  ,{ C64X::avgu4_1, C64X::avgu4_2, RRC,
+     { N_A, N_A, { FMX, 0x12 }, N_A }}
+  ,{ C64X::dotp2_1, C64X::dotp2_2, RRC,
+     { N_A, N_A, { FMX, 0x0c }, N_A }}
+  ,{ C64X::dotpu4_1, C64X::dotpu4_2, RRC,
+     { N_A, N_A, { FMX, 0x06 }, N_A }}
+  ,{ C64X::shr2_ri_1, C64X::shr2_ri_2, RI,
+     { N_A, { FSX, 0x7 }, N_A, N_A }}
+  ,{ C64X::shru2_ri_1, C64X::shru2_ri_2, RI,
+     { N_A, { FSX, 0x8 }, N_A, N_A }}
+  ,{ C64X::cmpgt2_1, C64X::cmpgt2_2, RR,
+     { N_A, { FS, 0x14 }, N_A, N_A }}
+  ,{ C64X::cmpeq4_1, C64X::cmpeq4_2, RRC,
+     { N_A, { FS, 0x1c }, N_A, N_A }}
+
+  // saturating arithmetic
+  ,{ C64X::sadd_1, C64X::sadd_2, RRC,
+     {{ FL, 0x13 }, N_A, N_A, N_A }}
+  ,{ C64X::ssub_1, C64X::ssub_2, RR,
+     {{ FL, 0x0f }, N_A, N_A, N_A }}
+  ,{ C64X::sshl_rr_1, C64X::sshl_rr_2, RS,
+     { N_A, { FS, 0x23 }, N_A, N_A }}
+  ,{ C64X::sshl_ri_1, C64X::sshl_ri_2, RI,
+     { N_A, { FS, 0x22 }, N_A, N_A }}
+  ,{ C64X::subc_1, C64X::subc_2, RR,
+     {{ FL, 0x4b }, N_A, N_A, N_A }}
+  ,{ C64X::norm_1, C64X::norm_2, NEG,
+     {{ FL, 0x63 }, N_A, N_A, N_A }}
+  ,{ C64X::sadd2_1, C64X::sadd2_2, RRC,
+     { N_A, { FSN, 0x00 }, N_A, N_A }}
+  ,{ C64X::saddu4_1, C64X::saddu4_2, RRC,
+     { N_A, { FSN, 0x03 }, N_A, N_A }}
+  ,{ C64X::smpy_1, C64X::smpy_2, RRC,
+     { N_A, N_A, { FM, 0x1a }, N_A }}
+
+  // C674x single precision floating point
+  ,{ C64X::addsp_1, C64X::addsp_2, RRC,
+     {{ FL, 0x10 }, N_A, N_A, N_A }}
+  ,{ C64X::subsp_1, C64X::subsp_2, RR,
+     {{ FL, 0x11 }, N_A, N_A, N_A }}
+  ,{ C64X::mpysp_1, C64X::mpysp_2, RRC,
+     { N_A, N_A, { FM, 0x1c }, N_A }}
+  ,{ C64X::cmpeqsp_1, C64X::cmpeqsp_2, RRC,
+     { N_A, { FS, 0x38 }, N_A, N_A }}
+  ,{ C64X::cmpgtsp_1, C64X::cmpgtsp_2, RR,
+     { N_A, { FS, 0x39 }, N_A, N_A }}
+  ,{ C64X::cmpltsp_1, C64X::cmpltsp_2, RR,
+     { N_A, { FS, 0x3a }, N_A, N_A }}
+  ,{ C64X::intsp_1, C64X::intsp_2, NEG,
+     {{ FL, 0x4a }, N_A, N_A, N_A }}
+  ,{ C64X::intspu_1, C64X::intspu_2, NEG,
+     {{ FL, 0x49 }, N_A, N_A, N_A }}
+  ,{ C64X::sptrunc_1, C64X::sptrunc_2, NEG,
+     {{ FL, 0x0b }, N_A, N_A, N_A }}
+
+  // fixed instructions (the unit is taken from the instruction flags)
+  ,{ C64X::shl_p_rr, C64X::shl_p_rr, RS,
+     { N_A, { FS, 0x33 }, N_A, N_A }}
+  ,{ C64X::shl_p_ri, C64X::shl_p_ri, RI,
+     { N_A, { FS, 0x32 }, N_A, N_A }}
+  ,{ C64X::shr_p_rr, C64X::shr_p_rr, RS,
+     { N_A, { FS, 0x37 }, N_A, N_A }}
+  ,{ C64X::shr_p_ri, C64X::shr_p_ri, RI,
+     { N_A, { FS, 0x36 }, N_A, N_A }}
+  ,{ C64X::rotl_p_rr, C64X::rotl_p_rr, RS,
+     { N_A, N_A, { FMX, 0x1d }, N_A }}
+  ,{ C64X::rotl_p_ri, C64X::rotl_p_ri, RI,
+     { N_A, N_A, { FMX, 0x1e }, N_A }}
+  ,{ C64X::and_p_rr, C64X::and_p_rr, RRC,
+     {{ FL, 0x7b }, { FS, 0x1f }, N_A, { FDX, 0x6 }}}
+  ,{ C64X::and_p_ri, C64X::and_p_ri, RI,
+     {{ FL, 0x7a }, { FS, 0x1e }, N_A, { FDX, 0x7 }}}
+  ,{ C64X::or_p_rr, C64X::or_p_rr, RRC,
+     {{ FL, 0x7f }, { FS, 0x1b }, N_A, { FDX, 0x2 }}}
+  ,{ C64X::or_p_ri, C64X::or_p_ri, RI,
+     {{ FL, 0x7e }, { FS, 0x1a }, N_A, { FDX, 0x3 }}}
+  ,{ C64X::xor_p_rr, C64X::xor_p_rr, RRC,
+     {{ FL, 0x6f }, { FS, 0x0b }, N_A, { FDX, 0xe }}}
+  ,{ C64X::xor_p_ri, C64X::xor_p_ri, RI,
+     {{ FL, 0x6e }, { FS, 0x0a }, N_A, { FDX, 0xf }}}
+  ,{ C64X::cmpeq_p_rr, C64X::cmpeq_p_rr, RRC,
+     {{ FL, 0x53 }, N_A, N_A, N_A }}
+  ,{ C64X::cmpeq_p_ri, C64X::cmpeq_p_ri, RI,
+     {{ FL, 0x52 }, N_A, N_A, N_A }}
+  ,{ C64X::cmpgt_p_rr, C64X::cmpgt_p_rr, RR,
+     {{ FL, 0x47 }, N_A, N_A, N_A }}
+  ,{ C64X::cmpgtu_p_rr, C64X::cmpgtu_p_rr, RR,
+     {{ FL, 0x4f }, N_A, N_A, N_A }}
+  ,{ C64X::cmplt_p_rr, C64X::cmplt_p_rr, RR,
+     {{ FL, 0x57 }, N_A, N_A, N_A }}
+  ,{ C64X::cmpltu_p_rr, C64X::cmpltu_p_rr, RR,
+     {{ FL, 0x5f }, N_A, N_A, N_A }}
+  ,{ C64X::addu_p_rr, C64X::addu_p_rr, RRC,
+     {{ FL, 0x2b }, N_A, N_A, N_A }}
+  ,{ C64X::mpy2, C64X::mpy2, RRC,
+     { N_A, N_A, { FMX, 0x00 }, N_A }}
+  ,{ C64X::mpy32_p_rr, C64X::mpy32_p_rr, RRC,
+     { N_A, N_A, { FMX, 0x14 }, N_A }}
+  ,{ C64X::mpy32u_p_rr, C64X::mpy32u_p_rr, RRC,
+     { N_A, N_A, { FMX, 0x18 }, N_A }}
+  ,{ C64X::swap4, C64X::swap4, UN,
+     {{ FLU, 0x01 }, N_A, N_A, N_A }}
+  ,{ C64X::bitr, C64X::bitr, UN,
+     { N_A, N_A, { FMU, 0x1f }, N_A }}
+  ,{ C64X::mvd, C64X::mvd, UN,
+     { N_A, N_A, { FMU, 0x1a }, N_A }}
+  ,{ C64X::adddp, C64X::adddp, RRC,
+     {{ FL, 0x18 }, N_A, N_A, N_A }}
+  ,{ C64X::subdp, C64X::subdp, RR,
+     {{ FL, 0x19 }, N_A, N_A, N_A }}
+  ,{ C64X::mpydp, C64X::mpydp, RRC,
+     { N_A, N_A, { FM, 0x0e }, N_A }}
+  ,{ C64X::cmpeqdp, C64X::cmpeqdp, RRC,
+     { N_A, { FS, 0x28 }, N_A, N_A }}
+  ,{ C64X::cmpgtdp, C64X::cmpgtdp, RR,
+     { N_A, { FS, 0x29 }, N_A, N_A }}
+  ,{ C64X::cmpltdp, C64X::cmpltdp, RR,
+     { N_A, { FS, 0x2a }, N_A, N_A }}
+  ,{ C64X::spdp, C64X::spdp, NEG,
+     { N_A, { FS, 0x02 }, N_A, N_A }}
+  ,{ C64X::dpsp, C64X::dpsp, NEG,
+     {{ FL, 0x09 }, N_A, N_A, N_A }}
+  ,{ C64X::dptrunc, C64X::dptrunc, NEG,
+     {{ FL, 0x01 }, N_A, N_A, N_A }}
+  ,{ C64X::intdp, C64X::intdp, NEG,
+     {{ FL, 0x39 }, N_A, N_A, N_A }}
+  ,{ C64X::intdpu, C64X::intdpu, NEG,
+     {{ FL, 0x3b }, N_A, N_A, N_A }}
+};
+
+#undef N_A
+
+// loads and stores: r-bit and op field (bits 8, 6-4)
+struct MemEncoding {
+  unsigned OpA, OpB;
+  unsigned char R, Op;
+};
+
+static const MemEncoding MemTbl[] = {
+   { C64X::ubyte_sload_1,    C64X::ubyte_sload_2,    0, 0x1 }
+  ,{ C64X::byte_sload_1,     C64X::byte_sload_2,     0, 0x2 }
+  ,{ C64X::byte_store_1,     C64X::byte_store_2,     0, 0x3 }
+  ,{ C64X::uhword_sload_1,   C64X::uhword_sload_2,   0, 0x0 }
+  ,{ C64X::hword_sload_1,    C64X::hword_sload_2,    0, 0x4 }
+  ,{ C64X::hword_store_1,    C64X::hword_store_2,    0, 0x5 }
+  ,{ C64X::word_load_1,      C64X::word_load_2,      0, 0x6 }
+  ,{ C64X::word_sload_1,     C64X::word_sload_2,     0, 0x6 }
+  ,{ C64X::word_store_1,     C64X::word_store_2,     0, 0x7 }
+  ,{ C64X::dword_load_1,     C64X::dword_load_2,     1, 0x6 }
+  ,{ C64X::dword_store_1,    C64X::dword_store_2,    1, 0x4 }
+  ,{ C64X::ndword_load_1,    C64X::ndword_load_2,    1, 0x2 }
+  ,{ C64X::ndword_store_1,   C64X::ndword_store_2,   1, 0x7 }
+  ,{ C64X::u_i1_load_p_addr, C64X::u_i1_load_p_idx,  0, 0x1 }
+  ,{ C64X::ubyte_preload_1,   C64X::ubyte_preload_2,   0, 0x1 }
+  ,{ C64X::ubyte_postload_1,  C64X::ubyte_postload_2,  0, 0x1 }
+  ,{ C64X::byte_preload_1,    C64X::byte_preload_2,    0, 0x2 }
+  ,{ C64X::byte_postload_1,   C64X::byte_postload_2,   0, 0x2 }
+  ,{ C64X::byte_prestore_1,   C64X::byte_prestore_2,   0, 0x3 }
+  ,{ C64X::byte_poststore_1,  C64X::byte_poststore_2,  0, 0x3 }
+  ,{ C64X::uhword_preload_1,  C64X::uhword_preload_2,  0, 0x0 }
+  ,{ C64X::uhword_postload_1, C64X::uhword_postload_2, 0, 0x0 }
+  ,{ C64X::hword_preload_1,   C64X::hword_preload_2,   0, 0x4 }
+  ,{ C64X::hword_postload_1,  C64X::hword_postload_2,  0, 0x4 }
+  ,{ C64X::hword_prestore_1,  C64X::hword_prestore_2,  0, 0x5 }
+  ,{ C64X::hword_poststore_1, C64X::hword_poststore_2, 0, 0x5 }
+  ,{ C64X::word_preload_1,    C64X::word_preload_2,    0, 0x6 }
+  ,{ C64X::word_postload_1,   C64X::word_postload_2,   0, 0x6 }
+  ,{ C64X::word_prestore_1,   C64X::word_prestore_2,   0, 0x7 }
+  ,{ C64X::word_poststore_1,  C64X::word_poststore_2,  0, 0x7 }
+  ,{ C64X::ubyte_circload_1,  C64X::ubyte_circload_1,  0, 0x1 }
+  ,{ C64X::byte_circload_1,   C64X::byte_circload_1,   0, 0x2 }
+  ,{ C64X::byte_circstore_1,  C64X::byte_circstore_1,  0, 0x3 }
+  ,{ C64X::uhword_circload_1, C64X::uhword_circload_1, 0, 0x0 }
+  ,{ C64X::hword_circload_1,  C64X::hword_circload_1,  0, 0x4 }
+  ,{ C64X::hword_circstore_1, C64X::hword_circstore_1, 0, 0x5 }
+  ,{ C64X::word_circload_1,   C64X::word_circload_1,   0, 0x6 }
+  ,{ C64X::word_circstore_1,  C64X::word_circstore_1,  0, 0x7 }
+};
+
+class TMS320C64XMCCodeEmitter : public MCCodeEmitter {
+  TMS320C64XMCCodeEmitter(const TMS320C64XMCCodeEmitter &); // DO NOT IMPLEMENT
+  void operator=(const TMS320C64XMCCodeEmitter &); // DO NOT IMPLEMENT
+  const TargetMachine &TM;
+  const TargetInstrInfo &TII;
+  const TargetRegisterInfo &TRI;
+  MCContext &Ctx;
+
+public:
+  TMS320C64XMCCodeEmitter(TargetMachine &tm, MCContext &ctx)
+    : TM(tm), TII(*TM.getInstrInfo()), TRI(*TM.getRegisterInfo()), Ctx(ctx)
+  {}
+
+  ~TMS320C64XMCCodeEmitter() {}
+
+  void EncodeInstruction(const MCInst &MI, raw_ostream &OS,
+                         SmallVectorImpl<MCFixup> &Fixups) const;
+
+private:
+  unsigned getBinaryCode(const MCInst &MI, const TargetInstrDesc &TID,
+                         SmallVectorImpl<MCFixup> &Fixups) const;
+
+  unsigned encodeALU(const MCInst &MI, const TargetInstrDesc &TID,
+                     const ALUEncoding &Enc) const;
+  unsigned encodeMem(const MCInst &MI, const TargetInstrDesc &TID,
+                     const MemEncoding &Enc) const;
+  unsigned encodeCondition(const MCInst &MI, const TargetInstrDesc &TID) const;
+
+  unsigned getCst16(const MCInst &MI, const MCOperand &MO, bool High,
+                    SmallVectorImpl<MCFixup> &Fixups) const;
+  unsigned getBranchTarget(const MCInst &MI, const MCOperand &MO,
+                           SmallVectorImpl<MCFixup> &Fixups,
+                           C64X::Fixups Kind = C64X::fixup_c64x_pcr_s21) const;
+
+  unsigned getReg(const MCOperand &MO) const {
+    assert(MO.isReg() && "register operand expected");
+    return C64X::getRegisterNumbering(TRI, MO.getReg());
+  }
+
+  static bool isBSide(const MCOperand &MO) {
+    return C64X::isBSideReg(MO.getReg());
+  }
+
+  static unsigned getUnit(const MCInst &MI, const TargetInstrDesc &TID) {
+    // flexible instructions carry the unit in the trailing form operand
+    if (TID.TSFlags & TMS320C64XII::is_side_inst)
+      return MI.getOperand(TID.getNumOperands() - 1).getImm() >> 1;
+    return GET_UNIT(TID.TSFlags);
+  }
+
+  void fail(const MCInst &MI, const char *Reason) const {
+    report_fatal_error(Twine("cannot encode ")
+                       + TII.get(MI.getOpcode()).getName() + ": " + Reason);
+  }
+
+  static void EmitWord(unsigned Val, raw_ostream &OS) {
+    // little endian
+    for (unsigned i = 0; i != 4; ++i) {
+      OS << char(Val & 0xff);
+      Val >>= 8;
+    }
+  }
+};
+
+} // end anonymous namespace
+
+//-----------------------------------------------------------------------------
+
+MCCodeEmitter *llvm::createTMS320C64XMCCodeEmitter(const Target &,
+                                                   TargetMachine &TM,
+                                                   MCContext &Ctx) {
+  return new TMS320C64XMCCodeEmitter(TM, Ctx);
+}
+
+//-----------------------------------------------------------------------------
+
+void TMS320C64XMCCodeEmitter::EncodeInstruction(const MCInst &MI,
+                                         raw_ostream &OS,
+                                         SmallVectorImpl<MCFixup> &Fixups) const
+{
+  const TargetInstrDesc &TID = TII.get(MI.getOpcode());
+  const MCOperand &Flags = MI.getOperand(MI.getNumOperands() - 1);
+  assert(Flags.isImm() && "packet flags operand missing");
+
+  // compact instructions, the p-bit is kept in the fetch packet header
+  if (Flags.getImm() & TMS320C64XII::mc_compact) {
+    unsigned Bits;
+    if (!C64X::getCompactEncoding(MI, TM, Bits))
+      fail(MI, "no compact form");
+    OS << char(Bits & 0xff) << char((Bits >> 8) & 0xff);
+    ++MCNumEmitted;
+    ++MCNumCompact;
+    return;
+  }
+
+  unsigned Bits = getBinaryCode(MI, TID, Fixups);
+  Bits |= encodeCondition(MI, TID);
+
+  // the p-bit chains the instructions of an execute packet
+  if (Flags.getImm() & TMS320C64XII::mc_parallel)
+    Bits |= 0x1;
+
+  EmitWord(Bits, OS);
+  ++MCNumEmitted;
+}
+
+//-----------------------------------------------------------------------------
+
+bool C64X::hasUnitEncoding(unsigned Opcode, unsigned Unit) {
+  assert(Unit < 4 && "invalid unit");
+  for (unsigned i = 0, e = array_lengthof(ALUTbl); i != e; ++i)
+    if (ALUTbl[i].OpA == Opcode || ALUTbl[i].OpB == Opcode)
+      return ALUTbl[i].Unit[Unit].Fmt != NA;
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+
+// register number, if the register is addressable from 16-bit code
+static bool getCompactReg(const TargetRegisterInfo &TRI, const MCOperand &MO,
+                          unsigned &Num)
+{
+  if (!MO.isReg())
+    return false;
+  Num = C64X::getRegisterNumbering(TRI, MO.getReg());
+  return Num < 8;
+}
+
+// C64x+ compact instructions. Registers are limited to A0-A7/B0-B7 (RS=0),
+// compact instructions are never conditional.
+
+bool C64X::getCompactEncoding(const MCInst &MI, const TargetMachine &TM,
+                              unsigned &Bits)
+{
+  const TargetInstrDesc &TID = TM.getInstrInfo()->get(MI.getOpcode());
+  const TargetRegisterInfo &TRI = *TM.getRegisterInfo();
+
+  for (unsigned i = 0, e = TID.getNumOperands(); i != e; ++i)
+    if (TID.OpInfo[i].isPredicate()) {
+      if (MI.getOperand(i).getImm() != -1)
+        return false;
+      break;
+    }
+
+  unsigned Side = IS_BSIDE(TID.TSFlags) ? 1 : 0;
+  unsigned Unit = (TID.TSFlags & TMS320C64XII::is_side_inst)
+    ? MI.getOperand(TID.getNumOperands() - 1).getImm() >> 1
+    : GET_UNIT(TID.TSFlags);
+
+  unsigned Dst, Src1, Src2;
+  switch (MI.getOpcode()) {
+    // nop n (Unop), 1 to 8 cycles
+    case C64X::noop: {
+      int Cycles = MI.getOperand(0).getImm();
+      if (Cycles < 1 || Cycles > 8)
+        return false;
+      Bits = ((Cycles - 1) << 13) | 0x0c6e;
+      return true;
+    }
+
+    // add/sub .L src1, xsrc2, dst (L3)
+    case C64X::add_rr_1:
+    case C64X::add_rr_2:
+    case C64X::sub_rr_1:
+    case C64X::sub_rr_2: {
+      const MCOperand *S1 = &MI.getOperand(1), *S2 = &MI.getOperand(2);
+      bool IsSub = MI.getOpcode() == C64X::sub_rr_1 ||
+                   MI.getOpcode() == C64X::sub_rr_2;
+      if (Unit != TMS320C64XII::unit_l)
+        return false;
+      if (isBSideReg(S1->getReg()) != (bool) Side) {
+        if (IsSub || isBSideReg(S2->getReg()) != (bool) Side)
+          return false;
+        std::swap(S1, S2);
+      }
+      if (!getCompactReg(TRI, MI.getOperand(0), Dst) ||
+          !getCompactReg(TRI, *S1, Src1) || !getCompactReg(TRI, *S2, Src2))
+        return false;
+      unsigned X = isBSideReg(S2->getReg()) != (bool) Side;
+      Bits = (Src1 << 13) | (X << 12) | (IsSub << 11) | (Src2 << 7)
+           | (Dst << 4) | Side;
+      return true;
+    }
+
+    // add .L scst3, xsrc2, dst (L3i), the constant 0 encodes 8
+    case C64X::add_ri_1:
+    case C64X::add_ri_2:
+    case C64X::sub_ri_1:
+    case C64X::sub_ri_2: {
+      int Cst = MI.getOperand(2).getImm();
+      if (MI.getOpcode() == C64X::sub_ri_1 || MI.getOpcode() == C64X::sub_ri_2)
+        Cst = -Cst;
+      if (Unit != TMS320C64XII::unit_l || Cst == 0 || Cst < -8 || Cst > 8)
+        return false;
+      if (!getCompactReg(TRI, MI.getOperand(0), Dst) ||
+          !getCompactReg(TRI, MI.getOperand(1), Src2))
+        return false;
+      unsigned X = isBSideReg(MI.getOperand(1).getReg()) != (bool) Side;
+      unsigned Sn = Cst < 0;
+      Bits = (((Sn ? -Cst : Cst) & 0x7) << 13) | (X << 12) | (Sn << 11)
+           | (0x1 << 10) | (Src2 << 7) | (Dst << 4) | Side;
+      return true;
+    }
+
+    // ldw/stw .D *ptr[ucst4], with ptr one of A4-A7/B4-B7 (Doff4)
+    case C64X::word_load_1:
+    case C64X::word_load_2:
+    case C64X::word_sload_1:
+    case C64X::word_sload_2:
+    case C64X::word_store_1:
+    case C64X::word_store_2: {
+      bool IsLoad = MI.getOpcode() != C64X::word_store_1 &&
+                    MI.getOpcode() != C64X::word_store_2;
+      const MCOperand &Data = MI.getOperand(IsLoad ? 0 : 2);
+      const MCOperand &Base = MI.getOperand(IsLoad ? 1 : 0);
+      const MCOperand &Offs = MI.getOperand(IsLoad ? 2 : 1);
+      unsigned Ptr, SrcDst;
+      if (!Offs.isImm() || Offs.getImm() < 0 || Offs.getImm() > 15)
+        return false;
+      if (!getCompactReg(TRI, Base, Ptr) || Ptr < 4 ||
+          !getCompactReg(TRI, Data, SrcDst))
+        return false;
+      unsigned Cst = Offs.getImm();
+      unsigned T = isBSideReg(Data.getReg());
+      Bits = ((Cst & 0x7) << 13) | (T << 12) | ((Cst >> 3) << 11)
+           | ((Ptr - 4) << 7) | (SrcDst << 4) | (IsLoad << 3) | (0x2 << 1)
+           | Side;
+      return true;
+    }
+
+    default:
+      return false;
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+unsigned
+TMS320C64XMCCodeEmitter::encodeCondition(const MCInst &MI,
+                                         const TargetInstrDesc &TID) const
+{
+  int PIdx = -1;
+  for (unsigned i = 0, e = TID.getNumOperands(); i != e; ++i)
+    if (TID.OpInfo[i].isPredicate()) {
+      PIdx = i;
+      break;
+    }
+
+  // not predicable, or always executed
+  if (PIdx == -1 || MI.getOperand(PIdx).getImm() == -1)
+    return 0;
+
+  unsigned creg;
+  switch (MI.getOperand(PIdx + 1).getReg()) {
+    case C64X::B0: creg = 0x1; break;
+    case C64X::B1: creg = 0x2; break;
+    case C64X::B2: creg = 0x3; break;
+    case C64X::A1: creg = 0x4; break;
+    case C64X::A2: creg = 0x5; break;
+    case C64X::A0: creg = 0x6; break;
+    default:
+      fail(MI, "invalid predicate register");
+  }
+
+  // z is set for [!reg]
+  unsigned z = MI.getOperand(PIdx).getImm() ? 0 : 1;
+  return (creg << 29) | (z << 28);
+}
+
+//-----------------------------------------------------------------------------
+
+unsigned
+TMS320C64XMCCodeEmitter::getCst16(const MCInst &MI, const MCOperand &MO,
+                                  bool High,
+                                  SmallVectorImpl<MCFixup> &Fixups) const
+{
+  if (MO.isImm())
+    return (High ? (MO.getImm() >> 16) : MO.getImm()) & 0xffff;
+
+  if (!MO.isExpr())
+    fail(MI, "bad constant operand");
+
+  Fixups.push_back(MCFixup::Create(0, MO.getExpr(), MCFixupKind(High
+    ? C64X::fixup_c64x_abs_h16 : C64X::fixup_c64x_abs_l16)));
+  return 0;
+}
+
+unsigned
+TMS320C64XMCCodeEmitter::getBranchTarget(const MCInst &MI, const MCOperand &MO,
+                                       SmallVectorImpl<MCFixup> &Fixups,
+                                       C64X::Fixups Kind) const
+{
+  if (!MO.isExpr())
+    fail(MI, "branch target is not a symbol");
+
+  Fixups.push_back(MCFixup::Create(0, MO.getExpr(), MCFixupKind(Kind)));
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+
+unsigned
+TMS320C64XMCCodeEmitter::encodeALU(const MCInst &MI,
+                                   const TargetInstrDesc &TID,
+                                   const ALUEncoding &Enc) const
+{
+  unsigned Unit = getUnit(MI, TID);
+  const UnitOp &UO = Enc.Unit[Unit];
+  if (UO.Fmt == NA)
+    fail(MI, "no encoding for the assigned functional unit");
+
+  bool Side = IS_BSIDE(TID.TSFlags);
+  const MCOperand *Src1 = 0;
+  const MCOperand *Src2 = &MI.getOperand(1);
+  int Cst = 0;
+
+  switch (Enc.Layout) {
+    case RR:
+    case RRC:
+      Src1 = &MI.getOperand(1);
+      Src2 = &MI.getOperand(2);
+      break;
+    case RI:
+      Cst = MI.getOperand(2).getImm();
+      break;
+    case RIN:
+      Cst = -MI.getOperand(2).getImm();
+      break;
+    case RS:
+      Src1 = &MI.getOperand(2);
+      break;
+    case NEG:
+      break;
+    case UN:
+      Cst = UO.Op;
+      break;
+  }
+
+  // only the src2 field can be read through the cross path
+  if (Src1 && isBSide(*Src1) != Side) {
+    if (Enc.Layout != RRC || isBSide(*Src2) != Side)
+      fail(MI, "cross path operand in the src1 position");
+    std::swap(Src1, Src2);
+  }
+
+  bool XPath = isBSide(*Src2) != Side;
+  unsigned F1 = Src1 ? getReg(*Src1) : (Cst & 0x1f);
+  unsigned F2 = getReg(*Src2);
+
+  if (!Src1 && !TMS320C64XInstrInfo::check_sconst_fits(Cst, 5) &&
+      !TMS320C64XInstrInfo::check_uconst_fits(Cst, 5))
+    fail(MI, "constant out of range");
+
+  unsigned Bits = (getReg(MI.getOperand(0)) << 23) | (Side << 1);
+
+  switch (UO.Fmt) {
+    case FL:
+      Bits |= (UO.Op << 5) | (0x6 << 2);
+      break;
+    case FLU:
+      Bits |= (0x1a << 5) | (0x6 << 2);
+      break;
+    case FS:
+      Bits |= (UO.Op << 6) | (0x8 << 2);
+      break;
+    case FSN:
+      // the creg/z field holds a fixed 0001
+      Bits |= (0x1 << 28) | (UO.Op << 6) | (0xc << 2);
+      break;
+    case FSX:
+      Bits |= (0x3 << 10) | (UO.Op << 6) | (0xc << 2);
+      break;
+    case FD:
+      // no cross path, and the base operand goes to the src2 field
+      if (XPath || !Src1)
+        fail(MI, "operands do not fit the .D format");
+      std::swap(F1, F2);
+      XPath = false;
+      Bits |= (UO.Op << 7) | (0x10 << 2);
+      break;
+    case FDX:
+      Bits |= (0x2 << 10) | (UO.Op << 6) | (0xc << 2);
+      break;
+    case FM:
+      Bits |= UO.Op << 7;
+      break;
+    case FMX:
+      Bits |= (UO.Op << 6) | (0xc << 2);
+      break;
+    case FMU:
+      Bits |= (0x03 << 6) | (0xc << 2);
+      break;
+  }
+
+  return Bits | (F2 << 18) | (F1 << 13) | (XPath << 12);
+}
+
+//-----------------------------------------------------------------------------
+
+unsigned
+TMS320C64XMCCodeEmitter::encodeMem(const MCInst &MI,
+                                   const TargetInstrDesc &TID,
+                                   const MemEncoding &Enc) const
+{
+  unsigned BaseIdx = TMS320C64XII::getMemBaseIdx(TID.TSFlags);
+  const MCOperand &Data =
+    MI.getOperand(TMS320C64XII::getMemDataIdx(TID.TSFlags));
+  const MCOperand &Base = MI.getOperand(BaseIdx);
+  const MCOperand &Offs = MI.getOperand(BaseIdx + 1);
+
+  unsigned Mode, Off;
+  if (TID.TSFlags & TMS320C64XII::is_memwriteback) {
+    // *--R[ucst5], *++R[ucst5], *R--[ucst5] or *R++[ucst5]
+    int Val = Offs.getImm();
+    Mode = (TID.TSFlags & TMS320C64XII::is_premodify) ? 0x8 : 0xa;
+    Mode |= (Val < 0) ? 0x0 : 0x1;
+    Off = (Val < 0) ? -Val : Val;
+    if (Off > 31)
+      fail(MI, "offset out of range");
+  } else if (Offs.isImm()) {
+    // offsets are already scaled, *-R[ucst5] or *+R[ucst5]
+    int Val = Offs.getImm();
+    Mode = (Val < 0) ? 0x0 : 0x1;
+    Off = (Val < 0) ? -Val : Val;
+    if (Off > 31)
+      fail(MI, "offset out of range");
+  } else {
+    // *+R[offsetR]
+    if (isBSide(Offs) != isBSide(Base))
+      fail(MI, "offset and base register on different sides");
+    Mode = 0x5;
+    Off = getReg(Offs);
+  }
+
+  // y selects the .D unit (side of the address), s the register file of the
+  // data (T1/T2 path)
+  unsigned Bits = (getReg(Base) << 18) | (Off << 13) | (Mode << 9)
+                | (Enc.R << 8) | (isBSide(Base) << 7) | (Enc.Op << 4)
+                | (0x1 << 2) | (isBSide(Data) << 1);
+
+  // non-aligned double words use a 4-bit register field and a scale bit
+  if (MI.getOpcode() == C64X::ndword_load_1 ||
+      MI.getOpcode() == C64X::ndword_load_2 ||
+      MI.getOpcode() == C64X::ndword_store_1 ||
+      MI.getOpcode() == C64X::ndword_store_2)
+    return Bits | ((getReg(Data) >> 1) << 24) | (0x1 << 23);
+
+  return Bits | (getReg(Data) << 23);
+}
+
+//-----------------------------------------------------------------------------
+
+unsigned
+TMS320C64XMCCodeEmitter::getBinaryCode(const MCInst &MI,
+                                       const TargetInstrDesc &TID,
+                                       SmallVectorImpl<MCFixup> &Fixups) const
+{
+  unsigned Opc = MI.getOpcode();
+  unsigned Side = IS_BSIDE(TID.TSFlags) ? 1 : 0;
+
+  for (unsigned i = 0, e = array_lengthof(ALUTbl); i != e; ++i)
+    if (ALUTbl[i].OpA == Opc || ALUTbl[i].OpB == Opc)
+      return encodeALU(MI, TID, ALUTbl[i]);
+
+  for (unsigned i = 0, e = array_lengthof(MemTbl); i != e; ++i)
+    if (MemTbl[i].OpA == Opc || MemTbl[i].OpB == Opc)
+      return encodeMem(MI, TID, MemTbl[i]);
+
+  switch (Opc) {
+    case C64X::noop: {
+      int Cycles = MI.getOperand(0).getImm();
+      assert(Cycles >= 1 && Cycles <= 9 && "bad nop count");
+      return (Cycles - 1) << 13;
+    }
+
+    // constants, 16-bit constant in bits 22-7
+    case C64X::mvk_1:
+    case C64X::mvk_2:
+    case C64X::mvkl_1:
+    case C64X::mvkl_2:
+    case C64X::mvkl_label_1:
+    case C64X::mvkl_label_2:
+      return (getReg(MI.getOperand(0)) << 23)
+           | (getCst16(MI, MI.getOperand(1), false, Fixups) << 7)
+           | (0x0a << 2) | (Side << 1);
+
+    case C64X::mvkh_1:
+    case C64X::mvkh_2:
+    case C64X::mvkh_label_1:
+    case C64X::mvkh_label_2:
+      return (getReg(MI.getOperand(0)) << 23)
+           | (getCst16(MI, MI.getOperand(1), true, Fixups) << 7)
+           | (0x1a << 2) | (Side << 1);
+
+    // mvc .S2 src2, AMR (the AMR is control register 0)
+    case C64X::mvc_amr:
+      return (getReg(MI.getOperand(1)) << 18) | (0x0e << 6) | (0x8 << 2)
+           | (0x1 << 1);
+
+    // mvc .S2 src2, ILC (control register 13)
+    case C64X::mvc_ilc:
+      return (0x0d << 23) | (getReg(MI.getOperand(1)) << 18) | (0x0e << 6)
+           | (0x8 << 2) | (0x1 << 1);
+
+    // mvc .S2 src2, TSCL (control register 10)
+    case C64X::mvc_tscl_w:
+      return (0x0a << 23) | (getReg(MI.getOperand(0)) << 18) | (0x0e << 6)
+           | (0x8 << 2) | (0x1 << 1);
+
+    // mvc .S2 TSCL, dst, the control register is in the src2 field
+    case C64X::mvc_tscl_r:
+      return (getReg(MI.getOperand(0)) << 23) | (0x0a << 18) | (0x0f << 6)
+           | (0x8 << 2) | (0x1 << 1);
+
+    // swap2 is packlh2 .S with both sources the same register
+    case C64X::swap2: {
+      const MCOperand &Src = MI.getOperand(1);
+      bool S = isBSide(MI.getOperand(0));
+      if (isBSide(Src) != S)
+        fail(MI, "swap2 reads its operand in the src1 position");
+      return (getReg(MI.getOperand(0)) << 23) | (getReg(Src) << 18)
+           | (getReg(Src) << 13) | (0x10 << 6) | (0x8 << 2) | (S << 1);
+    }
+
+    // loop buffer, nonconditional, ii-1 in bits 27-23 and op in bits 16-13
+    case C64X::sploop:
+    case C64X::sploopd:
+    case C64X::sploopw: {
+      int II = MI.getOperand(0).getImm();
+      if (II < 1 || II > 14)
+        fail(MI, "initiation interval out of range");
+      unsigned Op = Opc == C64X::sploop ? 0xc
+                  : Opc == C64X::sploopd ? 0xd : 0xf;
+      return ((II - 1) << 23) | (0x1 << 17) | (Op << 13);
+    }
+
+    // the stage/cycle field is laid out by the ii, only the kernel closing
+    // right after the first stage is needed
+    case C64X::spkernel:
+      if (MI.getOperand(0).getImm() || MI.getOperand(1).getImm())
+        fail(MI, "spkernel stage and cycle not supported");
+      return (0x1 << 17) | (0xa << 13);
+    case C64X::spkernelr:
+      return (0x1 << 17) | (0xb << 13);
+
+    case C64X::addk_p:
+      return (getReg(MI.getOperand(0)) << 23)
+           | ((MI.getOperand(2).getImm() & 0xffff) << 7)
+           | (0x14 << 2) | (Side << 1);
+
+    // bit field extraction, csta/cstb in bits 17-13 and 12-8
+    case C64X::ext_1:
+    case C64X::ext_2:
+    case C64X::extu_1:
+    case C64X::extu_2:
+    case C64X::ext_v_1:
+    case C64X::ext_v_2:
+    case C64X::extu_v_1:
+    case C64X::extu_v_2: {
+      bool Signed = Opc == C64X::ext_1 || Opc == C64X::ext_2 ||
+                    Opc == C64X::ext_v_1 || Opc == C64X::ext_v_2;
+      bool Var = Opc == C64X::ext_v_1 || Opc == C64X::ext_v_2 ||
+                 Opc == C64X::extu_v_1 || Opc == C64X::extu_v_2;
+      unsigned CstA = MI.getOperand(2).getImm() & 0x1f;
+      unsigned CstB = Var ? (MI.getOperand(3).getImm() & 0x1f) : CstA;
+      if (isBSide(MI.getOperand(1)) != (bool) Side)
+        fail(MI, "field operations have no cross path");
+      return (getReg(MI.getOperand(0)) << 23)
+           | (getReg(MI.getOperand(1)) << 18)
+           | (CstA << 13) | (CstB << 8) | ((Signed ? 0x1 : 0x0) << 6)
+           | (0x2 << 2) | (Side << 1);
+    }
+
+    // address computation (add .L1 base, offset, dst)
+    case C64X::lea_fail: {
+      const MCOperand &Base = MI.getOperand(1);
+      const MCOperand &Offs = MI.getOperand(2);
+      unsigned Bits = (getReg(MI.getOperand(0)) << 23) | (0x6 << 2);
+      if (Offs.isImm()) {
+        if (!TMS320C64XInstrInfo::check_sconst_fits(Offs.getImm(), 5))
+          fail(MI, "constant out of range");
+        return Bits | (getReg(Base) << 18) | ((Offs.getImm() & 0x1f) << 13)
+             | (isBSide(Base) << 12) | (0x02 << 5);
+      }
+      const MCOperand *Src1 = &Base, *Src2 = &Offs;
+      if (isBSide(*Src1))
+        std::swap(Src1, Src2);
+      return Bits | (getReg(*Src2) << 18) | (getReg(*Src1) << 13)
+           | (isBSide(*Src2) << 12) | (0x03 << 5);
+    }
+
+    // stack adjustment around calls, fixed to .D2
+    case C64X::call_start_i:
+      // sub .D2 B15, ucst5, B15
+      return (15 << 23) | (15 << 18)
+           | ((MI.getOperand(0).getImm() & 0x1f) << 13)
+           | (0x13 << 7) | (0x10 << 2) | (0x1 << 1);
+    case C64X::call_end_i:
+      // add .D2 B15, ucst5, B15
+      return (15 << 23) | (15 << 18)
+           | ((MI.getOperand(0).getImm() & 0x1f) << 13)
+           | (0x12 << 7) | (0x10 << 2) | (0x1 << 1);
+    case C64X::call_start_r:
+    case C64X::call_end_r: {
+      // sub/add .D2X B15, src2, B15
+      const MCOperand &Val = MI.getOperand(0);
+      unsigned Op = (Opc == C64X::call_start_r) ? 0xc : 0xa;
+      return (15 << 23) | (getReg(Val) << 18) | (15 << 13)
+           | (!isBSide(Val) << 12) | (0x2 << 10) | (Op << 6)
+           | (0xc << 2) | (0x1 << 1);
+    }
+
+    // branches to labels, 21-bit word displacement in bits 27-7
+    case C64X::branch:
+    case C64X::branch_A:
+    case C64X::branch_B:
+    case C64X::branch_cond:
+    case C64X::call_branch:
+      return (getBranchTarget(MI, MI.getOperand(0), Fixups) << 7)
+           | (0x04 << 2) | (Side << 1);
+
+    // bdec/bpos, 10-bit word displacement in bits 22-13, the counter in the
+    // dst field and N3 (bit 12) set for bdec
+    case C64X::bpos_1:
+    case C64X::bpos_2:
+      return (getReg(MI.getOperand(1)) << 23)
+           | (getBranchTarget(MI, MI.getOperand(0), Fixups,
+                              C64X::fixup_c64x_pcr_s10) << 13)
+           | (0x08 << 2) | (Side << 1);
+    case C64X::bdec_1:
+    case C64X::bdec_2:
+      return (getReg(MI.getOperand(0)) << 23)
+           | (getBranchTarget(MI, MI.getOperand(1), Fixups,
+                              C64X::fixup_c64x_pcr_s10) << 13)
+           | (0x1 << 12) | (0x08 << 2) | (Side << 1);
+
+    // callp writes the return address to B3 and is never conditional
+    case C64X::callp_global:
+    case C64X::callp_extsym:
+      return (0x1 << 28)
+           | (getBranchTarget(MI, MI.getOperand(0), Fixups) << 7)
+           | (0x04 << 2) | (0x1 << 1);
+
+    // register branches (b .S2 src2)
+    case C64X::ret:
+      return (3 << 18) | (0x0d << 6) | (0x8 << 2) | (0x1 << 1);
+    case C64X::branch_reg:
+    case C64X::call_reg: {
+      const MCOperand &Target = MI.getOperand(0);
+      return (getReg(Target) << 18) | (!isBSide(Target) << 12)
+           | (0x0d << 6) | (0x8 << 2) | (0x1 << 1);
+    }
+
+    default:
+      fail(MI, "instruction not supported in object files");
+  }
+  return 0;
+}
@@ -35,3 +35,19 @@ TMS320C64XMachineFunctionInfo::setScheduledCycles(const MachineBasicBlock *BB,
   assert(ScheduledCycles.find(BB) == ScheduledCycles.end());
   ScheduledCycles[BB] = c;
 }
+
+bool
+TMS320C64XMachineFunctionInfo::getCalleeSavedSlot(unsigned Reg,
+    int &FrameIdx) const {
+  DenseMap<unsigned, int>::const_iterator I = CalleeSavedSlots.find(Reg);
+  if (I == CalleeSavedSlots.end())
+    return false;
+  FrameIdx = I->second;
+  return true;
+}
+
+void
+TMS320C64XMachineFunctionInfo::setCalleeSavedSlot(unsigned Reg,
+    int FrameIdx) {
+  CalleeSavedSlots[Reg] = FrameIdx;
+}
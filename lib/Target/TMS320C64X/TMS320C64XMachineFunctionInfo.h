@@ -24,6 +24,9 @@ class TMS320C64XMachineFunctionInfo : public MachineFunctionInfo {
   DenseMap<const MachineBasicBlock*, unsigned> ScheduledCycles;
   unsigned ScheduledCyclesPre;
 
+  // fixed slots of callee saved registers spilled in pairs
+  DenseMap<unsigned, int> CalleeSavedSlots;
+
 public:
   TMS320C64XMachineFunctionInfo() : ScheduledCyclesPre(0) {}
 
@@ -36,6 +39,9 @@ public:
   // pre-pass per function
   unsigned getScheduledCyclesPre() const { return ScheduledCyclesPre; }
   void setScheduledCyclesPre(unsigned c) { ScheduledCyclesPre = c; }
+
+  bool getCalleeSavedSlot(unsigned Reg, int &FrameIdx) const;
+  void setCalleeSavedSlot(unsigned Reg, int FrameIdx);
 };
 
 } // End llvm namespace
@@ -0,0 +1,1474 @@
+//===-- TMS320C64XModuloScheduler.cpp ---------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Software pipelining for the C64x+. Single block innermost loops with a
+// recognizable trip count are modulo scheduled (iterative modulo scheduling,
+// no backtracking) after register allocation. If the initiation interval fits
+// the SPLOOP buffer, the loop is emitted as a hardware loop (ILC counted
+// SPLOOP/SPKERNEL), otherwise it is expanded into prolog, kernel and epilog
+// blocks guarded by a fallback to the original loop for short trip counts.
+//
+// The emitted blocks are bundled already and are skipped by the post RA
+// scheduler.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "modulo-sched"
+
+#include "TMS320C64X.h"
+#include "TMS320C64XHazardRecognizer.h"
+#include "TMS320C64XInstrInfo.h"
+#include "TMS320C64XMachineFunctionInfo.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/CodeGen/MachineDominators.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
+#include "llvm/CodeGen/MachineMemOperand.h"
+#include "llvm/CodeGen/ScheduleDAGInstrs.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include <algorithm>
+#include <climits>
+
+using namespace llvm;
+
+static cl::opt<unsigned>
+MaxModuloII("c64x-sploop-max-ii", cl::Hidden,
+  cl::desc("Maximum initiation interval tried by the modulo scheduler"),
+  cl::init(32));
+
+static cl::opt<unsigned>
+MaxModuloSize("c64x-sploop-max-size", cl::Hidden,
+  cl::desc("Maximum number of instructions of a modulo scheduled loop"),
+  cl::init(64));
+
+STATISTIC(NumSPLoops, "Number of loops emitted as SPLOOP");
+STATISTIC(NumExpandedLoops, "Number of loops expanded to prolog/kernel/epilog");
+
+// the SPLOOP buffer holds at most 14 execute packets per stage
+static const unsigned MaxSPLoopII = 14;
+
+// the kernel of an expanded loop needs to hide the delay slots of its branch
+static const unsigned MinKernelII = 6;
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+/// Dependence between two instructions of the loop body, Distance is the
+/// number of iterations the dependence spans (0 for intra-iteration deps).
+struct ModuloDep {
+  unsigned Other;
+  int Latency;
+  unsigned Distance;
+
+  ModuloDep(unsigned o, int lat, unsigned dist)
+  : Other(o), Latency(lat), Distance(dist) {}
+};
+
+/// Describes the counted loop, the trip count is given by
+/// (Bound + Adjust - Counter) / Step, plus one if the compare reads the
+/// counter before it is updated.
+struct LoopControl {
+  unsigned Counter;
+  int Step;
+  unsigned BoundReg;
+  int BoundImm;
+  int Adjust;
+  bool ReadsUpdated;
+  bool Relational;
+
+  LoopControl()
+  : Counter(0), Step(0), BoundReg(0), BoundImm(0), Adjust(0),
+    ReadsUpdated(false), Relational(false) {}
+};
+
+/// Builds the dependence graph for a loop body, scheduling itself is done
+/// by the pass.
+class ModuloDAG : public ScheduleDAGInstrs {
+  AliasAnalysis *AA;
+
+public:
+  ModuloDAG(MachineFunction &MF,
+            const MachineLoopInfo &MLI,
+            const MachineDominatorTree &MDT,
+            AliasAnalysis *aa)
+  : ScheduleDAGInstrs(MF, MLI, MDT), AA(aa) {}
+
+  virtual void Schedule() { BuildSchedGraph(AA); }
+};
+
+//-----------------------------------------------------------------------------
+
+class TMS320C64XModuloScheduler : public MachineFunctionPass {
+
+  typedef std::vector<TMS320C64XHazardRecognizer*> MRT_t;
+
+  TargetMachine &TM;
+  const TMS320C64XInstrInfo *TII;
+  const TargetRegisterInfo *TRI;
+  TMS320C64XMachineFunctionInfo *MFI;
+
+  // loop body in program order and the dependences between its instructions
+  std::vector<SUnit*> Body;
+  std::vector<SmallVector<ModuloDep, 4> > Preds, Succs;
+
+  // schedule of the body, ie. issue cycle of each instruction
+  std::vector<int> Cycle;
+
+  bool isCandidate(MachineLoop *L,
+                   MachineInstr *&BackBranch,
+                   MachineInstr *&ExitBranch) const;
+
+  MachineInstr *getSingleDef(MachineBasicBlock *MBB, unsigned Reg) const;
+  MachineInstr *getCopiedDef(MachineBasicBlock *MBB, unsigned Reg) const;
+  MachineInstr *getCounterUpdate(MachineBasicBlock *MBB, unsigned Reg,
+                                 int &Step) const;
+  unsigned getPosition(MachineBasicBlock *MBB, const MachineInstr *MI) const;
+  bool analyzeLoopControl(MachineBasicBlock *MBB,
+                          MachineInstr *BackBranch,
+                          LoopControl &LC) const;
+
+  void buildDependences(ModuloDAG &DAG, MachineBasicBlock *MBB);
+  void addLoopCarriedDeps();
+
+  unsigned computeResMII() const;
+  bool hasPositiveCycle(unsigned II) const;
+  unsigned computeRecMII(unsigned MaxII) const;
+
+  bool bookInstruction(TMS320C64XHazardRecognizer *Row, SUnit *SU) const;
+  bool scheduleLoop(unsigned II, MRT_t &MRT);
+  unsigned getScheduleLength() const;
+
+  bool isFree(MachineBasicBlock *MBB, unsigned Reg) const;
+  unsigned findFreeReg(MachineBasicBlock *MBB,
+                       const TargetRegisterClass *RC,
+                       unsigned Avoid = 0) const;
+
+  void emitTripCount(MachineBasicBlock *MBB, const LoopControl &LC,
+                     unsigned Reg, unsigned &Cycles) const;
+  void emitSingle(MachineBasicBlock *MBB, MachineInstr *MI,
+                  unsigned &Cycles) const;
+  void emitNoops(MachineBasicBlock *MBB, unsigned Count,
+                 unsigned &Cycles) const;
+  void emitBundle(MachineBasicBlock *MBB,
+                  SmallVectorImpl<MachineInstr*> &Bundle,
+                  unsigned &Cycles) const;
+
+  void detachLoop(MachineBasicBlock *MBB);
+  void emitExit(MachineBasicBlock *MBB, MachineInstr *ExitBranch,
+                int Drain, unsigned &Cycles) const;
+
+  bool emitSPLoop(MachineBasicBlock *MBB, MachineInstr *ExitBranch,
+                  const LoopControl &LC, unsigned II);
+
+  bool expandLoop(MachineBasicBlock *MBB, MachineInstr *ExitBranch,
+                  const LoopControl &LC, unsigned MII);
+
+  bool pipelineLoop(MachineFunction &MF, MachineLoop *L);
+
+public:
+
+  static char ID;
+
+  TMS320C64XModuloScheduler(TargetMachine &tm)
+  : MachineFunctionPass(ID), TM(tm), TII(0), TRI(0), MFI(0) {}
+
+  void getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.addRequired<AliasAnalysis>();
+    AU.addRequired<MachineDominatorTree>();
+    AU.addRequired<MachineLoopInfo>();
+    MachineFunctionPass::getAnalysisUsage(AU);
+  }
+
+  const char *getPassName() const {
+    return "C64x+ modulo scheduler";
+  }
+
+  bool runOnMachineFunction(MachineFunction &MF);
+};
+
+char TMS320C64XModuloScheduler::ID = 0;
+
+} // end anonymous namespace
+
+//-----------------------------------------------------------------------------
+
+FunctionPass *llvm::createTMS320C64XModuloScheduler(TargetMachine &tm) {
+  return new TMS320C64XModuloScheduler(tm);
+}
+
+//-----------------------------------------------------------------------------
+
+static void collectInnermostLoops(MachineLoop *L,
+                                  SmallVectorImpl<MachineLoop*> &Loops) {
+  if (L->begin() == L->end()) {
+    Loops.push_back(L);
+    return;
+  }
+  for (MachineLoop::iterator I = L->begin(), E = L->end(); I != E; ++I)
+    collectInnermostLoops(*I, Loops);
+}
+
+//-----------------------------------------------------------------------------
+
+bool TMS320C64XModuloScheduler::runOnMachineFunction(MachineFunction &MF) {
+  TII = static_cast<const TMS320C64XInstrInfo*>(TM.getInstrInfo());
+  TRI = TM.getRegisterInfo();
+  MFI = MF.getInfo<TMS320C64XMachineFunctionInfo>();
+
+  // we depend on accurate latencies derived from the itineraries
+  assert(TM.getInstrItineraryData() &&
+         !TM.getInstrItineraryData()->isEmpty());
+
+  MachineLoopInfo &MLI = getAnalysis<MachineLoopInfo>();
+
+  // collect the loops up front, the transformation changes the CFG
+  SmallVector<MachineLoop*, 8> Loops;
+  for (MachineLoopInfo::iterator I = MLI.begin(), E = MLI.end(); I != E; ++I)
+    collectInnermostLoops(*I, Loops);
+
+  bool Changed = false;
+  for (unsigned i = 0, e = Loops.size(); i != e; ++i)
+    Changed |= pipelineLoop(MF, Loops[i]);
+
+  return Changed;
+}
+
+//-----------------------------------------------------------------------------
+
+bool TMS320C64XModuloScheduler::isCandidate(MachineLoop *L,
+                                            MachineInstr *&BackBranch,
+                                            MachineInstr *&ExitBranch) const
+{
+  if (L->getBlocks().size() != 1)
+    return false;
+
+  MachineBasicBlock *MBB = L->getHeader();
+  if (!MBB->isSuccessor(MBB) || MBB->succ_size() != 2)
+    return false;
+
+  BackBranch = ExitBranch = 0;
+  unsigned Size = 0;
+
+  for (MachineBasicBlock::iterator I = MBB->begin(), E = MBB->end();
+       I != E; ++I) {
+    const TargetInstrDesc &Desc = I->getDesc();
+
+    if (Desc.isTerminator()) {
+      if (!BackBranch && (I->getOpcode() == TMS320C64X::branch_cond
+                          || I->getOpcode() == TMS320C64X::bpos_1
+                          || I->getOpcode() == TMS320C64X::bpos_2)
+          && I->getOperand(0).getMBB() == MBB)
+        BackBranch = I;
+      else if (BackBranch && !ExitBranch
+               && I->getOpcode() == TMS320C64X::branch)
+        ExitBranch = I;
+      else
+        return false;
+      continue;
+    }
+
+    // nothing may follow the terminators
+    if (BackBranch)
+      return false;
+
+    if (I->isDebugValue())
+      continue;
+
+    if (Desc.isCall() || Desc.isBranch() || Desc.isReturn()
+        || I->isInlineAsm() || I->isLabel()
+        || I->hasUnmodeledSideEffects())
+      return false;
+
+    switch (I->getOpcode()) {
+      case TMS320C64X::noop:
+      case TMS320C64X::prolog:
+      case TMS320C64X::epilog:
+      case TMS320C64X::BUNDLE_END:
+      case TMS320C64X::BR_OCCURS:
+      case TMS320C64X::call_return_label:
+      case TMS320C64X::mvc_ilc:
+      case TMS320C64X::mvc_amr:
+      case TMS320C64X::sploop:
+      case TMS320C64X::sploopd:
+      case TMS320C64X::sploopw:
+      case TMS320C64X::spkernel:
+      case TMS320C64X::spkernelr:
+        return false;
+    }
+
+    // all remaining target independent pseudos are off limits
+    if (I->getOpcode() <= TargetOpcode::COPY)
+      return false;
+
+    // the reservation table books a single cycle per instruction, units kept
+    // busy for longer (double precision arithmetic) are not modelled
+    if (GET_UNIT_BUSY(Desc.TSFlags))
+      return false;
+
+    ++Size;
+  }
+
+  if (!BackBranch || !Size || Size > MaxModuloSize)
+    return false;
+
+  // the loop needs to fall through to the exit if it is not branching there
+  MachineBasicBlock *Exit = *MBB->succ_begin() == MBB
+    ? *llvm::next(MBB->succ_begin()) : *MBB->succ_begin();
+
+  if (ExitBranch)
+    return ExitBranch->getOperand(0).getMBB() == Exit;
+  return MBB->isLayoutSuccessor(Exit);
+}
+
+//-----------------------------------------------------------------------------
+
+MachineInstr *
+TMS320C64XModuloScheduler::getSingleDef(MachineBasicBlock *MBB,
+                                        unsigned Reg) const
+{
+  MachineInstr *Def = 0;
+  for (MachineBasicBlock::iterator I = MBB->begin(), E = MBB->end();
+       I != E; ++I) {
+    for (unsigned i = 0, e = I->getNumOperands(); i != e; ++i) {
+      const MachineOperand &MO = I->getOperand(i);
+      if (!MO.isReg() || !MO.isDef() || !MO.getReg())
+        continue;
+      if (!TRI->regsOverlap(MO.getReg(), Reg))
+        continue;
+      if (Def)
+        return 0;
+      Def = I;
+      break;
+    }
+  }
+  return Def;
+}
+
+//-----------------------------------------------------------------------------
+//
+// The register allocator does not always assign the compare result to the
+// predicate register directly, but copies it over (cmplt A5, A3, A8;
+// mv A8, A0). Returns the single def of Reg with such copies looked through.
+//
+MachineInstr *
+TMS320C64XModuloScheduler::getCopiedDef(MachineBasicBlock *MBB,
+                                        unsigned Reg) const
+{
+  MachineInstr *Def = getSingleDef(MBB, Reg);
+  while (Def && Def->getOpcode() == TMS320C64X::mv
+         && !TII->isPredicated(Def)) {
+    MachineInstr *Copy = Def;
+    Def = getSingleDef(MBB, Copy->getOperand(1).getReg());
+    if (Def && getPosition(MBB, Def) > getPosition(MBB, Copy))
+      return 0;
+  }
+  return Def;
+}
+
+//-----------------------------------------------------------------------------
+
+MachineInstr *
+TMS320C64XModuloScheduler::getCounterUpdate(MachineBasicBlock *MBB,
+                                            unsigned Reg,
+                                            int &Step) const
+{
+  MachineInstr *Def = getSingleDef(MBB, Reg);
+  if (!Def || TII->isPredicated(Def))
+    return 0;
+
+  switch (Def->getOpcode()) {
+    case TMS320C64X::add_ri_1:
+    case TMS320C64X::add_ri_2:
+    case TMS320C64X::addk_p:
+      Step = Def->getOperand(2).getImm();
+      break;
+    case TMS320C64X::sub_ri_1:
+    case TMS320C64X::sub_ri_2:
+      Step = -Def->getOperand(2).getImm();
+      break;
+    default:
+      return 0;
+  }
+
+  if (!Step || Def->getOperand(0).getReg() != Reg
+      || !Def->getOperand(1).isReg() || Def->getOperand(1).getReg() != Reg)
+    return 0;
+
+  return Def;
+}
+
+//-----------------------------------------------------------------------------
+
+unsigned
+TMS320C64XModuloScheduler::getPosition(MachineBasicBlock *MBB,
+                                       const MachineInstr *MI) const
+{
+  unsigned Pos = 0;
+  for (MachineBasicBlock::iterator I = MBB->begin(); &*I != MI; ++I)
+    ++Pos;
+  return Pos;
+}
+
+//-----------------------------------------------------------------------------
+//
+// The counted loops emitted by the selector close with a compare of the
+// induction variable against an invariant bound (possibly negated through
+// xor with 1) and a conditional branch back to the header, or with bpos on
+// a down counter (see BranchOnCounter.cpp). Derive the trip count from this,
+// we need it as the ILC value for hardware loops and for the stage guard of
+// expanded loops.
+//
+bool
+TMS320C64XModuloScheduler::analyzeLoopControl(MachineBasicBlock *MBB,
+                                              MachineInstr *BackBranch,
+                                              LoopControl &LC) const
+{
+  // bpos continues while the decremented counter is not negative
+  if (TMS320C64XInstrInfo::isCounterBranch(BackBranch)) {
+    LC.Counter = BackBranch->getOperand(1).getReg();
+    if (!getCounterUpdate(MBB, LC.Counter, LC.Step) || LC.Step != -1)
+      return false;
+    LC.BoundImm = -1;
+    LC.Relational = true;
+    LC.ReadsUpdated = true;
+    return true;
+  }
+
+  bool ContinueIfSet = BackBranch->getOperand(1).getImm();
+  unsigned Pred = BackBranch->getOperand(2).getReg();
+
+  MachineInstr *Cmp = getCopiedDef(MBB, Pred);
+  if (!Cmp || TII->isPredicated(Cmp))
+    return false;
+
+  if (Cmp->getOpcode() == TMS320C64X::xor_p_ri) {
+    if (Cmp->getOperand(2).getImm() != 1)
+      return false;
+
+    MachineInstr *Inv = Cmp;
+    Cmp = getCopiedDef(MBB, Inv->getOperand(1).getReg());
+    if (!Cmp || TII->isPredicated(Cmp)
+        || getPosition(MBB, Cmp) > getPosition(MBB, Inv))
+      return false;
+    ContinueIfSet = !ContinueIfSet;
+  }
+
+  enum { CmpEQ, CmpLT, CmpGT } Kind;
+  switch (Cmp->getOpcode()) {
+    case TMS320C64X::cmpeq_p_rr:
+    case TMS320C64X::cmpeq_p_ri: Kind = CmpEQ; break;
+    case TMS320C64X::cmplt_p_rr: Kind = CmpLT; break;
+    case TMS320C64X::cmpgt_p_rr: Kind = CmpGT; break;
+    default: return false;
+  }
+
+  const MachineOperand &Op1 = Cmp->getOperand(1);
+  const MachineOperand &Op2 = Cmp->getOperand(2);
+
+  // find out which of the compare operands is the induction variable
+  MachineInstr *Update = 0;
+  bool Swapped = false;
+  if (Op1.isReg() && (Update = getCounterUpdate(MBB, Op1.getReg(), LC.Step)))
+    LC.Counter = Op1.getReg();
+  else if (Op2.isReg()
+           && (Update = getCounterUpdate(MBB, Op2.getReg(), LC.Step))) {
+    LC.Counter = Op2.getReg();
+    Swapped = true;
+  }
+  else
+    return false;
+
+  // the bound must be loop invariant
+  const MachineOperand &Bound = Swapped ? Op1 : Op2;
+  if (Bound.isReg()) {
+    for (MachineBasicBlock::iterator I = MBB->begin(), E = MBB->end();
+         I != E; ++I)
+      if (I->modifiesRegister(Bound.getReg(), TRI))
+        return false;
+    LC.BoundReg = Bound.getReg();
+  }
+  else
+    LC.BoundImm = Bound.getImm();
+
+  if (Swapped && Kind != CmpEQ)
+    Kind = (Kind == CmpLT) ? CmpGT : CmpLT;
+
+  // normalize to an exit once the counter hits Bound + Adjust
+  int AbsStep = LC.Step < 0 ? -LC.Step : LC.Step;
+  switch (Kind) {
+    case CmpEQ:
+      // while (i != n), the step needs to divide the distance. we can only
+      // cope with power of two steps (that are assumed to hit the bound)
+      if (ContinueIfSet || !isPowerOf2_32(AbsStep))
+        return false;
+      LC.Adjust = 0;
+      break;
+    case CmpLT:
+      // while (i < n) counts up, while (i >= n) counts down
+      if (LC.Step != (ContinueIfSet ? 1 : -1))
+        return false;
+      LC.Adjust = ContinueIfSet ? 0 : -1;
+      LC.Relational = true;
+      break;
+    case CmpGT:
+      // while (i > n) counts down, while (i <= n) counts up
+      if (LC.Step != (ContinueIfSet ? -1 : 1))
+        return false;
+      LC.Adjust = ContinueIfSet ? 0 : 1;
+      LC.Relational = true;
+      break;
+  }
+
+  LC.ReadsUpdated = getPosition(MBB, Update) < getPosition(MBB, Cmp);
+
+  DEBUG(dbgs() << "counted loop: step " << LC.Step << ", adjust "
+               << LC.Adjust << (LC.ReadsUpdated ? ", updated" : "") << "\n");
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void TMS320C64XModuloScheduler::buildDependences(ModuloDAG &DAG,
+                                                 MachineBasicBlock *MBB)
+{
+  DenseMap<MachineInstr*, SUnit*> MI2SU;
+  for (unsigned i = 0, e = DAG.SUnits.size(); i != e; ++i)
+    MI2SU[DAG.SUnits[i].getInstr()] = &DAG.SUnits[i];
+
+  // program order
+  Body.clear();
+  for (MachineBasicBlock::iterator I = MBB->begin(), E = MBB->end();
+       I != E; ++I) {
+    DenseMap<MachineInstr*, SUnit*>::iterator S = MI2SU.find(I);
+    if (S != MI2SU.end())
+      Body.push_back(S->second);
+  }
+
+  std::vector<int> Index(DAG.SUnits.size(), -1);
+  for (unsigned i = 0, e = Body.size(); i != e; ++i)
+    Index[Body[i]->NodeNum] = i;
+
+  Preds.assign(Body.size(), SmallVector<ModuloDep, 4>());
+  Succs.assign(Body.size(), SmallVector<ModuloDep, 4>());
+
+  for (unsigned i = 0, e = Body.size(); i != e; ++i) {
+    SUnit *SU = Body[i];
+    for (SUnit::const_succ_iterator I = SU->Succs.begin(),
+         E = SU->Succs.end(); I != E; ++I) {
+      SUnit *Succ = I->getSUnit();
+      // ignore the region boundary
+      if (Succ == &DAG.ExitSU || Succ == &DAG.EntrySU)
+        continue;
+      int j = Index[Succ->NodeNum];
+      assert(j >= 0 && "successor outside of the loop body");
+      Succs[i].push_back(ModuloDep(j, I->getLatency(), 0));
+      Preds[j].push_back(ModuloDep(i, I->getLatency(), 0));
+    }
+  }
+
+  addLoopCarriedDeps();
+}
+
+//-----------------------------------------------------------------------------
+
+static bool mayAliasAcrossIterations(const MachineInstr *A,
+                                     const MachineInstr *B) {
+  if (!A->hasOneMemOperand() || !B->hasOneMemOperand())
+    return true;
+
+  const Value *VA = (*A->memoperands_begin())->getValue();
+  const Value *VB = (*B->memoperands_begin())->getValue();
+  if (!VA || !VB)
+    return true;
+
+  // offsets within an iteration don't tell anything about the next one, only
+  // distinct identified objects are safe
+  const Value *OA = GetUnderlyingObject(VA);
+  const Value *OB = GetUnderlyingObject(VB);
+  return OA == OB || !isIdentifiedObject(OA) || !isIdentifiedObject(OB);
+}
+
+//-----------------------------------------------------------------------------
+
+void TMS320C64XModuloScheduler::addLoopCarriedDeps() {
+  const InstrItineraryData *IID = TM.getInstrItineraryData();
+  unsigned N = Body.size();
+
+  for (unsigned i = 0; i != N; ++i) {
+    MachineInstr *MI = Body[i]->getInstr();
+
+    for (unsigned o = 0, oe = MI->getNumOperands(); o != oe; ++o) {
+      const MachineOperand &MO = MI->getOperand(o);
+      if (!MO.isReg() || !MO.isDef() || !MO.getReg())
+        continue;
+      unsigned Reg = MO.getReg();
+
+      // only the last definition in the body reaches the next iteration
+      bool isLast = true;
+      for (unsigned k = i + 1; k != N && isLast; ++k)
+        if (Body[k]->getInstr()->modifiesRegister(Reg, TRI))
+          isLast = false;
+
+      bool isFirst = true;
+      for (unsigned k = 0; k != i && isFirst; ++k)
+        if (Body[k]->getInstr()->modifiesRegister(Reg, TRI))
+          isFirst = false;
+
+      for (unsigned j = 0; j != N; ++j) {
+        MachineInstr *Other = Body[j]->getInstr();
+
+        // true dependence to uses preceding the first def
+        if (isLast && Other->readsRegister(Reg, TRI)) {
+          bool Upward = true;
+          for (unsigned k = 0; k != j && Upward; ++k)
+            if (Body[k]->getInstr()->modifiesRegister(Reg, TRI))
+              Upward = false;
+          if (Upward) {
+            int Lat = TII->getDefLatency(IID, MI, Reg);
+            Succs[i].push_back(ModuloDep(j, Lat, 1));
+            Preds[j].push_back(ModuloDep(i, Lat, 1));
+          }
+        }
+
+        // anti dependence of uses on the def of the next iteration. the
+        // pipeline is exposed, the def may issue before the use as long as
+        // its result lands after it. Register lifetimes are thereby bound by
+        // the II, we don't unroll the kernel to rename registers.
+        if (isFirst && i != j && Other->readsRegister(Reg, TRI)) {
+          int Lat = 1 - (int)TII->getDefLatency(IID, MI, Reg);
+          Succs[j].push_back(ModuloDep(i, Lat, 1));
+          Preds[i].push_back(ModuloDep(j, Lat, 1));
+        }
+
+        // output dependence: the next first def must land after the last one
+        if (isFirst && i != j && Other->modifiesRegister(Reg, TRI)) {
+          bool OtherIsLast = true;
+          for (unsigned k = j + 1; k != N && OtherIsLast; ++k)
+            if (Body[k]->getInstr()->modifiesRegister(Reg, TRI))
+              OtherIsLast = false;
+          if (OtherIsLast) {
+            int Lat = std::max(1, (int)TII->getDefLatency(IID, Other, Reg)
+                                  - (int)TII->getDefLatency(IID, MI, Reg) + 1);
+            Succs[j].push_back(ModuloDep(i, Lat, 1));
+            Preds[i].push_back(ModuloDep(j, Lat, 1));
+          }
+        }
+      }
+    }
+  }
+
+  // memory dependences into the next iteration
+  for (unsigned i = 0; i != N; ++i) {
+    const TargetInstrDesc &DI = Body[i]->getInstr()->getDesc();
+    if (!DI.mayLoad() && !DI.mayStore())
+      continue;
+
+    for (unsigned j = 0; j != N; ++j) {
+      if (i == j)
+        continue;
+      const TargetInstrDesc &DJ = Body[j]->getInstr()->getDesc();
+      if (!DJ.mayLoad() && !DJ.mayStore())
+        continue;
+      if (!DI.mayStore() && !DJ.mayStore())
+        continue;
+      if (!mayAliasAcrossIterations(Body[i]->getInstr(), Body[j]->getInstr()))
+        continue;
+
+      int Lat = DI.mayStore() ? 1 : 0;
+      Succs[i].push_back(ModuloDep(j, Lat, 1));
+      Preds[j].push_back(ModuloDep(i, Lat, 1));
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+//
+// resource bound of the initiation interval. flexible instructions can use
+// any of the units they support, so we count them per side only.
+//
+unsigned TMS320C64XModuloScheduler::computeResMII() const {
+  using namespace TMS320C64XII;
+
+  unsigned Fixed[8] = { 0 };
+  unsigned Extra[TMS320C64X::NumExtra] = { 0 };
+  unsigned OnSide[2] = { 0 }, NoMOnSide[2] = { 0 };
+
+  for (unsigned i = 0, e = Body.size(); i != e; ++i) {
+    SUnit *SU = Body[i];
+    MachineInstr *MI = SU->getInstr();
+
+    if (MI->getOpcode() == TMS320C64X::mv) {
+      unsigned side, xuse;
+      tie(side, xuse) = TMS320C64XHazardRecognizer::analyzeMove(SU);
+      OnSide[side]++;
+      NoMOnSide[side]++;
+      Extra[xuse]++;
+      continue;
+    }
+
+    const TargetInstrDesc &Desc = MI->getDesc();
+    unsigned side = IS_BSIDE(Desc.TSFlags) ? 1 : 0;
+    unsigned support = Desc.TSFlags & unit_support_mask;
+
+    OnSide[side]++;
+    if (TMS320C64XInstrInfo::isFlexible(Desc)) {
+      if (!(support & (1 << unit_m)))
+        NoMOnSide[side]++;
+    }
+    else {
+      unsigned unit = GET_UNIT(Desc.TSFlags);
+      Fixed[unit << 1 | side]++;
+      if (unit != unit_m)
+        NoMOnSide[side]++;
+    }
+
+    Extra[TMS320C64X::ResourceAssignment::getExtraUse(SU)]++;
+  }
+
+  unsigned MII = 1;
+  for (unsigned i = 0; i != 8; ++i)
+    MII = std::max(MII, Fixed[i]);
+  for (unsigned i = TMS320C64X::T1; i != TMS320C64X::NumExtra; ++i)
+    MII = std::max(MII, Extra[i]);
+  for (unsigned side = 0; side != 2; ++side) {
+    MII = std::max(MII, (OnSide[side] + 3) / 4);
+    MII = std::max(MII, (NoMOnSide[side] + 2) / 3);
+  }
+  return MII;
+}
+
+//-----------------------------------------------------------------------------
+
+bool TMS320C64XModuloScheduler::hasPositiveCycle(unsigned II) const {
+  unsigned N = Body.size();
+  std::vector<int> Dist(N, 0);
+
+  // longest paths with edge weights latency - II * distance, any relaxation
+  // in the N-th round implies a positive cycle
+  for (unsigned round = 0; round <= N; ++round) {
+    bool Changed = false;
+    for (unsigned i = 0; i != N; ++i)
+      for (unsigned k = 0, ke = Succs[i].size(); k != ke; ++k) {
+        const ModuloDep &D = Succs[i][k];
+        int d = Dist[i] + D.Latency - (int)(II * D.Distance);
+        if (d > Dist[D.Other]) {
+          Dist[D.Other] = d;
+          Changed = true;
+        }
+      }
+    if (!Changed)
+      return false;
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+unsigned TMS320C64XModuloScheduler::computeRecMII(unsigned MaxII) const {
+  // feasibility is monotonic in II, do a binary search
+  unsigned Lo = 1, Hi = MaxII;
+  if (hasPositiveCycle(Hi))
+    return MaxII + 1;
+
+  while (Lo < Hi) {
+    unsigned Mid = (Lo + Hi) / 2;
+    if (hasPositiveCycle(Mid))
+      Lo = Mid + 1;
+    else
+      Hi = Mid;
+  }
+  return Lo;
+}
+
+//-----------------------------------------------------------------------------
+//
+// try to book SU in the given row of the reservation table. flexible
+// instructions are tried on all units they support (in the same order the
+// resource assignment uses).
+//
+bool
+TMS320C64XModuloScheduler::bookInstruction(TMS320C64XHazardRecognizer *Row,
+                                           SUnit *SU) const
+{
+  using namespace TMS320C64XII;
+
+  MachineInstr *MI = SU->getInstr();
+  const TargetInstrDesc &Desc = MI->getDesc();
+
+  if (!TMS320C64XInstrInfo::isFlexible(Desc)) {
+    if (Row->getHazardType(SU, 0) != ScheduleHazardRecognizer::NoHazard)
+      return false;
+    Row->EmitInstruction(SU);
+    return true;
+  }
+
+  static const unsigned UnitPrio[] = { unit_l, unit_s, unit_m, unit_d };
+  unsigned support = Desc.TSFlags & unit_support_mask;
+  MachineOperand &Form = MI->getOperand(MI->getDesc().getNumOperands() - 1);
+  assert(Form.isImm());
+
+  for (unsigned i = 0; i != array_lengthof(UnitPrio); ++i) {
+    if (!(support & (1 << UnitPrio[i])))
+      continue;
+    Form.setImm((UnitPrio[i] << 1) | (Form.getImm() & 0x1));
+    if (Row->getHazardType(SU, 0) == ScheduleHazardRecognizer::NoHazard) {
+      Row->EmitInstruction(SU);
+      return true;
+    }
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+//
+// iterative modulo scheduling without backtracking. instructions are placed
+// in order of their depth, each one at the earliest cycle satisfying the
+// dependences to already placed instructions where the modulo reservation
+// table has a free unit.
+//
+bool TMS320C64XModuloScheduler::scheduleLoop(unsigned II, MRT_t &MRT) {
+  unsigned N = Body.size();
+
+  std::vector<unsigned> Order(N);
+  for (unsigned i = 0; i != N; ++i)
+    Order[i] = i;
+
+  // stable on program order, which is a valid topological order
+  for (unsigned i = 1; i < N; ++i)
+    for (unsigned j = i; j > 0
+         && Body[Order[j]]->getDepth() < Body[Order[j-1]]->getDepth(); --j)
+      std::swap(Order[j], Order[j-1]);
+
+  Cycle.assign(N, -1);
+
+  for (unsigned o = 0; o != N; ++o) {
+    unsigned i = Order[o];
+    int Early = 0, Late = INT_MAX;
+
+    for (unsigned k = 0, ke = Preds[i].size(); k != ke; ++k) {
+      const ModuloDep &D = Preds[i][k];
+      if (D.Other != i && Cycle[D.Other] >= 0)
+        Early = std::max(Early, Cycle[D.Other] + D.Latency
+                                - (int)(II * D.Distance));
+    }
+    for (unsigned k = 0, ke = Succs[i].size(); k != ke; ++k) {
+      const ModuloDep &D = Succs[i][k];
+      if (D.Other != i && Cycle[D.Other] >= 0)
+        Late = std::min(Late, Cycle[D.Other] - D.Latency
+                              + (int)(II * D.Distance));
+    }
+
+    int Last = std::min(Late, Early + (int)II - 1);
+    for (int t = Early; t <= Last; ++t) {
+      if (bookInstruction(MRT[t % II], Body[i])) {
+        Cycle[i] = t;
+        break;
+      }
+    }
+
+    if (Cycle[i] < 0) {
+      DEBUG(dbgs() << "II " << II << ": no slot for ";
+            Body[i]->getInstr()->dump());
+      return false;
+    }
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+unsigned TMS320C64XModuloScheduler::getScheduleLength() const {
+  int Len = 0;
+  for (unsigned i = 0, e = Cycle.size(); i != e; ++i)
+    Len = std::max(Len, Cycle[i] + 1);
+  return Len;
+}
+
+//-----------------------------------------------------------------------------
+
+bool TMS320C64XModuloScheduler::isFree(MachineBasicBlock *MBB,
+                                       unsigned Reg) const
+{
+  MachineFunction &MF = *MBB->getParent();
+
+  if (TRI->getReservedRegs(MF).test(Reg) || Reg == TMS320C64X::B3)
+    return false;
+
+  // callee saved registers are only spilled if the allocator used them
+  for (const unsigned *CS = TRI->getCalleeSavedRegs(&MF); *CS; ++CS)
+    if (TRI->regsOverlap(*CS, Reg))
+      return false;
+
+  for (MachineBasicBlock::livein_iterator I = MBB->livein_begin(),
+       E = MBB->livein_end(); I != E; ++I)
+    if (TRI->regsOverlap(*I, Reg))
+      return false;
+
+  for (MachineBasicBlock::succ_iterator S = MBB->succ_begin(),
+       SE = MBB->succ_end(); S != SE; ++S)
+    for (MachineBasicBlock::livein_iterator I = (*S)->livein_begin(),
+         E = (*S)->livein_end(); I != E; ++I)
+      if (TRI->regsOverlap(*I, Reg))
+        return false;
+
+  for (MachineBasicBlock::iterator I = MBB->begin(), E = MBB->end();
+       I != E; ++I)
+    for (unsigned i = 0, e = I->getNumOperands(); i != e; ++i) {
+      const MachineOperand &MO = I->getOperand(i);
+      if (MO.isReg() && MO.getReg() && TRI->regsOverlap(MO.getReg(), Reg))
+        return false;
+    }
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+unsigned
+TMS320C64XModuloScheduler::findFreeReg(MachineBasicBlock *MBB,
+                                       const TargetRegisterClass *RC,
+                                       unsigned Avoid) const
+{
+  MachineFunction &MF = *MBB->getParent();
+  for (TargetRegisterClass::iterator I = RC->allocation_order_begin(MF),
+       E = RC->allocation_order_end(MF); I != E; ++I) {
+    if (Avoid && TRI->regsOverlap(*I, Avoid))
+      continue;
+    if (isFree(MBB, *I))
+      return *I;
+  }
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+
+void TMS320C64XModuloScheduler::emitSingle(MachineBasicBlock *MBB,
+                                           MachineInstr *MI,
+                                           unsigned &Cycles) const
+{
+  MBB->push_back(MI);
+  TII->insertBundleEnd(*MBB, MBB->end());
+  ++Cycles;
+}
+
+//-----------------------------------------------------------------------------
+
+void TMS320C64XModuloScheduler::emitNoops(MachineBasicBlock *MBB,
+                                          unsigned Count,
+                                          unsigned &Cycles) const
+{
+  if (!Count)
+    return;
+
+  DebugLoc dl;
+  TMS320C64XInstrInfo::addDefaultPred(BuildMI(*MBB, MBB->end(), dl,
+    TII->get(TMS320C64X::noop)).addImm(Count));
+  TII->insertBundleEnd(*MBB, MBB->end());
+  Cycles += Count;
+}
+
+//-----------------------------------------------------------------------------
+
+void TMS320C64XModuloScheduler::emitBundle(MachineBasicBlock *MBB,
+                                   SmallVectorImpl<MachineInstr*> &Bundle,
+                                   unsigned &Cycles) const
+{
+  if (Bundle.empty()) {
+    emitNoops(MBB, 1, Cycles);
+    return;
+  }
+
+  for (unsigned i = 0, e = Bundle.size(); i != e; ++i)
+    MBB->push_back(Bundle[i]);
+  TII->insertBundleEnd(*MBB, MBB->end());
+  ++Cycles;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Reg = (Bound + Adjust - Counter) / Step (+ 1), one instruction per cycle
+//
+void TMS320C64XModuloScheduler::emitTripCount(MachineBasicBlock *MBB,
+                                              const LoopControl &LC,
+                                              unsigned Reg,
+                                              unsigned &Cycles) const
+{
+  using namespace TMS320C64XII;
+
+  MachineFunction &MF = *MBB->getParent();
+  DebugLoc dl;
+
+  int side = TMS320C64X::BRegsRegClass.contains(Reg) ? 1 : 0;
+  bool xpath = side != (TMS320C64X::BRegsRegClass.contains(LC.Counter) ? 1:0);
+
+  if (LC.BoundReg)
+    emitSingle(MBB, TMS320C64XInstrInfo::addDefaultPred(BuildMI(MF, dl,
+      TII->get(TMS320C64X::mv), Reg).addReg(LC.BoundReg)), Cycles);
+  else
+    emitSingle(MBB, TMS320C64XInstrInfo::addFormOp(
+      TMS320C64XInstrInfo::addDefaultPred(BuildMI(MF, dl,
+        TII->get(TII->getSideOpcode(TMS320C64X::mvk_1, side)), Reg)
+          .addImm(LC.BoundImm)), unit_s), Cycles);
+
+  emitSingle(MBB, TMS320C64XInstrInfo::addFormOp(
+    TMS320C64XInstrInfo::addDefaultPred(BuildMI(MF, dl,
+      TII->get(TII->getSideOpcode(TMS320C64X::sub_rr_1, side)), Reg)
+        .addReg(Reg).addReg(LC.Counter)), unit_l, xpath), Cycles);
+
+  int Adjust = LC.Adjust + (LC.ReadsUpdated ? 0 : LC.Step);
+  unsigned Shift = Log2_32(LC.Step < 0 ? -LC.Step : LC.Step);
+
+  // fold the missing iteration into the adjustment if there is no division
+  if (Adjust && !Shift)
+    emitSingle(MBB, TMS320C64XInstrInfo::addFormOp(
+      TMS320C64XInstrInfo::addDefaultPred(BuildMI(MF, dl,
+        TII->get(TII->getSideOpcode(TMS320C64X::add_ri_1, side)), Reg)
+          .addReg(Reg).addImm(Adjust)), unit_l), Cycles);
+
+  if (LC.Step < 0)
+    emitSingle(MBB, TMS320C64XInstrInfo::addFormOp(
+      TMS320C64XInstrInfo::addDefaultPred(BuildMI(MF, dl,
+        TII->get(TII->getSideOpcode(TMS320C64X::neg_1, side)), Reg)
+          .addReg(Reg)), unit_l), Cycles);
+
+  if (Shift) {
+    emitSingle(MBB, TMS320C64XInstrInfo::addFormOp(
+      TMS320C64XInstrInfo::addDefaultPred(BuildMI(MF, dl,
+        TII->get(TII->getSideOpcode(TMS320C64X::srl_ri_1, side)), Reg)
+          .addReg(Reg).addImm(Shift)), unit_s), Cycles);
+
+    if (!LC.ReadsUpdated)
+      emitSingle(MBB, TMS320C64XInstrInfo::addFormOp(
+        TMS320C64XInstrInfo::addDefaultPred(BuildMI(MF, dl,
+          TII->get(TII->getSideOpcode(TMS320C64X::add_ri_1, side)), Reg)
+            .addReg(Reg).addImm(1)), unit_l), Cycles);
+  }
+}
+
+//-----------------------------------------------------------------------------
+//
+// take the loop body out of the block, the loop control is not needed any
+// more, debug values are dropped. The iterations overlap, so the kill flags
+// don't hold any more.
+//
+void TMS320C64XModuloScheduler::detachLoop(MachineBasicBlock *MBB) {
+  for (MachineBasicBlock::iterator I = MBB->begin(); I != MBB->end(); ) {
+    MachineInstr *MI = I++;
+    if (MI->isDebugValue() || MI->getOpcode() == TMS320C64X::branch_cond
+        || TMS320C64XInstrInfo::isCounterBranch(MI)) {
+      MBB->erase(MI);
+      continue;
+    }
+    MBB->remove(MI);
+    for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i)
+      if (MI->getOperand(i).isReg() && MI->getOperand(i).isUse())
+        MI->getOperand(i).setIsKill(false);
+  }
+}
+
+//-----------------------------------------------------------------------------
+//
+// leave the pipelined loop once the results of the last iteration have
+// landed, the delay slots of a branch to the exit cover the drain
+//
+void TMS320C64XModuloScheduler::emitExit(MachineBasicBlock *MBB,
+                                         MachineInstr *ExitBranch,
+                                         int Drain,
+                                         unsigned &Cycles) const
+{
+  if (ExitBranch
+      && MBB->isLayoutSuccessor(ExitBranch->getOperand(0).getMBB())) {
+    MBB->getParent()->DeleteMachineInstr(ExitBranch);
+    ExitBranch = 0;
+  }
+
+  if (!ExitBranch) {
+    emitNoops(MBB, std::max(Drain, 0), Cycles);
+    return;
+  }
+
+  emitNoops(MBB, std::max(Drain - 5, 0), Cycles);
+  emitSingle(MBB, ExitBranch, Cycles);
+  emitNoops(MBB, 5, Cycles);
+}
+
+//-----------------------------------------------------------------------------
+
+bool TMS320C64XModuloScheduler::emitSPLoop(MachineBasicBlock *MBB,
+                                           MachineInstr *ExitBranch,
+                                           const LoopControl &LC,
+                                           unsigned II)
+{
+  MachineFunction &MF = *MBB->getParent();
+  DebugLoc dl;
+
+  unsigned Count = findFreeReg(MBB, &TMS320C64X::BRegsRegClass);
+  unsigned Guard = LC.Relational
+    ? findFreeReg(MBB, &TMS320C64X::PredRegsRegClass, Count) : 0;
+  if (!Count || (LC.Relational && !Guard))
+    return false;
+
+  unsigned Len = getScheduleLength();
+  int Drain = 0;
+  for (unsigned i = 0, e = Body.size(); i != e; ++i)
+    Drain = std::max(Drain, Cycle[i] + (int)Body[i]->Latency - (int)Len);
+
+  if (ExitBranch)
+    MBB->remove(ExitBranch);
+  detachLoop(MBB);
+
+  unsigned Cycles = 0;
+  emitTripCount(MBB, LC, Count, Cycles);
+
+  // a relational loop entered past its bound still runs once
+  if (LC.Relational) {
+    int side = TMS320C64X::BRegsRegClass.contains(Guard) ? 1 : 0;
+    bool xpath = side != 1;
+    emitSingle(MBB, TMS320C64XInstrInfo::addFormOp(
+      TMS320C64XInstrInfo::addDefaultPred(BuildMI(MF, dl,
+        TII->get(TII->getSideOpcode(TMS320C64X::add_ri_1, side)), Guard)
+          .addReg(Count).addImm(-1)), TMS320C64XII::unit_l, xpath), Cycles);
+    emitSingle(MBB, TMS320C64XInstrInfo::addFormOp(
+      TMS320C64XInstrInfo::addDefaultPred(BuildMI(MF, dl,
+        TII->get(TII->getSideOpcode(TMS320C64X::srl_ri_1, side)), Guard)
+          .addReg(Guard).addImm(31)), TMS320C64XII::unit_s), Cycles);
+    emitSingle(MBB, TMS320C64XInstrInfo::addFormOp(BuildMI(MF, dl,
+      TII->get(TMS320C64X::mvk_2), Count).addImm(1)
+        .addImm(1).addReg(Guard), TMS320C64XII::unit_s), Cycles);
+  }
+
+  // ILC needs to be written 4 cycles ahead of the sploop
+  emitSingle(MBB, TMS320C64XInstrInfo::addDefaultPred(BuildMI(MF, dl,
+    TII->get(TMS320C64X::mvc_ilc), TMS320C64X::ILC).addReg(Count)), Cycles);
+  emitNoops(MBB, 3, Cycles);
+  emitSingle(MBB, TMS320C64XInstrInfo::addDefaultPred(BuildMI(MF, dl,
+    TII->get(TMS320C64X::sploop)).addImm(II)), Cycles);
+
+  // the flat schedule of a single iteration, the loop buffer overlays the
+  // stages
+  for (unsigned c = 0; c != Len; ++c) {
+    SmallVector<MachineInstr*, 8> Bundle;
+    for (unsigned i = 0, e = Body.size(); i != e; ++i)
+      if (Cycle[i] == (int)c)
+        Bundle.push_back(Body[i]->getInstr());
+    if (c == Len - 1)
+      Bundle.push_back(BuildMI(MF, dl, TII->get(TMS320C64X::spkernel))
+                         .addImm(0).addImm(0));
+    emitBundle(MBB, Bundle, Cycles);
+  }
+
+  // the code after the spkernel runs once the epilog is done
+  emitExit(MBB, ExitBranch, Drain, Cycles);
+
+  MBB->removeSuccessor(MBB);
+  MFI->setScheduledCycles(MBB, Cycles);
+
+  ++NumSPLoops;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+//
+// The loop is too long for the loop buffer: emit the stages explicitly.
+//
+//   MBB:    Pk = trip count - (stages - 1)
+//           [Pk <= 0] b Orig
+//   Prolog: stages 0 .. SC-2 of the first iterations
+//   Kernel: all stages, Pk -= 1, [Pk] b Kernel
+//   Epilog: stages 1 .. SC-1 of the last iterations
+//   Orig:   the unchanged loop, for trip counts below the stage count
+//
+bool TMS320C64XModuloScheduler::expandLoop(MachineBasicBlock *MBB,
+                                           MachineInstr *ExitBranch,
+                                           const LoopControl &LC,
+                                           unsigned MII)
+{
+  using namespace TMS320C64XII;
+
+  MachineFunction &MF = *MBB->getParent();
+  DebugLoc dl;
+
+  unsigned Pk = findFreeReg(MBB, &TMS320C64X::PredRegsRegClass);
+  unsigned Tmp = findFreeReg(MBB, &TMS320C64X::PredRegsRegClass, Pk);
+  if (!Pk || !Tmp)
+    return false;
+
+  int PkSide = TMS320C64X::BRegsRegClass.contains(Pk) ? 1 : 0;
+  int TmpSide = TMS320C64X::BRegsRegClass.contains(Tmp) ? 1 : 0;
+
+  MachineBasicBlock *Kernel = MF.CreateMachineBasicBlock(MBB->getBasicBlock());
+
+  // the kernel control is booked into the reservation table up front
+  MachineInstr *Dec = TMS320C64XInstrInfo::addFormOp(
+    TMS320C64XInstrInfo::addDefaultPred(BuildMI(MF, dl,
+      TII->get(TII->getSideOpcode(TMS320C64X::add_ri_1, PkSide)), Pk)
+        .addReg(Pk).addImm(-1)), unit_l);
+  MachineInstr *Br = BuildMI(MF, dl, TII->get(TMS320C64X::branch_cond))
+    .addMBB(Kernel).addImm(1).addReg(Pk);
+  Kernel->push_back(Dec);
+  Kernel->push_back(Br);
+  SUnit DecSU(Dec, ~0u), BrSU(Br, ~0u);
+
+  unsigned II = std::max(MII, MinKernelII + 1), DecRow = 0;
+  bool Scheduled = false;
+  for (; II <= MaxModuloII && !Scheduled; ++II) {
+    MRT_t MRT;
+    for (unsigned r = 0; r != II; ++r)
+      MRT.push_back(new TMS320C64XHazardRecognizer(*TII));
+
+    unsigned BrRow = II - MinKernelII;
+    if (bookInstruction(MRT[BrRow], &BrSU)) {
+      for (DecRow = 0; DecRow < BrRow; ++DecRow)
+        if (bookInstruction(MRT[DecRow], &DecSU))
+          break;
+      if (DecRow < BrRow)
+        Scheduled = scheduleLoop(II, MRT);
+    }
+
+    for (unsigned r = 0; r != II; ++r)
+      delete MRT[r];
+    if (Scheduled)
+      break;
+  }
+
+  // the hazard recognizer wants the control inside a block, take it out
+  // before the kernel is inserted, that would add its operands to the use
+  // lists a second time
+  Kernel->remove(Dec);
+  Kernel->remove(Br);
+
+  unsigned Len = getScheduleLength();
+  unsigned Stages = Scheduled ? (Len + II - 1) / II : 0;
+
+  // a single stage is no pipeline, also the stage adjustment must fit the
+  // immediate field
+  if (!Scheduled || Stages < 2 || Stages > 17) {
+    MF.DeleteMachineInstr(Dec);
+    MF.DeleteMachineInstr(Br);
+    MF.DeleteMachineBasicBlock(Kernel);
+    return false;
+  }
+
+  DEBUG(dbgs() << "expanding loop, II " << II << ", " << Stages
+               << " stages\n");
+
+  MachineBasicBlock *Exit = *MBB->succ_begin() == MBB
+    ? *llvm::next(MBB->succ_begin()) : *MBB->succ_begin();
+
+  // keep the original loop for short trip counts, it is only entered by the
+  // guard branch and leaves with a branch, so it goes behind the first block
+  // past the loop that does not fall through
+  MachineBasicBlock *Orig = MF.CreateMachineBasicBlock(MBB->getBasicBlock());
+  MachineFunction::iterator OrigPos;
+  if (!TII->findBranchTargetPos(Exit, OrigPos))
+    OrigPos = MF.end();
+  for (MachineBasicBlock::iterator I = MBB->begin(), E = MBB->end();
+       I != E; ++I)
+    if (!I->isDebugValue())
+      Orig->push_back(MF.CloneMachineInstr(I));
+  for (MachineBasicBlock::iterator I = Orig->begin(), E = Orig->end();
+       I != E; ++I)
+    if (I->getOpcode() == TMS320C64X::branch_cond
+        || TMS320C64XInstrInfo::isCounterBranch(I))
+      I->getOperand(0).setMBB(Orig);
+  if (!ExitBranch)
+    TMS320C64XInstrInfo::addDefaultPred(BuildMI(*Orig, Orig->end(), dl,
+      TII->get(TMS320C64X::branch)).addMBB(Exit));
+
+  MachineBasicBlock *Prolog = MF.CreateMachineBasicBlock(MBB->getBasicBlock());
+  MachineBasicBlock *Epilog = MF.CreateMachineBasicBlock(MBB->getBasicBlock());
+  MachineFunction::iterator Pos = llvm::next(MachineFunction::iterator(MBB));
+  MF.insert(Pos, Prolog);
+  MF.insert(Pos, Kernel);
+  MF.insert(Pos, Epilog);
+  MF.insert(OrigPos, Orig);
+
+  for (MachineBasicBlock::livein_iterator I = MBB->livein_begin(),
+       E = MBB->livein_end(); I != E; ++I) {
+    Orig->addLiveIn(*I);
+    Prolog->addLiveIn(*I);
+    Kernel->addLiveIn(*I);
+    Epilog->addLiveIn(*I);
+  }
+  Prolog->addLiveIn(Pk);
+  Kernel->addLiveIn(Pk);
+  for (unsigned i = 0, e = Body.size(); i != e; ++i) {
+    MachineInstr *MI = Body[i]->getInstr();
+    for (unsigned o = 0, oe = MI->getNumOperands(); o != oe; ++o) {
+      const MachineOperand &MO = MI->getOperand(o);
+      if (MO.isReg() && MO.isDef() && MO.getReg()
+          && !Epilog->isLiveIn(MO.getReg())) {
+        Kernel->addLiveIn(MO.getReg());
+        Epilog->addLiveIn(MO.getReg());
+      }
+    }
+  }
+
+  int Drain = 0;
+  for (unsigned i = 0, e = Body.size(); i != e; ++i)
+    Drain = std::max(Drain, Cycle[i] + (int)Body[i]->Latency - (int)Len);
+
+  if (ExitBranch)
+    MBB->remove(ExitBranch);
+  detachLoop(MBB);
+
+  // trip count and guard
+  unsigned Cycles = 0;
+  emitTripCount(MBB, LC, Pk, Cycles);
+  emitSingle(MBB, TMS320C64XInstrInfo::addFormOp(
+    TMS320C64XInstrInfo::addDefaultPred(BuildMI(MF, dl,
+      TII->get(TII->getSideOpcode(TMS320C64X::add_ri_1, PkSide)), Pk)
+        .addReg(Pk).addImm(1 - (int)Stages)), unit_l), Cycles);
+  emitSingle(MBB, TMS320C64XInstrInfo::addFormOp(
+    TMS320C64XInstrInfo::addDefaultPred(BuildMI(MF, dl,
+      TII->get(TII->getSideOpcode(TMS320C64X::add_ri_1, TmpSide)), Tmp)
+        .addReg(Pk).addImm(-1)), unit_l, PkSide != TmpSide), Cycles);
+  emitSingle(MBB, TMS320C64XInstrInfo::addFormOp(
+    TMS320C64XInstrInfo::addDefaultPred(BuildMI(MF, dl,
+      TII->get(TII->getSideOpcode(TMS320C64X::srl_ri_1, TmpSide)), Tmp)
+        .addReg(Tmp).addImm(31)), unit_s), Cycles);
+  emitSingle(MBB, BuildMI(MF, dl, TII->get(TMS320C64X::branch_cond))
+    .addMBB(Orig).addImm(1).addReg(Tmp), Cycles);
+  emitNoops(MBB, 5, Cycles);
+  MFI->setScheduledCycles(MBB, Cycles);
+
+  // prolog, cycle c issues everything of the iterations started so far
+  Cycles = 0;
+  for (unsigned c = 0, ce = (Stages - 1) * II; c != ce; ++c) {
+    SmallVector<MachineInstr*, 8> Bundle;
+    for (unsigned i = 0, e = Body.size(); i != e; ++i)
+      if (Cycle[i] <= (int)c && ((int)c - Cycle[i]) % II == 0)
+        Bundle.push_back(MF.CloneMachineInstr(Body[i]->getInstr()));
+    emitBundle(Prolog, Bundle, Cycles);
+  }
+  MFI->setScheduledCycles(Prolog, Cycles);
+
+  // kernel, the control instructions were booked into their rows
+  Cycles = 0;
+  for (unsigned r = 0; r != II; ++r) {
+    SmallVector<MachineInstr*, 8> Bundle;
+    for (unsigned i = 0, e = Body.size(); i != e; ++i)
+      if (Cycle[i] % II == r)
+        Bundle.push_back(Body[i]->getInstr());
+    if (r == DecRow)
+      Bundle.push_back(Dec);
+    if (r == II - MinKernelII)
+      Bundle.push_back(Br);
+    emitBundle(Kernel, Bundle, Cycles);
+  }
+  MFI->setScheduledCycles(Kernel, Cycles);
+
+  // epilog, the remaining stages of the iterations in flight
+  Cycles = 0;
+  for (unsigned c = 0, ce = (Stages - 1) * II; c != ce; ++c) {
+    SmallVector<MachineInstr*, 8> Bundle;
+    for (unsigned i = 0, e = Body.size(); i != e; ++i)
+      if (Cycle[i] >= (int)(c + II) && (Cycle[i] - (int)c) % II == 0)
+        Bundle.push_back(MF.CloneMachineInstr(Body[i]->getInstr()));
+    emitBundle(Epilog, Bundle, Cycles);
+  }
+  emitExit(Epilog, ExitBranch, Drain, Cycles);
+  MFI->setScheduledCycles(Epilog, Cycles);
+
+  // CFG
+  MBB->removeSuccessor(MBB);
+  MBB->removeSuccessor(Exit);
+  MBB->addSuccessor(Prolog);
+  MBB->addSuccessor(Orig);
+  Prolog->addSuccessor(Kernel);
+  Kernel->addSuccessor(Kernel);
+  Kernel->addSuccessor(Epilog);
+  Epilog->addSuccessor(Exit);
+  Orig->addSuccessor(Orig);
+  Orig->addSuccessor(Exit);
+
+  ++NumExpandedLoops;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool TMS320C64XModuloScheduler::pipelineLoop(MachineFunction &MF,
+                                             MachineLoop *L)
+{
+  MachineInstr *BackBranch, *ExitBranch;
+  if (!isCandidate(L, BackBranch, ExitBranch))
+    return false;
+
+  MachineBasicBlock *MBB = L->getHeader();
+
+  LoopControl LC;
+  if (!analyzeLoopControl(MBB, BackBranch, LC))
+    return false;
+
+  DEBUG(dbgs() << "modulo scheduling BB#" << MBB->getNumber() << "\n");
+
+  const MachineLoopInfo &MLI = getAnalysis<MachineLoopInfo>();
+  const MachineDominatorTree &MDT = getAnalysis<MachineDominatorTree>();
+  ModuloDAG DAG(MF, MLI, MDT, &getAnalysis<AliasAnalysis>());
+
+  unsigned Count = 0;
+  MachineBasicBlock::iterator FirstTerm = MBB->begin();
+  for (; FirstTerm != MBB->end() && &*FirstTerm != BackBranch; ++FirstTerm)
+    ++Count;
+
+  DAG.StartBlock(MBB);
+  DAG.Run(MBB, MBB->begin(), FirstTerm, Count);
+  buildDependences(DAG, MBB);
+
+  unsigned ResMII = computeResMII();
+  unsigned RecMII = computeRecMII(MaxModuloII);
+  unsigned MII = std::max(ResMII, RecMII);
+
+  DEBUG(dbgs() << "ResMII " << ResMII << ", RecMII " << RecMII << "\n");
+
+  bool Changed = false;
+
+  // try the smallest II that fits the loop buffer
+  for (unsigned II = MII; II <= std::min(MaxSPLoopII, (unsigned)MaxModuloII);
+       ++II) {
+    MRT_t MRT;
+    for (unsigned r = 0; r != II; ++r)
+      MRT.push_back(new TMS320C64XHazardRecognizer(*TII));
+
+    bool Scheduled = scheduleLoop(II, MRT);
+
+    for (unsigned r = 0; r != II; ++r)
+      delete MRT[r];
+
+    // without overlapping iterations the loop buffer gains nothing, neither
+    // does a larger II
+    if (Scheduled && II >= getScheduleLength())
+      break;
+
+    if (Scheduled) {
+      DEBUG(dbgs() << "SPLOOP with II " << II << "\n");
+      Changed = emitSPLoop(MBB, ExitBranch, LC, II);
+      break;
+    }
+  }
+
+  if (!Changed && MII <= MaxModuloII)
+    Changed = expandLoop(MBB, ExitBranch, LC, MII);
+
+  DAG.FinishBlock();
+  return Changed;
+}
@@ -34,6 +34,7 @@
 
 // NKIM, bad, circular, but ok for now
 #include "TMS320C64XInstrInfo.h"
+#include "TMS320C64XMachineFunctionInfo.h"
 
 // Actual register information
 #include "llvm/CodeGen/MachineFrameInfo.h"
@@ -66,6 +67,14 @@ TMS320C64XRegisterInfo::getReservedRegs(const MachineFunction &MF) const {
   Reserved.set(TMS320C64X::B15);
   Reserved.set(TMS320C64X::A15);
   Reserved.set(TMS320C64X::A14);
+  // and the register pairs containing them
+  Reserved.set(TMS320C64X::PB14);
+  Reserved.set(TMS320C64X::PA14);
+  // the AMR is only written by the circular addressing pass, it never holds
+  // values of the register allocator
+  Reserved.set(TMS320C64X::AMR);
+  // the time stamp counter runs by itself, it is read without a def
+  Reserved.set(TMS320C64X::TSCL);
   return Reserved;
 }
 
@@ -106,16 +115,21 @@ TMS320C64XRegisterInfo::getCalleeSavedRegClasses(MachineFunction const*) const {
 
 //-----------------------------------------------------------------------------
 
-unsigned int
-TMS320C64XRegisterInfo::getSubReg(unsigned int, unsigned int) const {
-  llvm_unreachable("Unimplemented function getSubReg\n");
+bool
+TMS320C64XRegisterInfo::requiresRegisterScavenging(const MachineFunction&) const {
+  return true;
 }
 
 //-----------------------------------------------------------------------------
 
 bool
-TMS320C64XRegisterInfo::requiresRegisterScavenging(const MachineFunction&) const {
-  return true;
+TMS320C64XRegisterInfo::hasReservedSpillSlot(const MachineFunction &MF,
+                                             unsigned Reg,
+                                             int &FrameIdx) const
+{
+  // callee saved pairs, see processFunctionBeforeCalleeSavedScan
+  return MF.getInfo<TMS320C64XMachineFunctionInfo>()
+    ->getCalleeSavedSlot(Reg, FrameIdx);
 }
 
 //-----------------------------------------------------------------------------
@@ -236,16 +250,35 @@ llvm::TMS320C64X::resolveSide(const TargetRegisterClass *RC) {
     return ARegsRegisterClass;
   else if (RC == BRegsRegisterClass || RC->hasSuperClass(BRegsRegisterClass))
     return BRegsRegisterClass;
-  assert(RC == GPRegsRegisterClass);
+  else if (RC == APairRegsRegisterClass)
+    return ARegsRegisterClass;
+  else if (RC == BPairRegsRegisterClass)
+    return BRegsRegisterClass;
+  assert(RC == GPRegsRegisterClass || RC == PairRegsRegisterClass);
   return RC;
 }
 
+bool llvm::TMS320C64X::isBSideReg(unsigned Reg) {
+  return BRegsRegClass.contains(Reg) || BPairRegsRegClass.contains(Reg);
+}
+
+unsigned llvm::TMS320C64X::getRegisterNumbering(const TargetRegisterInfo &TRI,
+                                                unsigned Reg) {
+  // a pair is addressed by its even (lower) register
+  if (PairRegsRegClass.contains(Reg))
+    Reg = TRI.getSubReg(Reg, TMS320C64X::sub_lo);
+
+  int Num = TRI.getDwarfRegNum(Reg, false);
+  assert(Num >= 0 && Num < 64 && "not a register of the A/B file!");
+  return Num & 0x1f;
+}
+
 
 //-----------------------------------------------------------------------------
 
 int
 TMS320C64XRegisterInfo::getDwarfRegNum(unsigned reg_num, bool isEH) const {
-  llvm_unreachable("Unimplemented function getDwarfRegNum\n");
+  return TMS320C64XGenRegisterInfo::getDwarfRegNumFull(reg_num, 0);
 }
 
 //-----------------------------------------------------------------------------
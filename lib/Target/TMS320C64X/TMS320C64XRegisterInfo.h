@@ -51,10 +51,11 @@ struct TMS320C64XRegisterInfo : TMS320C64XGenRegisterInfo {
 
   BitVector getReservedRegs(const MachineFunction &MF) const;
 
-  unsigned int getSubReg(unsigned int, unsigned int) const;
-
   bool requiresRegisterScavenging(const MachineFunction &MF) const;
 
+  bool hasReservedSpillSlot(const MachineFunction &MF, unsigned Reg,
+                            int &FrameIdx) const;
+
   // NKIM, has changed for the llvm-versions higher than 2.7
   virtual void eliminateFrameIndex(MachineBasicBlock::iterator I,
                                    int SPAdj, RegScavenger *r = 0) const;
@@ -74,9 +75,17 @@ struct TMS320C64XRegisterInfo : TMS320C64XGenRegisterInfo {
 namespace TMS320C64X {
 
   /// helper that returns the canonical RC for the side of the given RC.
-  /// GPRegs cannot be resolved and will return GPRegs
+  /// GPRegs cannot be resolved and will return GPRegs, same for PairRegs.
+  /// Register pair classes resolve to the side of their halves
   const TargetRegisterClass *resolveSide(const TargetRegisterClass *RC);
 
+  /// returns true if the physical register (or register pair) is on side B
+  bool isBSideReg(unsigned Reg);
+
+  /// returns the number of a physical register within its register file (the
+  /// encoding used in instruction words), pairs map to their even register
+  unsigned getRegisterNumbering(const TargetRegisterInfo &TRI, unsigned Reg);
+
 } // TMS320C64X namespace
 
 } // llvm namespace
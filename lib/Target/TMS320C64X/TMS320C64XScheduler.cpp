@@ -26,12 +26,21 @@
 #include "llvm/CodeGen/MachineFunctionPass.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
 #include "llvm/CodeGen/MachineLoopInfo.h"
+#include "llvm/CodeGen/MachineProfileAnalysis.h"
 #include "llvm/CodeGen/ScheduleHazardRecognizer.h"
+#include "llvm/CodeGen/SuperblockFormation.h"
 #include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Target/TargetLowering.h"
+#include "llvm/Target/TargetRegisterInfo.h"
+#include "llvm/InitializePasses.h"
+
+#include <algorithm>
+#include <set>
 
 using namespace llvm;
 
@@ -40,30 +49,120 @@ BundleNoReorder("c64x-bundle-noreorder", cl::Hidden,
            cl::desc("Don't reorder instructions when creating bundles"),
            cl::init(false));
 
+static cl::opt<bool>
+SuperblockSched("c64x-superblock-sched", cl::Hidden,
+           cl::desc("Schedule superblocks as a whole, moving instructions "
+                    "across side exits"),
+           cl::init(true));
+
+static cl::opt<bool>
+SuperblockCompensation("c64x-superblock-comp", cl::Hidden,
+           cl::desc("Allow instructions to sink below cold side exits of a "
+                    "superblock by copying them onto the exit edge"),
+           cl::init(true));
+
+STATISTIC(NumSuperblocks, "Number of superblocks scheduled as a whole");
+STATISTIC(NumSpeculated, "Number of instructions moved above a side exit");
+STATISTIC(NumCompensation, "Number of compensation instructions inserted");
+
+// longer traces do not expose more parallelism, but make the DAG expensive
+static const unsigned MaxTraceBlocks = 16;
+
 //-----------------------------------------------------------------------------
 
 namespace {
 
+/// SuperblockTrace - A chain of blocks that is only entered at the top and
+/// scheduled as a single region. Every block but the last one ends with a
+/// conditional branch leaving the trace (side exit) and falls through into
+/// the next block otherwise.
+struct SuperblockTrace {
+  SmallVector<MachineBasicBlock*, 8> Blocks;
+
+  // per side exit: the BR_OCCURS marking it, the block it leaves to, the
+  // probability of leaving there and whether instructions may sink below it
+  // (which requires copies of them on the exit edge)
+  SmallVector<MachineInstr*, 8> ExitOccurs;
+  SmallVector<MachineBasicBlock*, 8> ExitTargets;
+  SmallVector<double, 8> ExitProb;
+  SmallVector<bool, 8> ExitCompensable;
+
+  // probability of reaching the end of the trace
+  double EndProb;
+
+  // index of the block every instruction originally belonged to
+  DenseMap<const MachineInstr*, unsigned> Segment;
+
+  // instructions to copy onto the edge of every side exit (program order)
+  std::vector<std::vector<MachineInstr*> > Compensation;
+
+  // instruction/exit pairs that could not be compensated and need to stay
+  // above the exit
+  std::set<std::pair<const MachineInstr*, unsigned> > Pinned;
+
+  SuperblockTrace() : EndProb(1.0) {}
+
+  unsigned getNumExits() const { return ExitOccurs.size(); }
+
+  int getExitIndex(const MachineInstr *MI) const {
+    for (unsigned i = 0, e = ExitOccurs.size(); i != e; ++i)
+      if (ExitOccurs[i] == MI)
+        return i;
+    return -1;
+  }
+};
+
+class CustomListScheduler;
+
 class TMS320C64XScheduler : public MachineFunctionPass {
 
     TargetMachine &TM;
+    TMS320C64XMachineFunctionInfo *MFI;
+    MachineProfileAnalysis *MPA;
 
     bool addTerminatorInstr(MachineBasicBlock *MBB);
 
+    // superblock scheduling
+    bool isTraceBlock(MachineBasicBlock *MBB) const;
+    bool canExtendTrace(MachineBasicBlock *MBB,
+                        MachineBasicBlock *Next) const;
+    bool isLikely(MachineBasicBlock *MBB, MachineBasicBlock *Next) const;
+    void addTrace(SmallVectorImpl<MachineBasicBlock*> &Chain,
+                  std::vector<SuperblockTrace*> &Traces,
+                  std::set<MachineBasicBlock*> &Used);
+    void collectSuperblocks(MachineFunction &Fn,
+                            std::vector<SuperblockTrace*> &Traces);
+    void computeExitWeights(MachineFunction &Fn, SuperblockTrace &T);
+    unsigned scheduleSuperblock(MachineFunction &Fn, SuperblockTrace &T,
+                                CustomListScheduler *Scheduler);
+    void splitSuperblock(SuperblockTrace &T);
+    void insertCompensation(MachineFunction &Fn, SuperblockTrace &T);
+    void updateLiveIns(MachineFunction &Fn, SuperblockTrace &T);
+
   public:
 
     static char ID;
 
     TMS320C64XScheduler(TargetMachine &tm)
-    : MachineFunctionPass(ID), TM(tm) {}
+    : MachineFunctionPass(ID), TM(tm), MFI(0), MPA(0) {
+      if (SuperblockSched)
+        initializeMachineProfileAnalysisAnalysisGroup(
+          *PassRegistry::getPassRegistry());
+    }
 
     void getAnalysisUsage(AnalysisUsage &AU) const {
-      AU.setPreservesCFG();
       AU.addRequired<AliasAnalysis>();
       AU.addRequired<MachineDominatorTree>();
-      AU.addPreserved<MachineDominatorTree>();
       AU.addRequired<MachineLoopInfo>();
-      AU.addPreserved<MachineLoopInfo>();
+
+      // compensation code for superblocks is placed in new blocks
+      if (SuperblockSched)
+        AU.addRequired<MachineProfileAnalysis>();
+      else {
+        AU.setPreservesCFG();
+        AU.addPreserved<MachineDominatorTree>();
+        AU.addPreserved<MachineLoopInfo>();
+      }
       MachineFunctionPass::getAnalysisUsage(AU);
     }
 
@@ -74,6 +173,77 @@ class TMS320C64XScheduler : public MachineFunctionPass {
     bool runOnMachineFunction(MachineFunction &Fn);
 };
 
+//-----------------------------------------------------------------------------
+
+/// TracePriorityQueue - Available queue used for superblocks. The priority of
+/// a node is its depth, weighted with the probability of the exits it has to
+/// be scheduled before. Instructions feeding the likely exits get the slots
+/// first, the ones only needed on a cold path fill what is left.
+class TracePriorityQueue : public SchedulingPriorityQueue {
+  std::vector<SUnit*> Queue;
+  std::vector<double> Priority;
+
+  bool isBetter(const SUnit *LHS, const SUnit *RHS) const {
+    if (LHS->isScheduleHigh != RHS->isScheduleHigh)
+      return LHS->isScheduleHigh;
+    if (Priority[LHS->NodeNum] != Priority[RHS->NodeNum])
+      return Priority[LHS->NodeNum] > Priority[RHS->NodeNum];
+    // stable order, same as the latency queue
+    return LHS->NodeNum > RHS->NodeNum;
+  }
+
+  std::vector<SUnit*>::iterator best() {
+    std::vector<SUnit*>::iterator Best = Queue.begin();
+    for (std::vector<SUnit*>::iterator I = Queue.begin(), E = Queue.end();
+         I != E; ++I)
+      if (isBetter(*I, *Best))
+        Best = I;
+    return Best;
+  }
+
+public:
+  bool isBottomUp() const { return false; }
+
+  void initNodes(std::vector<SUnit> &SUnits) {
+    Priority.assign(SUnits.size(), 0.0);
+  }
+
+  void addNode(const SUnit *SU) {}
+  void updateNode(const SUnit *SU) {}
+  void releaseState() { Queue.clear(); }
+
+  void setPriority(unsigned NodeNum, double P) { Priority[NodeNum] = P; }
+
+  bool empty() const { return Queue.empty(); }
+
+  void push(SUnit *SU) { Queue.push_back(SU); }
+
+  SUnit *pop() {
+    if (Queue.empty())
+      return 0;
+    std::vector<SUnit*>::iterator Best = best();
+    SUnit *SU = *Best;
+    *Best = Queue.back();
+    Queue.pop_back();
+    return SU;
+  }
+
+  void remove(SUnit *SU) {
+    std::vector<SUnit*>::iterator I =
+      std::find(Queue.begin(), Queue.end(), SU);
+    assert(I != Queue.end() && "Not in queue!");
+    *I = Queue.back();
+    Queue.pop_back();
+  }
+
+  void dump(ScheduleDAG *DAG) const {
+    for (unsigned i = 0, e = Queue.size(); i != e; ++i) {
+      dbgs() << "Priority " << Priority[Queue[i]->NodeNum] << ": ";
+      Queue[i]->dump(DAG);
+    }
+  }
+};
+
 //-----------------------------------------------------------------------------
 #if 0
 typedef TMS320C64X::SchedulerBase TheBase;
@@ -90,7 +260,11 @@ char TMS320C64XScheduler::ID = 0;
     ScheduleHazardRecognizer *HazardRec;
 
     /// AvailableQueue - The priority queue to use for the available SUnits.
-    LatencyPriorityQueue AvailableQueue;
+    /// Blocks use the latency queue, superblocks weight the nodes with the
+    /// probabilities of the exits.
+    SchedulingPriorityQueue *AvailableQueue;
+    LatencyPriorityQueue LatencyQueue;
+    TracePriorityQueue TraceQueue;
 
     /// PendingQueue - Instructions which successors have been scheduled, but
     /// are not ready because of their latency.
@@ -101,6 +275,25 @@ char TMS320C64XScheduler::ID = 0;
 
     unsigned NumCycles;
 
+    /// Trace - The superblock currently scheduled, null for a single block.
+    SuperblockTrace *Trace;
+
+    /// ExitNodes - The BR_OCCURS nodes of the side exits of the trace and
+    /// the cycles (bottom up) they have been scheduled in, -1 if not yet.
+    std::vector<SUnit*> ExitNodes;
+    std::vector<int> ExitCycles;
+
+    /// NodeCycles - The cycle (bottom up) every node has been scheduled in.
+    std::vector<unsigned> NodeCycles;
+
+    /// CompCandidates - Nodes that may sink below a side exit, provided they
+    /// can be copied onto the exit edge.
+    std::vector<std::pair<SUnit*, unsigned> > CompCandidates;
+
+    void addTraceDeps();
+    void computeTracePriorities();
+    bool isExitHazard(const SUnit *SU, unsigned CurCycle) const;
+
     void ReleasePred(SUnit *SU, const SDep *PredEdge);
 
     void ScheduleNodeBottomUp(SUnit*, unsigned);
@@ -123,6 +316,16 @@ char TMS320C64XScheduler::ID = 0;
     virtual unsigned getCycles() const { return NumCycles; }
     virtual void Observe(MachineInstr *MI, unsigned Count) {};
     virtual void StartBlock(MachineBasicBlock *BB);
+
+    /// setTrace - Schedule the following regions as (parts of) the given
+    /// superblock, or as a single block again if null.
+    void setTrace(SuperblockTrace *T) { Trace = T; }
+
+    /// verifyCompensation - Check that every instruction that sunk below a
+    /// side exit can be copied onto the exit edge and record the copies in
+    /// the trace. Returns false if some could not, those are pinned above
+    /// their exit and the trace needs to be scheduled again.
+    bool verifyCompensation();
   };
 }
 
@@ -136,8 +339,10 @@ CustomListScheduler::CustomListScheduler(MachineFunction &MF,
   : TheBase(MF, MLI, MDT)
   , ScheduleInstrsCommon(MF)
   , HazardRec(HR)
+  , AvailableQueue(&LatencyQueue)
   , AA(AA)
   , NumCycles(0)
+  , Trace(0)
 {}
 
 //-----------------------------------------------------------------------------
@@ -203,10 +408,412 @@ bool TMS320C64XScheduler::addTerminatorInstr(MachineBasicBlock *MBB) {
 
 //-----------------------------------------------------------------------------
 
+/// countCycles - Number of cycles in a bundled block. The bundle holding a
+/// BR_OCCURS alone is no cycle of its own, it marks the end of the block.
+static unsigned countCycles(const MachineBasicBlock *MBB) {
+  unsigned Cycles = 0;
+  bool Busy = false;
+  for (MachineBasicBlock::const_iterator I = MBB->begin(), E = MBB->end();
+       I != E; ++I) {
+    unsigned Opc = I->getOpcode();
+    if (Opc == TMS320C64X::BUNDLE_END) {
+      if (Busy)
+        ++Cycles;
+      Busy = false;
+    }
+    else if (Opc != TMS320C64X::BR_OCCURS && !I->isKill() &&
+             !I->isImplicitDef())
+      Busy = true;
+  }
+  return Cycles + Busy;
+}
+
+//-----------------------------------------------------------------------------
+
+/// isTraceBlock - Blocks that can be part of a superblock: nothing in them
+/// shuts down scheduling, and they have not been bundled already.
+bool TMS320C64XScheduler::isTraceBlock(MachineBasicBlock *MBB) const {
+  if (MBB->empty() || MFI->hasScheduledCycles(MBB))
+    return false;
+
+  for (MachineBasicBlock::iterator I = MBB->begin(), E = MBB->end();
+       I != E; ++I)
+    if (isSchedulingBoundary(I, *MBB->getParent()) || I->getDesc().isCall())
+      return false;
+  return true;
+}
+
+/// canExtendTrace - Next can follow MBB in a superblock, if MBB ends with a
+/// single conditional branch (the side exit) and falls through into Next,
+/// which is not entered otherwise.
+bool TMS320C64XScheduler::canExtendTrace(MachineBasicBlock *MBB,
+                                         MachineBasicBlock *Next) const {
+  if (!MBB->isLayoutSuccessor(Next) || !MBB->isSuccessor(Next) ||
+      MBB->succ_size() != 2 || Next->pred_size() != 1)
+    return false;
+
+  if (!isTraceBlock(Next) || Next->hasAddressTaken() || Next->isLandingPad())
+    return false;
+
+  MachineBasicBlock::iterator Term = MBB->getFirstTerminator();
+  if (Term == MBB->end() || llvm::next(Term) != MBB->end())
+    return false;
+
+  const TargetInstrDesc &TID = Term->getDesc();
+  return TID.isConditionalBranch() && Term->getOperand(0).isMBB() &&
+         Term->getOperand(0).getMBB() != Next;
+}
+
+/// isLikely - Is falling through from MBB into Next not less frequent than
+/// taking the side exit? Assume so if there is no profile information.
+bool TMS320C64XScheduler::isLikely(MachineBasicBlock *MBB,
+                                   MachineBasicBlock *Next) const {
+  MachineBasicBlock *Exit = MBB->getFirstTerminator()->getOperand(0).getMBB();
+  double Taken = MPA->getEdgeWeight(MBB, Exit);
+  double Fallthrough = MPA->getEdgeWeight(MBB, Next);
+
+  if (Taken < 0 || Fallthrough < 0)
+    return true;
+  return Fallthrough >= Taken;
+}
+
+void TMS320C64XScheduler::addTrace(SmallVectorImpl<MachineBasicBlock*> &Chain,
+                                   std::vector<SuperblockTrace*> &Traces,
+                                   std::set<MachineBasicBlock*> &Used) {
+  if (Chain.size() > 1) {
+    SuperblockTrace *T = new SuperblockTrace();
+    T->Blocks.append(Chain.begin(), Chain.end());
+    Used.insert(Chain.begin(), Chain.end());
+    Traces.push_back(T);
+  }
+  Chain.clear();
+}
+
+/// collectSuperblocks - Take the superblocks built by SuperblockFormation,
+/// hottest first. Passes after the formation (branch folding) may have
+/// changed the cfg, so every link is verified again and a superblock split
+/// where necessary. Without superblocks (no path profile), grow traces along
+/// the likely fallthrough edges according to the edge profile.
+void TMS320C64XScheduler::collectSuperblocks(
+  MachineFunction &Fn, std::vector<SuperblockTrace*> &Traces)
+{
+  const MachineSuperBlockMapTy &MSBs = SuperblockFormation::getSuperblocks();
+  std::set<MachineBasicBlock*> Used;
+  SmallVector<MachineBasicBlock*, 8> Chain;
+
+  if (!MSBs.empty()) {
+    std::set<MachineBasicBlock*> Blocks;
+    for (MachineFunction::iterator I = Fn.begin(), E = Fn.end(); I != E; ++I)
+      Blocks.insert(I);
+
+    for (MachineSuperBlockMapTy::const_reverse_iterator I = MSBs.rbegin(),
+         E = MSBs.rend(); I != E; ++I) {
+      MachineSuperBlock *MSB = I->second;
+      if (MSB->getParent() != &Fn)
+        continue;
+
+      for (MachineSuperBlock::iterator BI = MSB->begin(), BE = MSB->end();
+           BI != BE; ++BI) {
+        MachineBasicBlock *MBB = *BI;
+        if (!Blocks.count(MBB) || Used.count(MBB) || !isTraceBlock(MBB)) {
+          addTrace(Chain, Traces, Used);
+          continue;
+        }
+        if (!Chain.empty() && (Chain.size() == MaxTraceBlocks ||
+                               !canExtendTrace(Chain.back(), MBB)))
+          addTrace(Chain, Traces, Used);
+        Chain.push_back(MBB);
+      }
+      addTrace(Chain, Traces, Used);
+    }
+    return;
+  }
+
+  for (MachineFunction::iterator I = Fn.begin(), E = Fn.end(); I != E; ) {
+    MachineBasicBlock *MBB = I++;
+    if (!isTraceBlock(MBB))
+      continue;
+
+    Chain.push_back(MBB);
+    while (I != E && Chain.size() < MaxTraceBlocks &&
+           canExtendTrace(Chain.back(), I) && isLikely(Chain.back(), I))
+      Chain.push_back(I++);
+    addTrace(Chain, Traces, Used);
+  }
+}
+
+/// computeExitWeights - Probabilities of leaving the trace through each of
+/// its exits, all exits weigh the same without profile information. Exits
+/// taken less often than the trace continues may get compensation code.
+void TMS320C64XScheduler::computeExitWeights(MachineFunction &Fn,
+                                             SuperblockTrace &T) {
+  const unsigned NumExits = T.getNumExits();
+  double Entry = MPA->getExecutionCount(T.Blocks.front());
+  double End = MPA->getExecutionCount(T.Blocks.back());
+  bool Weighted = Entry > 0 && End >= 0;
+
+  const TMS320C64XInstrInfo *TII =
+    static_cast<const TMS320C64XInstrInfo*>(TM.getInstrInfo());
+
+  T.ExitProb.clear();
+  T.ExitCompensable.clear();
+  for (unsigned j = 0; j != NumExits; ++j) {
+    double Taken = MPA->getEdgeWeight(T.Blocks[j], T.ExitTargets[j]);
+    double Fallthrough = MPA->getEdgeWeight(T.Blocks[j], T.Blocks[j + 1]);
+    T.ExitProb.push_back(Taken);
+    Weighted &= Taken >= 0;
+    // compensation blocks follow the first block after the exit that does
+    // not fall through, they must not become the fallthrough of any block
+    MachineFunction::iterator Pos;
+    bool CanPlace = TII->findBranchTargetPos(T.Blocks[j], Pos);
+    T.ExitCompensable.push_back(SuperblockCompensation && CanPlace &&
+      (Taken < 0 || Fallthrough < 0 || Taken <= Fallthrough));
+  }
+
+  for (unsigned j = 0; j != NumExits; ++j)
+    T.ExitProb[j] = Weighted ? T.ExitProb[j] / Entry : 1.0;
+  T.EndProb = Weighted ? End / Entry : 1.0;
+}
+
+/// scheduleSuperblock - Move the instructions of the trace into its last
+/// block (its successors provide the registers live at the end of the trace)
+/// and schedule them as a single region. Returns the number of cycles.
+unsigned TMS320C64XScheduler::scheduleSuperblock(MachineFunction &Fn,
+                                                 SuperblockTrace &T,
+                                                 CustomListScheduler *Sched) {
+  const unsigned NumBlocks = T.Blocks.size();
+  MachineBasicBlock *Last = T.Blocks.back();
+
+  for (unsigned i = 0; i != NumBlocks; ++i) {
+    MachineBasicBlock *MBB = T.Blocks[i];
+    addTerminatorInstr(MBB);
+    for (MachineBasicBlock::iterator I = MBB->begin(), E = MBB->end();
+         I != E; ++I)
+      T.Segment[I] = i;
+
+    if (i + 1 != NumBlocks) {
+      T.ExitOccurs.push_back(prior(MBB->end()));
+      T.ExitTargets.push_back(
+        MBB->getFirstTerminator()->getOperand(0).getMBB());
+    }
+  }
+  computeExitWeights(Fn, T);
+
+  DEBUG({
+      dbgs() << "Scheduling superblock:";
+      for (unsigned i = 0; i != NumBlocks; ++i)
+        dbgs() << ' ' << T.Blocks[i]->getName();
+      dbgs() << '\n';
+    });
+
+  for (unsigned i = NumBlocks - 1; i-- > 0; )
+    Last->splice(Last->begin(), T.Blocks[i], T.Blocks[i]->begin(),
+                 T.Blocks[i]->end());
+
+  // reschedule until all instructions sunk below an exit can be compensated,
+  // every round pins at least one more instruction above its exit
+  Sched->StartBlock(Last);
+  Sched->setTrace(&T);
+  do {
+    Sched->Run(Last, Last->begin(), Last->end(), Last->size());
+  } while (!Sched->verifyCompensation());
+  Sched->EmitSchedule();
+  Sched->setTrace(0);
+  Sched->FinishBlock();
+
+  splitSuperblock(T);
+  insertCompensation(Fn, T);
+  updateLiveIns(Fn, T);
+
+  unsigned Cycles = 0;
+  for (unsigned i = 0; i != NumBlocks; ++i) {
+    MachineBasicBlock *MBB = T.Blocks[i];
+    for (MachineBasicBlock::iterator I = MBB->begin(), E = MBB->end();
+         I != E; ++I)
+      if (T.Segment.lookup(I) > i)
+        ++NumSpeculated;
+
+    Sched->FixupKills(MBB);
+    MFI->setScheduledCycles(MBB, countCycles(MBB));
+    Cycles += MFI->getScheduledCycles(MBB);
+  }
+  ++NumSuperblocks;
+  return Cycles;
+}
+
+/// splitSuperblock - Distribute the schedule among the blocks of the trace
+/// again. The bundle holding the BR_OCCURS of a side exit is the first cycle
+/// after the delay slots, it is skipped when the exit is taken. It is split
+/// so that the marker ends the exiting block and the rest of the bundle
+/// starts the next one.
+void TMS320C64XScheduler::splitSuperblock(SuperblockTrace &T) {
+  const TargetInstrInfo *TII = TM.getInstrInfo();
+  MachineBasicBlock *Last = T.Blocks.back();
+  DebugLoc dl;
+
+  for (unsigned j = 0, e = T.getNumExits(); j != e; ++j) {
+    MachineInstr *Occurs = T.ExitOccurs[j];
+    assert(Occurs->getParent() == Last && "exit not within the superblock");
+
+    MachineBasicBlock::iterator First = Occurs;
+    while (First != Last->begin() &&
+           prior(First)->getOpcode() != TMS320C64X::BUNDLE_END)
+      --First;
+    if (&*First != Occurs) {
+      Last->remove(Occurs);
+      Last->insert(First, Occurs);
+    }
+
+    MachineBasicBlock::iterator Split = llvm::next(
+      MachineBasicBlock::iterator(Occurs));
+    if (Split->getOpcode() != TMS320C64X::BUNDLE_END)
+      BuildMI(*Last, Split, dl, TII->get(TMS320C64X::BUNDLE_END));
+    Split = llvm::next(llvm::next(MachineBasicBlock::iterator(Occurs)));
+
+    MachineBasicBlock *MBB = T.Blocks[j];
+    MBB->splice(MBB->end(), Last, Last->begin(), Split);
+    BuildMI(*Last, Last->begin(), dl, TII->get(TMS320C64X::BUNDLE_END));
+  }
+}
+
+/// insertCompensation - Place copies of the instructions that sunk below a
+/// side exit on the exit edge. The new block is placed behind the first
+/// block after the exit that ends in an unconditional branch, close to the
+/// trace, and scheduled like any other block.
+void TMS320C64XScheduler::insertCompensation(MachineFunction &Fn,
+                                             SuperblockTrace &T) {
+  const TMS320C64XInstrInfo *TII =
+    static_cast<const TMS320C64XInstrInfo*>(TM.getInstrInfo());
+  const TargetRegisterInfo *TRI = TM.getRegisterInfo();
+
+  for (unsigned j = 0, e = T.getNumExits(); j != e; ++j) {
+    std::vector<MachineInstr*> &Copies = T.Compensation[j];
+    if (Copies.empty())
+      continue;
+
+    MachineBasicBlock *Exiting = T.Blocks[j];
+    MachineBasicBlock *Target = T.ExitTargets[j];
+    MachineBasicBlock *Comp =
+      Fn.CreateMachineBasicBlock(Target->getBasicBlock());
+    MachineFunction::iterator Pos;
+    if (!TII->findBranchTargetPos(Exiting, Pos))
+      llvm_unreachable("compensation for an exit without a placement");
+    Fn.insert(Pos, Comp);
+
+    for (unsigned i = 0, ie = Copies.size(); i != ie; ++i)
+      Comp->push_back(Fn.CloneMachineInstr(Copies[i]));
+    TII->InsertBranch(*Comp, Target, 0, SmallVector<MachineOperand, 0>(),
+                      DebugLoc());
+    NumCompensation += Copies.size();
+
+    // redirect the side exit
+    for (MachineBasicBlock::iterator I = Exiting->begin(), E = Exiting->end();
+         I != E; ++I)
+      if (I->getDesc().isBranch() && I->getOperand(0).isMBB() &&
+          I->getOperand(0).getMBB() == Target)
+        I->getOperand(0).setMBB(Comp);
+    Exiting->removeSuccessor(Target);
+    Exiting->addSuccessor(Comp);
+    Comp->addSuccessor(Target);
+
+    // live into the copies are their operands not defined by an earlier copy
+    // and whatever the target needs and the copies do not define
+    std::vector<unsigned> Defs;
+    for (MachineBasicBlock::iterator I = Comp->begin(), E = Comp->end();
+         I != E; ++I) {
+      for (unsigned i = 0, ie = I->getNumOperands(); i != ie; ++i) {
+        const MachineOperand &MO = I->getOperand(i);
+        if (!MO.isReg() || !MO.getReg() || !MO.isUse())
+          continue;
+        bool Defined = false;
+        for (unsigned d = 0; d != Defs.size(); ++d)
+          Defined |= TRI->regsOverlap(Defs[d], MO.getReg());
+        if (!Defined && !Comp->isLiveIn(MO.getReg()))
+          Comp->addLiveIn(MO.getReg());
+      }
+      for (unsigned i = 0, ie = I->getNumOperands(); i != ie; ++i) {
+        const MachineOperand &MO = I->getOperand(i);
+        if (MO.isReg() && MO.getReg() && MO.isDef())
+          Defs.push_back(MO.getReg());
+      }
+    }
+    for (MachineBasicBlock::livein_iterator I = Target->livein_begin(),
+         E = Target->livein_end(); I != E; ++I) {
+      bool Defined = false;
+      for (unsigned d = 0; d != Defs.size(); ++d)
+        Defined |= TRI->regsOverlap(Defs[d], *I);
+      if (!Defined && !Comp->isLiveIn(*I))
+        Comp->addLiveIn(*I);
+    }
+
+    DEBUG(dbgs() << "Compensation for exit " << j << " of superblock:\n";
+          Comp->dump());
+  }
+}
+
+/// updateLiveIns - Instructions moved between the blocks of the trace, so
+/// their live-in lists are recomputed, bottom-up from the live-ins of the
+/// successors.
+void TMS320C64XScheduler::updateLiveIns(MachineFunction &Fn,
+                                        SuperblockTrace &T) {
+  const TargetInstrInfo *TII = TM.getInstrInfo();
+  const TargetRegisterInfo *TRI = TM.getRegisterInfo();
+  BitVector Reserved = TRI->getReservedRegs(Fn);
+
+  for (unsigned i = T.Blocks.size(); i-- > 0; ) {
+    MachineBasicBlock *MBB = T.Blocks[i];
+    std::set<unsigned> Live;
+
+    for (MachineBasicBlock::succ_iterator SI = MBB->succ_begin(),
+         SE = MBB->succ_end(); SI != SE; ++SI)
+      Live.insert((*SI)->livein_begin(), (*SI)->livein_end());
+
+    for (MachineBasicBlock::reverse_iterator I = MBB->rbegin(),
+         E = MBB->rend(); I != E; ++I) {
+      // predicated definitions do not end the live range
+      if (!TII->isPredicated(&*I)) {
+        for (unsigned o = 0, oe = I->getNumOperands(); o != oe; ++o) {
+          const MachineOperand &MO = I->getOperand(o);
+          if (!MO.isReg() || !MO.getReg() || !MO.isDef())
+            continue;
+
+          // a partial definition leaves the other halves of a pair live
+          std::vector<unsigned> Killed;
+          for (std::set<unsigned>::iterator LI = Live.begin(),
+               LE = Live.end(); LI != LE; ++LI)
+            if (TRI->regsOverlap(*LI, MO.getReg()))
+              Killed.push_back(*LI);
+          for (unsigned k = 0; k != Killed.size(); ++k) {
+            Live.erase(Killed[k]);
+            for (const unsigned *Sub = TRI->getSubRegisters(Killed[k]);
+                 *Sub; ++Sub)
+              if (!TRI->regsOverlap(*Sub, MO.getReg()))
+                Live.insert(*Sub);
+          }
+        }
+      }
+      for (unsigned o = 0, oe = I->getNumOperands(); o != oe; ++o) {
+        const MachineOperand &MO = I->getOperand(o);
+        if (MO.isReg() && MO.getReg() && MO.isUse() && !MO.isUndef())
+          Live.insert(MO.getReg());
+      }
+    }
+
+    while (MBB->livein_begin() != MBB->livein_end())
+      MBB->removeLiveIn(*MBB->livein_begin());
+    for (std::set<unsigned>::iterator LI = Live.begin(), LE = Live.end();
+         LI != LE; ++LI)
+      if (!Reserved.test(*LI))
+        MBB->addLiveIn(*LI);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
 bool TMS320C64XScheduler::runOnMachineFunction(MachineFunction &Fn) {
   AliasAnalysis *AA = &getAnalysis<AliasAnalysis>();
-  TMS320C64XMachineFunctionInfo *MFI =
-    Fn.getInfo<TMS320C64XMachineFunctionInfo>();
+  MFI = Fn.getInfo<TMS320C64XMachineFunctionInfo>();
+  MPA = SuperblockSched ? &getAnalysis<MachineProfileAnalysis>() : 0;
 
   const MachineLoopInfo &MLI = getAnalysis<MachineLoopInfo>();
   const MachineDominatorTree &MDT = getAnalysis<MachineDominatorTree>();
@@ -222,11 +829,33 @@ bool TMS320C64XScheduler::runOnMachineFunction(MachineFunction &Fn) {
   CustomListScheduler *Scheduler =
     new CustomListScheduler(Fn, MLI, MDT, HR, AA);
 
+  // Superblocks are scheduled first, compensation code is placed in new
+  // blocks that are scheduled with the rest below
+  std::set<MachineBasicBlock*> TraceBlocks;
+  if (SuperblockSched) {
+    std::vector<SuperblockTrace*> Traces;
+    collectSuperblocks(Fn, Traces);
+    for (unsigned i = 0, e = Traces.size(); i != e; ++i) {
+      NumCycles += scheduleSuperblock(Fn, *Traces[i], Scheduler);
+      TraceBlocks.insert(Traces[i]->Blocks.begin(), Traces[i]->Blocks.end());
+      delete Traces[i];
+    }
+  }
+
   // Loop over all of the basic blocks
   for (MachineFunction::iterator MBB = Fn.begin(), MBBe = Fn.end();
        MBB != MBBe; ++MBB) {
     unsigned BlockCycles = 0;
 
+    if (TraceBlocks.count(MBB))
+      continue;
+
+    // blocks emitted by the modulo scheduler are bundled already
+    if (MFI->hasScheduledCycles(MBB)) {
+      NumCycles += MFI->getScheduledCycles(MBB);
+      continue;
+    }
+
     // do we add a TERM to the end of the block?
     addTerminatorInstr(MBB);
     bool BlockHasTerm = prior(MBB->end())->getOpcode() == TMS320C64X::BR_OCCURS;
@@ -341,9 +970,16 @@ void CustomListScheduler::Schedule() {
   DEBUG(for (unsigned su = 0, e = SUnits.size(); su != e; ++su)
           SUnits[su].dumpAll(this));
 
-  AvailableQueue.initNodes(SUnits);
+  if (Trace) {
+    AvailableQueue = &TraceQueue;
+    AvailableQueue->initNodes(SUnits);
+    computeTracePriorities();
+  } else {
+    AvailableQueue = &LatencyQueue;
+    AvailableQueue->initNodes(SUnits);
+  }
   ListScheduleBottomUp();
-  AvailableQueue.releaseState();
+  AvailableQueue->releaseState();
 }
 
 /// ReleasePred - Decrement the NumSuccsLeft count of a predecessor. Add it to
@@ -400,6 +1036,13 @@ void CustomListScheduler::ScheduleNodeBottomUp(SUnit *SU, unsigned CurCycle) {
   SU->setHeightToAtLeast(CurCycle);
   Sequence.push_back(SU);
 
+  if (Trace) {
+    NodeCycles[SU->NodeNum] = CurCycle;
+    int Exit = Trace->getExitIndex(SU->getInstr());
+    if (Exit >= 0)
+      ExitCycles[Exit] = CurCycle;
+  }
+
   ReleasePredecessors(SU, CurCycle);
 
 #if 0
@@ -420,7 +1063,7 @@ void CustomListScheduler::ScheduleNodeBottomUp(SUnit *SU, unsigned CurCycle) {
 #endif
 
   SU->isScheduled = true;
-  AvailableQueue.ScheduledNode(SU);
+  AvailableQueue->ScheduledNode(SU);
 }
 
 bool CustomListScheduler::DelayForLiveRegsBottomUp(SUnit *SU,
@@ -436,6 +1079,11 @@ void CustomListScheduler::ListScheduleBottomUp() {
 
   HazardRec->Reset();
 
+  if (Trace) {
+    NodeCycles.assign(SUnits.size(), 0);
+    ExitCycles.assign(Trace->getNumExits(), -1);
+  }
+
   // Release any predecessors of the special Exit node.
   ReleasePredecessors(&ExitSU, CurCycle);
 
@@ -460,12 +1108,12 @@ void CustomListScheduler::ListScheduleBottomUp() {
   // We put bundle seperators at the beginnig and end
   Sequence.push_back(getBundleEndSUnit());
 
-  while (!AvailableQueue.empty() || !PendingQueue.empty()) {
+  while (!AvailableQueue->empty() || !PendingQueue.empty()) {
     // Check to see if any of the pending instructions are ready to issue.  If
     // so, add them to the available queue.
     for (unsigned i = 0, e = PendingQueue.size(); i != e; ++i) {
       if (PendingQueue[i]->getHeight() <= CurCycle) {
-        AvailableQueue.push(PendingQueue[i]);
+        AvailableQueue->push(PendingQueue[i]);
         PendingQueue[i]->isAvailable = true;
         PendingQueue[i] = PendingQueue.back();
         PendingQueue.pop_back();
@@ -474,27 +1122,23 @@ void CustomListScheduler::ListScheduleBottomUp() {
     }
 
     DEBUG(dbgs() << "\n*** Examining Available\n";
-          LatencyPriorityQueue q = AvailableQueue;
-          while (!q.empty()) {
-            SUnit *su = q.pop();
-            dbgs() << "Height " << su->getHeight() << ": ";
-            su->dump(this);
-          });
-
-    SUnit *CurSU = AvailableQueue.pop();
+          AvailableQueue->dump(this));
+
+    SUnit *CurSU = AvailableQueue->pop();
     while (CurSU) {
       if (HazardRec->getHazardType(CurSU, 0) ==
-          ScheduleHazardRecognizer::NoHazard)
+          ScheduleHazardRecognizer::NoHazard &&
+          !isExitHazard(CurSU, CurCycle))
         break;
 
       CurSU->isPending = true;  // This SU is not in AvailableQueue right now.
       NotReady.push_back(CurSU);
-      CurSU = AvailableQueue.pop();
+      CurSU = AvailableQueue->pop();
     }
 
     // Add the nodes that aren't ready back onto the available list.
     if (!NotReady.empty()) {
-      AvailableQueue.push_all(NotReady);
+      AvailableQueue->push_all(NotReady);
       NotReady.clear();
     }
 
@@ -502,7 +1146,11 @@ void CustomListScheduler::ListScheduleBottomUp() {
       // Found instruction that fits current cycle
       ScheduleNodeBottomUp(CurSU, CurCycle);
       HazardRec->EmitInstruction(CurSU);
-      CycleHasInsts = true;
+      // KILL and IMPLICIT_DEF are dropped during emission, they alone do
+      // not make up a cycle (it becomes a noop if nothing else is found)
+      MachineInstr *MI = CurSU->getInstr();
+      if (!MI || !(MI->isKill() || MI->isImplicitDef()))
+        CycleHasInsts = true;
     } else if (CycleHasInsts) {
       // No instruction found, but at least one was scheduled in this cycle
       DEBUG(dbgs() << "*** Finished cycle " << CurCycle << '\n');
@@ -537,6 +1185,30 @@ void CustomListScheduler::BuildSchedGraph(AliasAnalysis *AA) {
  // build the graph as always
   TheBase::BuildSchedGraph(AA);
 
+  // The generic output dependencies have a latency of one, but the results
+  // are written at the end of the delay slots. A def with fewer delay slots
+  // than an earlier def of the same register must wait for that one to land.
+  const TMS320C64XInstrInfo *TII =
+    static_cast<const TMS320C64XInstrInfo*>(this->TII);
+  for (unsigned i = 0, e = SUnits.size(); i != e; ++i) {
+    SUnit *Later = &SUnits[i];
+    SmallVector<SDep, 4> Deps;
+    for (SUnit::pred_iterator I = Later->Preds.begin(),
+         E = Later->Preds.end(); I != E; ++I) {
+      if (I->getKind() != SDep::Output || !I->getSUnit()->isInstr())
+        continue;
+      unsigned Reg = I->getReg();
+      int Lat = (int) TII->getDefLatency(InstrItins,
+                                         I->getSUnit()->getInstr(), Reg)
+              - (int) TII->getDefLatency(InstrItins, Later->getInstr(), Reg)
+              + 1;
+      if (Lat > (int) I->getLatency())
+        Deps.push_back(SDep(I->getSUnit(), SDep::Order, Lat));
+    }
+    for (unsigned j = 0, je = Deps.size(); j != je; ++j)
+      Later->addPred(Deps[j]);
+  }
+
   // Enforce strict order on calls and branches. This also connects our 'branch
   // happens' instruction (TERM) to the actual branch instr.
   SUnit *nextBranch = NULL;
@@ -554,11 +1226,18 @@ void CustomListScheduler::BuildSchedGraph(AliasAnalysis *AA) {
     if (tid.isTerminator() || tid.isBranch())
       SUnits[i].isScheduleHigh = true;
 
-    // remember when the first branch of the block occurs
-    if (SUnits[i].getInstr()->getOpcode() == TMS320C64X::BR_OCCURS)
+    // remember when the first branch of the block occurs. The side exits of
+    // a superblock are not taken into account, see addTraceDeps
+    if (SUnits[i].getInstr()->getOpcode() == TMS320C64X::BR_OCCURS &&
+        !(Trace && Trace->getExitIndex(SUnits[i].getInstr()) >= 0))
       firstTerm = &SUnits[i];
   }
 
+  // constrain the motion of instructions across the side exits, nodes that
+  // need to precede an exit are no roots anymore
+  if (Trace)
+    addTraceDeps();
+
   // Nodes that are currently attached to the exit node (ie. roots), need to
   // execute before the first branch of the block occurs.
   // Note: we keep them connected to ExitSU.
@@ -612,6 +1291,208 @@ void CustomListScheduler::BuildSchedGraph(AliasAnalysis *AA) {
   }
 }
 
+//-----------------------------------------------------------------------------
+
+/// isSpeculable - Instructions that may be executed although the path they
+/// are on is left, ie. which can not fault and have no visible side effects.
+static bool isSpeculable(const MachineInstr *MI) {
+  const TargetInstrDesc &TID = MI->getDesc();
+  return !(TID.mayLoad() || TID.mayStore() || TID.isCall() ||
+           TID.isBranch() || TID.isTerminator() ||
+           MI->hasUnmodeledSideEffects() || MI->isInlineAsm());
+}
+
+/// definesLiveIn - Does the instruction write a register live into MBB? The
+/// frame and stack pointer are reserved and never listed as live-ins, but
+/// every path needs them (the prolog is scheduled with everything else).
+static bool definesLiveIn(const MachineInstr *MI,
+                          const MachineBasicBlock *MBB,
+                          const TargetRegisterInfo *TRI) {
+  for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+    const MachineOperand &MO = MI->getOperand(i);
+    if (!MO.isReg() || !MO.isDef() || !MO.getReg())
+      continue;
+    if (MO.getReg() == TMS320C64X::A15 || MO.getReg() == TMS320C64X::B15)
+      return true;
+    for (MachineBasicBlock::livein_iterator I = MBB->livein_begin(),
+         E = MBB->livein_end(); I != E; ++I)
+      if (TRI->regsOverlap(MO.getReg(), *I))
+        return true;
+  }
+  return false;
+}
+
+/// addTraceDeps - Add the dependencies that keep the schedule of a superblock
+/// correct when a side exit is taken. An instruction moved above an exit is
+/// executed on the exit path, so it must neither fault nor clobber a register
+/// live there. An instruction moved below an exit is skipped on the exit
+/// path, that is fine if its results are dead there. Otherwise it has to
+/// complete before the exit, or (for cold exits) be copied onto the exit edge.
+void CustomListScheduler::addTraceDeps() {
+  const unsigned NumExits = Trace->getNumExits();
+
+  ExitNodes.assign(NumExits, 0);
+  for (unsigned i = 0, e = SUnits.size(); i != e; ++i) {
+    int Exit = Trace->getExitIndex(SUnits[i].getInstr());
+    if (Exit >= 0)
+      ExitNodes[Exit] = &SUnits[i];
+  }
+
+  CompCandidates.clear();
+  for (unsigned i = 0, e = SUnits.size(); i != e; ++i) {
+    SUnit *SU = &SUnits[i];
+    MachineInstr *MI = SU->getInstr();
+    const TargetInstrDesc &TID = MI->getDesc();
+
+    // branches and markers are kept in order by BuildSchedGraph
+    if (TID.isTerminator() || TID.isBranch())
+      continue;
+
+    const unsigned Seg = Trace->Segment.lookup(MI);
+    assert(ExitNodes.size() >= Seg && "instruction outside of the trace");
+
+    // upward motion, it suffices to stop at the lowest exit not allowed
+    for (unsigned j = Seg; j-- > 0; ) {
+      if (!isSpeculable(MI) || definesLiveIn(MI, Trace->ExitTargets[j], ScheduleDAGInstrs::TRI)) {
+        SU->addPred(SDep(ExitNodes[j], SDep::Order, 0));
+        break;
+      }
+    }
+
+    // downward motion, it suffices to complete before the highest exit
+    bool Visible = TID.mayStore() || TID.isCall() ||
+                   MI->hasUnmodeledSideEffects();
+    for (unsigned j = Seg; j < NumExits; ++j) {
+      if (!Visible && !definesLiveIn(MI, Trace->ExitTargets[j], ScheduleDAGInstrs::TRI))
+        continue;
+
+      if (!Visible && isSpeculable(MI) && !MI->isKill() &&
+          !MI->isImplicitDef() && Trace->ExitCompensable[j] &&
+          !Trace->Pinned.count(std::make_pair(MI, j))) {
+        CompCandidates.push_back(std::make_pair(SU, j));
+        continue;
+      }
+
+      ExitNodes[j]->addPred(SDep(SU, SDep::Order, SU->Latency));
+      break;
+    }
+  }
+
+  // an exit that nothing needs to stay below is a root of the graph, it
+  // would never be released otherwise
+  for (unsigned j = 0; j != NumExits; ++j)
+    if (ExitNodes[j]->Succs.empty())
+      ExitSU.addPred(SDep(ExitNodes[j], SDep::Order, 0));
+}
+
+/// computeTracePriorities - Every node has to be scheduled before the end of
+/// the trace, the ancestors of a side exit also before the exit. Weight the
+/// depth of a node with the probability of leaving through those exits.
+void CustomListScheduler::computeTracePriorities() {
+  const unsigned NumNodes = SUnits.size();
+  std::vector<double> Weight(NumNodes, Trace->EndProb);
+
+  for (unsigned j = 0, e = ExitNodes.size(); j != e; ++j) {
+    std::vector<bool> Visited(NumNodes, false);
+    std::vector<SUnit*> WorkList(1, ExitNodes[j]);
+    while (!WorkList.empty()) {
+      SUnit *SU = WorkList.back();
+      WorkList.pop_back();
+      for (SUnit::pred_iterator I = SU->Preds.begin(), E = SU->Preds.end();
+           I != E; ++I) {
+        SUnit *Pred = I->getSUnit();
+        if (Pred->NodeNum >= NumNodes || Visited[Pred->NodeNum])
+          continue;
+        Visited[Pred->NodeNum] = true;
+        Weight[Pred->NodeNum] += Trace->ExitProb[j];
+        WorkList.push_back(Pred);
+      }
+    }
+  }
+
+  for (unsigned i = 0; i != NumNodes; ++i)
+    TraceQueue.setPriority(i, Weight[i] *
+                          (SUnits[i].getDepth() + SUnits[i].Latency));
+}
+
+/// isExitHazard - An instruction above a side exit must complete before the
+/// branch is taken, it would write into the exit block otherwise.
+bool CustomListScheduler::isExitHazard(const SUnit *SU,
+                                       unsigned CurCycle) const {
+  if (!Trace)
+    return false;
+
+  for (unsigned j = 0, e = ExitCycles.size(); j != e; ++j) {
+    int Cycle = ExitCycles[j];
+    if (Cycle >= 0 && Cycle < (int) CurCycle &&
+        (int) CurCycle < Cycle + (int) SU->Latency)
+      return true;
+  }
+  return false;
+}
+
+bool CustomListScheduler::verifyCompensation() {
+  const unsigned NumExits = Trace->getNumExits();
+  Trace->Compensation.assign(NumExits, std::vector<MachineInstr*>());
+
+  // the candidates that ended up in or below the cycle of their exit
+  std::set<std::pair<SUnit*, unsigned> > Sunk;
+  for (unsigned i = 0, e = CompCandidates.size(); i != e; ++i) {
+    SUnit *SU = CompCandidates[i].first;
+    unsigned Exit = CompCandidates[i].second;
+    if (NodeCycles[SU->NodeNum] <= (unsigned) ExitCycles[Exit])
+      Sunk.insert(CompCandidates[i]);
+  }
+
+  bool Valid = true;
+  for (std::set<std::pair<SUnit*, unsigned> >::iterator I = Sunk.begin(),
+       E = Sunk.end(); I != E; ++I) {
+    SUnit *SU = I->first;
+    unsigned ExitCycle = ExitCycles[I->second];
+    bool Copyable = true;
+
+    // the copy reads its operands when the exit is taken, nothing above the
+    // exit may overwrite them or the result in the meantime
+    for (SUnit::succ_iterator SI = SU->Succs.begin(), SE = SU->Succs.end();
+         SI != SE; ++SI) {
+      SUnit *Succ = SI->getSUnit();
+      if ((SI->getKind() == SDep::Anti || SI->getKind() == SDep::Output) &&
+          Succ != &ExitSU && NodeCycles[Succ->NodeNum] > ExitCycle)
+        Copyable = false;
+    }
+
+    // operands computed below the exit are only available if copied as well
+    for (SUnit::pred_iterator PI = SU->Preds.begin(), PE = SU->Preds.end();
+         PI != PE; ++PI) {
+      SUnit *Pred = PI->getSUnit();
+      if (PI->getKind() == SDep::Data && Pred->NodeNum < SUnits.size() &&
+          NodeCycles[Pred->NodeNum] <= ExitCycle &&
+          !Sunk.count(std::make_pair(Pred, I->second)))
+        Copyable = false;
+    }
+
+    if (!Copyable) {
+      DEBUG(dbgs() << "Pinning above exit " << I->second << ": ";
+            SU->getInstr()->dump());
+      Trace->Pinned.insert(std::make_pair(SU->getInstr(), I->second));
+      Valid = false;
+    }
+  }
+
+  if (!Valid)
+    return false;
+
+  // SUnits are numbered bottom up
+  for (unsigned i = SUnits.size(); i-- > 0; ) {
+    for (unsigned j = 0; j != NumExits; ++j)
+      if (Sunk.count(std::make_pair(&SUnits[i], j)))
+        Trace->Compensation[j].push_back(SUnits[i].getInstr());
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
 FunctionPass *llvm::createTMS320C64XScheduler(TargetMachine &tm) {
   return new TMS320C64XScheduler(tm);
 }
@@ -48,6 +48,15 @@ class TMS320C64XInstSelectorPass : public SelectionDAGISel {
     explicit TMS320C64XInstSelectorPass(TargetMachine &TM);
 
     SDNode *Select(SDNode *op);
+    SDNode *SelectPairLoad(SDNode *op);
+    MachineSDNode *emitPairLoad(SDNode *op);
+    SDNode *SelectPairStore(SDNode *op);
+    SDNode *SelectPairResult(SDNode *op);
+    SDNode *SelectDouble(SDNode *op);
+    SDValue getPair(DebugLoc dl, SDValue lo, SDValue hi);
+    SDNode *SelectIndexed(SDNode *op);
+    SDNode *SelectCircular(SDNode *op);
+    void select_pairaddr(SDNode *op, SDValue &base, SDValue &offs);
     bool select_addr(SDNode *&op, SDValue &N, SDValue &R1, SDValue &R2);
     bool select_idxaddr(SDNode *&op, SDValue &N, SDValue &R1, SDValue &R2);
     bool bounce_predicate(SDNode *&op, SDValue &N, SDValue &R1);
@@ -226,10 +235,25 @@ bool TMS320C64XInstSelectorPass::select_addr(SDNode *&op,
     // As mentioned above though, hardware will scale the offset, so we need
     // to insert a shift here.
 
-    // NKim, check for a zero scale in order to avoid dead shifts
-    const int scale = (int)log2(align);
+    // An index the dag already shifted by the access size (array elements,
+    // jump table entries) is what the hardware scales, use it unshifted
+    const int size_scale = (int)log2(want_align);
+    for (unsigned i = 0; size_scale != 0 && i < 2; ++i) {
+      SDValue idx = N.getOperand(i);
+      if (idx.getOpcode() == ISD::SHL
+          && idx.getOperand(1).getOpcode() == ISD::Constant
+          && cast<ConstantSDNode>(idx.getOperand(1))->getZExtValue()
+             == (uint64_t)size_scale)
+      {
+        base = N.getOperand(1 - i);
+        offs = idx.getOperand(0);
+        return true;
+      }
+    }
 
-    if (scale != 0) {
+    // NKim, check for a zero scale in order to avoid dead shifts. The
+    // hardware scales by the access size, not by the alignment of the base
+    if (size_scale != 0) {
 
       base = N.getOperand(0);
       SDValue ops[4];
@@ -238,7 +262,7 @@ bool TMS320C64XInstSelectorPass::select_addr(SDNode *&op,
       // NKim, must not be a target constant here ! We may want to match new
       // patterns for folding eventual shl/shr pairs into one sign-extension
       // instruction !
-      ops[1] = CurDAG->getConstant(scale, MVT::i32);
+      ops[1] = CurDAG->getConstant(size_scale, MVT::i32);
 
       // predication register/immediate value stuff, no functional unit spec
       // here, since we insert an intermediate node into the offset chain
@@ -352,5 +376,401 @@ SDNode * TMS320C64XInstSelectorPass::Select(SDNode *op) {
   // are already selected. ignore them.
   if (op->isMachineOpcode())
     return op;
-  return SelectCode(op);
+
+  // 64 bit nodes produce/consume register pairs which are not a legal type,
+  // so there are no patterns for them. Select them manually
+  switch (op->getOpcode()) {
+    case TMSISD::LDDW:
+    case TMSISD::LDNDW:
+      return SelectPairLoad(op);
+    case TMSISD::STDW:
+    case TMSISD::STNDW:
+      return SelectPairStore(op);
+    case TMSISD::ADDU:
+    case TMSISD::MPY2:
+    case ISD::SMUL_LOHI:
+    case ISD::UMUL_LOHI:
+      return SelectPairResult(op);
+    case TMSISD::ADDDP:
+    case TMSISD::SUBDP:
+    case TMSISD::MPYDP:
+    case TMSISD::CMPEQDP:
+    case TMSISD::CMPGTDP:
+    case TMSISD::CMPLTDP:
+    case TMSISD::INTDP:
+    case TMSISD::INTDPU:
+    case TMSISD::SPDP:
+    case TMSISD::DPSP:
+    case TMSISD::DPTRUNC:
+      return SelectDouble(op);
+    case ISD::LOAD:
+    case ISD::STORE:
+      if (cast<LSBaseSDNode>(op)->isIndexed())
+        return SelectIndexed(op);
+      return SelectCode(op);
+    case ISD::INTRINSIC_W_CHAIN:
+      if (isa<MemIntrinsicSDNode>(op))
+        return SelectCircular(op);
+      return SelectCode(op);
+    default:
+      return SelectCode(op);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+void TMS320C64XInstSelectorPass::select_pairaddr(SDNode *op,
+                                                 SDValue &base,
+                                                 SDValue &offs)
+{
+  MemSDNode *mem = cast<MemSDNode>(op);
+  SDValue addr = mem->getBasePtr();
+
+  // Aligned accesses use the common addressing modes, the non-aligned ones
+  // scale constant offsets by 8 as well, but only have the alignment of their
+  // base address. Don't bother and calculate the address explicitly
+  if (op->getOpcode() == TMSISD::LDDW || op->getOpcode() == TMSISD::STDW) {
+    select_addr(op, addr, base, offs);
+    return;
+  }
+
+  base = addr;
+  offs = CurDAG->getTargetConstant(0, MVT::i32);
+}
+
+//-----------------------------------------------------------------------------
+
+SDNode *TMS320C64XInstSelectorPass::SelectPairLoad(SDNode *op) {
+  emitPairLoad(op);
+  return NULL;
+}
+
+MachineSDNode *TMS320C64XInstSelectorPass::emitPairLoad(SDNode *op) {
+  DebugLoc dl = op->getDebugLoc();
+  SDValue base, offs;
+
+  select_pairaddr(op, base, offs);
+
+  unsigned opc = (op->getOpcode() == TMSISD::LDDW)
+    ? TMS320C64X::dword_load_1 : TMS320C64X::ndword_load_1;
+
+  // base, offset, default predicate, d-unit form (no xpath), chain
+  SDValue ops[] = {
+    base, offs,
+    CurDAG->getTargetConstant(-1, MVT::i32),
+    CurDAG->getRegister(TMS320C64X::NoRegister, MVT::i32),
+    CurDAG->getTargetConstant(TMS320C64XII::unit_d << 1, MVT::i32),
+    op->getOperand(0)
+  };
+
+  MachineSDNode *load =
+    CurDAG->getMachineNode(opc, dl, MVT::i64, MVT::Other, ops, 6);
+
+  MachineSDNode::mmo_iterator memOp = MF->allocateMemRefsArray(1);
+  memOp[0] = cast<MemSDNode>(op)->getMemOperand();
+  load->setMemRefs(memOp, memOp + 1);
+
+  // hand out both halves of the register pair
+  SDValue pair(load, 0);
+  ReplaceUses(SDValue(op, 0), CurDAG->getTargetExtractSubreg(
+    TMS320C64X::sub_lo, dl, MVT::i32, pair));
+  ReplaceUses(SDValue(op, 1), CurDAG->getTargetExtractSubreg(
+    TMS320C64X::sub_hi, dl, MVT::i32, pair));
+  ReplaceUses(SDValue(op, 2), SDValue(load, 1));
+  return load;
+}
+
+//-----------------------------------------------------------------------------
+
+SDNode *TMS320C64XInstSelectorPass::SelectPairStore(SDNode *op) {
+  DebugLoc dl = op->getDebugLoc();
+  SDValue base, offs;
+
+  unsigned opc = (op->getOpcode() == TMSISD::STDW)
+    ? TMS320C64X::dword_store_1 : TMS320C64X::ndword_store_1;
+
+  SDValue lo = op->getOperand(2);
+  SDValue hi = op->getOperand(3);
+  SDValue pair;
+
+  // the halves come straight from a pair load (copying a 64 bit value), the
+  // load is not selected yet, do it now and store the loaded pair as it is.
+  // Otherwise glue both halves together
+  if (lo.getNode() == hi.getNode() && lo.getResNo() == 0 &&
+      hi.getResNo() == 1 && (lo.getOpcode() == TMSISD::LDDW ||
+                             lo.getOpcode() == TMSISD::LDNDW)) {
+    pair = SDValue(emitPairLoad(lo.getNode()), 0);
+  } else {
+    pair = getPair(dl, lo, hi);
+  }
+
+  // (selecting the load above may have replaced our operands)
+  select_pairaddr(op, base, offs);
+
+  SDValue ops[] = {
+    base, offs, pair,
+    CurDAG->getTargetConstant(-1, MVT::i32),
+    CurDAG->getRegister(TMS320C64X::NoRegister, MVT::i32),
+    CurDAG->getTargetConstant(TMS320C64XII::unit_d << 1, MVT::i32),
+    op->getOperand(0)
+  };
+
+  MachineSDNode *store = CurDAG->getMachineNode(opc, dl, MVT::Other, ops, 7);
+
+  MachineSDNode::mmo_iterator memOp = MF->allocateMemRefsArray(1);
+  memOp[0] = cast<MemSDNode>(op)->getMemOperand();
+  store->setMemRefs(memOp, memOp + 1);
+
+  return store;
+}
+
+//-----------------------------------------------------------------------------
+
+SDNode *TMS320C64XInstSelectorPass::SelectPairResult(SDNode *op) {
+  DebugLoc dl = op->getDebugLoc();
+  unsigned opc;
+  switch (op->getOpcode()) {
+    case TMSISD::ADDU:     opc = TMS320C64X::addu_p_rr; break;
+    case TMSISD::MPY2:     opc = TMS320C64X::mpy2; break;
+    case ISD::SMUL_LOHI:   opc = TMS320C64X::mpy32_p_rr; break;
+    case ISD::UMUL_LOHI:   opc = TMS320C64X::mpy32u_p_rr; break;
+    default:
+      llvm_unreachable("unexpected pair result node");
+  }
+
+  SDValue ops[] = {
+    op->getOperand(0), op->getOperand(1),
+    CurDAG->getTargetConstant(-1, MVT::i32),
+    CurDAG->getRegister(TMS320C64X::NoRegister, MVT::i32)
+  };
+
+  SDValue pair(CurDAG->getMachineNode(opc, dl, MVT::i64, ops, 4), 0);
+
+  // the low word holds the sum (the lower product, the low half of the
+  // product), the high word the carry (the upper product, the high half)
+  ReplaceUses(SDValue(op, 0), CurDAG->getTargetExtractSubreg(
+    TMS320C64X::sub_lo, dl, MVT::i32, pair));
+  ReplaceUses(SDValue(op, 1), CurDAG->getTargetExtractSubreg(
+    TMS320C64X::sub_hi, dl, MVT::i32, pair));
+  return NULL;
+}
+
+//-----------------------------------------------------------------------------
+
+SDValue TMS320C64XInstSelectorPass::getPair(DebugLoc dl, SDValue lo,
+                                            SDValue hi)
+{
+  SDValue seq[] = {
+    lo, CurDAG->getTargetConstant(TMS320C64X::sub_lo, MVT::i32),
+    hi, CurDAG->getTargetConstant(TMS320C64X::sub_hi, MVT::i32)
+  };
+
+  return SDValue(CurDAG->getMachineNode(TargetOpcode::REG_SEQUENCE, dl,
+                                        MVT::i64, seq, 4), 0);
+}
+
+//-----------------------------------------------------------------------------
+
+/// SelectDouble - The C674x double precision nodes carry their operands and
+/// results as the low and high words of the doubles, the instructions read
+/// and write register pairs.
+SDNode *TMS320C64XInstSelectorPass::SelectDouble(SDNode *op) {
+  DebugLoc dl = op->getDebugLoc();
+  unsigned opc;
+  bool pairIn = true;
+  switch (op->getOpcode()) {
+    case TMSISD::ADDDP:   opc = TMS320C64X::adddp; break;
+    case TMSISD::SUBDP:   opc = TMS320C64X::subdp; break;
+    case TMSISD::MPYDP:   opc = TMS320C64X::mpydp; break;
+    case TMSISD::CMPEQDP: opc = TMS320C64X::cmpeqdp; break;
+    case TMSISD::CMPGTDP: opc = TMS320C64X::cmpgtdp; break;
+    case TMSISD::CMPLTDP: opc = TMS320C64X::cmpltdp; break;
+    case TMSISD::DPSP:    opc = TMS320C64X::dpsp; break;
+    case TMSISD::DPTRUNC: opc = TMS320C64X::dptrunc; break;
+    case TMSISD::INTDP:   opc = TMS320C64X::intdp; pairIn = false; break;
+    case TMSISD::INTDPU:  opc = TMS320C64X::intdpu; pairIn = false; break;
+    case TMSISD::SPDP:    opc = TMS320C64X::spdp; pairIn = false; break;
+    default:
+      llvm_unreachable("unexpected double precision node");
+  }
+
+  SmallVector<SDValue, 4> ops;
+  if (pairIn) {
+    for (unsigned i = 0, e = op->getNumOperands(); i != e; i += 2)
+      ops.push_back(getPair(dl, op->getOperand(i), op->getOperand(i + 1)));
+  } else
+    ops.push_back(op->getOperand(0));
+
+  ops.push_back(CurDAG->getTargetConstant(-1, MVT::i32));
+  ops.push_back(CurDAG->getRegister(TMS320C64X::NoRegister, MVT::i32));
+
+  if (op->getNumValues() == 1)
+    return CurDAG->SelectNodeTo(op, opc, MVT::i32, &ops[0], ops.size());
+
+  SDValue pair(CurDAG->getMachineNode(opc, dl, MVT::i64,
+                                      &ops[0], ops.size()), 0);
+  ReplaceUses(SDValue(op, 0), CurDAG->getTargetExtractSubreg(
+    TMS320C64X::sub_lo, dl, MVT::i32, pair));
+  ReplaceUses(SDValue(op, 1), CurDAG->getTargetExtractSubreg(
+    TMS320C64X::sub_hi, dl, MVT::i32, pair));
+  return NULL;
+}
+
+//-----------------------------------------------------------------------------
+
+/// SelectIndexed - Loads and stores modifying their base register, these are
+/// formed by the DAG combiner from pointer increments next to the access (eg.
+/// the pointer induction variables of loops).
+SDNode *TMS320C64XInstSelectorPass::SelectIndexed(SDNode *op) {
+  LSBaseSDNode *mem = cast<LSBaseSDNode>(op);
+  ISD::MemIndexedMode mode = mem->getAddressingMode();
+  bool pre = mode == ISD::PRE_INC || mode == ISD::PRE_DEC;
+  unsigned size = mem->getMemoryVT().getStoreSize();
+
+  // the offset is scaled by the access width, the sign selects ++ or --
+  int offs = cast<ConstantSDNode>(mem->getOffset())->getSExtValue() / size;
+  if (mode == ISD::PRE_DEC || mode == ISD::POST_DEC)
+    offs = -offs;
+
+  MachineSDNode::mmo_iterator memOp = MF->allocateMemRefsArray(1);
+  memOp[0] = mem->getMemOperand();
+
+  SDValue base = mem->getBasePtr();
+  SDValue chain = mem->getChain();
+  SDValue pred = CurDAG->getTargetConstant(-1, MVT::i32);
+  SDValue predReg = CurDAG->getRegister(TMS320C64X::NoRegister, MVT::i32);
+  SDValue unit = CurDAG->getTargetConstant(TMS320C64XII::unit_d << 1,
+                                           MVT::i32);
+  SDNode *res;
+
+  if (LoadSDNode *load = dyn_cast<LoadSDNode>(op)) {
+    bool sext = load->getExtensionType() == ISD::SEXTLOAD;
+    unsigned opc;
+    switch (size) {
+      case 1:
+        if (sext)
+          opc = pre ? TMS320C64X::byte_preload_1 : TMS320C64X::byte_postload_1;
+        else
+          opc = pre ? TMS320C64X::ubyte_preload_1
+                    : TMS320C64X::ubyte_postload_1;
+        break;
+      case 2:
+        if (sext)
+          opc = pre ? TMS320C64X::hword_preload_1
+                    : TMS320C64X::hword_postload_1;
+        else
+          opc = pre ? TMS320C64X::uhword_preload_1
+                    : TMS320C64X::uhword_postload_1;
+        break;
+      default:
+        opc = pre ? TMS320C64X::word_preload_1 : TMS320C64X::word_postload_1;
+        break;
+    }
+
+    // loaded value, modified base, chain
+    SDValue ops[] = {
+      base, CurDAG->getTargetConstant(offs, MVT::i32), pred, predReg, unit,
+      chain
+    };
+    res = CurDAG->SelectNodeTo(op, opc, MVT::i32, MVT::i32, MVT::Other,
+                               ops, 6);
+  } else {
+    unsigned opc;
+    switch (size) {
+      case 1:
+        opc = pre ? TMS320C64X::byte_prestore_1
+                  : TMS320C64X::byte_poststore_1;
+        break;
+      case 2:
+        opc = pre ? TMS320C64X::hword_prestore_1
+                  : TMS320C64X::hword_poststore_1;
+        break;
+      default:
+        opc = pre ? TMS320C64X::word_prestore_1
+                  : TMS320C64X::word_poststore_1;
+        break;
+    }
+
+    // modified base, chain
+    SDValue ops[] = {
+      base, CurDAG->getTargetConstant(offs, MVT::i32), op->getOperand(1),
+      pred, predReg, unit, chain
+    };
+    res = CurDAG->SelectNodeTo(op, opc, MVT::i32, MVT::Other, ops, 7);
+  }
+
+  cast<MachineSDNode>(res)->setMemRefs(memOp, memOp + 1);
+  return res;
+}
+
+//-----------------------------------------------------------------------------
+
+// Circular buffer accesses (the only memory intrinsics we have) are post-
+// modifying loads/stores whose base is copied into one of A4-A7. The log2 of
+// the buffer size is kept in the instruction, the AMR is set up from it after
+// register allocation (see CircularAddressing.cpp)
+
+SDNode *TMS320C64XInstSelectorPass::SelectCircular(SDNode *op) {
+  MemIntrinsicSDNode *mem = cast<MemIntrinsicSDNode>(op);
+  DebugLoc dl = op->getDebugLoc();
+  bool store = false;
+  unsigned opc;
+
+  switch (cast<ConstantSDNode>(op->getOperand(1))->getZExtValue()) {
+    default: llvm_unreachable("unknown memory intrinsic");
+    case Intrinsic::c64x_circ_ldw:  opc = TMS320C64X::word_circload_1; break;
+    case Intrinsic::c64x_circ_ldh:  opc = TMS320C64X::hword_circload_1; break;
+    case Intrinsic::c64x_circ_ldhu: opc = TMS320C64X::uhword_circload_1; break;
+    case Intrinsic::c64x_circ_ldb:  opc = TMS320C64X::byte_circload_1; break;
+    case Intrinsic::c64x_circ_ldbu: opc = TMS320C64X::ubyte_circload_1; break;
+    case Intrinsic::c64x_circ_stw:
+      opc = TMS320C64X::word_circstore_1;
+      store = true;
+      break;
+    case Intrinsic::c64x_circ_sth:
+      opc = TMS320C64X::hword_circstore_1;
+      store = true;
+      break;
+    case Intrinsic::c64x_circ_stb:
+      opc = TMS320C64X::byte_circstore_1;
+      store = true;
+      break;
+  }
+
+  // step and size have been checked during lowering
+  unsigned numOps = op->getNumOperands();
+  int step = cast<ConstantSDNode>(op->getOperand(numOps - 2))->getSExtValue();
+  uint64_t size =
+    cast<ConstantSDNode>(op->getOperand(numOps - 1))->getZExtValue();
+
+  SDValue base = SDValue(CurDAG->getMachineNode(
+    TargetOpcode::COPY_TO_REGCLASS, dl, MVT::i32, op->getOperand(2),
+    CurDAG->getTargetConstant(TMS320C64X::ACircRegsRegClassID, MVT::i32)), 0);
+  SDValue offs = CurDAG->getTargetConstant(step, MVT::i32);
+  SDValue bk = CurDAG->getTargetConstant(Log2_64(size), MVT::i32);
+  SDValue pred = CurDAG->getTargetConstant(-1, MVT::i32);
+  SDValue predReg = CurDAG->getRegister(TMS320C64X::NoRegister, MVT::i32);
+  SDValue unit = CurDAG->getTargetConstant(TMS320C64XII::unit_d << 1,
+                                           MVT::i32);
+  SDValue chain = op->getOperand(0);
+
+  MachineSDNode::mmo_iterator memOp = MF->allocateMemRefsArray(1);
+  memOp[0] = mem->getMemOperand();
+
+  SDNode *res;
+  if (!store) {
+    // loaded value, modified base, chain
+    SDValue ops[] = { base, offs, bk, pred, predReg, unit, chain };
+    res = CurDAG->SelectNodeTo(op, opc, MVT::i32, MVT::i32, MVT::Other,
+                               ops, 7);
+  } else {
+    // modified base, chain
+    SDValue ops[] = {
+      base, offs, op->getOperand(3), bk, pred, predReg, unit, chain
+    };
+    res = CurDAG->SelectNodeTo(op, opc, MVT::i32, MVT::Other, ops, 8);
+  }
+
+  cast<MachineSDNode>(res)->setMemRefs(memOp, memOp + 1);
+  return res;
 }
@@ -24,7 +24,11 @@
 // THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //===----------------------------------------------------------------------===//
 
+#include "TMS320C64X.h"
 #include "TMS320C64XSubtarget.h"
+#include "TMS320C64XInstrInfo.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/ScheduleDAG.h"
 #include "llvm/Target/SubtargetFeature.h"
 #include "TMS320C64XGenSubtarget.inc"
 #include <cassert>
@@ -35,6 +39,7 @@ TMS320C64XSubtarget::TMS320C64XSubtarget(const std::string &TT,
                                                const std::string &FS)
   : HasMPY32(true)
   , DoILP(false)
+  , HasFP(false)
 {
   // AJO: currently defaults to baseline compiler (no ILP attempted)
   ParseSubtargetFeatures(FS, "c64_basic");
@@ -48,3 +53,68 @@ const char *TMS320C64XSubtarget::getABIOptionString() const {
 bool TMS320C64XSubtarget::hasLibcall(const char *name) const {
   return Libcalls.count(name);
 }
+
+//-----------------------------------------------------------------------------
+
+/// On the C64x+ an instruction that reads a register via the cross path
+/// stalls for one cycle, if the register is written by a load issued in the
+/// cycle before (ie. the load result arrives in the same cycle). We add the
+/// stall to the latency of the dependency, so the post-RA scheduler rather
+/// fills the cycle with some other instruction.
+void TMS320C64XSubtarget::adjustSchedDependency(SUnit *def, SUnit *use,
+                                                SDep &dep) const {
+  using namespace TMS320C64XII;
+
+  // only the post-RA schedule knows the sides of the registers
+  if (!DoILP || dep.getKind() != SDep::Data
+      || !def->isInstr() || !use->isInstr())
+    return;
+
+  const MachineInstr *DefMI = def->getInstr();
+  const MachineInstr *UseMI = use->getInstr();
+
+  const TargetInstrDesc &defDesc = DefMI->getDesc();
+  if (!(defDesc.TSFlags & is_memaccess) || (defDesc.TSFlags & is_store))
+    return;
+
+  // memory accesses use the T paths, not the X paths
+  const TargetInstrDesc &useDesc = UseMI->getDesc();
+  if (useDesc.TSFlags & is_memaccess)
+    return;
+
+  unsigned reg = dep.getReg();
+  if (!reg)
+    return;
+
+  // only the data read from memory arrives late (in E5), other results of a
+  // load are written by the .D unit
+  int defIdx = DefMI->findRegisterDefOperandIdx(reg);
+  if (defIdx >= 0) {
+    unsigned defClass = defDesc.getSchedClass();
+    int defCycle = InstrItins.getOperandCycle(defClass, defIdx);
+    if (defCycle >= 0 && defCycle < (int) InstrItins.getStageLatency(defClass))
+      return;
+  }
+
+  unsigned useSide = IS_BSIDE(useDesc.TSFlags) ? 1 : 0;
+  if (UseMI->getOpcode() == TMS320C64X::mv) {
+    const MachineOperand &dst = UseMI->getOperand(0);
+    useSide = TMS320C64X::BRegsRegClass.contains(dst.getReg()) ? 1 : 0;
+  }
+
+  for (unsigned i = 0, e = UseMI->getNumOperands(); i != e; ++i) {
+    const MachineOperand &MO = UseMI->getOperand(i);
+    if (!MO.isReg() || MO.isDef() || MO.getReg() != reg)
+      continue;
+
+    // predicate registers are read without a cross path
+    if (i < useDesc.getNumOperands() && useDesc.OpInfo[i].isPredicate())
+      continue;
+
+    unsigned regSide = TMS320C64X::BRegsRegClass.contains(reg) ? 1 : 0;
+    if (regSide != useSide) {
+      dep.setLatency(dep.getLatency() + 1);
+      return;
+    }
+  }
+}
@@ -40,6 +40,7 @@ namespace llvm {
 
     bool HasMPY32;
     bool DoILP;
+    bool HasFP;
 
 
     /// This function is autogenerated by tblgen.
@@ -70,6 +71,14 @@ namespace llvm {
       return DoILP;
     }
 
+    bool hasMPY32() const {
+      return HasMPY32;
+    }
+
+    bool hasFP() const {
+      return HasFP;
+    }
+
     bool enableClusterAssignment() const {
       return DoILP;
     }
@@ -78,6 +87,10 @@ namespace llvm {
       return DoILP;
     }
 
+    // adjustSchedDependency - model the stall of a cross path read of a
+    // register loaded in the cycle before.
+    void adjustSchedDependency(SUnit *def, SUnit *use, SDep &dep) const;
+
     const char *getABIOptionString() const;
 
     // store lib call name and return a 'safe' pointer to it.
@@ -29,6 +29,7 @@
 #include "TMS320C64XMCAsmInfo.h"
 #include "llvm/PassManager.h"
 #include "llvm/CodeGen/Passes.h"
+#include "llvm/MC/MCStreamer.h"
 #include "llvm/Target/TargetRegistry.h"
 #include "llvm/Support/CommandLine.h"
 
@@ -43,6 +44,14 @@ static cl::opt<bool> EnableCallTimer("enable-libcall-timing",
   cl::Hidden, cl::desc("Enable backend support for timing of libcalls. (c64x)"),
   cl::init(false));
 
+static cl::opt<bool> EnableSPLoop("c64x-sploop",
+  cl::Hidden, cl::desc("Software pipeline inner loops (c64x+ SPLOOP)"),
+  cl::init(true));
+
+static cl::opt<bool> EnableShrinkWrap("c64x-shrink-wrap",
+  cl::Hidden, cl::desc("Save callee saved registers only on paths using them"),
+  cl::init(true));
+
 static cl::opt<AssignmentAlgorithm>
 ClusterOpt("c64x-clst",
   cl::desc("Choose a cluster assignment algorithm"),
@@ -54,11 +63,24 @@ ClusterOpt("c64x-clst",
     clEnumValN(ClusterUAS_none, "uas-none", "UAS (no priority: A before B)"),
     clEnumValN(ClusterUAS_rand, "uas-rand", "UAS (random cluster priority)"),
     clEnumValN(ClusterUAS_mwp, "uas-mwp", "UAS (magnitude weighted pred)"),
+    clEnumValN(ClusterUAS_rp, "uas-rp", "UAS (balance register pressure)"),
     clEnumValEnd),
   cl::init(ClusterNone));
 
 //-----------------------------------------------------------------------------
 
+// object files are always ELF (C6000 EABI)
+static MCStreamer *createMCStreamer(const Target &T, const std::string &TT,
+                                    MCContext &Ctx, TargetAsmBackend &TAB,
+                                    raw_ostream &OS,
+                                    MCCodeEmitter *Emitter,
+                                    bool RelaxAll,
+                                    bool NoExecStack) {
+  return createELFStreamer(Ctx, TAB, OS, Emitter, RelaxAll, NoExecStack);
+}
+
+//-----------------------------------------------------------------------------
+
 extern "C" void LLVMInitializeTMS320C64XTarget() {
   RegisterTargetMachine<TMS320C64XTargetMachine> X(TheTMS320C64XTarget);
 #if 0
@@ -66,6 +88,13 @@ extern "C" void LLVMInitializeTMS320C64XTarget() {
 #else
   RegisterAsmInfo<TMS320C64XMCAsmInfoELF> Z(TheTMS320C64XTarget);
 #endif
+
+  TargetRegistry::RegisterCodeEmitter(TheTMS320C64XTarget,
+                                      createTMS320C64XMCCodeEmitter);
+  TargetRegistry::RegisterAsmBackend(TheTMS320C64XTarget,
+                                     createTMS320C64XAsmBackend);
+  TargetRegistry::RegisterObjectStreamer(TheTMS320C64XTarget,
+                                         createMCStreamer);
 }
 
 //-----------------------------------------------------------------------------
@@ -74,7 +103,7 @@ TMS320C64XTargetMachine::TMS320C64XTargetMachine(const Target &T,
                                                  const std::string &TT,
 						 const std::string &FS)
 : VLIWTargetMachine(T, TT),
-  DataLayout("e-p:32:32:32-i8:8:8-i16:16:16-i32:32:32-f32:32:32-f64:64:64-n32"),
+  DataLayout("e-p:32:32:32-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-n32"),
 
   // No float types - could define n40, in that the DSP supports 40 bit
   // arithmetic, however it doesn't support it for all logic operations,
@@ -94,6 +123,21 @@ TMS320C64XTargetMachine::TMS320C64XTargetMachine(const Target &T,
 
 //-----------------------------------------------------------------------------
 
+bool TMS320C64XTargetMachine::addPreISel(PassManagerBase &PM,
+                                         CodeGenOpt::Level OptLevel)
+{
+  // inline division, the libcalls are kept at -O0
+  if (OptLevel != CodeGenOpt::None)
+    PM.add(createTMS320C64XDivisionExpansionPass());
+
+  // count loops down for bdec/bpos (see BranchOnCounter.cpp)
+  if (OptLevel != CodeGenOpt::None)
+    PM.add(createTMS320C64XCounterLoopPass());
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+
 bool TMS320C64XTargetMachine::addInstSelector(PassManagerBase &PM,
                                               CodeGenOpt::Level OptLevel)
 {
@@ -104,7 +148,7 @@ bool TMS320C64XTargetMachine::addInstSelector(PassManagerBase &PM,
 //-----------------------------------------------------------------------------
 
 bool TMS320C64XTargetMachine::addPreRegAlloc(PassManagerBase &PM,
-                                             CodeGenOpt::Level)
+                                             CodeGenOpt::Level OptLevel)
 {
   bool wantScheduleForm;
   switch (ClusterOpt) {
@@ -113,20 +157,66 @@ bool TMS320C64XTargetMachine::addPreRegAlloc(PassManagerBase &PM,
   case ClusterUAS_none:
   case ClusterUAS_rand:
   case ClusterUAS_mwp:
+  case ClusterUAS_rp:
            wantScheduleForm = true;
            break;
   }
 
+  // share and hoist constant materializations, load jump table entries in
+  // the delay slots of the range check. Both after machine sinking, which
+  // would move them back
+  if (OptLevel != CodeGenOpt::None) {
+    PM.add(createTMS320C64XConstantHoisting(*this));
+    PM.add(createTMS320C64XJumpTableDispatch(*this));
+  }
+
   if (Subtarget.enableClusterAssignment()) {
     if (wantScheduleForm) PM.add(createTMS320C64XBranchDelayExpander(*this));
     PM.add(createTMS320C64XClusterAssignment(*this, ClusterOpt));
     if (wantScheduleForm) PM.add(createTMS320C64XBranchDelayReducer(*this));
   }
+
+  // bpos needs the side of the counter
+  if (OptLevel != CodeGenOpt::None)
+    PM.add(createTMS320C64XBranchOnCounterSelect(*this));
   return false;
 }
 
 //-----------------------------------------------------------------------------
 
+bool TMS320C64XTargetMachine::getEnableShrinkWrapDefault() const {
+  return EnableShrinkWrap;
+}
+
+//-----------------------------------------------------------------------------
+
+bool TMS320C64XTargetMachine::addPreSched2(PassManagerBase &PM,
+                                           CodeGenOpt::Level OptLevel)
+{
+  // mvklh is rematerialized by the register allocator, it is a mvkl/mvkh
+  // pair for everything after
+  PM.add(createTMS320C64XConstantExpansion(*this));
+
+  // the AMR setup depends on the registers of circular buffer accesses, and
+  // needs to be scheduled along with everything else
+  PM.add(createTMS320C64XCircularAddressingPass(*this));
+
+  // the modulo scheduler emits bundles, so it is tied to the bundling
+  // post RA scheduler
+  if (Subtarget.enablePostRAScheduler() && EnableSPLoop
+      && OptLevel != CodeGenOpt::None) {
+    PM.add(createTMS320C64XModuloScheduler(*this));
+  }
+
+  // bdec after the modulo scheduler, which wants the counter update in the
+  // loop body
+  if (OptLevel != CodeGenOpt::None)
+    PM.add(createTMS320C64XBranchOnCounterFusion(*this));
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
 bool TMS320C64XTargetMachine::addPostRAScheduler(PassManagerBase &PM,
                                                 CodeGenOpt::Level OptLevel)
 {
@@ -160,6 +250,13 @@ bool TMS320C64XTargetMachine::addPostISel(PassManagerBase &PM,
     passesAdded = true;
   }
 
+  // every compare gets its own predicate register from the isel, more so
+  // in converted regions, try to share them
+  if (OptLevel != CodeGenOpt::None) {
+    PM.add(createTMS320C64XPredicateSharing(*this));
+    passesAdded = true;
+  }
+
   if (EnableCallTimer) {
     PM.add(createTMS320C64XCallTimerPass(*this));
     passesAdded = true;
@@ -91,12 +91,20 @@ class TMS320C64XTargetMachine : public VLIWTargetMachine {
       return false;
     }
 
+    virtual bool getEnableShrinkWrapDefault() const;
+
+    virtual bool addPreISel(PassManagerBase &PM,
+                            CodeGenOpt::Level OptLevel);
+
     virtual bool addInstSelector(PassManagerBase &PM,
 				 CodeGenOpt::Level OptLevel);
 
     virtual bool addPreRegAlloc(PassManagerBase &PM,
                                 CodeGenOpt::Level);
 
+    virtual bool addPreSched2(PassManagerBase &PM,
+                              CodeGenOpt::Level OptLevel);
+
     virtual bool addPostRAScheduler(PassManagerBase &PM,
                                     CodeGenOpt::Level OptLevel);
 
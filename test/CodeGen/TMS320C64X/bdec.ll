@@ -0,0 +1,110 @@
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ -c64x-sploop=false | \
+; RUN:   FileCheck %s
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ -c64x-sploop=false -stats |& \
+; RUN:   grep {loops closed with bdec} | grep {^ *4 }
+
+; The latches end with bdec and fall through into the exit, without a branch
+; to the layout successor behind the counter branch.
+; CHECK: sum:
+; CHECK: %loop
+; CHECK-NOT: cmpgt
+; CHECK: bdec .S1 {{LBB0_[0-9]+}},
+; CHECK-NOT: {{[[:space:]]b[[:space:]]}}
+; CHECK: %exit
+; CHECK: cond:
+; CHECK: %latch
+; CHECK: bdec .S1 {{LBB1_[0-9]+}},
+; CHECK-NOT: {{[[:space:]]b[[:space:]]}}
+; CHECK: %exit
+
+; Behind a guard the count n-1 is known not to wrap, the counter is set up
+; in a preheader in front of the loop.
+; CHECK: guarded:
+; CHECK: %loop.preheader
+; CHECK: %loop
+; CHECK-NOT: cmp
+; CHECK: bdec .S1 {{LBB2_[0-9]+}},
+; CHECK: %exit
+; CHECK: narrow:
+; CHECK: %loop.preheader
+; CHECK: %loop
+; CHECK-NOT: cmp
+; CHECK: bdec .S1 {{LBB3_[0-9]+}},
+; CHECK: %exit
+
+define i32 @sum(i32* %p, i32 %n) nounwind {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [0, %entry], [%i1, %loop]
+  %s = phi i32 [0, %entry], [%s1, %loop]
+  %a = getelementptr i32* %p, i32 %i
+  %v = load i32* %a
+  %s1 = add i32 %s, %v
+  %i1 = add i32 %i, 1
+  %c = icmp slt i32 %i1, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  %r = mul i32 %s1, %n
+  ret i32 %r
+}
+
+define i32 @cond(i32* %p, i32 %n) nounwind {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [0, %entry], [%i1, %latch]
+  %s = phi i32 [0, %entry], [%s2, %latch]
+  %a = getelementptr i32* %p, i32 %i
+  %v = load i32* %a
+  %z = icmp eq i32 %v, 0
+  br i1 %z, label %latch, label %body
+body:
+  %m = mul i32 %v, %v
+  store i32 %m, i32* %a
+  br label %latch
+latch:
+  %s2 = phi i32 [%s, %loop], [%v, %body]
+  %i1 = add i32 %i, 1
+  %c = icmp slt i32 %i1, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  %r = mul i32 %s2, %n
+  ret i32 %r
+}
+
+define i32 @guarded(i32* %p, i32 %n) nounwind {
+entry:
+  %g = icmp sgt i32 %n, 0
+  br i1 %g, label %loop, label %exit
+loop:
+  %i = phi i32 [0, %entry], [%i1, %loop]
+  %s = phi i32 [0, %entry], [%s1, %loop]
+  %a = getelementptr i32* %p, i32 %i
+  %v = load i32* %a
+  %s1 = add i32 %s, %v
+  %i1 = add i32 %i, 1
+  %c = icmp eq i32 %i1, %n
+  br i1 %c, label %exit, label %loop
+exit:
+  %r = phi i32 [0, %entry], [%s1, %loop]
+  ret i32 %r
+}
+
+define void @narrow(i16* %p, i16 %m) nounwind {
+entry:
+  %n = zext i16 %m to i32
+  %g = icmp eq i16 %m, 0
+  br i1 %g, label %exit, label %loop
+loop:
+  %i = phi i32 [0, %entry], [%i1, %loop]
+  %a = getelementptr i16* %p, i32 %i
+  %v = load i16* %a
+  %w = shl i16 %v, 1
+  store i16 %w, i16* %a
+  %i1 = add i32 %i, 1
+  %c = icmp ult i32 %i1, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret void
+}
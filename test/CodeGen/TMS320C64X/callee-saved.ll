@@ -0,0 +1,61 @@
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ | FileCheck %s
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ -c64x-shrink-wrap=false | \
+; RUN:   FileCheck %s -check-prefix=NOWRAP
+
+; The callee saved registers are saved and restored in even/odd pairs.
+; CHECK: pairs:
+; CHECK: stdw .D1T1 A11:A10, *-A15[2]
+; CHECK: stdw .D1T1 A13:A12, *-A15[3]
+; CHECK: callp
+; CHECK: lddw .D1T1 *-A15[2], A11:A10
+; CHECK: lddw .D1T1 *-A15[3], A13:A12
+
+; Shrink wrapped, A10 and A11 share a double word slot and are saved
+; together, the fast path saves and restores the pair only. The slow path
+; saves A12 itself.
+; CHECK: wrap:
+; CHECK: stdw .D1T1 A11:A10, *-A15[2]
+; CHECK-NOT: A12
+; CHECK: %fast
+; CHECK-NOT: A12
+; CHECK: lddw .D1T1 *-A15[2], A11:A10
+; CHECK-NOT: A12
+; CHECK: %slow
+; CHECK: stw .D1T1 A12, *-A15[5]
+; CHECK: callp
+; CHECK: lddw .D1T1 *-A15[2], A11:A10
+; CHECK: ldw .D1T1 *-A15[5], A12
+
+; Without shrink wrapping, the entry saves A12 as well.
+; NOWRAP: wrap:
+; NOWRAP: stdw .D1T1 A11:A10, *-A15[2]
+; NOWRAP: stw .D1T1 A12, *-A15[5]
+; NOWRAP: %fast
+
+declare i32 @g(i32)
+
+define i32 @pairs(i32 %a, i32 %b, i32 %c, i32 %d) nounwind {
+  %x = call i32 @g(i32 %a)
+  %y = add i32 %x, %b
+  %z = call i32 @g(i32 %y)
+  %s = add i32 %z, %c
+  %t = add i32 %s, %d
+  %u = add i32 %t, %a
+  %v = add i32 %u, %b
+  ret i32 %v
+}
+
+define i32 @wrap(i32 %a, i32 %b) nounwind {
+entry:
+  %z = icmp eq i32 %a, 0
+  br i1 %z, label %fast, label %slow
+fast:
+  ret i32 %b
+slow:
+  %x = call i32 @g(i32 %a)
+  %y = add i32 %x, %b
+  %w = call i32 @g(i32 %y)
+  %v = add i32 %w, %a
+  %r = add i32 %v, %b
+  ret i32 %r
+}
@@ -0,0 +1,60 @@
+; RUN: llc < %s -march=tms320c64x | FileCheck %s
+
+; sum addresses memory only through the circular pointer, the AMR switches A4
+; to BK0 (64 bytes) on entry and is cleared before the return.
+; CHECK: sum:
+; CHECK: mvkl .S2 327681, [[R:B[0-9]+]]
+; CHECK: mvkh .S2 327681, [[R]]
+; CHECK: mvc .S2 [[R]], AMR
+; CHECK: %loop
+; CHECK-NOT: AMR
+; CHECK: ldw .D1 *A4++[1],
+; CHECK: %exit
+; CHECK: mvk .S2 0, [[Z:B[0-9]+]]
+; CHECK: mvc .S2 [[Z]], AMR
+
+; The callee of call expects linear addressing, each load is a run of its
+; own.
+; CHECK: call:
+; CHECK: mvc .S2 {{B[0-9]+}}, AMR
+; CHECK: ldw .D1 *A4++[1],
+; CHECK: mvk .S2 0, [[Z:B[0-9]+]]
+; CHECK: mvc .S2 [[Z]], AMR
+; CHECK: callp .S2 g
+; CHECK: mvc .S2 {{B[0-9]+}}, AMR
+; CHECK: ldw .D1 *A4++[1],
+; CHECK: mvk .S2 0, [[Z:B[0-9]+]]
+; CHECK: mvc .S2 [[Z]], AMR
+
+declare {i32, i8*} @llvm.c64x.circ.ldw(i8*, i32, i32) nounwind readonly
+declare void @g()
+
+define i32 @sum(i8* %p, i32 %n) nounwind {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [0, %entry], [%i1, %loop]
+  %s = phi i32 [0, %entry], [%s1, %loop]
+  %q = phi i8* [%p, %entry], [%q1, %loop]
+  %r = call {i32, i8*} @llvm.c64x.circ.ldw(i8* %q, i32 1, i32 64)
+  %v = extractvalue {i32, i8*} %r, 0
+  %q1 = extractvalue {i32, i8*} %r, 1
+  %s1 = add i32 %s, %v
+  %i1 = add i32 %i, 1
+  %c = icmp slt i32 %i1, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret i32 %s1
+}
+
+define i32 @call(i8* %p) nounwind {
+entry:
+  %r = call {i32, i8*} @llvm.c64x.circ.ldw(i8* %p, i32 1, i32 64)
+  %v = extractvalue {i32, i8*} %r, 0
+  %q = extractvalue {i32, i8*} %r, 1
+  call void @g()
+  %r2 = call {i32, i8*} @llvm.c64x.circ.ldw(i8* %q, i32 1, i32 64)
+  %w = extractvalue {i32, i8*} %r2, 0
+  %s = add i32 %v, %w
+  ret i32 %s
+}
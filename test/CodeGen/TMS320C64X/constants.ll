@@ -0,0 +1,36 @@
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ -c64x-superblock-sched=false \
+; RUN:   | FileCheck %s
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ -c64x-superblock-sched=false \
+; RUN:   -c64x-hoist-constants=false | FileCheck %s -check-prefix=NOHOIST
+
+; Both stores address g, its address is materialized once in the dominating
+; entry block instead of once in each successor.
+; CHECK: merge:
+; CHECK: mvkl .S1 g, [[R:A[0-9]+]]
+; CHECK: mvkh .S1 g, [[R]]
+; CHECK: %then
+; CHECK-NOT: mvkl
+; CHECK: stw .D1T1 {{A[0-9]+}}, *[[R]]
+; CHECK: %else
+; CHECK-NOT: mvkl
+; CHECK: stw .D1T1 {{A[0-9]+}}, *[[R]]
+; NOHOIST: merge:
+; NOHOIST: %then
+; NOHOIST: mvkl .S1 g,
+; NOHOIST: %else
+; NOHOIST: mvkl .S1 g,
+
+@g = global i32 0
+
+define void @merge(i32 %a, i32 %b) nounwind {
+entry:
+  %c = icmp eq i32 %a, 0
+  br i1 %c, label %then, label %else
+then:
+  store i32 %b, i32* @g
+  ret void
+else:
+  %m = mul i32 %b, %a
+  store i32 %m, i32* @g
+  ret void
+}
@@ -0,0 +1,29 @@
+; RUN: llc < %s -march=tms320c64x | FileCheck %s
+; RUN: llc < %s -march=tms320c64x -stats |& \
+; RUN:   grep {delay slots filled from above} | grep {^ *2 }
+; RUN: llc < %s -march=tms320c64x -mcpu=generic 2> /dev/null | FileCheck %s
+
+; Without the post-RA scheduler, the copy and the subtraction independent of
+; the compare move into the delay slots of the branch, a single nop covers
+; the rest. An unknown CPU has no itineraries, the latencies are taken from
+; the delay slots then.
+; CHECK: fill:
+; CHECK: cmpeq .L1 0, A4, A0
+; CHECK-NEXT: [!A0] b .S1 [[F:LBB0_[0-9]+]]
+; CHECK-NEXT: mv B4, A3
+; CHECK-NEXT: sub .L1 A3, A6, A5
+; CHECK-NEXT: nop 3
+; CHECK: [[F]]:
+
+define i32 @fill(i32 %a, i32 %b, i32 %c) nounwind {
+entry:
+  %x = add i32 %a, %b
+  %y = sub i32 %b, %c
+  %z = icmp eq i32 %a, 0
+  br i1 %z, label %t, label %f
+t:
+  %p = mul i32 %x, %y
+  ret i32 %p
+f:
+  ret i32 %y
+}
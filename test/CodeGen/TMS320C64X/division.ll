@@ -0,0 +1,84 @@
+; RUN: llc < %s -march=tms320c64x | FileCheck %s
+; RUN: llc < %s -march=tms320c64x -c64x-inline-div=false | \
+; RUN:   FileCheck %s -check-prefix=CALL
+
+; Divisions by a variable divisor are aligned with lmbd and developed with
+; subc, signed ones on the absolute values.
+; CHECK: udiv:
+; CHECK-NOT: callp
+; CHECK: lmbd
+; CHECK: %div.loop
+; CHECK: subc
+; CHECK: srem:
+; CHECK-NOT: callp
+; CHECK: lmbd
+; CHECK: %div.loop
+; CHECK: subc
+; CHECK: %div.done
+; CHECK: neg
+
+; The reciprocal of a loop invariant divisor is developed by subc in front
+; of the loop, the loop multiplies by it.
+; CHECK: inv:
+; CHECK-NOT: callp
+; CHECK: %recip.loop
+; CHECK: subc
+; CHECK: %loop
+; CHECK-NOT: callp
+; CHECK: mpy32u
+; CHECK: %exit
+
+; Functions optimized for size keep the call, constant divisors are left to
+; the DAG.
+; CHECK: size:
+; CHECK: callp .S2 __c6xabi_divu,
+; CHECK: const:
+; CHECK-NOT: subc
+; CHECK: mpy32u
+; CHECK-NOT: subc
+; CHECK: .ref __c6xabi_divu
+
+; CALL: udiv:
+; CALL: callp .S2 __c6xabi_divu,
+; CALL: srem:
+; CALL: callp .S2 __c6xabi_remi,
+; CALL: inv:
+; CALL: %loop
+; CALL: callp .S2 __c6xabi_divu,
+
+define i32 @udiv(i32 %a, i32 %b) nounwind {
+  %q = udiv i32 %a, %b
+  ret i32 %q
+}
+
+define i32 @srem(i32 %a, i32 %b) nounwind {
+  %r = srem i32 %a, %b
+  ret i32 %r
+}
+
+define i32 @inv(i32* %p, i32 %d, i32 %n) nounwind {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [0, %entry], [%i1, %loop]
+  %s = phi i32 [0, %entry], [%s1, %loop]
+  %a = getelementptr i32* %p, i32 %i
+  %v = load i32* %a
+  %q = udiv i32 %v, %d
+  %s1 = add i32 %s, %q
+  %i1 = add i32 %i, 1
+  %c = icmp slt i32 %i1, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret i32 %s1
+}
+
+define i32 @size(i32 %a, i32 %b) nounwind optsize {
+  %q = udiv i32 %a, %b
+  ret i32 %q
+}
+
+define i32 @const(i32 %a) nounwind {
+  %q = udiv i32 %a, 7
+  ret i32 %q
+}
@@ -0,0 +1,128 @@
+; RUN: llc < %s -march=tms320c64x -mcpu=c674x | FileCheck %s
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ | \
+; RUN:   FileCheck %s -check-prefix=SOFT
+
+; The C674x executes single and double precision arithmetic, compares and
+; conversions natively, the values stay in the general purpose registers
+; and register pairs. Divisions remain library calls. The C64x+ calls the
+; runtime for all of them.
+
+; CHECK: fadd:
+; CHECK-NOT: callp
+; CHECK: addsp .L1X A4, B4, A4
+define float @fadd(float %a, float %b) nounwind {
+  %r = fadd float %a, %b
+  ret float %r
+}
+
+; CHECK: fsub:
+; CHECK-NOT: callp
+; CHECK: subsp .L1X A4, B4, A4
+define float @fsub(float %a, float %b) nounwind {
+  %r = fsub float %a, %b
+  ret float %r
+}
+
+; CHECK: fmul:
+; CHECK-NOT: callp
+; CHECK: mpysp .M1X A4, B4, A4
+define float @fmul(float %a, float %b) nounwind {
+  %r = fmul float %a, %b
+  ret float %r
+}
+
+; CHECK: fcmp:
+; CHECK-NOT: callp
+; CHECK: cmpltsp .S1X A4, B4,
+define i32 @fcmp(float %a, float %b) nounwind {
+  %c = fcmp olt float %a, %b
+  %r = zext i1 %c to i32
+  ret i32 %r
+}
+
+; CHECK: sitofp:
+; CHECK-NOT: callp
+; CHECK: intsp .L1 A4, A4
+define float @sitofp(i32 %a) nounwind {
+  %r = sitofp i32 %a to float
+  ret float %r
+}
+
+; CHECK: fptosi:
+; CHECK-NOT: callp
+; CHECK: sptrunc .L1 A4, A4
+define i32 @fptosi(float %a) nounwind {
+  %r = fptosi float %a to i32
+  ret i32 %r
+}
+
+; CHECK: dadd:
+; CHECK-NOT: callp
+; CHECK: adddp .L1 A5:A4, {{A[0-9]+}}:{{A[0-9]+}}, A5:A4
+define double @dadd(double %a, double %b) nounwind {
+  %r = fadd double %a, %b
+  ret double %r
+}
+
+; CHECK: dmul:
+; CHECK-NOT: callp
+; CHECK: mpydp .M1 A5:A4, {{A[0-9]+}}:{{A[0-9]+}}, A5:A4
+define double @dmul(double %a, double %b) nounwind {
+  %r = fmul double %a, %b
+  ret double %r
+}
+
+; CHECK: dcmp:
+; CHECK-NOT: callp
+; CHECK: cmpeqdp .S1 A5:A4, {{A[0-9]+}}:{{A[0-9]+}},
+define i32 @dcmp(double %a, double %b) nounwind {
+  %c = fcmp oeq double %a, %b
+  %r = zext i1 %c to i32
+  ret i32 %r
+}
+
+; CHECK: ext:
+; CHECK-NOT: callp
+; CHECK: spdp .S1 A4, A5:A4
+define double @ext(float %a) nounwind {
+  %r = fpext float %a to double
+  ret double %r
+}
+
+; CHECK: trunc:
+; CHECK-NOT: callp
+; CHECK: dpsp .L1 A5:A4, A4
+define float @trunc(double %a) nounwind {
+  %r = fptrunc double %a to float
+  ret float %r
+}
+
+; CHECK: dtoi:
+; CHECK-NOT: callp
+; CHECK: dptrunc .L1 A5:A4, A4
+define i32 @dtoi(double %a) nounwind {
+  %r = fptosi double %a to i32
+  ret i32 %r
+}
+
+; CHECK: itod:
+; CHECK-NOT: callp
+; CHECK: intdp .L1 A4, A5:A4
+define double @itod(i32 %a) nounwind {
+  %r = sitofp i32 %a to double
+  ret double %r
+}
+
+; CHECK: fdiv:
+; CHECK: callp .S2 __c6xabi_divf,
+define float @fdiv(float %a, float %b) nounwind {
+  %r = fdiv float %a, %b
+  ret float %r
+}
+
+; SOFT: fadd:
+; SOFT: callp .S2 __c6xabi_addf,
+; SOFT: dmul:
+; SOFT: callp .S2 __c6xabi_mpyd,
+; SOFT: itod:
+; SOFT: callp .S2 __c6xabi_fltid,
@@ -0,0 +1,59 @@
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ | FileCheck %s
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ | not grep {callp\|llsh}
+
+; Doubleword accesses go through a register pair, aligned ones with
+; lddw/stdw and the others with ldndw. i64 additions carry with addu into a
+; pair, the shifts are expanded inline instead of calling the RTS.
+; CHECK: copy:
+; CHECK: lddw .D1T1 *A3, [[PAIR:A[0-9]+:A[0-9]+]]
+; CHECK: stdw .D1T1 [[PAIR]], *A4
+; CHECK: unaligned:
+; CHECK: ldndw .D1T1 *A4, A5:A4
+; CHECK: add:
+; CHECK: addu .L1 A4, {{A[0-9]+}}, {{A[0-9]+:A[0-9]+}}
+; CHECK: shl:
+; CHECK: cmpltu
+; CHECK: [!A0] mv
+; CHECK: ashr:
+; CHECK: shr .S1 A5, 31,
+; CHECK: [!A0] mv
+; CHECK: lshr:
+; CHECK: shru .S1
+; CHECK: [!A0] mv
+
+define void @copy(i64* %d, i64* %s) nounwind {
+entry:
+  %v = load i64* %s, align 8
+  store i64 %v, i64* %d, align 8
+  ret void
+}
+
+define i64 @unaligned(i64* %s) nounwind {
+entry:
+  %v = load i64* %s, align 4
+  ret i64 %v
+}
+
+define i64 @add(i64 %a, i64 %b) nounwind {
+entry:
+  %r = add i64 %a, %b
+  ret i64 %r
+}
+
+define i64 @shl(i64 %a, i64 %n) nounwind {
+entry:
+  %r = shl i64 %a, %n
+  ret i64 %r
+}
+
+define i64 @ashr(i64 %a, i64 %n) nounwind {
+entry:
+  %r = ashr i64 %a, %n
+  ret i64 %r
+}
+
+define i64 @lshr(i64 %a, i64 %n) nounwind {
+entry:
+  %r = lshr i64 %a, %n
+  ret i64 %r
+}
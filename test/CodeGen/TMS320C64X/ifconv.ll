@@ -0,0 +1,85 @@
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ -if-conversion | FileCheck %s
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ -if-conversion -ifconv-fast-estimation | FileCheck %s -check-prefix=FAST
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ -if-conversion -stats |& grep {2 ifconversion.*predicated basic blocks}
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ -if-conversion -ifconv-fast-estimation -stats |& grep {1 ifconversion.*predicated basic blocks}
+
+; A short triangle is predicated by both cost models; the single block loop
+; that results is then pipelined.
+; CHECK: clip:
+; CHECK: sploop
+; CHECK: cmpgt .L1 [[V:A[0-9]+]], [[L:A[0-9]+]], A0
+; CHECK: [ A0] sub .L1 [[V]], [[L]],
+; CHECK: spkernel
+; FAST: clip:
+; FAST: sploop
+; FAST: [ A0] sub .L1
+; FAST: spkernel
+
+; The multiply chain is too long for the static heuristic, but the schedule
+; estimate weighs it against the branch taken on every iteration.
+; CHECK: scale:
+; CHECK: cmpgt .L1
+; CHECK-NOT: [!A0] b
+; CHECK: [ A0] mpy32 .M1X
+; CHECK: [ A0] mpy32 .M1X
+; CHECK: [ A0] mpy32 .M1X
+; CHECK: [ A0] mpy32 .M1X
+; CHECK: [ A0] mpy32 .M1X
+; CHECK: [ A0] mpy32 .M1X
+; FAST: scale:
+; FAST: cmpgt .L1 {{A[0-9]+}}, {{A[0-9]+}}, A0
+; FAST: [!A0] b .S1 [[LATCH:LBB1_[0-9]+]]
+; FAST-NOT: [ A0] mpy32
+; FAST: mpy32 .M1X
+; FAST: [[LATCH]]:
+
+define i32 @clip(i32* %p, i32 %n, i32 %lim) nounwind {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [0, %entry], [%i1, %latch]
+  %s = phi i32 [0, %entry], [%s1, %latch]
+  %a = getelementptr i32* %p, i32 %i
+  %v = load i32* %a
+  %c = icmp sgt i32 %v, %lim
+  br i1 %c, label %big, label %latch
+big:
+  %d = sub i32 %v, %lim
+  br label %latch
+latch:
+  %w = phi i32 [%d, %big], [%v, %loop]
+  %s1 = add i32 %s, %w
+  %i1 = add i32 %i, 1
+  %e = icmp slt i32 %i1, %n
+  br i1 %e, label %loop, label %exit
+exit:
+  ret i32 %s1
+}
+
+define i32 @scale(i32* %p, i32 %n, i32 %lim, i32 %k) nounwind {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [0, %entry], [%i1, %latch]
+  %s = phi i32 [0, %entry], [%s1, %latch]
+  %a = getelementptr i32* %p, i32 %i
+  %v = load i32* %a
+  %c = icmp sgt i32 %v, %lim
+  br i1 %c, label %big, label %latch
+big:
+  %d1 = mul i32 %v, %k
+  %d2 = mul i32 %d1, %k
+  %d3 = mul i32 %d2, %k
+  %d4 = mul i32 %d3, %k
+  %d5 = mul i32 %d4, %k
+  %d6 = mul i32 %d5, %k
+  br label %latch
+latch:
+  %w = phi i32 [%d6, %big], [%v, %loop]
+  %s1 = add i32 %s, %w
+  %i1 = add i32 %i, 1
+  %e = icmp slt i32 %i1, %n
+  br i1 %e, label %loop, label %exit
+exit:
+  ret i32 %s1
+}
@@ -0,0 +1,240 @@
+; RUN: llc < %s -march=tms320c64x | FileCheck %s
+; RUN: llc < %s -march=tms320c64x -O0 -filetype=obj -o %t
+; RUN: llc < %s -march=tms320c64x -filetype=obj -o %t
+
+; Every TI intrinsic selects its instruction, packed operands are passed in
+; words.
+
+; CHECK: add2:
+; CHECK: add2 .L1 A4, B4, A4
+define i32 @add2(i32 %a, i32 %b) nounwind {
+  %r = call i32 @llvm.c64x.add2(i32 %a, i32 %b)
+  ret i32 %r
+}
+
+; CHECK: sub2:
+; CHECK: sub2 .L1 A4, B4, A4
+define i32 @sub2(i32 %a, i32 %b) nounwind {
+  %r = call i32 @llvm.c64x.sub2(i32 %a, i32 %b)
+  ret i32 %r
+}
+
+; CHECK: add4:
+; CHECK: add4 .L1 A4, B4, A4
+define i32 @add4(i32 %a, i32 %b) nounwind {
+  %r = call i32 @llvm.c64x.add4(i32 %a, i32 %b)
+  ret i32 %r
+}
+
+; CHECK: sub4:
+; CHECK: sub4 .L1 A4, B4, A4
+define i32 @sub4(i32 %a, i32 %b) nounwind {
+  %r = call i32 @llvm.c64x.sub4(i32 %a, i32 %b)
+  ret i32 %r
+}
+
+; CHECK: max2:
+; CHECK: max2 .L1 A4, B4, A4
+define i32 @max2(i32 %a, i32 %b) nounwind {
+  %r = call i32 @llvm.c64x.max2(i32 %a, i32 %b)
+  ret i32 %r
+}
+
+; CHECK: min2:
+; CHECK: min2 .L1 A4, B4, A4
+define i32 @min2(i32 %a, i32 %b) nounwind {
+  %r = call i32 @llvm.c64x.min2(i32 %a, i32 %b)
+  ret i32 %r
+}
+
+; CHECK: avgu4:
+; CHECK: avgu4 .M1 A4, B4, A4
+define i32 @avgu4(i32 %a, i32 %b) nounwind {
+  %r = call i32 @llvm.c64x.avgu4(i32 %a, i32 %b)
+  ret i32 %r
+}
+
+; CHECK: dotp2:
+; CHECK: dotp2 .M1 A4, B4, A4
+define i32 @dotp2(i32 %a, i32 %b) nounwind {
+  %r = call i32 @llvm.c64x.dotp2(i32 %a, i32 %b)
+  ret i32 %r
+}
+
+; CHECK: dotpu4:
+; CHECK: dotpu4 .M1 A4, B4, A4
+define i32 @dotpu4(i32 %a, i32 %b) nounwind {
+  %r = call i32 @llvm.c64x.dotpu4(i32 %a, i32 %b)
+  ret i32 %r
+}
+
+; CHECK: pack2:
+; CHECK: pack2 .L1 A4, B4, A4
+define i32 @pack2(i32 %a, i32 %b) nounwind {
+  %r = call i32 @llvm.c64x.pack2(i32 %a, i32 %b)
+  ret i32 %r
+}
+
+; CHECK: packh2:
+; CHECK: packh2 .L1 A4, B4, A4
+define i32 @packh2(i32 %a, i32 %b) nounwind {
+  %r = call i32 @llvm.c64x.packh2(i32 %a, i32 %b)
+  ret i32 %r
+}
+
+; CHECK: packhl2:
+; CHECK: packhl2 .L1 A4, B4, A4
+define i32 @packhl2(i32 %a, i32 %b) nounwind {
+  %r = call i32 @llvm.c64x.packhl2(i32 %a, i32 %b)
+  ret i32 %r
+}
+
+; CHECK: packlh2:
+; CHECK: packlh2 .L1 A4, B4, A4
+define i32 @packlh2(i32 %a, i32 %b) nounwind {
+  %r = call i32 @llvm.c64x.packlh2(i32 %a, i32 %b)
+  ret i32 %r
+}
+
+; CHECK: lmbd:
+; CHECK: lmbd .L1 A4, B4, A4
+define i32 @lmbd(i32 %a, i32 %b) nounwind {
+  %r = call i32 @llvm.c64x.lmbd(i32 %a, i32 %b)
+  ret i32 %r
+}
+
+; CHECK: sadd:
+; CHECK: sadd .L1 A4, B4, A4
+define i32 @sadd(i32 %a, i32 %b) nounwind {
+  %r = call i32 @llvm.c64x.sadd(i32 %a, i32 %b)
+  ret i32 %r
+}
+
+; CHECK: ssub:
+; CHECK: ssub .L1 A4, B4, A4
+define i32 @ssub(i32 %a, i32 %b) nounwind {
+  %r = call i32 @llvm.c64x.ssub(i32 %a, i32 %b)
+  ret i32 %r
+}
+
+; the shift amount is side-fixed, only the value can cross
+; CHECK: sshl:
+; CHECK: mv B4, [[AMT:A[0-9]+]]
+; CHECK: sshl .S1 A4, [[AMT]], A4
+define i32 @sshl(i32 %a, i32 %b) nounwind {
+  %r = call i32 @llvm.c64x.sshl(i32 %a, i32 %b)
+  ret i32 %r
+}
+
+; CHECK: sshlx:
+; CHECK: sshl .S1 B4, A4, A4
+define i32 @sshlx(i32 %a, i32 %b) nounwind {
+  %r = call i32 @llvm.c64x.sshl(i32 %b, i32 %a)
+  ret i32 %r
+}
+
+; CHECK: sadd2:
+; CHECK: sadd2 .S1 A4, B4, A4
+define i32 @sadd2(i32 %a, i32 %b) nounwind {
+  %r = call i32 @llvm.c64x.sadd2(i32 %a, i32 %b)
+  ret i32 %r
+}
+
+; CHECK: saddu4:
+; CHECK: saddu4 .S1 A4, B4, A4
+define i32 @saddu4(i32 %a, i32 %b) nounwind {
+  %r = call i32 @llvm.c64x.saddu4(i32 %a, i32 %b)
+  ret i32 %r
+}
+
+; CHECK: smpy:
+; CHECK: smpy .M1 A4, B4, A4
+define i32 @smpy(i32 %a, i32 %b) nounwind {
+  %r = call i32 @llvm.c64x.smpy(i32 %a, i32 %b)
+  ret i32 %r
+}
+
+; CHECK: subc:
+; CHECK: subc .L1 A4, B4, A4
+define i32 @subc(i32 %a, i32 %b) nounwind {
+  %r = call i32 @llvm.c64x.subc(i32 %a, i32 %b)
+  ret i32 %r
+}
+
+; CHECK: sshli:
+; CHECK: sshl .S1 A4, 3, A4
+define i32 @sshli(i32 %a) nounwind {
+  %r = call i32 @llvm.c64x.sshl(i32 %a, i32 3)
+  ret i32 %r
+}
+
+; CHECK: swap4:
+; CHECK: swap4 .L1 A4, A4
+define i32 @swap4(i32 %a) nounwind {
+  %r = call i32 @llvm.c64x.swap4(i32 %a)
+  ret i32 %r
+}
+
+; CHECK: bitr:
+; CHECK: bitr .M1 A4, A4
+define i32 @bitr(i32 %a) nounwind {
+  %r = call i32 @llvm.c64x.bitr(i32 %a)
+  ret i32 %r
+}
+
+; CHECK: norm:
+; CHECK: norm .L1 A4, A4
+define i32 @norm(i32 %a) nounwind {
+  %r = call i32 @llvm.c64x.norm(i32 %a)
+  ret i32 %r
+}
+
+; _mpy2 writes both products into a register pair, the lower one into the
+; even register.
+; CHECK: mpy2:
+; CHECK: mpy2 .M1 A4, [[B:A[0-9]+]], [[HI:A[0-9]+]]:[[LO:A[0-9]+]]
+; CHECK: mv [[HI]], [[H:A[0-9]+]]
+; CHECK: sub .L1 [[H]], [[LO]], A4
+define i32 @mpy2(i32 %a, i32 %b) nounwind {
+  %p = call {i32, i32} @llvm.c64x.mpy2(i32 %a, i32 %b)
+  %lo = extractvalue {i32, i32} %p, 0
+  %hi = extractvalue {i32, i32} %p, 1
+  %r = sub i32 %hi, %lo
+  ret i32 %r
+}
+
+; _nassert generates no code.
+; CHECK: nassert:
+; CHECK-NOT: {{[[:space:]]nassert[[:space:]]}}
+; CHECK: b .S2 B3
+define i32 @nassert(i32 %a) nounwind {
+  call void @llvm.c64x.nassert(i32 %a)
+  ret i32 %a
+}
+
+declare i32 @llvm.c64x.add2(i32, i32) nounwind readnone
+declare i32 @llvm.c64x.sub2(i32, i32) nounwind readnone
+declare i32 @llvm.c64x.add4(i32, i32) nounwind readnone
+declare i32 @llvm.c64x.sub4(i32, i32) nounwind readnone
+declare i32 @llvm.c64x.max2(i32, i32) nounwind readnone
+declare i32 @llvm.c64x.min2(i32, i32) nounwind readnone
+declare i32 @llvm.c64x.avgu4(i32, i32) nounwind readnone
+declare i32 @llvm.c64x.dotp2(i32, i32) nounwind readnone
+declare i32 @llvm.c64x.dotpu4(i32, i32) nounwind readnone
+declare i32 @llvm.c64x.pack2(i32, i32) nounwind readnone
+declare i32 @llvm.c64x.packh2(i32, i32) nounwind readnone
+declare i32 @llvm.c64x.packhl2(i32, i32) nounwind readnone
+declare i32 @llvm.c64x.packlh2(i32, i32) nounwind readnone
+declare i32 @llvm.c64x.lmbd(i32, i32) nounwind readnone
+declare i32 @llvm.c64x.sadd(i32, i32) nounwind readnone
+declare i32 @llvm.c64x.ssub(i32, i32) nounwind readnone
+declare i32 @llvm.c64x.sshl(i32, i32) nounwind readnone
+declare i32 @llvm.c64x.sadd2(i32, i32) nounwind readnone
+declare i32 @llvm.c64x.saddu4(i32, i32) nounwind readnone
+declare i32 @llvm.c64x.smpy(i32, i32) nounwind readnone
+declare i32 @llvm.c64x.subc(i32, i32) nounwind readnone
+declare i32 @llvm.c64x.swap4(i32) nounwind readnone
+declare i32 @llvm.c64x.bitr(i32) nounwind readnone
+declare i32 @llvm.c64x.norm(i32) nounwind readnone
+declare {i32, i32} @llvm.c64x.mpy2(i32, i32) nounwind readnone
+declare void @llvm.c64x.nassert(i32) nounwind readonly
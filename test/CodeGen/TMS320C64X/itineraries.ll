@@ -0,0 +1,58 @@
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ | FileCheck %s
+
+; The result of mpy32 is written in E4 and read by the add three cycles
+; later.
+; CHECK: mpy32:
+; CHECK: mpy32 .M1X A4, B4, [[M:A[0-9]+]]
+; CHECK: nop 1
+; CHECK: nop 1
+; CHECK: nop 1
+; CHECK-NOT: nop
+; CHECK: add .L1 [[M]], 1,
+
+; smpy is a 16x16 multiply, it writes in E2.
+; CHECK: smpy:
+; CHECK: smpy .M1X A4, B4, [[S:A[0-9]+]]
+; CHECK: nop 1
+; CHECK-NOT: nop
+; CHECK: add .L1 [[S]], 1,
+
+; Stores read all of their operands in E1 and occupy .D for one cycle, the
+; load follows them right away. Its data arrives after four delay slots.
+; CHECK: stores:
+; CHECK: stw .D1T2 B4, *A4
+; CHECK-NOT: nop
+; CHECK: stw .D1T1 A6, *+A4[1]
+; CHECK-NOT: nop
+; CHECK: ldw .D1T1 *A4, [[V:A[0-9]+]]
+; CHECK: nop 1
+; CHECK: nop 1
+; CHECK: nop 1
+; CHECK: nop 1
+; CHECK-NOT: nop
+; CHECK: add .L1 [[V]], 1,
+
+define i32 @mpy32(i32 %a, i32 %b) nounwind {
+  %m = mul i32 %a, %b
+  %r = add i32 %m, 1
+  ret i32 %r
+}
+
+declare i32 @llvm.c64x.smpy(i32, i32) nounwind readnone
+
+define i32 @smpy(i32 %a, i32 %b) nounwind {
+  %m = call i32 @llvm.c64x.smpy(i32 %a, i32 %b)
+  %r = add i32 %m, 1
+  ret i32 %r
+}
+
+define void @stores(i32* %p, i32 %a, i32 %b) nounwind {
+  store i32 %a, i32* %p
+  %q = getelementptr i32* %p, i32 1
+  store i32 %b, i32* %q
+  %v = load i32* %p
+  %s = add i32 %v, 1
+  %r = getelementptr i32* %p, i32 2
+  store i32 %s, i32* %r
+  ret void
+}
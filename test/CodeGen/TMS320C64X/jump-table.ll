@@ -0,0 +1,49 @@
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ | FileCheck %s
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ -c64x-hoist-jump-tables=false \
+; RUN:   -c64x-superblock-sched=false | FileCheck %s -check-prefix=NOHOIST
+
+; The table address and the entry load execute in the delay slots of the
+; range check, the load predicated on the index being in range. The dispatch
+; block is left with the indirect branch.
+; CHECK: sw:
+; CHECK: mvkl .S1 LJTI0_0, [[T:A[0-9]+]]
+; CHECK: cmpgtu .L1 A4, {{A[0-9]+}}, [[P:A.]]
+; CHECK: [![[P]]] ldw .D1T1 *[[T]][A4], [[D:A[0-9]+]]
+; CHECK: [ [[P]]] b .S1
+; CHECK: %entry
+; CHECK-NOT: ldw
+; CHECK: b .S2X [[D]]
+; NOHOIST: sw:
+; NOHOIST: cmpgtu
+; NOHOIST: %entry
+; NOHOIST: mvkl .S1 LJTI0_0,
+; NOHOIST: ldw
+; NOHOIST: b .S2X
+
+define i32 @sw(i32 %x, i32 %a) nounwind {
+entry:
+  switch i32 %x, label %def [
+    i32 0, label %b0
+    i32 1, label %b1
+    i32 2, label %b2
+    i32 3, label %b3
+    i32 4, label %b4
+  ]
+b0:
+  %r0 = add i32 %a, 11
+  ret i32 %r0
+b1:
+  %r1 = mul i32 %a, %a
+  ret i32 %r1
+b2:
+  %r2 = xor i32 %a, 1234
+  ret i32 %r2
+b3:
+  %r3 = shl i32 %a, 7
+  ret i32 %r3
+b4:
+  %r4 = sub i32 0, %a
+  ret i32 %r4
+def:
+  ret i32 %a
+}
@@ -0,0 +1,41 @@
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ -c64x-sploop=false \
+; RUN:   -c64x-clst=uas | FileCheck %s -check-prefix=UAS
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ -c64x-sploop=false \
+; RUN:   -c64x-clst=uas -c64x-loop-partition | FileCheck %s -check-prefix=PART
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ -c64x-sploop=false \
+; RUN:   -c64x-clst=uas -c64x-loop-partition -stats |& \
+; RUN:   grep {loop recurrences pinned}
+
+; Left to UAS, the sums are moved between the sides on every iteration.
+; Pinned, each sum stays on the side of its product.
+; UAS: %loop
+; UAS: mpy32
+; UAS: mv
+; UAS: branch occurs
+; PART: %loop
+; PART: mpy32
+; PART-NOT: mv
+; PART: branch occurs
+
+define i32 @f(i32* %p, i32* %q, i32 %n) nounwind {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [0, %entry], [%i1, %loop]
+  %s = phi i32 [0, %entry], [%s1, %loop]
+  %t = phi i32 [0, %entry], [%t1, %loop]
+  %a = getelementptr i32* %p, i32 %i
+  %v = load i32* %a
+  %b = getelementptr i32* %q, i32 %i
+  %w = load i32* %b
+  %s0 = mul i32 %v, %v
+  %s1 = add i32 %s, %s0
+  %t0 = mul i32 %w, %w
+  %t1 = add i32 %t, %t0
+  %i1 = add i32 %i, 1
+  %c = icmp slt i32 %i1, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  %r = xor i32 %s1, %t1
+  ret i32 %r
+}
@@ -0,0 +1,81 @@
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ | FileCheck %s
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ -c64x-counter-loops=false | \
+; RUN:   FileCheck %s -check-prefix=CMP
+
+; The iterations of sum overlap at II 1, the code after the spkernel is
+; reached once the epilog drained, without a branch to the exit.
+; CHECK: sum:
+; CHECK: mvc .S2 {{B[0-9]+}}, ILC
+; CHECK: sploop 1
+; CHECK: spkernel 0, 0
+; CHECK-NOT: {{[[:space:]]b[[:space:]]}}
+; CHECK: %exit
+
+; The recurrence of count makes the II as long as the schedule, nothing
+; would overlap in the loop buffer.
+; CHECK: count:
+; CHECK-NOT: sploop
+; CHECK: bdec
+; CHECK: %exit
+
+; A for loop behind its guard is pipelined as well, either on the counter
+; or with the exit compare copied into the predicate register.
+; CHECK: guarded:
+; CHECK: mvc .S2 {{B[0-9]+}}, ILC
+; CHECK: sploop 1
+; CHECK: spkernel
+; CMP: guarded:
+; CMP: mvc .S2 {{B[0-9]+}}, ILC
+; CMP: sploop
+; CMP: cmpeq .L1 0, [[I:A[0-9]+]], [[C:A[0-9]+]]
+; CMP: mv [[C]], A0
+; CMP: spkernel
+; CMP: %exit
+
+define i32 @sum(i32* %p, i32 %n) nounwind {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [0, %entry], [%i1, %loop]
+  %s = phi i32 [0, %entry], [%s1, %loop]
+  %a = getelementptr i32* %p, i32 %i
+  %v = load i32* %a
+  %s1 = add i32 %s, %v
+  %i1 = add i32 %i, 1
+  %c = icmp slt i32 %i1, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret i32 %s1
+}
+
+define i32 @count(i32 %a, i32 %b, i32 %n) nounwind {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [0, %entry], [%i1, %loop]
+  %x = phi i32 [%a, %entry], [%x1, %loop]
+  %x1 = xor i32 %x, %b
+  %i1 = add i32 %i, 1
+  %c = icmp slt i32 %i1, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret i32 %x1
+}
+
+define i32 @guarded(i32* %p, i32 %n) nounwind {
+entry:
+  %g = icmp sgt i32 %n, 0
+  br i1 %g, label %loop, label %exit
+loop:
+  %i = phi i32 [0, %entry], [%i1, %loop]
+  %s = phi i32 [0, %entry], [%s1, %loop]
+  %a = getelementptr i32* %p, i32 %i
+  %v = load i32* %a
+  %s1 = add i32 %s, %v
+  %i1 = add i32 %i, 1
+  %c = icmp eq i32 %i1, %n
+  br i1 %c, label %exit, label %loop
+exit:
+  %r = phi i32 [0, %entry], [%s1, %loop]
+  ret i32 %r
+}
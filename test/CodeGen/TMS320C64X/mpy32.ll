@@ -0,0 +1,56 @@
+; RUN: llc < %s -march=tms320c64x | FileCheck %s
+; RUN: llc < %s -march=tms320c64x | not grep {callp}
+
+; The high word of a 32x32 product comes from the odd register of the pair
+; written by mpy32 (signed) or mpy32u (unsigned).
+; CHECK: mulhs:
+; CHECK: mpy32 .M1 A4, {{A[0-9]+}}, [[HI:A[0-9]+]]:{{A[0-9]+}}
+; CHECK: mv [[HI]], A4
+; CHECK: mulhu:
+; CHECK: mpy32u .M1 A4, {{A[0-9]+}}, [[HU:A[0-9]+]]:{{A[0-9]+}}
+; CHECK: mv [[HU]], A4
+
+; A 64 bit product takes the full product of the low words and adds the
+; low words of the cross products to its high word.
+; CHECK: mul64:
+; CHECK: mpy32u .M1 A4, {{A[0-9]+}}, [[PH:A[0-9]+]]:[[PL:A[0-9]+]]
+; CHECK: mpy32 .M1 A4, B5, [[C1:A[0-9]+]]
+; CHECK: mpy32 .M1 A5, {{A[0-9]+}}, [[C2:A[0-9]+]]
+; CHECK: mv [[PH]], A5
+; CHECK: mv [[PL]], A4
+; CHECK: add .L1 A5, [[C1]], A5
+; CHECK: add .L1 A5, [[C2]], A5
+
+; Divisions by constants multiply by the magic number with mpy32.
+; CHECK: div7:
+; CHECK: mvkl .S1 -1840700269, [[M:A[0-9]+]]
+; CHECK: mpy32 .M1 A4, [[M]], [[DH:A[0-9]+]]:
+; CHECK: add .L1 [[DH]], A4,
+
+define i32 @mulhs(i32 %a, i32 %b) nounwind {
+  %x = sext i32 %a to i64
+  %y = sext i32 %b to i64
+  %p = mul i64 %x, %y
+  %h = lshr i64 %p, 32
+  %r = trunc i64 %h to i32
+  ret i32 %r
+}
+
+define i32 @mulhu(i32 %a, i32 %b) nounwind {
+  %x = zext i32 %a to i64
+  %y = zext i32 %b to i64
+  %p = mul i64 %x, %y
+  %h = lshr i64 %p, 32
+  %r = trunc i64 %h to i32
+  ret i32 %r
+}
+
+define i64 @mul64(i64 %a, i64 %b) nounwind {
+  %p = mul i64 %a, %b
+  ret i64 %p
+}
+
+define i32 @div7(i32 %a) nounwind {
+  %q = sdiv i32 %a, 7
+  ret i32 %q
+}
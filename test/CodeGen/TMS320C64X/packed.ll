@@ -0,0 +1,82 @@
+; RUN: llc < %s -march=tms320c64x | FileCheck %s
+
+; Packed v2i16/v4i8 operations select the C64x SIMD instructions.
+
+; CHECK: add2:
+; CHECK: add2 .L1 A4, B4, A4
+define <2 x i16> @add2(<2 x i16> %a, <2 x i16> %b) nounwind {
+  %r = add <2 x i16> %a, %b
+  ret <2 x i16> %r
+}
+
+; CHECK: sub2:
+; CHECK: sub2 .L1 A4, B4, A4
+define <2 x i16> @sub2(<2 x i16> %a, <2 x i16> %b) nounwind {
+  %r = sub <2 x i16> %a, %b
+  ret <2 x i16> %r
+}
+
+; CHECK: add4:
+; CHECK: add4 .L1 A4, B4, A4
+define <4 x i8> @add4(<4 x i8> %a, <4 x i8> %b) nounwind {
+  %r = add <4 x i8> %a, %b
+  ret <4 x i8> %r
+}
+
+; CHECK: sub4:
+; CHECK: sub4 .L1 A4, B4, A4
+define <4 x i8> @sub4(<4 x i8> %a, <4 x i8> %b) nounwind {
+  %r = sub <4 x i8> %a, %b
+  ret <4 x i8> %r
+}
+
+; CHECK: shr2:
+; CHECK: shr2 .S1 A4, 3, A4
+define <2 x i16> @shr2(<2 x i16> %a) nounwind {
+  %r = ashr <2 x i16> %a, <i16 3, i16 3>
+  ret <2 x i16> %r
+}
+
+; CHECK: shru2:
+; CHECK: shru2 .S1 A4, 15, A4
+define <2 x i16> @shru2(<2 x i16> %a) nounwind {
+  %r = lshr <2 x i16> %a, <i16 15, i16 15>
+  ret <2 x i16> %r
+}
+
+; different amounts for the halves are shifted one by one
+; CHECK: shr2_mixed:
+; CHECK-NOT: shr2 .S
+; CHECK: pack2
+define <2 x i16> @shr2_mixed(<2 x i16> %a) nounwind {
+  %r = ashr <2 x i16> %a, <i16 3, i16 4>
+  ret <2 x i16> %r
+}
+
+; CHECK: swap:
+; CHECK: packlh2 .L1 A4, A4, A4
+define <2 x i16> @swap(<2 x i16> %a) nounwind {
+  %r = shufflevector <2 x i16> %a, <2 x i16> undef, <2 x i32> <i32 1, i32 0>
+  ret <2 x i16> %r
+}
+
+; CHECK: pack2:
+; CHECK: pack2 .L1 A3, A4, A4
+define <2 x i16> @pack2(<2 x i16> %a, <2 x i16> %b) nounwind {
+  %r = shufflevector <2 x i16> %a, <2 x i16> %b, <2 x i32> <i32 0, i32 2>
+  ret <2 x i16> %r
+}
+
+; CHECK: packh2:
+; CHECK: packh2 .L1 A3, A4, A4
+define <2 x i16> @packh2(<2 x i16> %a, <2 x i16> %b) nounwind {
+  %r = shufflevector <2 x i16> %a, <2 x i16> %b, <2 x i32> <i32 1, i32 3>
+  ret <2 x i16> %r
+}
+
+; CHECK: packhl2:
+; CHECK: packhl2 .L1 A4, B4, A4
+define <2 x i16> @packhl2(<2 x i16> %a, <2 x i16> %b) nounwind {
+  %r = shufflevector <2 x i16> %a, <2 x i16> %b, <2 x i32> <i32 2, i32 1>
+  ret <2 x i16> %r
+}
@@ -0,0 +1,49 @@
+; RUN: llc < %s -march=tms320c64x | FileCheck %s
+
+; The pointer increments of the streams are folded into the accesses, the
+; loop bodies hold no adds on the pointers.
+; CHECK: sum:
+; CHECK: %loop
+; CHECK: ldw .D1 *A4++[1], [[V:A[0-9]+]]
+; CHECK-NOT: add .L1 A4,
+; CHECK: add .L1 {{A[0-9]+}}, [[V]],
+; CHECK: %exit
+; CHECK: copy:
+; CHECK: mv B4, [[S:A[0-9]+]]
+; CHECK: %loop
+; CHECK: ldh .D1 *[[S]]++[1], [[H:A[0-9]+]]
+; CHECK-NOT: add
+; CHECK: sth .D1 [[H]], *A4++[1]
+; CHECK: %exit
+
+define i32 @sum(i32* %p, i32 %n) nounwind readonly {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [0, %entry], [%i1, %loop]
+  %s = phi i32 [0, %entry], [%s1, %loop]
+  %a = getelementptr i32* %p, i32 %i
+  %v = load i32* %a
+  %s1 = add i32 %s, %v
+  %i1 = add i32 %i, 1
+  %c = icmp slt i32 %i1, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret i32 %s1
+}
+
+define void @copy(i16* %d, i16* %s, i32 %n) nounwind {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [0, %entry], [%i1, %loop]
+  %a = getelementptr i16* %s, i32 %i
+  %v = load i16* %a
+  %b = getelementptr i16* %d, i32 %i
+  store i16 %v, i16* %b
+  %i1 = add i32 %i, 1
+  %c = icmp slt i32 %i1, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret void
+}
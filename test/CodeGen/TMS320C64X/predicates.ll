@@ -0,0 +1,43 @@
+; RUN: llc < %s -march=tms320c64x -if-conversion | FileCheck %s
+; RUN: llc < %s -march=tms320c64x -if-conversion \
+; RUN:   -c64x-share-predicates=false | FileCheck %s -check-prefix=NOSHARE
+
+; b > a is the condition of a < b and a >= b its inverse, all of them read
+; the result of the first compare.
+; CHECK: f:
+; CHECK: cmplt .L1 A4, A3, [[P:A.]]
+; CHECK-NOT: cmp
+; CHECK: [ [[P]]] stw .D1 A4, *A6
+; CHECK-NOT: cmp
+; CHECK: [ [[P]]] stw .D1 A3, *+A6[1]
+; CHECK-NOT: cmp
+; CHECK: %t3
+; NOSHARE: f:
+; NOSHARE: cmplt
+; NOSHARE: cmpgt
+; NOSHARE: cmplt
+
+define i32 @f(i32 %a, i32 %b, i32* %p) nounwind {
+entry:
+  %c1 = icmp slt i32 %a, %b
+  br i1 %c1, label %t1, label %j1
+t1:
+  store i32 %a, i32* %p
+  br label %j1
+j1:
+  %q = getelementptr i32* %p, i32 1
+  %c2 = icmp sgt i32 %b, %a
+  br i1 %c2, label %t2, label %j2
+t2:
+  store i32 %b, i32* %q
+  br label %j2
+j2:
+  %r = getelementptr i32* %p, i32 2
+  %c3 = icmp sge i32 %a, %b
+  br i1 %c3, label %t3, label %j3
+t3:
+  store i32 0, i32* %r
+  br label %j3
+j3:
+  ret i32 %a
+}
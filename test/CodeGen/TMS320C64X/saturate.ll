@@ -0,0 +1,183 @@
+; RUN: llc < %s -march=tms320c64x | FileCheck %s
+
+; Clamps of a wider result to the signed range of the narrower type become
+; the saturating instructions.
+; CHECK: sadd_q31:
+; CHECK: sadd .L1
+; CHECK: ssub_q31:
+; CHECK: ssub .L1
+; CHECK: sshl_q31:
+; CHECK: sshl .S1 {{A[0-9]+}}, 4,
+; CHECK: clamp16:
+; CHECK: sshl .S1 {{A[0-9]+}}, 16,
+; CHECK: shr .S1 {{A[0-9]+}}, 16,
+; CHECK: smpy_q15:
+; CHECK: smpy .M1
+; CHECK: shr .S1 {{A[0-9]+}}, 16,
+; CHECK: smpy_q31:
+; CHECK: smpy .M1
+; CHECK: sadd2_q15:
+; CHECK: sadd2 .S1
+; CHECK: ext .S1 {{A[0-9]+}}, 16, 16,
+; CHECK: saddu4_byte:
+; CHECK: saddu4 .S1
+
+; A bound that is not a power of 2, or not symmetric, stays a compare and
+; select pair.
+; CHECK: no_pow2:
+; CHECK-NOT: sshl
+; CHECK: cmpgt
+; CHECK: cmplt
+; CHECK: no_symmetric:
+; CHECK-NOT: sshl
+; CHECK: cmpgt
+; CHECK: cmplt
+
+; The operands of the i64 add are not sign extended, the sum may not fit
+; into 33 bits.
+; CHECK: no_sadd_wide:
+; CHECK-NOT: {{[[:space:]]sadd[[:space:]]}}
+; CHECK: addu
+
+; Word operands do not fit into the halfword lanes of sadd2, the clamp of
+; the sum is a plain sshl.
+; CHECK: no_sadd2_word:
+; CHECK-NOT: {{[[:space:]]sadd2[[:space:]]}}
+; CHECK: sshl .S1 {{A[0-9]+}}, 16,
+
+; The halfword sum may exceed 510, saddu4 would not see the upper byte.
+; CHECK: no_saddu4_half:
+; CHECK-NOT: {{[[:space:]]saddu4[[:space:]]}}
+; CHECK: cmpgtu
+
+define i32 @sadd_q31(i32 %a, i32 %b) nounwind readnone {
+  %x = sext i32 %a to i64
+  %y = sext i32 %b to i64
+  %s = add i64 %x, %y
+  %c1 = icmp sgt i64 %s, 2147483647
+  %m1 = select i1 %c1, i64 2147483647, i64 %s
+  %c2 = icmp slt i64 %m1, -2147483648
+  %m2 = select i1 %c2, i64 -2147483648, i64 %m1
+  %r = trunc i64 %m2 to i32
+  ret i32 %r
+}
+
+define i32 @ssub_q31(i32 %a, i32 %b) nounwind readnone {
+  %x = sext i32 %a to i64
+  %y = sext i32 %b to i64
+  %s = sub i64 %x, %y
+  %c1 = icmp sgt i64 %s, 2147483647
+  %m1 = select i1 %c1, i64 2147483647, i64 %s
+  %c2 = icmp slt i64 %m1, -2147483648
+  %m2 = select i1 %c2, i64 -2147483648, i64 %m1
+  %r = trunc i64 %m2 to i32
+  ret i32 %r
+}
+
+define i32 @sshl_q31(i32 %a) nounwind readnone {
+  %x = sext i32 %a to i64
+  %s = shl i64 %x, 4
+  %c1 = icmp sgt i64 %s, 2147483647
+  %m1 = select i1 %c1, i64 2147483647, i64 %s
+  %c2 = icmp slt i64 %m1, -2147483648
+  %m2 = select i1 %c2, i64 -2147483648, i64 %m1
+  %r = trunc i64 %m2 to i32
+  ret i32 %r
+}
+
+define i32 @clamp16(i32 %x) nounwind readnone {
+  %c1 = icmp sgt i32 %x, 32767
+  %m1 = select i1 %c1, i32 32767, i32 %x
+  %c2 = icmp slt i32 %m1, -32768
+  %m2 = select i1 %c2, i32 -32768, i32 %m1
+  ret i32 %m2
+}
+
+define i32 @smpy_q15(i16 %a, i16 %b) nounwind readnone {
+  %x = sext i16 %a to i32
+  %y = sext i16 %b to i32
+  %p = mul i32 %x, %y
+  %s = ashr i32 %p, 15
+  %c1 = icmp sgt i32 %s, 32767
+  %m1 = select i1 %c1, i32 32767, i32 %s
+  %c2 = icmp slt i32 %m1, -32768
+  %m2 = select i1 %c2, i32 -32768, i32 %m1
+  ret i32 %m2
+}
+
+define i32 @smpy_q31(i16 %a, i16 %b) nounwind readnone {
+  %x = sext i16 %a to i64
+  %y = sext i16 %b to i64
+  %p = mul i64 %x, %y
+  %s = shl i64 %p, 1
+  %c1 = icmp sgt i64 %s, 2147483647
+  %m1 = select i1 %c1, i64 2147483647, i64 %s
+  %c2 = icmp slt i64 %m1, -2147483648
+  %m2 = select i1 %c2, i64 -2147483648, i64 %m1
+  %r = trunc i64 %m2 to i32
+  ret i32 %r
+}
+
+define i32 @sadd2_q15(i16 %a, i16 %b) nounwind readnone {
+  %x = sext i16 %a to i32
+  %y = sext i16 %b to i32
+  %s = add i32 %x, %y
+  %c1 = icmp sgt i32 %s, 32767
+  %m1 = select i1 %c1, i32 32767, i32 %s
+  %c2 = icmp slt i32 %m1, -32768
+  %m2 = select i1 %c2, i32 -32768, i32 %m1
+  ret i32 %m2
+}
+
+define i32 @saddu4_byte(i8 %a, i8 %b) nounwind readnone {
+  %x = zext i8 %a to i32
+  %y = zext i8 %b to i32
+  %s = add i32 %x, %y
+  %c = icmp ugt i32 %s, 255
+  %m = select i1 %c, i32 255, i32 %s
+  ret i32 %m
+}
+
+define i32 @no_pow2(i32 %x) nounwind readnone {
+  %c1 = icmp sgt i32 %x, 1000
+  %m1 = select i1 %c1, i32 1000, i32 %x
+  %c2 = icmp slt i32 %m1, -1000
+  %m2 = select i1 %c2, i32 -1000, i32 %m1
+  ret i32 %m2
+}
+
+define i32 @no_symmetric(i32 %x) nounwind readnone {
+  %c1 = icmp sgt i32 %x, 32767
+  %m1 = select i1 %c1, i32 32767, i32 %x
+  %c2 = icmp slt i32 %m1, -32767
+  %m2 = select i1 %c2, i32 -32767, i32 %m1
+  ret i32 %m2
+}
+
+define i32 @no_sadd_wide(i64 %x, i64 %y) nounwind readnone {
+  %s = add i64 %x, %y
+  %c1 = icmp sgt i64 %s, 2147483647
+  %m1 = select i1 %c1, i64 2147483647, i64 %s
+  %c2 = icmp slt i64 %m1, -2147483648
+  %m2 = select i1 %c2, i64 -2147483648, i64 %m1
+  %r = trunc i64 %m2 to i32
+  ret i32 %r
+}
+
+define i32 @no_sadd2_word(i32 %a, i32 %b) nounwind readnone {
+  %s = add i32 %a, %b
+  %c1 = icmp sgt i32 %s, 32767
+  %m1 = select i1 %c1, i32 32767, i32 %s
+  %c2 = icmp slt i32 %m1, -32768
+  %m2 = select i1 %c2, i32 -32768, i32 %m1
+  ret i32 %m2
+}
+
+define i32 @no_saddu4_half(i16 %a, i16 %b) nounwind readnone {
+  %x = zext i16 %a to i32
+  %y = zext i16 %b to i32
+  %s = add i32 %x, %y
+  %c = icmp ugt i32 %s, 255
+  %m = select i1 %c, i32 255, i32 %s
+  ret i32 %m
+}
@@ -0,0 +1,55 @@
+; RUN: llc < %s -march=tms320c64x | FileCheck %s
+
+; The hardware scales the index register of an access by the access size.
+; An index the dag already shifted by that amount is used unshifted, no
+; shl/shr pair is left in front of the access.
+; CHECK: word:
+; CHECK-NOT: shl
+; CHECK-NOT: shr
+; CHECK: ldw .D1 *A4[{{A[0-9]+}}], A4
+; CHECK: half:
+; CHECK-NOT: shl
+; CHECK-NOT: shr
+; CHECK: ldh .D1 *A4[{{A[0-9]+}}], A4
+; CHECK: store:
+; CHECK-NOT: shl
+; CHECK-NOT: shr
+; CHECK: stw .D1 A6, *A4[{{A[0-9]+}}]
+
+; Any other byte offset is shifted down by the access size, no matter how
+; well the base is aligned. arr[2 * i] is at (i << 3) >> 2 words.
+; CHECK: even:
+; CHECK: ext .S1 A4, 3, 2, [[I:A[0-9]+]]
+; CHECK: stw .D1 B4, *{{A[0-9]+}}{{\[}}[[I]]{{\]}}
+
+@arr = global [64 x i32] zeroinitializer, align 8
+
+define i32 @word(i32* %p, i32 %i) nounwind readonly {
+entry:
+  %a = getelementptr i32* %p, i32 %i
+  %v = load i32* %a
+  ret i32 %v
+}
+
+define i32 @half(i16* %p, i32 %i) nounwind readonly {
+entry:
+  %a = getelementptr i16* %p, i32 %i
+  %v = load i16* %a
+  %r = sext i16 %v to i32
+  ret i32 %r
+}
+
+define void @store(i32* %p, i32 %i, i32 %v) nounwind {
+entry:
+  %a = getelementptr i32* %p, i32 %i
+  store i32 %v, i32* %a
+  ret void
+}
+
+define void @even(i32 %i, i32 %v) nounwind {
+entry:
+  %j = shl i32 %i, 1
+  %a = getelementptr [64 x i32]* @arr, i32 0, i32 %j
+  store i32 %v, i32* %a, align 8
+  ret void
+}
@@ -0,0 +1,77 @@
+; RUN: c64x-sim %s 2> /dev/null | FileCheck %s
+
+; Divisions by loop invariant divisors multiply by a reciprocal developed
+; with subc in front of the loop, check it for small, even, odd and large
+; divisors
+; CHECK: ok
+
+@ok = private constant [3 x i8] c"ok\00"
+@fail = private constant [5 x i8] c"fail\00"
+@vals = private constant [8 x i32] [i32 0, i32 1, i32 99, i32 1000,
+                                    i32 123456789, i32 2147483647, i32 -1,
+                                    i32 -2147483648]
+
+declare i32 @puts(i8*)
+
+define i32 @uinv(i32* %p, i32 %d) nounwind noinline {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [0, %entry], [%i1, %loop]
+  %s = phi i32 [0, %entry], [%s1, %loop]
+  %a = getelementptr i32* %p, i32 %i
+  %v = load i32* %a
+  %q = udiv i32 %v, %d
+  %s1 = add i32 %s, %q
+  %i1 = add i32 %i, 1
+  %c = icmp slt i32 %i1, 8
+  br i1 %c, label %loop, label %exit
+exit:
+  ret i32 %s1
+}
+
+define i32 @sinv(i32* %p, i32 %d) nounwind noinline {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [0, %entry], [%i1, %loop]
+  %s = phi i32 [0, %entry], [%s1, %loop]
+  %a = getelementptr i32* %p, i32 %i
+  %v = load i32* %a
+  %q = sdiv i32 %v, %d
+  %s1 = add i32 %s, %q
+  %i1 = add i32 %i, 1
+  %c = icmp slt i32 %i1, 8
+  br i1 %c, label %loop, label %exit
+exit:
+  ret i32 %s1
+}
+
+define i32 @main() nounwind {
+  %p = getelementptr [8 x i32]* @vals, i32 0, i32 0
+  %u1 = call i32 @uinv(i32* %p, i32 1)
+  %u3 = call i32 @uinv(i32* %p, i32 3)
+  %u10 = call i32 @uinv(i32* %p, i32 10)
+  %ub = call i32 @uinv(i32* %p, i32 -2147483647)
+  %ue = call i32 @uinv(i32* %p, i32 -2)
+  %s7 = call i32 @sinv(i32* %p, i32 -7)
+  %s5 = call i32 @sinv(i32* %p, i32 5)
+  %c1 = icmp eq i32 %u1, 123457887
+  %c2 = icmp eq i32 %u3, 2904464158
+  %c3 = icmp eq i32 %u10, 871339244
+  %c4 = icmp eq i32 %ub, 1
+  %c5 = icmp eq i32 %ue, 1
+  %c6 = icmp eq i32 %s7, -17636840
+  %c7 = icmp eq i32 %s5, 24691576
+  %a1 = and i1 %c1, %c2
+  %a2 = and i1 %a1, %c3
+  %a3 = and i1 %a2, %c4
+  %a4 = and i1 %a3, %c5
+  %a5 = and i1 %a4, %c6
+  %c = and i1 %a5, %c7
+  %ok = getelementptr [3 x i8]* @ok, i32 0, i32 0
+  %fail = getelementptr [5 x i8]* @fail, i32 0, i32 0
+  %m = select i1 %c, i8* %ok, i8* %fail
+  call i32 @puts(i8* %m)
+  ret i32 0
+}
@@ -0,0 +1,35 @@
+; RUN: c64x-sim %s 2> /dev/null | FileCheck %s
+
+; shr2 and shru2 shift the halfwords separately
+; CHECK: ok
+
+@ok = private constant [3 x i8] c"ok\00"
+@fail = private constant [5 x i8] c"fail\00"
+
+declare i32 @puts(i8*)
+
+define <2 x i16> @sra(<2 x i16> %a) nounwind noinline {
+  %r = ashr <2 x i16> %a, <i16 3, i16 3>
+  ret <2 x i16> %r
+}
+
+define <2 x i16> @srl(<2 x i16> %a) nounwind noinline {
+  %r = lshr <2 x i16> %a, <i16 3, i16 3>
+  ret <2 x i16> %r
+}
+
+define i32 @main() nounwind {
+  %a = bitcast i32 -2147418096 to <2 x i16>
+  %x = call <2 x i16> @sra(<2 x i16> %a)
+  %y = call <2 x i16> @srl(<2 x i16> %a)
+  %xi = bitcast <2 x i16> %x to i32
+  %yi = bitcast <2 x i16> %y to i32
+  %c1 = icmp eq i32 %xi, 4026531842
+  %c2 = icmp eq i32 %yi, 268435458
+  %c = and i1 %c1, %c2
+  %ok = getelementptr [3 x i8]* @ok, i32 0, i32 0
+  %fail = getelementptr [5 x i8]* @fail, i32 0, i32 0
+  %m = select i1 %c, i8* %ok, i8* %fail
+  call i32 @puts(i8* %m)
+  ret i32 0
+}
@@ -0,0 +1,125 @@
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ | FileCheck %s -check-prefix=ASM
+; RUN: c64x-sim -mcpu=c64x+ -c64x-sploop=false %s 2> /dev/null | FileCheck %s
+; RUN: c64x-sim -mcpu=c64x+ %s 2> /dev/null | FileCheck %s
+; RUN: c64x-sim -mcpu=c64x+ -c64x-counter-loops=false %s 2> /dev/null | \
+; RUN:   FileCheck %s
+; RUN: c64x-sim -mcpu=c64x+ %s |& not grep warning
+
+; The same results with the loop executed from the SPLOOP buffer, without
+; resource conflicts between the overlapped iterations, and with the prod
+; loop, too long for the buffer, expanded into prolog, kernel and epilog.
+; The original prod loop for short trip counts follows the exit block. The
+; guarded loop is entered for positive counts only.
+; ASM: mvc .S2 {{B[0-9]+}}, ILC
+; ASM: sploop
+; ASM: spkernel
+; ASM: prod:
+; ASM: [[ORIG:LBB1_[0-9]+]]
+; ASM: %exit
+; ASM: b .S2 B3
+; ASM: [[ORIG]]:
+; ASM: bpos .S1 [[ORIG]],
+; ASM: main:
+; CHECK: ok
+
+@arr = global [16 x i32] [i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7,
+                          i32 8, i32 9, i32 10, i32 11, i32 12, i32 13,
+                          i32 14, i32 15, i32 16]
+@ok = private constant [3 x i8] c"ok\00"
+@fail = private constant [5 x i8] c"fail\00"
+
+declare i32 @puts(i8*)
+
+define i32 @sum(i32* %p, i32 %n) nounwind noinline {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [0, %entry], [%i1, %loop]
+  %s = phi i32 [0, %entry], [%s1, %loop]
+  %a = getelementptr i32* %p, i32 %i
+  %v = load i32* %a
+  %s1 = add i32 %s, %v
+  %i1 = add i32 %i, 1
+  %c = icmp slt i32 %i1, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret i32 %s1
+}
+
+define i32 @prod(i32* %p, i32 %n) nounwind noinline {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [0, %entry], [%i1, %loop]
+  %s = phi i32 [1, %entry], [%s4, %loop]
+  %a = getelementptr i32* %p, i32 %i
+  %v = load i32* %a
+  %s1 = mul i32 %s, %v
+  %s2 = mul i32 %s1, %v
+  %s3 = mul i32 %s2, %v
+  %s4 = mul i32 %s3, %v
+  %i1 = add i32 %i, 1
+  %c = icmp slt i32 %i1, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret i32 %s4
+}
+
+define i32 @guarded(i32* %p, i32 %n) nounwind noinline {
+entry:
+  %g = icmp sgt i32 %n, 0
+  br i1 %g, label %loop, label %exit
+loop:
+  %i = phi i32 [0, %entry], [%i1, %loop]
+  %s = phi i32 [0, %entry], [%s1, %loop]
+  %a = getelementptr i32* %p, i32 %i
+  %v = load i32* %a
+  %s1 = add i32 %s, %v
+  %i1 = add i32 %i, 1
+  %c = icmp eq i32 %i1, %n
+  br i1 %c, label %exit, label %loop
+exit:
+  %r = phi i32 [0, %entry], [%s1, %loop]
+  ret i32 %r
+}
+
+define i32 @main() nounwind {
+  %p = getelementptr [16 x i32]* @arr, i32 0, i32 0
+  %s16 = call i32 @sum(i32* %p, i32 16)
+  %s5 = call i32 @sum(i32* %p, i32 5)
+  %s1 = call i32 @sum(i32* %p, i32 1)
+  %s0 = call i32 @sum(i32* %p, i32 0)
+  %c16 = icmp eq i32 %s16, 136
+  %c5 = icmp eq i32 %s5, 15
+  %c1 = icmp eq i32 %s1, 1
+  %c0 = icmp eq i32 %s0, 1
+  %a = and i1 %c16, %c5
+  %b = and i1 %c1, %c0
+  %p7 = call i32 @prod(i32* %p, i32 7)
+  %p2 = call i32 @prod(i32* %p, i32 2)
+  %p1 = call i32 @prod(i32* %p, i32 1)
+  %c7 = icmp eq i32 %p7, -244252672
+  %c2 = icmp eq i32 %p2, 16
+  %cp1 = icmp eq i32 %p1, 1
+  %d = and i1 %c7, %c2
+  %e = and i1 %d, %cp1
+  %g16 = call i32 @guarded(i32* %p, i32 16)
+  %g1 = call i32 @guarded(i32* %p, i32 1)
+  %g0 = call i32 @guarded(i32* %p, i32 0)
+  %gm = call i32 @guarded(i32* %p, i32 -3)
+  %cg16 = icmp eq i32 %g16, 136
+  %cg1 = icmp eq i32 %g1, 1
+  %cg0 = icmp eq i32 %g0, 0
+  %cgm = icmp eq i32 %gm, 0
+  %h = and i1 %cg16, %cg1
+  %i = and i1 %cg0, %cgm
+  %j = and i1 %h, %i
+  %f = and i1 %a, %b
+  %k = and i1 %f, %e
+  %c = and i1 %k, %j
+  %ok = getelementptr [3 x i8]* @ok, i32 0, i32 0
+  %fail = getelementptr [5 x i8]* @fail, i32 0, i32 0
+  %m = select i1 %c, i8* %ok, i8* %fail
+  call i32 @puts(i8* %m)
+  ret i32 0
+}
@@ -0,0 +1,70 @@
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ -c64x-superblock-sched=false | \
+; RUN:   FileCheck %s -check-prefix=BB
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ | FileCheck %s -check-prefix=SB
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ \
+; RUN:   -stats |& grep {superblocks scheduled as a whole} | grep {^ *2 }
+
+; Scheduled block by block, the increment and the loop test wait for the
+; side exit. The loop body forms a superblock, they move above the branch to
+; out into its delay slots.
+; BB: h:
+; BB: %loop
+; BB: b .S1
+; BB: %cont
+; BB: cmplt
+; SB: h:
+; SB: %loop
+; SB: b .S1
+; SB: cmplt
+; SB: %cont
+
+; The entry and next form a superblock, the products start above the branch
+; to out and the stack adjustment sunk below it is copied onto the exit edge.
+; The copy is placed right behind next, which returns.
+; BB: f:
+; BB: b .S1
+; BB: %next
+; BB: mpy32
+; SB: f:
+; SB: mpy32
+; SB: b .S1 [[EXIT:LBB1_[0-9]+]]
+; SB: %next
+; SB-NOT: mpy32
+; SB: [[EXIT]]:
+; SB: b LBB1_
+; SB: sub .L2 B15,
+
+define i32 @h(i32* %p, i32 %n, i32 %b) nounwind {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [0, %entry], [%i1, %cont]
+  %s = phi i32 [0, %entry], [%s1, %cont]
+  %a = getelementptr i32* %p, i32 %i
+  %v = load i32* %a
+  %z = icmp eq i32 %v, 0
+  br i1 %z, label %out, label %cont
+cont:
+  %m = mul i32 %b, %i
+  %t = add i32 %m, %s
+  %s1 = add i32 %t, %v
+  %i1 = add i32 %i, 1
+  %c = icmp slt i32 %i1, %n
+  br i1 %c, label %loop, label %out
+out:
+  %r = phi i32 [%s, %loop], [%s1, %cont]
+  ret i32 %r
+}
+
+define i32 @f(i32 %a, i32 %b, i32 %c) nounwind {
+entry:
+  %z = icmp eq i32 %a, 0
+  br i1 %z, label %out, label %next
+next:
+  %m = mul i32 %b, %c
+  %n = mul i32 %m, %b
+  %s = add i32 %n, %a
+  ret i32 %s
+out:
+  ret i32 %c
+}
@@ -0,0 +1,35 @@
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ -c64x-clst=uas -stats |& \
+; RUN:   grep {Number of register spills} | grep {^ *1 }
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ -c64x-clst=uas-rp -stats |& \
+; RUN:   not grep {Number of register spills}
+
+; The loaded values live across the call. Operand sides alone put most of
+; them on the A side, which has only four callee saved registers. uas-rp
+; places the rest on the B side and nothing is spilled around the call.
+
+declare void @g()
+
+define i32 @f(i32* %p, i32 %k) nounwind {
+entry:
+  %a0 = getelementptr i32* %p, i32 0
+  %v0 = load i32* %a0
+  %m0 = mul i32 %v0, %k
+  %a1 = getelementptr i32* %p, i32 1
+  %v1 = load i32* %a1
+  %m1 = mul i32 %v1, %k
+  %a2 = getelementptr i32* %p, i32 2
+  %v2 = load i32* %a2
+  %m2 = mul i32 %v2, %k
+  %a3 = getelementptr i32* %p, i32 3
+  %v3 = load i32* %a3
+  %m3 = mul i32 %v3, %k
+  %a4 = getelementptr i32* %p, i32 4
+  %v4 = load i32* %a4
+  %m4 = mul i32 %v4, %k
+  call void @g()
+  %y1 = add i32 %m0, %m1
+  %y2 = add i32 %y1, %m2
+  %y3 = add i32 %y2, %m3
+  %y4 = add i32 %y3, %m4
+  ret i32 %y4
+}
@@ -0,0 +1,20 @@
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ | FileCheck %s
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ -stats |& \
+; RUN:   grep {instructions moved to another unit}
+
+; The cluster assignment puts all of the adds on .L1. The post-RA scheduler
+; moves the ones finding .L1 taken to .S1 instead of waiting a cycle.
+; CHECK: units:
+; CHECK: sub .S1 A6, A8,
+; CHECK-NEXT: || add .L1 A4, A6,
+; CHECK: add .S1 A8, A4,
+; CHECK-NEXT: || and .L1
+
+define i32 @units(i32 %a, i32 %b, i32 %c, i32 %d, i32 %e) nounwind {
+  %x = add i32 %a, %c
+  %y = sub i32 %c, %e
+  %z = add i32 %e, %a
+  %w = and i32 %x, %y
+  %r = or i32 %w, %z
+  ret i32 %r
+}
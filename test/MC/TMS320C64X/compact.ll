@@ -0,0 +1,28 @@
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ -c64x-compact -filetype=obj \
+; RUN:   -o - | elf-dump --dump-section-data | FileCheck %s
+
+; Words 1-5 of the first fetch packet hold two 16-bit instructions each,
+; the header in word 7 has layout 0111110 and the p-bit of halfword 11, the
+; stw in parallel with the mvk behind it. One of each compact format:
+;   203c  ldw .D1T1 *+A4[1], A3   (Doff4)
+;   0c6e  nop 1                   (Unop)
+;   62b0  add .L1 A3, A5, A3      (L3)
+;   add0  add .L1 A3, -5, A5      (L3i)
+;   0054  stw .D1T1 A5, *A4       (Doff4)
+; CHECK: '.text'
+; CHECK: '_section_data', 'f402bc07 3c205c40 6c606e0c 6e0c6e0c b062306b d0ad5400 2b080000 0008c0e7
+
+define i32 @f(i32* %p) nounwind {
+entry:
+  %p1 = getelementptr i32* %p, i32 1
+  %p2 = getelementptr i32* %p, i32 2
+  %p3 = getelementptr i32* %p, i32 3
+  %a = load i32* %p1
+  %b = load i32* %p2
+  %c = load i32* %p3
+  %s = add i32 %a, %b
+  %t = sub i32 %s, %c
+  %u = add i32 %t, -5
+  store i32 %u, i32* %p
+  ret i32 %t
+}
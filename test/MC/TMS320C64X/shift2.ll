@@ -0,0 +1,15 @@
+; RUN: llc < %s -march=tms320c64x -filetype=obj -o - | \
+; RUN:   elf-dump --dump-section-data | FileCheck %s
+
+; shr2 .S1 A4, 3, A3 and shru2 .S1 A3, 15, A4, little endian words
+; CHECK: '.text'
+; CHECK: f06d9001 30ee0d02
+
+define i32 @shifts(i32 %a) nounwind readnone {
+entry:
+  %x = bitcast i32 %a to <2 x i16>
+  %s = ashr <2 x i16> %x, <i16 3, i16 3>
+  %u = lshr <2 x i16> %s, <i16 15, i16 15>
+  %r = bitcast <2 x i16> %u to i32
+  ret i32 %r
+}
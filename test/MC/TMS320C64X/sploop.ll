@@ -0,0 +1,23 @@
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ -filetype=obj \
+; RUN:   -o - | elf-dump --dump-section-data | FileCheck %s
+
+; mvc .S2 B4, ILC; nop 3; sploop 1 and the spkernel closing the loop
+; CHECK: '.text'
+; CHECK: a2039006 00400000 00800300
+; CHECK: 00400300
+
+define i32 @sum(i32* %p, i32 %n) nounwind {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [0, %entry], [%i1, %loop]
+  %s = phi i32 [0, %entry], [%s1, %loop]
+  %a = getelementptr i32* %p, i32 %i
+  %v = load i32* %a
+  %s1 = add i32 %s, %v
+  %i1 = add i32 %i, 1
+  %c = icmp slt i32 %i1, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret i32 %s1
+}
@@ -0,0 +1,18 @@
+; RUN: llc < %s -march=tms320c64x -mcpu=c64x+ -filetype=obj -o - | \
+; RUN:   elf-dump --dump-section-data | FileCheck %s
+
+; mvc .S2 B3, TSCL starts the counter, mvc .S2 TSCL, B3 and
+; mvc .S2 TSCL, B4 read the stamps, little endian words
+; CHECK: '.text'
+; CHECK: a2030c05 e203a801 e2032802
+
+declare i32 @llvm.c64x.timestamp.start()
+declare i32 @llvm.c64x.timestamp.end()
+
+define i32 @timed() nounwind {
+entry:
+  %a = call i32 @llvm.c64x.timestamp.start()
+  %b = call i32 @llvm.c64x.timestamp.end()
+  %d = sub i32 %b, %a
+  ret i32 %d
+}
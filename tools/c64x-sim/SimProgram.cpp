@@ -0,0 +1,471 @@
+//===-- SimProgram.cpp - Program image for the C64x+ simulator ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Captures the output of the TMS320C64X asm printer and links it into an
+// executable image.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SimProgram.h"
+#include "TMS320C64X.h"
+#include "TMS320C64XInstrInfo.h"
+#include "llvm/MC/MCContext.h"
+#include "llvm/MC/MCExpr.h"
+#include "llvm/MC/MCSectionELF.h"
+#include "llvm/MC/MCStreamer.h"
+#include "llvm/MC/MCSymbol.h"
+#include "llvm/Support/ELF.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+using namespace llvm;
+using namespace c64xsim;
+
+namespace llvm {
+namespace c64xsim {
+
+//-----------------------------------------------------------------------------
+// CaptureStreamer
+
+class CaptureStreamer : public MCStreamer {
+  SimProgram &P;
+  int Cur;
+
+  SimSection &cur() {
+    if (Cur < 0)
+      report_fatal_error("c64x-sim: output outside of a section");
+    return P.Sections[Cur];
+  }
+
+  void pad(unsigned Bytes, unsigned char Value) {
+    SimSection &S = cur();
+    if (!S.IsText) {
+      S.Data.insert(S.Data.end(), Bytes, Value);
+      return;
+    }
+    // padding in code is executed as nops (the zero word is nop 1)
+    for (unsigned i = 0; i < Bytes; i += 4)
+      EmitIntValue(0, std::min(4U, Bytes - i), 0);
+  }
+
+  void addLabel(MCSymbol *Sym, unsigned Sec, unsigned Offset) {
+    P.Labels[Sym] = std::make_pair(Sec, Offset);
+    if (P.FunctionNames.count(Sym->getName()) && P.Sections[Sec].IsText) {
+      // the addresses are assigned by link
+      SimFunction F = { Sym->getName(), Sec, Offset, 0, 0, false };
+      P.Functions.push_back(F);
+    }
+  }
+
+  void addInst(const MCInst &Inst, unsigned Size, bool Parallel, bool Hdr) {
+    SimInst I;
+    I.Inst = Inst;
+    I.Section = Cur;
+    I.Offset = cur().Data.size();
+    I.Addr = 0;
+    I.Size = Size;
+    I.Parallel = Parallel;
+    I.Header = Hdr;
+    P.Insts.push_back(I);
+    cur().Data.insert(cur().Data.end(), Size, 0);
+  }
+
+  void applyHeader(unsigned Header) {
+    // the p-bits of the 16-bit instructions in a header based fetch packet
+    // are kept in the header, indexed by halfword
+    unsigned FPStart = cur().Data.size() & ~31U;
+    for (unsigned i = P.Insts.size(); i-- != 0; ) {
+      SimInst &I = P.Insts[i];
+      if ((int) I.Section != Cur || I.Offset < FPStart)
+        break;
+      if (I.Size == 2)
+        I.Parallel = (Header >> ((I.Offset - FPStart) / 2)) & 0x1;
+    }
+  }
+
+public:
+  CaptureStreamer(MCContext &Ctx, SimProgram &prog)
+    : MCStreamer(Ctx), P(prog), Cur(-1) {}
+
+  virtual void ChangeSection(const MCSection *Section) {
+    Cur = P.getSection(Section, Section->getKind().isText());
+  }
+
+  // start in .text, like the ELF streamer
+  virtual void InitSections() {
+    SwitchSection(getContext().getELFSection(".text", ELF::SHT_PROGBITS,
+                                             ELF::SHF_EXECINSTR |
+                                             ELF::SHF_ALLOC,
+                                             SectionKind::getText()));
+  }
+
+  virtual void EmitLabel(MCSymbol *Symbol) {
+    addLabel(Symbol, Cur, cur().Data.size());
+  }
+
+  virtual void EmitAssignment(MCSymbol *Symbol, const MCExpr *Value) {
+    P.Assignments[Symbol] = Value;
+  }
+
+  virtual void EmitCommonSymbol(MCSymbol *Symbol, uint64_t Size,
+                                unsigned ByteAlignment) {
+    EmitLocalCommonSymbol(Symbol, Size);
+  }
+
+  virtual void EmitLocalCommonSymbol(MCSymbol *Symbol, uint64_t Size) {
+    unsigned Sec = P.getSection(0, false);
+    SimSection &S = P.Sections[Sec];
+    S.Data.resize((S.Data.size() + 7) & ~7U, 0);
+    addLabel(Symbol, Sec, S.Data.size());
+    S.Data.resize(S.Data.size() + Size, 0);
+  }
+
+  virtual void EmitZerofill(const MCSection *Section, MCSymbol *Symbol,
+                            unsigned Size, unsigned ByteAlignment) {
+    unsigned Sec = P.getSection(Section, false);
+    SimSection &S = P.Sections[Sec];
+    if (ByteAlignment > 1)
+      S.Data.resize((S.Data.size() + ByteAlignment - 1) & ~(ByteAlignment - 1));
+    S.Align = std::max(S.Align, ByteAlignment);
+    if (Symbol)
+      addLabel(Symbol, Sec, S.Data.size());
+    S.Data.resize(S.Data.size() + Size, 0);
+  }
+
+  virtual void EmitTBSSSymbol(const MCSection *Section, MCSymbol *Symbol,
+                              uint64_t Size, unsigned ByteAlignment) {
+    EmitZerofill(Section, Symbol, Size, ByteAlignment);
+  }
+
+  virtual void EmitBytes(StringRef Data, unsigned AddrSpace) {
+    if (cur().IsText)
+      report_fatal_error("c64x-sim: raw bytes in a code section");
+    cur().Data.insert(cur().Data.end(), Data.begin(), Data.end());
+  }
+
+  virtual void EmitIntValue(uint64_t Value, unsigned Size,
+                            unsigned AddrSpace) {
+    SimSection &S = cur();
+    if (S.IsText) {
+      // zero words are nops, the others fetch packet headers
+      if (Size != 4 || (Value && (Value >> 28) != 0xe))
+        report_fatal_error("c64x-sim: unexpected data in a code section");
+
+      if (Value) {
+        applyHeader(Value);
+        addInst(MCInst(), 4, false, true);
+        return;
+      }
+      MCInst Nop;
+      Nop.setOpcode(TMS320C64X::noop);
+      Nop.addOperand(MCOperand::CreateImm(1));
+      Nop.addOperand(MCOperand::CreateImm(-1));
+      Nop.addOperand(MCOperand::CreateReg(0));
+      Nop.addOperand(MCOperand::CreateImm(0));
+      addInst(Nop, 4, false, false);
+      return;
+    }
+    for (unsigned i = 0; i != Size; ++i)
+      S.Data.push_back((Value >> (8 * i)) & 0xff);
+  }
+
+  virtual void EmitValueImpl(const MCExpr *Value, unsigned Size,
+                             bool isPCRel, unsigned AddrSpace) {
+    SimSection &S = cur();
+    if (S.IsText || isPCRel)
+      report_fatal_error("c64x-sim: unsupported value in a code section");
+    SimFixup F = { (unsigned) S.Data.size(), Size, Value };
+    S.Fixups.push_back(F);
+    S.Data.insert(S.Data.end(), Size, 0);
+  }
+
+  virtual void EmitFill(uint64_t NumBytes, uint8_t FillValue,
+                        unsigned AddrSpace) {
+    pad(NumBytes, FillValue);
+  }
+
+  virtual void EmitValueToAlignment(unsigned ByteAlignment, int64_t Value,
+                                    unsigned ValueSize,
+                                    unsigned MaxBytesToEmit) {
+    SimSection &S = cur();
+    S.Align = std::max(S.Align, ByteAlignment);
+    unsigned Size = S.Data.size();
+    pad(((Size + ByteAlignment - 1) & ~(ByteAlignment - 1)) - Size, Value);
+  }
+
+  virtual void EmitCodeAlignment(unsigned ByteAlignment,
+                                 unsigned MaxBytesToEmit) {
+    EmitValueToAlignment(ByteAlignment, 0, 1, MaxBytesToEmit);
+  }
+
+  virtual void EmitInstruction(const MCInst &Inst) {
+    if (!cur().IsText)
+      report_fatal_error("c64x-sim: instruction outside of a code section");
+
+    // the trailing operand carries the p-bit, see TMS320C64XAsmPrinter
+    unsigned Flags = Inst.getOperand(Inst.getNumOperands() - 1).getImm();
+    if (Flags & TMS320C64XII::mc_compact)
+      addInst(Inst, 2, false, false);
+    else
+      addInst(Inst, 4, Flags & TMS320C64XII::mc_parallel, false);
+  }
+
+  // not used by ELF output or irrelevant for the simulation
+  virtual void EmitAssemblerFlag(MCAssemblerFlag Flag) {}
+  virtual void EmitThumbFunc(MCSymbol *Func) {}
+  virtual void EmitWeakReference(MCSymbol *Alias, const MCSymbol *Symbol) {
+    P.Assignments[Alias] = MCSymbolRefExpr::Create(Symbol, getContext());
+  }
+  virtual void EmitSymbolAttribute(MCSymbol *Symbol, MCSymbolAttr Attribute) {}
+  virtual void EmitSymbolDesc(MCSymbol *Symbol, unsigned DescValue) {}
+  virtual void BeginCOFFSymbolDef(const MCSymbol *Symbol) {}
+  virtual void EmitCOFFSymbolStorageClass(int StorageClass) {}
+  virtual void EmitCOFFSymbolType(int Type) {}
+  virtual void EndCOFFSymbolDef() {}
+  virtual void EmitELFSize(MCSymbol *Symbol, const MCExpr *Value) {}
+  virtual void EmitULEB128Value(const MCExpr *Value, unsigned AddrSpace) {
+    report_fatal_error("c64x-sim: LEB128 values are not supported");
+  }
+  virtual void EmitSLEB128Value(const MCExpr *Value, unsigned AddrSpace) {
+    report_fatal_error("c64x-sim: LEB128 values are not supported");
+  }
+  virtual void EmitValueToOffset(const MCExpr *Offset, unsigned char Value) {
+    report_fatal_error("c64x-sim: .org is not supported");
+  }
+  virtual void EmitFileDirective(StringRef Filename) {}
+  virtual void EmitDwarfAdvanceLineAddr(int64_t LineDelta,
+                                        const MCSymbol *LastLabel,
+                                        const MCSymbol *Label) {}
+  virtual void Finish() {}
+};
+
+} // namespace c64xsim
+} // namespace llvm
+
+//-----------------------------------------------------------------------------
+// SimProgram
+
+MCStreamer *SimProgram::createStreamer(MCContext &Ctx) {
+  return new CaptureStreamer(Ctx, *this);
+}
+
+unsigned SimProgram::getSection(const MCSection *Sec, bool IsText) {
+  for (unsigned i = 0, e = SectionPtrs.size(); i != e; ++i)
+    if (SectionPtrs[i] == Sec)
+      return i;
+
+  SimSection S;
+  S.IsText = IsText;
+  S.Align = IsText ? 32 : 8;
+  S.Addr = 0;
+
+  SectionPtrs.push_back(Sec);
+  Sections.push_back(S);
+  return Sections.size() - 1;
+}
+
+//-----------------------------------------------------------------------------
+
+bool SimProgram::resolveSymbol(const MCSymbol *Sym, int64_t &Res) {
+  DenseMap<const MCSymbol*, std::pair<unsigned, unsigned> >::iterator L =
+    Labels.find(Sym);
+  if (L != Labels.end()) {
+    Res = Sections[L->second.first].Addr + L->second.second;
+    return true;
+  }
+
+  DenseMap<const MCSymbol*, const MCExpr*>::iterator A =
+    Assignments.find(Sym);
+  if (A != Assignments.end())
+    return evaluate(A->second, Res);
+  if (Sym->isVariable())
+    return evaluate(Sym->getVariableValue(), Res);
+
+  // bind undefined functions to the host library
+  StringMap<unsigned>::iterator H = HostAddrs.find(Sym->getName());
+  if (H == HostAddrs.end()) {
+    if (!IsHostFn || !IsHostFn(Sym->getName())) {
+      Error = "undefined symbol '" + Sym->getName().str() + "'";
+      return false;
+    }
+    unsigned Addr = HostBase + HostAddrs.size() * HostSpacing;
+    HostAddrs[Sym->getName()] = Addr;
+    H = HostAddrs.find(Sym->getName());
+
+    SimFunction F = { Sym->getName(), 0, 0, Addr, Addr + HostSpacing, true };
+    Functions.push_back(F);
+  }
+  Res = H->second;
+  return true;
+}
+
+bool SimProgram::evaluate(const MCExpr *Expr, int64_t &Res) {
+  switch (Expr->getKind()) {
+    case MCExpr::Constant:
+      Res = cast<MCConstantExpr>(Expr)->getValue();
+      return true;
+
+    case MCExpr::SymbolRef:
+      return resolveSymbol(&cast<MCSymbolRefExpr>(Expr)->getSymbol(), Res);
+
+    case MCExpr::Unary: {
+      const MCUnaryExpr *U = cast<MCUnaryExpr>(Expr);
+      if (!evaluate(U->getSubExpr(), Res))
+        return false;
+      switch (U->getOpcode()) {
+        case MCUnaryExpr::LNot:  Res = !Res; break;
+        case MCUnaryExpr::Minus: Res = -Res; break;
+        case MCUnaryExpr::Not:   Res = ~Res; break;
+        case MCUnaryExpr::Plus:  break;
+      }
+      return true;
+    }
+
+    case MCExpr::Binary: {
+      const MCBinaryExpr *B = cast<MCBinaryExpr>(Expr);
+      int64_t L, R;
+      if (!evaluate(B->getLHS(), L) || !evaluate(B->getRHS(), R))
+        return false;
+      switch (B->getOpcode()) {
+        case MCBinaryExpr::Add: Res = L + R; return true;
+        case MCBinaryExpr::Sub: Res = L - R; return true;
+        case MCBinaryExpr::And: Res = L & R; return true;
+        case MCBinaryExpr::Or:  Res = L | R; return true;
+        case MCBinaryExpr::Shl: Res = L << R; return true;
+        case MCBinaryExpr::Shr: Res = L >> R; return true;
+        default:
+          break;
+      }
+      break;
+    }
+
+    default:
+      break;
+  }
+  Error = "unsupported expression";
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+
+bool SimProgram::link(unsigned Base, bool (*isHostFn)(StringRef)) {
+  IsHostFn = isHostFn;
+
+  // code first, then data
+  unsigned Addr = Base;
+  for (int Text = 1; Text >= 0; --Text)
+    for (unsigned i = 0, e = Sections.size(); i != e; ++i) {
+      SimSection &S = Sections[i];
+      if (S.IsText != (bool) Text)
+        continue;
+      Addr = (Addr + S.Align - 1) & ~(S.Align - 1);
+      S.Addr = Addr;
+      Addr += S.Data.size();
+    }
+  DataEnd = Addr;
+
+  for (unsigned i = 0, e = Functions.size(); i != e; ++i)
+    Functions[i].Begin = Sections[Functions[i].Section].Addr
+                       + Functions[i].Offset;
+
+  for (unsigned i = 0, e = Insts.size(); i != e; ++i) {
+    SimInst &I = Insts[i];
+    I.Addr = Sections[I.Section].Addr + I.Offset;
+    InstAt[I.Addr] = i;
+
+    // symbolic operands become immediates
+    for (unsigned op = 0, ope = I.Inst.getNumOperands(); op != ope; ++op) {
+      MCOperand &MO = I.Inst.getOperand(op);
+      int64_t Val;
+      if (!MO.isExpr())
+        continue;
+      if (!evaluate(MO.getExpr(), Val))
+        return false;
+      MO = MCOperand::CreateImm(Val);
+    }
+  }
+
+  for (unsigned i = 0, e = Sections.size(); i != e; ++i) {
+    SimSection &S = Sections[i];
+    for (unsigned f = 0, fe = S.Fixups.size(); f != fe; ++f) {
+      const SimFixup &F = S.Fixups[f];
+      int64_t Val;
+      if (!evaluate(F.Value, Val))
+        return false;
+      for (unsigned b = 0; b != F.Size; ++b)
+        S.Data[F.Offset + b] = (Val >> (8 * b)) & 0xff;
+    }
+  }
+
+  // a function ends where the next one (or its section) begins
+  std::vector<SimFunction> Code;
+  for (unsigned i = 0, e = Functions.size(); i != e; ++i)
+    if (!Functions[i].IsHost)
+      Code.push_back(Functions[i]);
+  for (unsigned i = 0, e = Code.size(); i != e; ++i) {
+    const SimSection &S = Sections[Code[i].Section];
+    Code[i].End = S.Addr + S.Data.size();
+    for (unsigned j = 0; j != e; ++j)
+      if (Code[j].Begin > Code[i].Begin && Code[j].Begin < Code[i].End)
+        Code[i].End = Code[j].Begin;
+  }
+  for (unsigned i = 0, e = Functions.size(); i != e; ++i)
+    if (Functions[i].IsHost)
+      Code.push_back(Functions[i]);
+  Functions.swap(Code);
+  return true;
+}
+
+void SimProgram::load(unsigned char *Mem, unsigned MemBase) const {
+  for (unsigned i = 0, e = Sections.size(); i != e; ++i) {
+    const SimSection &S = Sections[i];
+    if (!S.Data.empty())
+      std::copy(S.Data.begin(), S.Data.end(), Mem + (S.Addr - MemBase));
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+const SimInst *SimProgram::getNext(const SimInst *I) const {
+  const SimInst *Next = getInstAt(I->Addr + I->Size);
+  while (Next && Next->Header)
+    Next = getInstAt(Next->Addr + Next->Size);
+  return Next;
+}
+
+int SimProgram::getFunctionAt(unsigned Addr) const {
+  for (unsigned i = 0, e = Functions.size(); i != e; ++i)
+    if (Addr >= Functions[i].Begin && Addr < Functions[i].End)
+      return i;
+  return -1;
+}
+
+unsigned SimProgram::getFunctionAddr(StringRef Name) const {
+  for (unsigned i = 0, e = Functions.size(); i != e; ++i)
+    if (Functions[i].Name == Name && !Functions[i].IsHost)
+      return Functions[i].Begin;
+  return 0;
+}
+
+StringRef SimProgram::getHostFunction(unsigned Addr) const {
+  for (StringMap<unsigned>::const_iterator I = HostAddrs.begin(),
+       E = HostAddrs.end(); I != E; ++I)
+    if (I->second == Addr)
+      return I->first();
+  return StringRef();
+}
+
+unsigned SimProgram::getCodeSize() const {
+  unsigned Size = 0;
+  for (unsigned i = 0, e = Sections.size(); i != e; ++i)
+    if (Sections[i].IsText)
+      Size += Sections[i].Data.size();
+  return Size;
+}
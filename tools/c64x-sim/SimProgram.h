@@ -0,0 +1,148 @@
+//===-- SimProgram.h - Program image for the C64x+ simulator ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The simulator does not read object files. Instead, the TMS320C64X backend
+// emits the module into a capturing MCStreamer, which records the lowered
+// MCInsts (including the p-bits and the header based fetch packets) and the
+// data sections at the very same offsets the ELF writer would use. The
+// program is then linked to fixed addresses and symbolic operands are
+// resolved.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef C64X_SIM_PROGRAM_H
+#define C64X_SIM_PROGRAM_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/MC/MCInst.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class MCContext;
+  class MCExpr;
+  class MCSection;
+  class MCStreamer;
+  class MCSymbol;
+  class TargetMachine;
+
+namespace c64xsim {
+
+  /// SimInst - an instruction of the program image
+  struct SimInst {
+    MCInst Inst;
+    unsigned Section;
+    unsigned Offset;
+    unsigned Addr;
+    unsigned Size;      // 4, or 2 for compact instructions
+    bool Parallel;      // p-bit, executes in parallel with the next one
+    bool Header;        // a fetch packet header, not executed
+  };
+
+  struct SimFixup {
+    unsigned Offset;
+    unsigned Size;
+    const MCExpr *Value;
+  };
+
+  struct SimSection {
+    bool IsText;
+    unsigned Align;
+    unsigned Addr;
+    std::vector<unsigned char> Data;
+    std::vector<SimFixup> Fixups;
+  };
+
+  /// SimFunction - address range of a function, for the profiles
+  struct SimFunction {
+    std::string Name;
+    unsigned Section, Offset;
+    unsigned Begin, End;
+    bool IsHost; // host implemented library function
+  };
+
+  class SimProgram {
+    friend class CaptureStreamer;
+
+    std::vector<SimSection> Sections;
+    std::vector<const MCSection*> SectionPtrs; // null for common symbols
+    std::vector<SimInst> Insts;
+
+    // labels, and symbols defined by assignments
+    DenseMap<const MCSymbol*, std::pair<unsigned, unsigned> > Labels;
+    DenseMap<const MCSymbol*, const MCExpr*> Assignments;
+
+    // functions defined by the module, and host implemented externals
+    StringSet<> FunctionNames;
+    StringMap<unsigned> HostAddrs;
+    std::vector<SimFunction> Functions;
+
+    // instruction address to index into Insts
+    DenseMap<unsigned, unsigned> InstAt;
+
+    unsigned DataEnd;
+    bool (*IsHostFn)(StringRef);
+    std::string Error;
+
+    bool evaluate(const MCExpr *Expr, int64_t &Res);
+    bool resolveSymbol(const MCSymbol *Sym, int64_t &Res);
+    unsigned getSection(const MCSection *Sec, bool IsText);
+
+  public:
+    SimProgram() : DataEnd(0), IsHostFn(0) {}
+
+    /// host functions are placed outside of the memory, they are never
+    /// fetched but intercepted when a branch reaches them
+    enum { HostBase = 0x00010000, HostSpacing = 0x20 };
+
+    void addFunctionName(StringRef Name) { FunctionNames.insert(Name); }
+
+    /// createStreamer - returns the streamer capturing the output of the
+    /// asm printer into this program.
+    MCStreamer *createStreamer(MCContext &Ctx);
+
+    /// link - assigns addresses to the sections starting with Base, resolves
+    /// all symbolic operands and data fixups. Undefined symbols are bound to
+    /// host functions if IsHostFn accepts their name. Returns false and sets
+    /// the error string on failure.
+    bool link(unsigned Base, bool (*IsHostFn)(StringRef));
+
+    /// copies the initialized sections into the memory image at Mem, which
+    /// maps the address MemBase.
+    void load(unsigned char *Mem, unsigned MemBase) const;
+
+    const std::string &getError() const { return Error; }
+
+    const SimInst *getInstAt(unsigned Addr) const {
+      DenseMap<unsigned, unsigned>::const_iterator I = InstAt.find(Addr);
+      return I == InstAt.end() ? 0 : &Insts[I->second];
+    }
+    /// returns the instruction following I in program order (headers are
+    /// skipped), or null
+    const SimInst *getNext(const SimInst *I) const;
+
+    const std::vector<SimFunction> &getFunctions() const { return Functions; }
+    /// returns the index of the function containing Addr, or -1
+    int getFunctionAt(unsigned Addr) const;
+    /// returns the start address of the named function, or 0
+    unsigned getFunctionAddr(StringRef Name) const;
+    /// returns the name of the host function at Addr, or an empty string
+    StringRef getHostFunction(unsigned Addr) const;
+
+    unsigned getDataEnd() const { return DataEnd; }
+    unsigned getCodeSize() const;
+    unsigned getNumInsts() const { return Insts.size(); }
+  };
+
+} // namespace c64xsim
+} // namespace llvm
+
+#endif
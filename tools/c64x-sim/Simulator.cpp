@@ -0,0 +1,1424 @@
+//===-- Simulator.cpp - Execute packet simulator for the C64x+ ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Implements the pipeline, the caches and the host library of c64x-sim.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Simulator.h"
+#include "TMS320C64X.h"
+#include "TMS320C64XInstrInfo.h"
+#include "TMS320C64XRegisterInfo.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetInstrInfo.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetRegisterInfo.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace llvm;
+using namespace c64xsim;
+
+namespace C64X = llvm::TMS320C64X;
+
+//-----------------------------------------------------------------------------
+// SimCache
+
+void SimCache::init(unsigned Size, unsigned LineSize, unsigned Ways) {
+  LineShift = 0;
+  while ((1U << LineShift) < LineSize)
+    ++LineShift;
+  NumWays = Ways;
+  NumSets = Size / (LineSize * Ways);
+  Tags.assign(NumSets * NumWays, ~0U);
+  Ages.assign(NumSets * NumWays, 0);
+  Clock = Hits = Misses = 0;
+}
+
+bool SimCache::access(unsigned Addr, bool Allocate) {
+  if (!NumSets)
+    return true;
+
+  unsigned Line = Addr >> LineShift;
+  unsigned Set = Line % NumSets;
+  unsigned *T = &Tags[Set * NumWays];
+  unsigned *A = &Ages[Set * NumWays];
+
+  ++Clock;
+  unsigned Victim = 0;
+  for (unsigned w = 0; w != NumWays; ++w) {
+    if (T[w] == Line) {
+      A[w] = Clock;
+      ++Hits;
+      return true;
+    }
+    if (A[w] < A[Victim])
+      Victim = w;
+  }
+
+  ++Misses;
+  if (Allocate) {
+    T[Victim] = Line;
+    A[Victim] = Clock;
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+// Simulator
+
+Simulator::Simulator(const SimProgram &P, const TargetMachine &tm,
+                     const SimOptions &opts, raw_ostream &out)
+  : Prog(P), TII(*tm.getInstrInfo()), TRI(*tm.getRegisterInfo()),
+    Opts(opts), Out(out), PC(0), LastFetch(~0U), ExecCycle(0),
+    Halted(false), ExitCode(0), NumPackets(0), NumInsts(0), NumNopCycles(0),
+    NumHostCycles(0), XPathStalls(0), L1PStalls(0), L1DStalls(0),
+    NumConflicts(0)
+{
+  // map the A/B registers and pairs onto the register file
+  RegIndex.assign(TRI.getNumRegs(), -1);
+  for (unsigned Reg = 1, e = TRI.getNumRegs(); Reg != e; ++Reg) {
+    unsigned Lo = TRI.getSubReg(Reg, C64X::sub_lo);
+    int Num = TRI.getDwarfRegNum(Lo ? Lo : Reg, false);
+    if (Num < 0 || Num >= 64)
+      continue;
+    RegIndex[Reg] = Num;
+  }
+
+  std::memset(Regs, 0, sizeof(Regs));
+  Loop.Active = Loop.Recording = false;
+  std::fill(LoadReadyAt, LoadReadyAt + NumRegs, ~0ULL);
+  std::fill(UnitBusyUntil, UnitBusyUntil + 8, 0ULL);
+
+  L1P.init(Opts.L1PSize, 32, 1);
+  L1D.init(Opts.L1DSize, 64, 2);
+  Profile.resize(Prog.getFunctions().size());
+  for (unsigned i = 0, e = Profile.size(); i != e; ++i)
+    Profile[i].Cycles = Profile[i].Stalls = Profile[i].Calls = 0;
+}
+
+void Simulator::fail(const std::string &Msg) {
+  if (Error.empty())
+    Error = Msg;
+  Halted = true;
+}
+
+//-----------------------------------------------------------------------------
+// registers
+
+int Simulator::getReg(const MCOperand &MO) const {
+  if (!MO.isReg() || MO.getReg() >= RegIndex.size())
+    return -1;
+  return RegIndex[MO.getReg()];
+}
+
+unsigned Simulator::readReg(const MCOperand &MO) const {
+  if (MO.isImm())
+    return MO.getImm();
+  // other registers (eg. the always true predicate) read as zero
+  int Idx = getReg(MO);
+  return Idx < 0 ? 0 : Regs[Idx];
+}
+
+uint64_t Simulator::readPair(const MCOperand &MO) const {
+  int Idx = getReg(MO);
+  assert(Idx >= 0 && "not a register of the A/B file");
+  return (uint64_t) Regs[Idx + 1] << 32 | Regs[Idx];
+}
+
+void Simulator::writeReg(unsigned Idx, unsigned Value, unsigned Delay,
+                         bool IsLoad) {
+  PendingWrite W = { Idx, Value, ExecCycle + Delay + 1, IsLoad };
+  Writes.push_back(W);
+}
+
+void Simulator::writeReg(const MCOperand &MO, unsigned Value, unsigned Delay,
+                         bool IsLoad) {
+  int Idx = getReg(MO);
+  assert(Idx >= 0 && "not a register of the A/B file");
+  writeReg(Idx, Value, Delay, IsLoad);
+}
+
+void Simulator::commitWrites() {
+  unsigned Keep = 0;
+  for (unsigned i = 0, e = Writes.size(); i != e; ++i) {
+    const PendingWrite &W = Writes[i];
+    if (W.ReadyAt > ExecCycle) {
+      Writes[Keep++] = W;
+      continue;
+    }
+    Regs[W.Reg] = W.Value;
+    LoadReadyAt[W.Reg] = W.IsLoad ? W.ReadyAt : ~0ULL;
+  }
+  Writes.resize(Keep);
+}
+
+//-----------------------------------------------------------------------------
+// memory
+
+bool Simulator::readMem(unsigned Addr, unsigned Size, uint64_t &Value) {
+  if (Addr < Opts.MemBase || Addr - Opts.MemBase + Size > Mem.size()) {
+    fail("read from invalid address 0x" + utohexstr(Addr));
+    return false;
+  }
+  Value = 0;
+  for (unsigned i = Size; i-- != 0; )
+    Value = Value << 8 | Mem[Addr - Opts.MemBase + i];
+  return true;
+}
+
+bool Simulator::writeMem(unsigned Addr, unsigned Size, uint64_t Value) {
+  if (Addr < Opts.MemBase || Addr - Opts.MemBase + Size > Mem.size()) {
+    fail("write to invalid address 0x" + utohexstr(Addr));
+    return false;
+  }
+  for (unsigned i = 0; i != Size; ++i)
+    Mem[Addr - Opts.MemBase + i] = (Value >> (8 * i)) & 0xff;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+// execute packets
+
+bool Simulator::isExecuted(const MCInst &MI) const {
+  const TargetInstrDesc &TID = TII.get(MI.getOpcode());
+  for (unsigned i = 0, e = TID.getNumOperands(); i != e; ++i) {
+    if (!TID.OpInfo[i].isPredicate())
+      continue;
+    int Cond = MI.getOperand(i).getImm();
+    if (Cond == -1)
+      return true;
+    bool Zero = readReg(MI.getOperand(i + 1)) == 0;
+    return Cond ? !Zero : Zero;
+  }
+  return true;
+}
+
+// functional unit, side and cross/data path used by MI. Unit is -1 for
+// instructions that do not occupy a unit (nop).
+void Simulator::getUnitUse(const MCInst &MI, int &Unit, int &Side,
+                           int &DataSide, bool &XPath) const {
+  const TargetInstrDesc &TID = TII.get(MI.getOpcode());
+  unsigned Flags = TID.TSFlags;
+  Unit = -1;
+  Side = IS_BSIDE(Flags) ? 1 : 0;
+  DataSide = -1;
+  XPath = false;
+
+  switch (MI.getOpcode()) {
+    case C64X::noop:
+    case C64X::sploop:
+    case C64X::spkernel:
+      return;
+    case C64X::callp_global:
+    case C64X::callp_extsym:
+    case C64X::ret:
+    case C64X::branch_reg:
+    case C64X::call_reg:
+      Unit = TMS320C64XII::unit_s;
+      Side = 1;
+      break;
+    case C64X::call_start_i:
+    case C64X::call_end_i:
+    case C64X::call_start_r:
+    case C64X::call_end_r:
+      Unit = TMS320C64XII::unit_d;
+      Side = 1;
+      break;
+    default:
+      if (Flags & TMS320C64XII::is_memaccess) {
+        unsigned BaseIdx = TMS320C64XII::getMemBaseIdx(Flags);
+        unsigned DataIdx = TMS320C64XII::getMemDataIdx(Flags);
+        Unit = TMS320C64XII::unit_d;
+        Side = C64X::isBSideReg(MI.getOperand(BaseIdx).getReg());
+        DataSide = C64X::isBSideReg(MI.getOperand(DataIdx).getReg());
+        return;
+      }
+      if (Flags & TMS320C64XII::is_side_inst)
+        Unit = MI.getOperand(TID.getNumOperands() - 1).getImm() >> 1;
+      else
+        Unit = GET_UNIT(Flags);
+      break;
+  }
+
+  // any source operand from the other register file uses the cross path
+  int PIdx = -1;
+  for (unsigned i = 0, e = TID.getNumOperands(); i != e; ++i)
+    if (TID.OpInfo[i].isPredicate())
+      PIdx = i;
+  for (unsigned i = TID.getNumDefs(), e = TID.getNumOperands(); i != e; ++i)
+    if ((int) i != PIdx + 1 && getReg(MI.getOperand(i)) >= 0 &&
+        (getReg(MI.getOperand(i)) >= 32) != (bool) Side)
+      XPath = true;
+}
+
+// checks the resource constraints of the packet and returns the number of
+// stall cycles caused by cross path reads of freshly loaded registers
+unsigned Simulator::checkPacket(const std::vector<const SimInst*> &Packet) {
+  unsigned UnitMask = 0, XMask = 0, TMask = 0;
+  bool Conflict = false;
+  unsigned Stall = 0;
+
+  for (unsigned i = 0, e = Packet.size(); i != e; ++i) {
+    const MCInst &MI = Packet[i]->Inst;
+    int Unit, Side, DataSide;
+    bool XPath;
+    getUnitUse(MI, Unit, Side, DataSide, XPath);
+    if (Unit < 0)
+      continue;
+
+    unsigned UIdx = Unit << 1 | Side;
+    unsigned U = 1 << UIdx;
+    Conflict |= (UnitMask & U) != 0 || UnitBusyUntil[UIdx] > ExecCycle;
+    UnitMask |= U;
+    // not fully pipelined instructions block their unit for some more cycles
+    UnitBusyUntil[UIdx] = ExecCycle + 1 +
+      GET_UNIT_BUSY(TII.get(MI.getOpcode()).TSFlags);
+    if (DataSide >= 0) {
+      Conflict |= (TMask & (1 << DataSide)) != 0;
+      TMask |= 1 << DataSide;
+    }
+    if (!XPath)
+      continue;
+    Conflict |= (XMask & (1 << Side)) != 0;
+    XMask |= 1 << Side;
+
+    const TargetInstrDesc &TID = TII.get(MI.getOpcode());
+    for (unsigned op = TID.getNumDefs(), ope = TID.getNumOperands();
+         op != ope; ++op) {
+      int Idx = getReg(MI.getOperand(op));
+      if (Idx >= 0 && (Idx >= 32) != (bool) Side &&
+          LoadReadyAt[Idx] == ExecCycle)
+        Stall = 1;
+    }
+  }
+
+  if (Conflict) {
+    if (!NumConflicts)
+      errs() << "c64x-sim: warning: resource conflict in the execute packet "
+                "at 0x" << utohexstr(Packet[0]->Addr) << "\n";
+    ++NumConflicts;
+  }
+  return Stall;
+}
+
+// adds the instructions the following iterations of a SPLOOP issue in the
+// current cycle
+void Simulator::issueLoopBuffer(std::vector<const SimInst*> &Packet) {
+  uint64_t Cycle = ExecCycle - Loop.Start;
+  for (unsigned i = 0, e = Loop.Insts.size(); i != e; ++i) {
+    unsigned Offset = Loop.Insts[i].first;
+    if (Cycle < Offset || (Cycle - Offset) % Loop.II)
+      continue;
+    uint64_t Iteration = (Cycle - Offset) / Loop.II;
+    if (Iteration && Iteration < Loop.Iterations)
+      Packet.push_back(Loop.Insts[i].second);
+  }
+}
+
+void Simulator::branchTo(unsigned Target, unsigned Delay, bool IsCall) {
+  PendingBranch B = { Target, ExecCycle + Delay + 1, IsCall };
+  Branches.push_back(B);
+}
+
+// loads and stores, returns the stall cycles of the access
+unsigned Simulator::executeMem(const MCInst &MI, unsigned Delay) {
+  unsigned Size = 4, Scale = 4;
+  bool Signed = false, Pair = false, Aligned = true;
+
+  switch (MI.getOpcode()) {
+    case C64X::ubyte_sload_1:    case C64X::ubyte_sload_2:
+    case C64X::byte_store_1:     case C64X::byte_store_2:
+    case C64X::u_i1_load_p_addr: case C64X::u_i1_load_p_idx:
+    case C64X::ubyte_preload_1:  case C64X::ubyte_preload_2:
+    case C64X::ubyte_postload_1: case C64X::ubyte_postload_2:
+    case C64X::byte_prestore_1:  case C64X::byte_prestore_2:
+    case C64X::byte_poststore_1: case C64X::byte_poststore_2:
+    case C64X::ubyte_circload_1: case C64X::byte_circstore_1:
+      Size = Scale = 1;
+      break;
+    case C64X::byte_sload_1:     case C64X::byte_sload_2:
+    case C64X::byte_preload_1:   case C64X::byte_preload_2:
+    case C64X::byte_postload_1:  case C64X::byte_postload_2:
+    case C64X::byte_circload_1:
+      Size = Scale = 1;
+      Signed = true;
+      break;
+    case C64X::uhword_sload_1:    case C64X::uhword_sload_2:
+    case C64X::hword_store_1:     case C64X::hword_store_2:
+    case C64X::uhword_preload_1:  case C64X::uhword_preload_2:
+    case C64X::uhword_postload_1: case C64X::uhword_postload_2:
+    case C64X::hword_prestore_1:  case C64X::hword_prestore_2:
+    case C64X::hword_poststore_1: case C64X::hword_poststore_2:
+    case C64X::uhword_circload_1: case C64X::hword_circstore_1:
+      Size = Scale = 2;
+      break;
+    case C64X::hword_sload_1:    case C64X::hword_sload_2:
+    case C64X::hword_preload_1:  case C64X::hword_preload_2:
+    case C64X::hword_postload_1: case C64X::hword_postload_2:
+    case C64X::hword_circload_1:
+      Size = Scale = 2;
+      Signed = true;
+      break;
+    case C64X::dword_load_1:     case C64X::dword_load_2:
+    case C64X::dword_store_1:    case C64X::dword_store_2:
+      Size = Scale = 8;
+      Pair = true;
+      break;
+    case C64X::ndword_load_1:    case C64X::ndword_load_2:
+    case C64X::ndword_store_1:   case C64X::ndword_store_2:
+      Size = Scale = 8;
+      Pair = true;
+      Aligned = false;
+      break;
+    default:
+      break;
+  }
+
+  uint64_t Flags = TII.get(MI.getOpcode()).TSFlags;
+  bool IsStore = Flags & TMS320C64XII::is_store;
+  unsigned BaseIdx = TMS320C64XII::getMemBaseIdx(Flags);
+  const MCOperand &Data = MI.getOperand(TMS320C64XII::getMemDataIdx(Flags));
+  const MCOperand &Base = MI.getOperand(BaseIdx);
+  const MCOperand &Offs = MI.getOperand(BaseIdx + 1);
+
+  // offsets are scaled by the access size, aligned accesses ignore the low
+  // address bits
+  unsigned Addr = readReg(Base) + (int) readReg(Offs) * Scale;
+
+  // bases in A4-A7/B4-B7 may be circular, the address then wraps around
+  // within the aligned block of 2^(N+1) bytes selected by the AMR
+  int BaseReg = getReg(Base);
+  if ((BaseReg & 31) >= 4 && (BaseReg & 31) <= 7) {
+    unsigned Field = ((BaseReg & 31) - 4 + (BaseReg >= 32 ? 4 : 0)) * 2;
+    unsigned Mode = (Regs[AMRIdx] >> Field) & 3;
+    if (Mode == 1 || Mode == 2) {
+      unsigned N = (Regs[AMRIdx] >> (Mode == 1 ? 16 : 21)) & 0x1f;
+      unsigned Mask = N == 31 ? ~0U : (2U << N) - 1;
+      Addr = (readReg(Base) & ~Mask) | (Addr & Mask);
+    }
+  }
+
+  // the modified base is written by the .D unit without delay slots, post-
+  // modifying accesses use the original base
+  if (Flags & TMS320C64XII::is_memwriteback) {
+    writeReg(Base, Addr, 0);
+    if (!(Flags & TMS320C64XII::is_premodify))
+      Addr = readReg(Base);
+  }
+  if (Aligned)
+    Addr &= ~(Size - 1);
+
+  // stores do not allocate and go through the write buffer
+  bool Hit = L1D.access(Addr, !IsStore);
+  if (!Aligned && ((Addr ^ (Addr + Size - 1)) & ~63U))
+    Hit &= L1D.access(Addr + Size - 1, !IsStore);
+
+  if (IsStore) {
+    PendingStore S = { Addr, Size, Pair ? readPair(Data) : readReg(Data) };
+    Stores.push_back(S);
+    return 0;
+  }
+
+  uint64_t Value;
+  if (!readMem(Addr, Size, Value))
+    return 0;
+
+  if (Signed)
+    Value = (uint64_t) (Size == 1 ? (int64_t) (int8_t) Value
+                                  : (int64_t) (int16_t) Value);
+
+  int Idx = getReg(Data);
+  writeReg(Idx, Value, Delay, true);
+  if (Pair)
+    writeReg(Idx + 1, Value >> 32, Delay, true);
+
+  return Hit ? 0 : Opts.L1DMissPenalty;
+}
+
+// bit casts between the register contents and the host floating point types
+template<typename To, typename From> static To bitCast(From V) {
+  To Res;
+  std::memcpy(&Res, &V, sizeof(Res));
+  return Res;
+}
+
+static float toFloat(unsigned V) { return bitCast<float>(V); }
+static double toDouble(uint64_t V) { return bitCast<double>(V); }
+static unsigned fromFloat(float F) { return bitCast<unsigned>(F); }
+static uint64_t fromDouble(double D) { return bitCast<uint64_t>(D); }
+
+// conversion to a signed word rounding towards zero, saturating on overflow
+static unsigned truncToWord(double Value) {
+  if (Value != Value || Value >= 2147483648.0)
+    return 0x7fffffff;
+  if (Value <= -2147483649.0)
+    return 0x80000000;
+  return (int) Value;
+}
+
+static unsigned lmbd(unsigned Bit, unsigned Value) {
+  if (!(Bit & 1))
+    Value = ~Value;
+  unsigned N = 0;
+  while (N != 32 && !(Value & (0x80000000U >> N)))
+    ++N;
+  return N;
+}
+
+static unsigned saturate(int64_t Value) {
+  if (Value > 0x7fffffffLL)
+    return 0x7fffffff;
+  if (Value < -0x80000000LL)
+    return 0x80000000;
+  return Value;
+}
+
+// number of redundant sign bits
+static unsigned norm(unsigned Value) {
+  return lmbd(1, (int) Value < 0 ? ~Value : Value) - 1;
+}
+
+static unsigned addHalves(unsigned A, unsigned B, bool Sub) {
+  unsigned Lo = (Sub ? A - B : A + B) & 0xffff;
+  unsigned Hi = (Sub ? (A >> 16) - (B >> 16) : (A >> 16) + (B >> 16));
+  return Hi << 16 | Lo;
+}
+
+static unsigned addBytes(unsigned A, unsigned B, bool Sub) {
+  unsigned Res = 0;
+  for (unsigned i = 0; i != 32; i += 8) {
+    unsigned X = (A >> i) & 0xff, Y = (B >> i) & 0xff;
+    Res |= ((Sub ? X - Y : X + Y) & 0xff) << i;
+  }
+  return Res;
+}
+
+// cmpgt2/cmpeq4, one result bit per element starting with the lowest
+static unsigned compareHalves(unsigned A, unsigned B) {
+  unsigned Res = 0;
+  for (unsigned i = 0; i != 2; ++i)
+    Res |= ((int16_t) (A >> 16 * i) > (int16_t) (B >> 16 * i)) << i;
+  return Res;
+}
+
+static unsigned compareBytes(unsigned A, unsigned B) {
+  unsigned Res = 0;
+  for (unsigned i = 0; i != 4; ++i)
+    Res |= (((A >> 8 * i) & 0xff) == ((B >> 8 * i) & 0xff)) << i;
+  return Res;
+}
+
+// shr2/shru2, amounts above 15 shift out all bits of a halfword
+static unsigned shiftHalves(unsigned A, unsigned Amount, bool Signed) {
+  unsigned Res = 0;
+  Amount &= 0x1f;
+  for (unsigned i = 0; i != 32; i += 16) {
+    unsigned Half = Signed
+      ? (unsigned) ((int16_t) (A >> i) >> std::min(Amount, 15U))
+      : (Amount > 15 ? 0 : ((A >> i) & 0xffff) >> Amount);
+    Res |= (Half & 0xffff) << i;
+  }
+  return Res;
+}
+
+static unsigned minMaxHalves(unsigned A, unsigned B, bool Max) {
+  unsigned Res = 0;
+  for (unsigned i = 0; i != 32; i += 16) {
+    int X = (int16_t) (A >> i), Y = (int16_t) (B >> i);
+    Res |= ((Max ? std::max(X, Y) : std::min(X, Y)) & 0xffff) << i;
+  }
+  return Res;
+}
+
+// executes a single instruction, returns the stall cycles it causes
+unsigned Simulator::execute(const SimInst &I, unsigned NextPC) {
+  const MCInst &MI = I.Inst;
+  const TargetInstrDesc &TID = TII.get(MI.getOpcode());
+  unsigned Delay = GET_DELAY_SLOTS(TID.TSFlags);
+
+  if (!isExecuted(MI))
+    return 0;
+
+  if (TID.TSFlags & TMS320C64XII::is_memaccess)
+    return executeMem(MI, Delay);
+
+  unsigned A = 0, B = 0;
+  if (MI.getNumOperands() > 2) {
+    A = MI.getOperand(1).isReg() || MI.getOperand(1).isImm()
+      ? readReg(MI.getOperand(1)) : 0;
+    B = MI.getOperand(2).isReg() || MI.getOperand(2).isImm()
+      ? readReg(MI.getOperand(2)) : 0;
+  }
+  const MCOperand &Dst = MI.getOperand(0);
+
+  switch (MI.getOpcode()) {
+    case C64X::noop:
+      return 0;
+
+    case C64X::add_rr_1: case C64X::add_rr_2:
+    case C64X::add_ri_1: case C64X::add_ri_2:
+    case C64X::lea_fail:
+      writeReg(Dst, A + B, Delay); break;
+    case C64X::sub_rr_1: case C64X::sub_rr_2:
+    case C64X::sub_ri_1: case C64X::sub_ri_2:
+      writeReg(Dst, A - B, Delay); break;
+    case C64X::neg_1: case C64X::neg_2:
+      writeReg(Dst, -A, Delay); break;
+    case C64X::mpy32_1: case C64X::mpy32_2:
+      writeReg(Dst, A * B, Delay); break;
+    case C64X::mpy32_p_rr:
+    case C64X::mpy32u_p_rr: {
+      // 64-bit product in a register pair
+      uint64_t Prod = (MI.getOpcode() == C64X::mpy32_p_rr)
+        ? (uint64_t) ((int64_t) (int) A * (int) B) : (uint64_t) A * B;
+      writeReg(getReg(Dst), Prod, Delay, false);
+      writeReg(getReg(Dst) + 1, Prod >> 32, Delay, false);
+      break;
+    }
+    case C64X::andn_rr_1: case C64X::andn_rr_2:
+      writeReg(Dst, A & ~B, Delay); break;
+    case C64X::lmbd_rr_1: case C64X::lmbd_rr_2:
+      writeReg(Dst, lmbd(A, B), Delay); break;
+    case C64X::lmbd_ri_1: case C64X::lmbd_ri_2:
+      writeReg(Dst, lmbd(B, A), Delay); break;
+
+    case C64X::add_am_d_1: case C64X::add_am_d_2:
+      writeReg(Dst, A + (B << 3), Delay); break;
+    case C64X::add_am_w_1: case C64X::add_am_w_2:
+      writeReg(Dst, A + (B << 2), Delay); break;
+    case C64X::add_am_h_1: case C64X::add_am_h_2:
+      writeReg(Dst, A + (B << 1), Delay); break;
+    case C64X::sub_am_w_1: case C64X::sub_am_w_2:
+      writeReg(Dst, A - (B << 2), Delay); break;
+    case C64X::sub_am_h_1: case C64X::sub_am_h_2:
+      writeReg(Dst, A - (B << 1), Delay); break;
+
+    // shifts, amounts above 31 shift out all bits
+    case C64X::srl_rr_1: case C64X::srl_rr_2:
+    case C64X::srl_ri_1: case C64X::srl_ri_2:
+      writeReg(Dst, (B & 0x3f) > 31 ? 0 : A >> (B & 0x3f), Delay); break;
+    case C64X::shl_p_rr: case C64X::shl_p_ri:
+      writeReg(Dst, (B & 0x3f) > 31 ? 0 : A << (B & 0x3f), Delay); break;
+    case C64X::shr_p_rr: case C64X::shr_p_ri:
+      writeReg(Dst, (int) A >> std::min(B & 0x3f, 31U), Delay); break;
+    case C64X::rotl_p_rr: case C64X::rotl_p_ri:
+      B &= 0x1f;
+      writeReg(Dst, B ? (A << B | A >> (32 - B)) : A, Delay); break;
+
+    case C64X::and_p_rr: case C64X::and_p_ri:
+      writeReg(Dst, A & B, Delay); break;
+    case C64X::or_p_rr: case C64X::or_p_ri:
+      writeReg(Dst, A | B, Delay); break;
+    case C64X::xor_p_rr: case C64X::xor_p_ri:
+      writeReg(Dst, A ^ B, Delay); break;
+    case C64X::cmpeq_p_rr: case C64X::cmpeq_p_ri:
+      writeReg(Dst, A == B, Delay); break;
+    case C64X::cmpgt_p_rr:
+      writeReg(Dst, (int) A > (int) B, Delay); break;
+    case C64X::cmpgtu_p_rr:
+      writeReg(Dst, A > B, Delay); break;
+    case C64X::cmplt_p_rr:
+      writeReg(Dst, (int) A < (int) B, Delay); break;
+    case C64X::cmpltu_p_rr:
+      writeReg(Dst, A < B, Delay); break;
+    case C64X::addu_p_rr: {
+      // 40-bit result in a register pair
+      uint64_t Sum = (uint64_t) A + B;
+      writeReg(getReg(Dst), Sum, Delay, false);
+      writeReg(getReg(Dst) + 1, (Sum >> 32) & 0xff, Delay, false);
+      break;
+    }
+
+    // packed data
+    case C64X::add2_1: case C64X::add2_2:
+      writeReg(Dst, addHalves(A, B, false), Delay); break;
+    case C64X::sub2_1: case C64X::sub2_2:
+      writeReg(Dst, addHalves(A, B, true), Delay); break;
+    case C64X::add4_1: case C64X::add4_2:
+      writeReg(Dst, addBytes(A, B, false), Delay); break;
+    case C64X::sub4_1: case C64X::sub4_2:
+      writeReg(Dst, addBytes(A, B, true), Delay); break;
+    case C64X::max2_1: case C64X::max2_2:
+      writeReg(Dst, minMaxHalves(A, B, true), Delay); break;
+    case C64X::min2_1: case C64X::min2_2:
+      writeReg(Dst, minMaxHalves(A, B, false), Delay); break;
+    case C64X::cmpgt2_1: case C64X::cmpgt2_2:
+      writeReg(Dst, compareHalves(A, B), Delay); break;
+    case C64X::cmpeq4_1: case C64X::cmpeq4_2:
+      writeReg(Dst, compareBytes(A, B), Delay); break;
+    case C64X::shr2_ri_1: case C64X::shr2_ri_2:
+      writeReg(Dst, shiftHalves(A, B, true), Delay); break;
+    case C64X::shru2_ri_1: case C64X::shru2_ri_2:
+      writeReg(Dst, shiftHalves(A, B, false), Delay); break;
+    case C64X::pack2_1: case C64X::pack2_2:
+      writeReg(Dst, A << 16 | (B & 0xffff), Delay); break;
+    case C64X::packh2_1: case C64X::packh2_2:
+      writeReg(Dst, (A & 0xffff0000) | B >> 16, Delay); break;
+    case C64X::packhl2_1: case C64X::packhl2_2:
+      writeReg(Dst, (A & 0xffff0000) | (B & 0xffff), Delay); break;
+    case C64X::packlh2_1: case C64X::packlh2_2:
+      writeReg(Dst, A << 16 | B >> 16, Delay); break;
+    case C64X::avgu4_1: case C64X::avgu4_2: {
+      unsigned Res = 0;
+      for (unsigned i = 0; i != 32; i += 8)
+        Res |= ((((A >> i) & 0xff) + ((B >> i) & 0xff) + 1) >> 1) << i;
+      writeReg(Dst, Res, Delay);
+      break;
+    }
+    case C64X::dotp2_1: case C64X::dotp2_2:
+      writeReg(Dst, (int16_t) A * (int16_t) B
+                  + (int16_t) (A >> 16) * (int16_t) (B >> 16), Delay);
+      break;
+    case C64X::mpy2: {
+      // both products in a register pair, the lower one in the even register
+      writeReg(getReg(Dst), (int16_t) A * (int16_t) B, Delay, false);
+      writeReg(getReg(Dst) + 1, (int16_t) (A >> 16) * (int16_t) (B >> 16),
+               Delay, false);
+      break;
+    }
+    case C64X::dotpu4_1: case C64X::dotpu4_2: {
+      unsigned Res = 0;
+      for (unsigned i = 0; i != 32; i += 8)
+        Res += ((A >> i) & 0xff) * ((B >> i) & 0xff);
+      writeReg(Dst, Res, Delay);
+      break;
+    }
+    case C64X::swap2:
+      writeReg(Dst, A << 16 | A >> 16, Delay); break;
+    case C64X::swap4:
+      writeReg(Dst, (A & 0xff00ff00) >> 8 | (A & 0x00ff00ff) << 8, Delay);
+      break;
+    case C64X::bitr: {
+      unsigned Res = 0;
+      for (unsigned i = 0; i != 32; ++i)
+        Res |= ((A >> i) & 1) << (31 - i);
+      writeReg(Dst, Res, Delay);
+      break;
+    }
+    case C64X::mvd:
+      writeReg(Dst, A, Delay); break;
+
+    // saturating arithmetic
+    case C64X::sadd_1: case C64X::sadd_2:
+      writeReg(Dst, saturate((int64_t) (int) A + (int) B), Delay); break;
+    case C64X::ssub_1: case C64X::ssub_2:
+      writeReg(Dst, saturate((int64_t) (int) A - (int) B), Delay); break;
+    case C64X::sshl_rr_1: case C64X::sshl_rr_2:
+    case C64X::sshl_ri_1: case C64X::sshl_ri_2:
+      writeReg(Dst, saturate((int64_t) (int) A << (B & 0x1f)), Delay); break;
+    case C64X::subc_1: case C64X::subc_2:
+      writeReg(Dst, A >= B ? ((A - B) << 1) + 1 : A << 1, Delay); break;
+    case C64X::norm_1: case C64X::norm_2:
+      writeReg(Dst, norm(A), Delay); break;
+    case C64X::sadd2_1: case C64X::sadd2_2: {
+      unsigned Res = 0;
+      for (unsigned i = 0; i != 32; i += 16) {
+        int Sum = (int16_t) (A >> i) + (int16_t) (B >> i);
+        Sum = std::max(-0x8000, std::min(0x7fff, Sum));
+        Res |= (Sum & 0xffff) << i;
+      }
+      writeReg(Dst, Res, Delay);
+      break;
+    }
+    case C64X::saddu4_1: case C64X::saddu4_2: {
+      unsigned Res = 0;
+      for (unsigned i = 0; i != 32; i += 8)
+        Res |= std::min(0xffU, ((A >> i) & 0xff) + ((B >> i) & 0xff)) << i;
+      writeReg(Dst, Res, Delay);
+      break;
+    }
+    case C64X::smpy_1: case C64X::smpy_2:
+      writeReg(Dst, saturate((int64_t) ((int16_t) A * (int16_t) B) << 1),
+               Delay);
+      break;
+
+    // C674x floating point
+    case C64X::addsp_1: case C64X::addsp_2:
+      writeReg(Dst, fromFloat(toFloat(A) + toFloat(B)), Delay); break;
+    case C64X::subsp_1: case C64X::subsp_2:
+      writeReg(Dst, fromFloat(toFloat(A) - toFloat(B)), Delay); break;
+    case C64X::mpysp_1: case C64X::mpysp_2:
+      writeReg(Dst, fromFloat(toFloat(A) * toFloat(B)), Delay); break;
+    case C64X::cmpeqsp_1: case C64X::cmpeqsp_2:
+      writeReg(Dst, toFloat(A) == toFloat(B), Delay); break;
+    case C64X::cmpgtsp_1: case C64X::cmpgtsp_2:
+      writeReg(Dst, toFloat(A) > toFloat(B), Delay); break;
+    case C64X::cmpltsp_1: case C64X::cmpltsp_2:
+      writeReg(Dst, toFloat(A) < toFloat(B), Delay); break;
+    case C64X::intsp_1: case C64X::intsp_2:
+      writeReg(Dst, fromFloat((float) (int) A), Delay); break;
+    case C64X::intspu_1: case C64X::intspu_2:
+      writeReg(Dst, fromFloat((float) A), Delay); break;
+    case C64X::sptrunc_1: case C64X::sptrunc_2:
+      writeReg(Dst, truncToWord(toFloat(A)), Delay); break;
+    case C64X::cmpeqdp:
+    case C64X::cmpgtdp:
+    case C64X::cmpltdp: {
+      double X = toDouble(readPair(MI.getOperand(1)));
+      double Y = toDouble(readPair(MI.getOperand(2)));
+      bool Res = MI.getOpcode() == C64X::cmpeqdp ? X == Y
+        : (MI.getOpcode() == C64X::cmpgtdp ? X > Y : X < Y);
+      writeReg(Dst, Res, Delay);
+      break;
+    }
+    case C64X::dpsp:
+      writeReg(Dst, fromFloat(toDouble(readPair(MI.getOperand(1)))), Delay);
+      break;
+    case C64X::dptrunc:
+      writeReg(Dst, truncToWord(toDouble(readPair(MI.getOperand(1)))),
+               Delay);
+      break;
+    case C64X::adddp:
+    case C64X::subdp:
+    case C64X::mpydp:
+    case C64X::intdp:
+    case C64X::intdpu:
+    case C64X::spdp: {
+      double Res;
+      switch (MI.getOpcode()) {
+        case C64X::intdp:  Res = (int) A; break;
+        case C64X::intdpu: Res = A; break;
+        case C64X::spdp:   Res = toFloat(A); break;
+        default: {
+          double X = toDouble(readPair(MI.getOperand(1)));
+          double Y = toDouble(readPair(MI.getOperand(2)));
+          Res = MI.getOpcode() == C64X::adddp ? X + Y
+            : (MI.getOpcode() == C64X::subdp ? X - Y : X * Y);
+        }
+      }
+      // result in a register pair
+      uint64_t Bits = fromDouble(Res);
+      writeReg(getReg(Dst), Bits, Delay, false);
+      writeReg(getReg(Dst) + 1, Bits >> 32, Delay, false);
+      break;
+    }
+
+    // bit fields
+    case C64X::ext_1: case C64X::ext_2:
+    case C64X::extu_1: case C64X::extu_2:
+    case C64X::ext_v_1: case C64X::ext_v_2:
+    case C64X::extu_v_1: case C64X::extu_v_2: {
+      unsigned Opc = MI.getOpcode();
+      bool Var = Opc == C64X::ext_v_1 || Opc == C64X::ext_v_2 ||
+                 Opc == C64X::extu_v_1 || Opc == C64X::extu_v_2;
+      unsigned CstA = B & 0x1f;
+      unsigned CstB = Var ? MI.getOperand(3).getImm() & 0x1f : CstA;
+      unsigned Val = A << CstA;
+      if (Opc == C64X::ext_1 || Opc == C64X::ext_2 ||
+          Opc == C64X::ext_v_1 || Opc == C64X::ext_v_2)
+        Val = (int) Val >> CstB;
+      else
+        Val >>= CstB;
+      writeReg(Dst, Val, Delay);
+      break;
+    }
+
+    // control registers
+    case C64X::mvc_amr:
+      writeReg(AMRIdx, readReg(MI.getOperand(1)), Delay, false); break;
+    case C64X::mvc_ilc:
+      writeReg(ILCIdx, readReg(MI.getOperand(1)), Delay, false); break;
+    // the time stamp counter is taken to run from the start of the program,
+    // it counts the pipeline cycles
+    case C64X::mvc_tscl_w:
+      break;
+    case C64X::mvc_tscl_r:
+      writeReg(Dst, (unsigned) ExecCycle, Delay); break;
+
+    // hardware loops, the ILC holds the number of iterations
+    case C64X::sploop:
+      if (Loop.Active)
+        fail("sploop inside of a software pipelined loop");
+      else if (!Regs[ILCIdx])
+        fail("sploop with an ILC of 0");
+      else if (Dst.getImm() < 1)
+        fail("sploop with an invalid initiation interval");
+      else {
+        Loop.Active = Loop.Recording = true;
+        Loop.II = Dst.getImm();
+        Loop.Iterations = Regs[ILCIdx];
+        Loop.NopCycles = 0;
+        Loop.Start = ExecCycle + 1;
+        Loop.Insts.clear();
+      }
+      break;
+    case C64X::spkernel:
+      if (!Loop.Recording)
+        fail("spkernel outside of a software pipelined loop");
+      else if (MI.getOperand(0).getImm() || MI.getOperand(1).getImm())
+        fail("spkernel stage and cycle not supported");
+      else {
+        Loop.Recording = false;
+        Loop.Length = ExecCycle - Loop.Start + 1;
+      }
+      break;
+
+    // constants
+    case C64X::mvk_1: case C64X::mvk_2:
+    case C64X::mvkl_1: case C64X::mvkl_2:
+    case C64X::mvkl_label_1: case C64X::mvkl_label_2:
+      writeReg(Dst, (int16_t) A, Delay); break;
+    case C64X::mvkh_1: case C64X::mvkh_2:
+    case C64X::mvkh_label_1: case C64X::mvkh_label_2:
+      writeReg(Dst, (A & 0xffff0000) | (B & 0xffff), Delay); break;
+    case C64X::addk_p:
+      writeReg(Dst, A + (int16_t) B, Delay); break;
+
+    // stack adjustment around calls
+    case C64X::call_start_i:
+    case C64X::call_start_r:
+      writeReg(15 + 32, Regs[15 + 32] - readReg(MI.getOperand(0)), 0, false);
+      break;
+    case C64X::call_end_i:
+    case C64X::call_end_r:
+      writeReg(15 + 32, Regs[15 + 32] + readReg(MI.getOperand(0)), 0, false);
+      break;
+
+    // control flow, five delay slots
+    case C64X::branch:
+    case C64X::branch_A:
+    case C64X::branch_B:
+    case C64X::branch_cond:
+      branchTo(Dst.getImm(), 5, false); break;
+    case C64X::call_branch:
+      branchTo(Dst.getImm(), 5, true); break;
+    // bpos/bdec branch while the counter is not negative, bdec counts it
+    // down in the same cycle
+    case C64X::bpos_1:
+    case C64X::bpos_2:
+      if ((int) A >= 0)
+        branchTo(Dst.getImm(), 5, false);
+      break;
+    case C64X::bdec_1:
+    case C64X::bdec_2:
+      if ((int) B >= 0) {
+        branchTo(A, 5, false);
+        writeReg(Dst, B - 1, 0);
+      }
+      break;
+    case C64X::callp_global:
+    case C64X::callp_extsym:
+      // the return address is the following execute packet
+      writeReg(3 + 32, NextPC, 0, false);
+      branchTo(Dst.getImm(), 5, true);
+      break;
+    case C64X::ret:
+      branchTo(Regs[3 + 32], 5, false); break;
+    case C64X::branch_reg:
+      branchTo(readReg(Dst), 5, false); break;
+    case C64X::call_reg:
+      branchTo(readReg(Dst), 5, true); break;
+
+    default:
+      fail(std::string("instruction not supported: ") +
+           TII.get(MI.getOpcode()).getName());
+  }
+  return 0;
+}
+
+// accesses the program cache for the fetch packet of Addr
+unsigned Simulator::fetch(unsigned Addr) {
+  unsigned FP = Addr & ~31U;
+  if (FP == LastFetch)
+    return 0;
+  LastFetch = FP;
+  return L1P.access(FP, true) ? 0 : Opts.L1PMissPenalty;
+}
+
+bool Simulator::step() {
+  commitWrites();
+
+  if (PC == ExitAddr) {
+    halt(Regs[4]);
+    return false;
+  }
+  if (callHost(PC))
+    return !Halted;
+
+  // the loop is done once the last iteration has issued its last cycle,
+  // fetching resumes after the SPKERNEL
+  if (Loop.Active && !Loop.Recording &&
+      ExecCycle - Loop.Start >=
+        (uint64_t) (Loop.Iterations - 1) * Loop.II + Loop.Length) {
+    Loop.Active = false;
+    Regs[ILCIdx] = 0;
+  }
+
+  // gather the execute packet, nothing is fetched while the loop buffer
+  // drains or a nop of the loop body is counted down
+  std::vector<const SimInst*> Packet;
+  unsigned FetchStall = 0, NextPC = PC;
+  if (!Loop.Active || (Loop.Recording && !Loop.NopCycles)) {
+    const SimInst *I = Prog.getInstAt(PC);
+    if (I && I->Header)
+      I = Prog.getNext(I);
+    while (I) {
+      FetchStall += fetch(I->Addr);
+      Packet.push_back(I);
+      if (!I->Parallel)
+        break;
+      I = Prog.getNext(I);
+    }
+    if (Packet.empty() || Packet.back()->Parallel) {
+      fail("no execute packet at 0x" + utohexstr(PC));
+      return false;
+    }
+
+    const SimInst *Next = Prog.getNext(Packet.back());
+    NextPC = Next ? Next->Addr : 0;
+
+    if (Loop.Active)
+      for (unsigned i = 0, e = Packet.size(); i != e; ++i) {
+        unsigned Opc = Packet[i]->Inst.getOpcode();
+        if (Opc != C64X::noop && Opc != C64X::spkernel)
+          Loop.Insts.push_back(std::make_pair(
+            (unsigned) (ExecCycle - Loop.Start), Packet[i]));
+      }
+  } else if (Loop.NopCycles)
+    --Loop.NopCycles;
+  if (Loop.Active)
+    issueLoopBuffer(Packet);
+
+  if (Opts.Trace) {
+    Out << format("%10llu", (unsigned long long) ExecCycle)
+        << format("  %08x ", PC);
+    for (unsigned i = 0, e = Packet.size(); i != e; ++i)
+      Out << (i ? " || " : " ")
+          << TII.get(Packet[i]->Inst.getOpcode()).getName();
+    Out << "\n";
+  }
+
+  unsigned XStall = checkPacket(Packet);
+
+  // all instructions read their operands before any of them writes memory
+  unsigned Cycles = 1, MemStall = 0;
+  for (unsigned i = 0, e = Packet.size(); i != e; ++i) {
+    const MCInst &MI = Packet[i]->Inst;
+    if (MI.getOpcode() == C64X::noop)
+      Cycles = std::max(Cycles, (unsigned) MI.getOperand(0).getImm());
+    if (MI.getOpcode() == C64X::callp_global ||
+        MI.getOpcode() == C64X::callp_extsym)
+      Cycles = 6;
+    MemStall = std::max(MemStall, execute(*Packet[i], NextPC));
+  }
+  for (unsigned i = 0, e = Stores.size(); i != e; ++i)
+    writeMem(Stores[i].Addr, Stores[i].Size, Stores[i].Value);
+  Stores.clear();
+
+  // the loop buffer advances cycle by cycle
+  if (Loop.Active && Cycles > 1) {
+    Loop.NopCycles = Cycles - 1;
+    Cycles = 1;
+  }
+
+  // a branch taking effect ends a multi-cycle nop
+  uint64_t NextCycle = ExecCycle + Cycles;
+  int Taken = -1;
+  for (unsigned i = 0, e = Branches.size(); i != e; ++i)
+    if (Branches[i].At <= NextCycle &&
+        (Taken < 0 || Branches[i].At < Branches[Taken].At))
+      Taken = i;
+
+  if (Taken >= 0 && Loop.Active) {
+    fail("branch taken in a software pipelined loop");
+    return false;
+  }
+  if (Taken >= 0) {
+    PendingBranch B = Branches[Taken];
+    Branches.erase(Branches.begin() + Taken);
+    Cycles = B.At - ExecCycle;
+    NextPC = B.Target;
+    int F = Prog.getFunctionAt(B.Target);
+    if (B.IsCall && F >= 0 && Prog.getFunctions()[F].Begin == B.Target)
+      ++Profile[F].Calls;
+  }
+
+  unsigned Stall = FetchStall + XStall + MemStall;
+  int F = Prog.getFunctionAt(PC);
+  if (F >= 0) {
+    Profile[F].Cycles += Cycles + Stall;
+    Profile[F].Stalls += Stall;
+  }
+
+  for (unsigned i = 0, e = Packet.size(); i != e; ++i)
+    if (Packet[i]->Inst.getOpcode() == C64X::noop) {
+      NumNopCycles += e == 1 ? Cycles : Cycles - 1;
+      break;
+    }
+  NumInsts += Packet.size();
+  ++NumPackets;
+  L1PStalls += FetchStall;
+  XPathStalls += XStall;
+  L1DStalls += MemStall;
+
+  ExecCycle += Cycles;
+  PC = NextPC;
+  return !Halted;
+}
+
+bool Simulator::run(unsigned Entry, const std::vector<std::string> &Args) {
+  Mem.assign(Opts.MemSize, 0);
+  Prog.load(&Mem[0], Opts.MemBase);
+
+  // the command line goes to the top of the memory, followed by the stack
+  unsigned Top = Opts.MemBase + Opts.MemSize;
+  std::vector<unsigned> Argv;
+  for (unsigned i = 0, e = Args.size(); i != e; ++i) {
+    Top -= Args[i].size() + 1;
+    std::copy(Args[i].begin(), Args[i].end(), &Mem[Top - Opts.MemBase]);
+    Argv.push_back(Top);
+  }
+  Argv.push_back(0);
+  Top = (Top - Argv.size() * 4) & ~7U;
+  for (unsigned i = 0, e = Argv.size(); i != e; ++i)
+    writeMem(Top + i * 4, 4, Argv[i]);
+
+  Regs[4] = Args.size();      // A4, argc
+  Regs[4 + 32] = Top;         // B4, argv
+  Regs[3 + 32] = ExitAddr;    // B3, return address
+  Regs[15 + 32] = Top - 8;    // B15, stack pointer
+  PC = Entry;
+
+  while (step())
+    if (ExecCycle + L1PStalls + L1DStalls + XPathStalls > Opts.MaxCycles) {
+      fail("cycle limit exceeded");
+      break;
+    }
+  return Error.empty();
+}
+
+//-----------------------------------------------------------------------------
+// host library
+
+unsigned Simulator::getArg(unsigned N) const {
+  // A4, B4, A6, B6, ...
+  return Regs[(N & 1) * 32 + 4 + (N >> 1) * 2];
+}
+
+uint64_t Simulator::getArg64(unsigned N) const {
+  unsigned Idx = (N & 1) * 32 + 4 + (N >> 1) * 2;
+  return (uint64_t) Regs[Idx + 1] << 32 | Regs[Idx];
+}
+
+void Simulator::setResult(unsigned Value) {
+  Regs[4] = Value;
+}
+
+void Simulator::setResult64(uint64_t Value) {
+  Regs[4] = Value;
+  Regs[5] = Value >> 32;
+}
+
+namespace {
+  typedef void (*HostFn)(Simulator &S);
+
+  struct HostFunction {
+    const char *Name;
+    HostFn Fn;
+  };
+}
+
+template<typename T> static int compare(T A, T B) {
+  return A < B ? -1 : (A > B ? 1 : 0);
+}
+
+static bool checkDivisor(Simulator &S, uint64_t D) {
+  if (!D)
+    S.fail("division by zero");
+  return D != 0;
+}
+
+static void host_divi(Simulator &S) {
+  if (checkDivisor(S, S.getArg(1)))
+    S.setResult((int) S.getArg(0) / (int) S.getArg(1));
+}
+static void host_divu(Simulator &S) {
+  if (checkDivisor(S, S.getArg(1)))
+    S.setResult(S.getArg(0) / S.getArg(1));
+}
+static void host_remi(Simulator &S) {
+  if (checkDivisor(S, S.getArg(1)))
+    S.setResult((int) S.getArg(0) % (int) S.getArg(1));
+}
+static void host_remu(Simulator &S) {
+  if (checkDivisor(S, S.getArg(1)))
+    S.setResult(S.getArg(0) % S.getArg(1));
+}
+static void host_mpyll(Simulator &S) {
+  S.setResult64(S.getArg64(0) * S.getArg64(1));
+}
+static void host_divlli(Simulator &S) {
+  if (checkDivisor(S, S.getArg64(1)))
+    S.setResult64((int64_t) S.getArg64(0) / (int64_t) S.getArg64(1));
+}
+static void host_divull(Simulator &S) {
+  if (checkDivisor(S, S.getArg64(1)))
+    S.setResult64(S.getArg64(0) / S.getArg64(1));
+}
+static void host_remlli(Simulator &S) {
+  if (checkDivisor(S, S.getArg64(1)))
+    S.setResult64((int64_t) S.getArg64(0) % (int64_t) S.getArg64(1));
+}
+static void host_remull(Simulator &S) {
+  if (checkDivisor(S, S.getArg64(1)))
+    S.setResult64(S.getArg64(0) % S.getArg64(1));
+}
+
+#define FLOAT_ARG(n) toFloat(S.getArg(n))
+#define DOUBLE_ARG(n) toDouble(S.getArg64(n))
+
+static void host_addf(Simulator &S) {
+  S.setResult(fromFloat(FLOAT_ARG(0) + FLOAT_ARG(1)));
+}
+static void host_subf(Simulator &S) {
+  S.setResult(fromFloat(FLOAT_ARG(0) - FLOAT_ARG(1)));
+}
+static void host_mpyf(Simulator &S) {
+  S.setResult(fromFloat(FLOAT_ARG(0) * FLOAT_ARG(1)));
+}
+static void host_divf(Simulator &S) {
+  S.setResult(fromFloat(FLOAT_ARG(0) / FLOAT_ARG(1)));
+}
+static void host_cmpf(Simulator &S) {
+  S.setResult(compare(FLOAT_ARG(0), FLOAT_ARG(1)));
+}
+static void host_addd(Simulator &S) {
+  S.setResult64(fromDouble(DOUBLE_ARG(0) + DOUBLE_ARG(1)));
+}
+static void host_subd(Simulator &S) {
+  S.setResult64(fromDouble(DOUBLE_ARG(0) - DOUBLE_ARG(1)));
+}
+static void host_mpyd(Simulator &S) {
+  S.setResult64(fromDouble(DOUBLE_ARG(0) * DOUBLE_ARG(1)));
+}
+static void host_divd(Simulator &S) {
+  S.setResult64(fromDouble(DOUBLE_ARG(0) / DOUBLE_ARG(1)));
+}
+static void host_cmpd(Simulator &S) {
+  S.setResult(compare(DOUBLE_ARG(0), DOUBLE_ARG(1)));
+}
+
+static void host_cvtdf(Simulator &S) {
+  S.setResult(fromFloat((float) DOUBLE_ARG(0)));
+}
+static void host_cvtfd(Simulator &S) {
+  S.setResult64(fromDouble(FLOAT_ARG(0)));
+}
+static void host_fixdi(Simulator &S) {
+  S.setResult((int) DOUBLE_ARG(0));
+}
+static void host_fixdu(Simulator &S) {
+  S.setResult((unsigned) DOUBLE_ARG(0));
+}
+static void host_fixfi(Simulator &S) {
+  S.setResult((int) FLOAT_ARG(0));
+}
+static void host_fixfu(Simulator &S) {
+  S.setResult((unsigned) FLOAT_ARG(0));
+}
+static void host_fixdlli(Simulator &S) {
+  S.setResult64((int64_t) DOUBLE_ARG(0));
+}
+static void host_fixdull(Simulator &S) {
+  S.setResult64((uint64_t) DOUBLE_ARG(0));
+}
+static void host_fixflli(Simulator &S) {
+  S.setResult64((int64_t) FLOAT_ARG(0));
+}
+static void host_fixfull(Simulator &S) {
+  S.setResult64((uint64_t) FLOAT_ARG(0));
+}
+static void host_fltid(Simulator &S) {
+  S.setResult64(fromDouble((int) S.getArg(0)));
+}
+static void host_fltif(Simulator &S) {
+  S.setResult(fromFloat((int) S.getArg(0)));
+}
+static void host_fltud(Simulator &S) {
+  S.setResult64(fromDouble(S.getArg(0)));
+}
+static void host_fltuf(Simulator &S) {
+  S.setResult(fromFloat(S.getArg(0)));
+}
+static void host_fltllid(Simulator &S) {
+  S.setResult64(fromDouble((int64_t) S.getArg64(0)));
+}
+static void host_fltulld(Simulator &S) {
+  S.setResult64(fromDouble(S.getArg64(0)));
+}
+static void host_fltllif(Simulator &S) {
+  S.setResult(fromFloat((int64_t) S.getArg64(0)));
+}
+static void host_fltullf(Simulator &S) {
+  S.setResult(fromFloat(S.getArg64(0)));
+}
+
+#undef FLOAT_ARG
+#undef DOUBLE_ARG
+
+// the mem* functions are charged one cycle per double word
+static void host_memmove(Simulator &S) {
+  unsigned Dst = S.getArg(0), Src = S.getArg(1), N = S.getArg(2);
+  std::vector<uint64_t> Buf(N);
+  for (unsigned i = 0; i != N; ++i)
+    if (!S.readMem(Src + i, 1, Buf[i]))
+      return;
+  for (unsigned i = 0; i != N; ++i)
+    if (!S.writeMem(Dst + i, 1, Buf[i]))
+      return;
+  S.addHostCycles(N / 8);
+  S.setResult(Dst);
+}
+static void host_memset(Simulator &S) {
+  unsigned Dst = S.getArg(0), N = S.getArg(2);
+  for (unsigned i = 0; i != N; ++i)
+    if (!S.writeMem(Dst + i, 1, S.getArg(1)))
+      return;
+  S.addHostCycles(N / 8);
+  S.setResult(Dst);
+}
+static void host_strlen(Simulator &S) {
+  unsigned N = 0;
+  uint64_t C;
+  while (S.readMem(S.getArg(0) + N, 1, C) && C)
+    ++N;
+  S.addHostCycles(N / 4);
+  S.setResult(N);
+}
+static void host_putchar(Simulator &S) {
+  S.getOutput() << (char) S.getArg(0);
+  S.setResult(S.getArg(0) & 0xff);
+}
+static void host_puts(Simulator &S) {
+  uint64_t C;
+  for (unsigned Addr = S.getArg(0); S.readMem(Addr, 1, C) && C; ++Addr)
+    S.getOutput() << (char) C;
+  S.getOutput() << '\n';
+  S.setResult(0);
+}
+static void host_abort(Simulator &S) {
+  S.fail("abort called");
+}
+static void host_exit(Simulator &S) {
+  S.halt(S.getArg(0));
+}
+
+#define HOST_FN(Name) { #Name, host_##Name }
+#define HOST_ABI_FN(Name) { "__c6xabi_" #Name, host_##Name }
+
+static const HostFunction HostFunctions[] = {
+  HOST_ABI_FN(divi), HOST_ABI_FN(divu), HOST_ABI_FN(remi), HOST_ABI_FN(remu),
+  { "__divu", host_divu }, { "__remu", host_remu },
+  HOST_ABI_FN(mpyll), HOST_ABI_FN(divlli), HOST_ABI_FN(divull),
+  HOST_ABI_FN(remlli), HOST_ABI_FN(remull),
+  HOST_ABI_FN(addf), HOST_ABI_FN(subf), HOST_ABI_FN(mpyf), HOST_ABI_FN(divf),
+  HOST_ABI_FN(cmpf),
+  HOST_ABI_FN(addd), HOST_ABI_FN(subd), HOST_ABI_FN(mpyd), HOST_ABI_FN(divd),
+  HOST_ABI_FN(cmpd),
+  HOST_ABI_FN(cvtdf), HOST_ABI_FN(cvtfd),
+  HOST_ABI_FN(fixdi), HOST_ABI_FN(fixdu), HOST_ABI_FN(fixfi),
+  HOST_ABI_FN(fixfu), HOST_ABI_FN(fixdlli), HOST_ABI_FN(fixdull),
+  HOST_ABI_FN(fixflli), HOST_ABI_FN(fixfull),
+  HOST_ABI_FN(fltid), HOST_ABI_FN(fltif), HOST_ABI_FN(fltud),
+  HOST_ABI_FN(fltuf), HOST_ABI_FN(fltllid), HOST_ABI_FN(fltulld),
+  HOST_ABI_FN(fltllif), HOST_ABI_FN(fltullf),
+  { "memcpy", host_memmove }, HOST_FN(memmove), HOST_FN(memset),
+  HOST_FN(strlen), HOST_FN(putchar), HOST_FN(puts),
+  HOST_FN(abort), HOST_FN(exit)
+};
+
+#undef HOST_FN
+#undef HOST_ABI_FN
+
+static HostFn findHostFunction(StringRef Name) {
+  for (unsigned i = 0, e = array_lengthof(HostFunctions); i != e; ++i)
+    if (Name == HostFunctions[i].Name)
+      return HostFunctions[i].Fn;
+  return 0;
+}
+
+bool c64xsim::isHostFunction(StringRef Name) {
+  return findHostFunction(Name) != 0;
+}
+
+// runs the host function at Addr, if there is one. The call costs a fixed
+// number of cycles, and returns to B3.
+bool Simulator::callHost(unsigned Addr) {
+  StringRef Name = Prog.getHostFunction(Addr);
+  if (Name.empty())
+    return false;
+
+  if (Opts.Trace)
+    Out << format("%10llu", (unsigned long long) ExecCycle)
+        << "  host call " << Name << "\n";
+
+  uint64_t Before = NumHostCycles;
+  NumHostCycles += Opts.HostCallCycles;
+  findHostFunction(Name)(*this);
+  uint64_t Cycles = NumHostCycles - Before;
+
+  // host functions are profiled as well, the call was counted on arrival
+  int F = Prog.getFunctionAt(Addr);
+  if (F >= 0)
+    Profile[F].Cycles += Cycles;
+
+  ExecCycle += Cycles;
+  PC = Regs[3 + 32];
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+// reports
+
+void Simulator::printStatistics(raw_ostream &OS) const {
+  uint64_t Stalls = XPathStalls + L1PStalls + L1DStalls;
+  OS << "cycles:             " << ExecCycle + Stalls << "\n"
+     << "  execution:        " << ExecCycle << "\n"
+     << "  host functions:   " << NumHostCycles << "\n"
+     << "  nop:              " << NumNopCycles << "\n"
+     << "  stalls:           " << Stalls << "\n"
+     << "    cross path:     " << XPathStalls << "\n"
+     << "    L1P miss:       " << L1PStalls << "\n"
+     << "    L1D miss:       " << L1DStalls << "\n"
+     << "execute packets:    " << NumPackets << "\n"
+     << "instructions:       " << NumInsts << "\n";
+  if (NumPackets)
+    OS << "  per packet:       "
+       << format("%.2f", (double) NumInsts / NumPackets) << "\n";
+  if (L1P.isEnabled())
+    OS << "L1P hits/misses:    " << L1P.Hits << " / " << L1P.Misses << "\n";
+  if (L1D.isEnabled())
+    OS << "L1D hits/misses:    " << L1D.Hits << " / " << L1D.Misses << "\n";
+  if (NumConflicts)
+    OS << "resource conflicts: " << NumConflicts << "\n";
+  OS << "code size:          " << Prog.getCodeSize() << " bytes\n";
+}
+
+void Simulator::printProfile(raw_ostream &OS) const {
+  const std::vector<SimFunction> &Fns = Prog.getFunctions();
+
+  std::vector<std::pair<uint64_t, unsigned> > Order;
+  for (unsigned i = 0, e = Fns.size(); i != e; ++i)
+    if (Profile[i].Cycles || Profile[i].Calls)
+      Order.push_back(std::make_pair(Profile[i].Cycles, i));
+  std::sort(Order.rbegin(), Order.rend());
+
+  OS << "      cycles     stalls    calls  function\n";
+  for (unsigned i = 0, e = Order.size(); i != e; ++i) {
+    unsigned F = Order[i].second;
+    OS << format("%12llu ", (unsigned long long) Profile[F].Cycles)
+       << format("%10llu ", (unsigned long long) Profile[F].Stalls)
+       << format("%8llu  ", (unsigned long long) Profile[F].Calls)
+       << Fns[F].Name << (Fns[F].IsHost ? " (host)" : "") << "\n";
+  }
+}
@@ -0,0 +1,207 @@
+//===-- Simulator.h - Execute packet simulator for the C64x+ ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Cycle accurate simulation of linked SimPrograms. The model follows the
+// C64x+ pipeline as seen by the compiler: execute packets issue in order, the
+// results become visible after the delay slots of their instructions, and
+// branches take effect after five delay slots. SPLOOP/SPKERNEL loops issue
+// the iterations after the first one from the loop buffer, the code after the
+// SPKERNEL runs once the last iteration is complete (fstg and fcyc 0, neither
+// SPLOOPD/SPLOOPW nor SPKERNELR or SPMASK are modelled). Stalls freeze the
+// whole pipeline, they are accounted separately from the execution cycles:
+//
+//   - a cross path read of a register loaded in the previous cycle
+//   - L1P misses (direct mapped, per fetch packet)
+//   - L1D read misses (2-way set associative, LRU, read allocate)
+//
+// Library functions the program does not define are implemented by the host
+// at a fixed cost.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef C64X_SIM_SIMULATOR_H
+#define C64X_SIM_SIMULATOR_H
+
+#include "SimProgram.h"
+#include "llvm/Support/DataTypes.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class raw_ostream;
+  class TargetInstrInfo;
+  class TargetMachine;
+  class TargetRegisterInfo;
+
+namespace c64xsim {
+
+  /// SimCache - tag store of a set associative cache with LRU replacement,
+  /// the data itself lives in the memory image.
+  class SimCache {
+    unsigned LineShift, NumSets, NumWays;
+    std::vector<unsigned> Tags; // ~0U for invalid lines
+    std::vector<unsigned> Ages;
+    unsigned Clock;
+
+  public:
+    uint64_t Hits, Misses;
+
+    SimCache() : LineShift(0), NumSets(0), NumWays(0), Clock(0),
+                 Hits(0), Misses(0) {}
+
+    /// configures the cache, a size of 0 disables it (all accesses hit)
+    void init(unsigned Size, unsigned LineSize, unsigned Ways);
+    bool isEnabled() const { return NumSets != 0; }
+
+    /// looks up the line of Addr, returns true on a hit. Misses allocate
+    /// the line if Allocate is set.
+    bool access(unsigned Addr, bool Allocate);
+  };
+
+  struct SimOptions {
+    unsigned MemBase, MemSize;
+    unsigned L1PSize, L1PMissPenalty;
+    unsigned L1DSize, L1DMissPenalty;
+    unsigned HostCallCycles;
+    uint64_t MaxCycles;
+    bool Trace;
+  };
+
+  class Simulator {
+  public:
+    /// return address of the entry function, the simulation ends when it is
+    /// reached
+    enum { ExitAddr = 0x00000100 };
+
+  private:
+    const SimProgram &Prog;
+    const TargetInstrInfo &TII;
+    const TargetRegisterInfo &TRI;
+    SimOptions Opts;
+    raw_ostream &Out;
+
+    // A0-A31, B0-B31 and the control registers modelled, the AMR and ILC
+    enum { AMRIdx = 64, ILCIdx = 65, NumRegs = 66 };
+
+    std::vector<unsigned char> Mem;
+    unsigned Regs[NumRegs];
+    std::vector<int> RegIndex;  // physical register (or pair) to Regs index
+
+    // results in flight, they are visible from cycle ReadyAt on
+    struct PendingWrite {
+      unsigned Reg, Value;
+      uint64_t ReadyAt;
+      bool IsLoad;
+    };
+    std::vector<PendingWrite> Writes;
+    uint64_t LoadReadyAt[NumRegs];   // when a load last wrote the register
+    uint64_t UnitBusyUntil[8];       // first cycle the unit accepts an insn
+
+    struct PendingBranch {
+      unsigned Target;
+      uint64_t At;
+      bool IsCall;
+    };
+    std::vector<PendingBranch> Branches;
+
+    struct PendingStore {
+      unsigned Addr, Size;
+      uint64_t Value;
+    };
+    std::vector<PendingStore> Stores;
+
+    // the SPLOOP buffer, instructions of the first iteration are recorded
+    // with their cycle relative to Start
+    struct LoopBuffer {
+      bool Active, Recording;
+      unsigned II, Iterations, Length, NopCycles;
+      uint64_t Start;
+      std::vector<std::pair<unsigned, const SimInst*> > Insts;
+    };
+    LoopBuffer Loop;
+
+    unsigned PC, LastFetch;
+    uint64_t ExecCycle;         // cycles of the pipeline, without stalls
+    bool Halted;
+    int ExitCode;
+    std::string Error;
+
+    SimCache L1P, L1D;
+
+    // statistics
+    uint64_t NumPackets, NumInsts, NumNopCycles, NumHostCycles;
+    uint64_t XPathStalls, L1PStalls, L1DStalls;
+    unsigned NumConflicts;
+
+    struct FunctionProfile {
+      uint64_t Cycles, Stalls, Calls;
+    };
+    std::vector<FunctionProfile> Profile;
+
+    int getReg(const MCOperand &MO) const;
+    unsigned readReg(const MCOperand &MO) const;
+    uint64_t readPair(const MCOperand &MO) const;
+    void writeReg(unsigned Idx, unsigned Value, unsigned Delay, bool IsLoad);
+    void writeReg(const MCOperand &MO, unsigned Value, unsigned Delay,
+                  bool IsLoad = false);
+    void commitWrites();
+
+    bool isExecuted(const MCInst &MI) const;
+    void getUnitUse(const MCInst &MI, int &Unit, int &Side, int &DataSide,
+                    bool &XPath) const;
+    unsigned checkPacket(const std::vector<const SimInst*> &Packet);
+    void issueLoopBuffer(std::vector<const SimInst*> &Packet);
+
+    unsigned execute(const SimInst &I, unsigned NextPC);
+    unsigned executeMem(const MCInst &MI, unsigned Delay);
+    void branchTo(unsigned Target, unsigned Delay, bool IsCall);
+    bool callHost(unsigned Addr);
+
+    unsigned fetch(unsigned Addr);
+    bool step();
+
+  public:
+    Simulator(const SimProgram &P, const TargetMachine &TM,
+              const SimOptions &Opts, raw_ostream &Out);
+
+    /// runs the function at Entry with the given command line, returns false
+    /// if the simulation failed (see getError)
+    bool run(unsigned Entry, const std::vector<std::string> &Args);
+
+    int getExitCode() const { return ExitCode; }
+    const std::string &getError() const { return Error; }
+
+    void printStatistics(raw_ostream &OS) const;
+    void printProfile(raw_ostream &OS) const;
+
+    //--- interface of the host implemented library functions
+
+    /// returns the 32-bit argument in the Nth argument register
+    unsigned getArg(unsigned N) const;
+    /// returns the 64-bit argument in the Nth argument register pair
+    uint64_t getArg64(unsigned N) const;
+    void setResult(unsigned Value);
+    void setResult64(uint64_t Value);
+
+    bool readMem(unsigned Addr, unsigned Size, uint64_t &Value);
+    bool writeMem(unsigned Addr, unsigned Size, uint64_t Value);
+
+    void addHostCycles(unsigned Cycles) { NumHostCycles += Cycles; }
+    void halt(int Code) { Halted = true; ExitCode = Code; }
+    void fail(const std::string &Msg);
+    raw_ostream &getOutput() { return Out; }
+  };
+
+  /// returns true if the simulator implements the named library function
+  bool isHostFunction(StringRef Name);
+
+} // namespace c64xsim
+} // namespace llvm
+
+#endif
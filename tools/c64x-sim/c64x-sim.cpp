@@ -0,0 +1,258 @@
+//===-- c64x-sim.cpp - Cycle accurate simulator for the C64x+ -------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// c64x-sim compiles a module with the TMS320C64X backend and runs it on a
+// cycle accurate model of the C64x+ core, in the spirit of lli. The backend is
+// run exactly as for "llc -filetype=obj", all codegen options of llc apply.
+//
+//   c64x-sim [options] <input bitcode> <program arguments>...
+//
+// The simulation reports the cycles spent, the stalls by cause, the cache
+// statistics and (with -profile) a per function profile. The exit code of
+// the tool is the one returned by the simulated program.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SimProgram.h"
+#include "Simulator.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Module.h"
+#include "llvm/PassManager.h"
+#include "llvm/CodeGen/LinkAllAsmWriterComponents.h"
+#include "llvm/CodeGen/LinkAllCodegenComponents.h"
+#include "llvm/MC/MCCodeEmitter.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FormattedStream.h"
+#include "llvm/Support/IRReader.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/SubtargetFeature.h"
+#include "llvm/Target/TargetAsmBackend.h"
+#include "llvm/Target/TargetData.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetRegistry.h"
+#include <memory>
+
+using namespace llvm;
+using namespace c64xsim;
+
+extern "C" {
+  void LLVMInitializeTMS320C64XTargetInfo();
+  void LLVMInitializeTMS320C64XTarget();
+  void LLVMInitializeTMS320C64XAsmPrinter();
+}
+
+namespace llvm {
+  extern Target TheTMS320C64XTarget;
+}
+
+static cl::opt<std::string>
+InputFile(cl::desc("<input bitcode>"), cl::Positional, cl::init("-"));
+
+static cl::list<std::string>
+InputArgv(cl::ConsumeAfter, cl::desc("<program arguments>..."));
+
+static cl::opt<char>
+OptLevel("O", cl::desc("Optimization level. [-O0, -O1, -O2, or -O3] "
+                       "(default = '-O2')"),
+         cl::Prefix, cl::ZeroOrMore, cl::init(' '));
+
+static cl::opt<std::string>
+MCPU("mcpu", cl::desc("Target a specific cpu type (-mcpu=help for details)"),
+     cl::value_desc("cpu-name"), cl::init(""));
+
+static cl::list<std::string>
+MAttrs("mattr", cl::CommaSeparated,
+       cl::desc("Target specific attributes (-mattr=help for details)"),
+       cl::value_desc("a1,+a2,-a3,..."));
+
+static cl::opt<std::string>
+EntryFunc("entry", cl::desc("Function to call (default: main)"),
+          cl::value_desc("function"), cl::init("main"));
+
+static cl::opt<bool>
+Trace("trace", cl::desc("Print every execute packet issued"));
+
+static cl::opt<bool>
+PrintProfile("profile", cl::desc("Print the per function profile"));
+
+static cl::opt<unsigned long long>
+MaxCycles("max-cycles", cl::desc("Abort the simulation after N cycles"),
+          cl::init(1000000000ULL));
+
+static cl::opt<unsigned>
+MemSize("mem-size", cl::desc("Size of the simulated memory in KB "
+                             "(default: 16384)"), cl::init(16384));
+
+static cl::opt<unsigned>
+L1PSize("l1p-size", cl::desc("L1P size in KB, 0 for an ideal program memory "
+                             "(default: 32)"), cl::init(32));
+
+static cl::opt<unsigned>
+L1PMissPenalty("l1p-miss-penalty", cl::desc("Stall cycles of a L1P miss"),
+               cl::init(8));
+
+static cl::opt<unsigned>
+L1DSize("l1d-size", cl::desc("L1D size in KB, 0 for an ideal data memory "
+                             "(default: 32)"), cl::init(32));
+
+static cl::opt<unsigned>
+L1DMissPenalty("l1d-miss-penalty", cl::desc("Stall cycles of a L1D read miss"),
+               cl::init(10));
+
+static cl::opt<unsigned>
+HostCallCycles("host-call-cycles",
+               cl::desc("Cycles charged for a call of a host implemented "
+                        "library function"), cl::init(30));
+
+//-----------------------------------------------------------------------------
+
+// internal memory of the C64x+ devices starts at 0x00800000
+static const unsigned MemBase = 0x00800000;
+
+// the program the capture streamer writes to
+static SimProgram *TheProgram;
+
+// replaces the ELF streamer of the target, the code emitter and the asm
+// backend are not needed.
+static MCStreamer *createCaptureStreamer(const Target &T,
+                                         const std::string &TT,
+                                         MCContext &Ctx,
+                                         TargetAsmBackend &TAB,
+                                         raw_ostream &OS,
+                                         MCCodeEmitter *Emitter,
+                                         bool RelaxAll,
+                                         bool NoExecStack) {
+  delete Emitter;
+  delete &TAB;
+  return TheProgram->createStreamer(Ctx);
+}
+
+//-----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+
+  LLVMContext &Context = getGlobalContext();
+  llvm_shutdown_obj Y;
+
+  // the object streamer is only registered if there is none yet, so ours
+  // must come before the target initialization
+  LLVMInitializeTMS320C64XTargetInfo();
+  TargetRegistry::RegisterObjectStreamer(TheTMS320C64XTarget,
+                                         createCaptureStreamer);
+  LLVMInitializeTMS320C64XTarget();
+  LLVMInitializeTMS320C64XAsmPrinter();
+
+  cl::ParseCommandLineOptions(argc, argv,
+                              "cycle accurate C64x+ simulator\n");
+
+  SMDiagnostic Err;
+  std::auto_ptr<Module> M(ParseIRFile(InputFile, Err, Context));
+  if (!M.get()) {
+    Err.Print(argv[0], errs());
+    return 1;
+  }
+
+  std::string FeaturesStr;
+  if (MCPU.size() || MAttrs.size()) {
+    SubtargetFeatures Features;
+    Features.setCPU(MCPU);
+    for (unsigned i = 0; i != MAttrs.size(); ++i)
+      Features.AddFeature(MAttrs[i]);
+    FeaturesStr = Features.getString();
+  }
+
+  std::auto_ptr<TargetMachine>
+    Target(TheTMS320C64XTarget.createTargetMachine("tms320c64x-unknown-elf",
+                                                   FeaturesStr));
+  assert(Target.get() && "Could not allocate target machine!");
+
+  CodeGenOpt::Level OLvl = CodeGenOpt::Default;
+  switch (OptLevel) {
+    default:
+      errs() << argv[0] << ": invalid optimization level.\n";
+      return 1;
+    case ' ': break;
+    case '0': OLvl = CodeGenOpt::None; break;
+    case '1': OLvl = CodeGenOpt::Less; break;
+    case '2': OLvl = CodeGenOpt::Default; break;
+    case '3': OLvl = CodeGenOpt::Aggressive; break;
+  }
+
+  // compile the module into the program image
+  SimProgram Program;
+  TheProgram = &Program;
+  for (Module::iterator F = M->begin(), E = M->end(); F != E; ++F)
+    if (!F->isDeclaration())
+      Program.addFunctionName(F->getName());
+
+  {
+    PassManager PM;
+    PM.add(new TargetData(*Target->getTargetData()));
+
+    std::string Buffer;
+    raw_string_ostream OS(Buffer);
+    formatted_raw_ostream FOS(OS);
+    if (Target->addPassesToEmitFile(PM, FOS, TargetMachine::CGFT_ObjectFile,
+                                    OLvl)) {
+      errs() << argv[0] << ": target does not support object emission\n";
+      return 1;
+    }
+    PM.run(*M);
+
+    // the symbols live in the MCContext of the passes
+    if (!Program.link(MemBase, isHostFunction)) {
+      errs() << argv[0] << ": " << Program.getError() << "\n";
+      return 1;
+    }
+  }
+
+  unsigned Entry = Program.getFunctionAddr(EntryFunc);
+  if (!Entry) {
+    errs() << argv[0] << ": function '" << EntryFunc << "' not found\n";
+    return 1;
+  }
+
+  SimOptions Opts;
+  Opts.MemBase = MemBase;
+  Opts.MemSize = MemSize * 1024;
+  Opts.L1PSize = L1PSize * 1024;
+  Opts.L1PMissPenalty = L1PMissPenalty;
+  Opts.L1DSize = L1DSize * 1024;
+  Opts.L1DMissPenalty = L1DMissPenalty;
+  Opts.HostCallCycles = HostCallCycles;
+  Opts.MaxCycles = MaxCycles;
+  Opts.Trace = Trace;
+
+  if (Program.getDataEnd() > Opts.MemBase + Opts.MemSize) {
+    errs() << argv[0] << ": the program does not fit into the memory\n";
+    return 1;
+  }
+
+  // argv[0] of the program is the name of the input
+  std::vector<std::string> Args;
+  Args.push_back(InputFile);
+  Args.insert(Args.end(), InputArgv.begin(), InputArgv.end());
+
+  Simulator Sim(Program, *Target, Opts, outs());
+  bool Success = Sim.run(Entry, Args);
+  outs().flush();
+
+  if (!Success)
+    errs() << argv[0] << ": simulation failed: " << Sim.getError() << "\n";
+  Sim.printStatistics(errs());
+  if (PrintProfile)
+    Sim.printProfile(errs());
+
+  return Success ? Sim.getExitCode() : 1;
+}